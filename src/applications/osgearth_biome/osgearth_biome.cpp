@@ -30,6 +30,7 @@
 #include <osgEarth/Lighting>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/PhongLightingEffect>
+#include <osgEarth/Registry>
 
 #include <osgEarthProcedural/BiomeLayer>
 #include <osgEarthProcedural/BiomeManager>
@@ -41,6 +42,7 @@
 #include <osgDB/WriteFile>
 #include <osg/Uniform>
 #include <iostream>
+#include <chrono>
 
 #define LC "[osgearth_biome] "
 
@@ -54,6 +56,11 @@ usage(const char* name)
     OE_NOTICE
         << "\nUsage: " << name
         << "\n   --encode-texture [filename]"
+        << "\n   --benchmark-lifemap file.earth"
+        << "\n       [--lod n]          LOD of the tiles to create (default = 14)"
+        << "\n       [--tiles n]        Tiles per side of the sample area (default = 4)"
+        << "\n       [--lon x --lat y]  Center of the sample area (default = 0,0)"
+        << "\n       [--threads a,b,c]  Thread counts to compare (default = 1,2,4,8)"
         << std::endl;
     return 0;
 }
@@ -80,6 +87,99 @@ encodeTexture(osg::ArgumentParser& args)
     return 0;
 }
 
+int
+benchmarkLifeMap(osg::ArgumentParser& args)
+{
+    args.read("--benchmark-lifemap");
+
+    unsigned lod = 14u;
+    args.read("--lod", lod);
+
+    unsigned tilesPerSide = 4u;
+    args.read("--tiles", tilesPerSide);
+
+    double lon = 0.0, lat = 0.0;
+    args.read("--lon", lon);
+    args.read("--lat", lat);
+
+    std::vector<unsigned> threadCounts = { 1u, 2u, 4u, 8u };
+    std::string threadList;
+    if (args.read("--threads", threadList))
+    {
+        threadCounts.clear();
+        StringVector tokens;
+        StringTokenizer(threadList, tokens, ",", "", false, true);
+        for (auto& token : tokens)
+            threadCounts.push_back(std::max(1u, as<unsigned>(token, 1u)));
+    }
+
+    // Time the rasterizer, not the cache.
+    Registry::instance()->setOverrideCachePolicy(CachePolicy::NO_CACHE);
+
+    osg::ref_ptr<MapNode> mapNode = MapNode::load(args);
+    if (!mapNode.valid())
+        return usage(args[0]);
+
+    LifeMapLayer* lifemap = mapNode->getMap()->getLayer<LifeMapLayer>();
+    if (!lifemap || !lifemap->isOpen())
+    {
+        OE_WARN << LC << "No open LifeMapLayer in the map" << std::endl;
+        return -1;
+    }
+
+    TileKey center = lifemap->getProfile()->createTileKey(lon, lat, lod);
+    if (!center.valid())
+    {
+        OE_WARN << LC << "Invalid location or LOD" << std::endl;
+        return -1;
+    }
+
+    std::vector<TileKey> keys;
+    int half = (int)tilesPerSide / 2;
+    for (int y = 0; y < (int)tilesPerSide; ++y)
+    {
+        for (int x = 0; x < (int)tilesPerSide; ++x)
+        {
+            TileKey key = center.createNeighborKey(x - half, y - half);
+            if (key.valid())
+                keys.push_back(key);
+        }
+    }
+
+    auto pass = [&]()
+    {
+        lifemap->bumpRevision();
+        unsigned pixels = 0u;
+        auto start = std::chrono::steady_clock::now();
+        for (auto& key : keys)
+        {
+            GeoImage image = lifemap->createImage(key);
+            if (image.valid())
+                pixels += image.getImage()->s() * image.getImage()->t();
+        }
+        auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(ms, pixels);
+    };
+
+    // warm up (loads the source layers' own caches, shaders, etc.)
+    pass();
+
+    std::cout << "LifeMap benchmark: " << keys.size() << " tiles at LOD " << lod << std::endl;
+
+    for (auto threads : threadCounts)
+    {
+        lifemap->setThreads(threads);
+        auto result = pass();
+        std::cout
+            << "  threads = " << threads
+            << "  ms/tile = " << (result.first / (double)std::max((std::size_t)1, keys.size()))
+            << "  Mpixels/s = " << (result.first > 0.0 ? (double)result.second / (result.first * 1000.0) : 0.0)
+            << std::endl;
+    }
+
+    return 0;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -89,6 +189,9 @@ main(int argc, char** argv)
 
     if (arguments.find("--encode-texture") >= 0)
         return encodeTexture(arguments);
+
+    if (arguments.find("--benchmark-lifemap") >= 0)
+        return benchmarkLifeMap(arguments);
     
     return usage(argv[0]);
 }
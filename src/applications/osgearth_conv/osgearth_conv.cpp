@@ -60,6 +60,7 @@ int usage(char** argv)
         << "\n    --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy"
         << "\n    --no-overwrite                      : skip tiles that already exist in the destination"
         << "\n    --threads [int]                     : go faster by using [n] working threads"
+        << "\n    --layer-stats                       : print tile timing and cache statistics for the input layer"
         << std::endl;
 
     return 0;
@@ -337,6 +338,8 @@ main(int argc, char** argv)
 
     osgDB::readCommandLine(args);
 
+    bool printLayerStats = args.read("--layer-stats");
+
     if (args.read("--pause"))
     {
         std::cout << "Press enter to continue" << std::endl;
@@ -654,5 +657,10 @@ main(int argc, char** argv)
         << osg::Timer::instance()->delta_s(t0, t1)
         << " seconds." << std::endl;
 
+    if (printLayerStats)
+    {
+        input->getTileStatistics().print(std::cout, "Input layer \"" + input->getName() + "\"");
+    }
+
     return 0;
 }
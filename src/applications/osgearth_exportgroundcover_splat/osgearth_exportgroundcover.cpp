@@ -29,6 +29,9 @@
 #include <osgEarthSplat/GroundCoverLayer>
 #include <osgEarthSplat/NoiseTextureFactory>
 #include <osgEarthSplat/GroundCoverFeatureGenerator>
+#include <osgEarthSplat/GroundCoverInstanceGenerator>
+#include <thread>
+#include <cfloat>
 
 #define LC "[exportgroundcover] "
 
@@ -47,6 +50,9 @@ usage(const char* name, const std::string& error)
         << "\n  --extents swlong swlat nelong nelat  ; extents in degrees"
         << "\n  --out out.shp                        ; output features"
         << "\n  --include-billboard-property <name>  ; include billboard property name as attribute (optional)"
+        << "\n  --instances                          ; export with the CPU port of the compute shader (optional)"
+        << "\n  --benchmark                          ; time instance generation instead of exporting (--out not required)"
+        << "\n  --iterations n                       ; benchmark iterations per configuration (default 3)"
         << std::endl;
 
     return -1;
@@ -58,7 +64,12 @@ struct App
     GroundCoverLayer* gclayer;
     GeoExtent extent;
     GroundCoverFeatureGenerator featureGen;
+    GroundCoverInstanceGenerator instanceGen;
+    osg::ref_ptr<TerrainTileModelFactory> factory;
     osg::ref_ptr<OGRFeatureSource> outfs;
+    bool useInstances = false;
+    bool benchmark = false;
+    unsigned iterations = 3u;
 
     Threading::Mutexed<std::queue<FeatureList*> > outputQueue;
     Threading::Event gate;
@@ -78,8 +89,13 @@ struct App
             return usage(argv[0], "Missing --extents");
         extent = GeoExtent(SpatialReference::get("wgs84"), xmin, ymin, xmax, ymax);
 
+        useInstances = arguments.read("--instances");
+        benchmark = arguments.read("--benchmark");
+        arguments.read("--iterations", iterations);
+        iterations = std::max(iterations, 1u);
+
         std::string outfile;
-        if (!arguments.read("--out", outfile))
+        if (!arguments.read("--out", outfile) && !benchmark)
             return usage(argv[0], "Missing --out");
 
         mapNode = MapNode::load(arguments);
@@ -92,19 +108,34 @@ struct App
         if (!gclayer)
             return usage(argv[0], "Cannot find --layer in map; check the layer name");
 
+        factory = new TerrainTileModelFactory(mapNode->options().terrain().get());
+
         featureGen.setMap(map);
         featureGen.setLayer(gclayer);
-        featureGen.setFactory(new TerrainTileModelFactory(mapNode->options().terrain().get()));
+        featureGen.setFactory(factory.get());
 
         if (featureGen.getStatus().isError())
             return usage(argv[0], featureGen.getStatus().message());
 
+        if (useInstances || benchmark)
+        {
+            instanceGen.setLayer(gclayer, map);
+        }
+
+        if (benchmark)
+            return 0;
+
         // create output shapefile
         osg::ref_ptr<FeatureProfile> outProfile = new FeatureProfile(extent);
         FeatureSchema outSchema;
         outSchema["elevation"] = ATTRTYPE_DOUBLE;
         outSchema["width"] = ATTRTYPE_DOUBLE;
         outSchema["height"] = ATTRTYPE_DOUBLE;
+        if (useInstances)
+        {
+            outSchema["side_index"] = ATTRTYPE_INT;
+            outSchema["top_index"] = ATTRTYPE_INT;
+        }
 
         std::string prop;
         while (arguments.read("--include-billboard-property", prop))
@@ -127,15 +158,150 @@ struct App
         // even if the output if empty, we still must push a FeatureList
         // to the output queue b/c it's expecting an exact number of keys.
         FeatureList* output = new FeatureList();
-        featureGen.getFeatures(key, *output);
+
+        if (useInstances)
+            exportInstances(key, *output);
+        else
+            featureGen.getFeatures(key, *output);
 
         outputQueue.lock();
         outputQueue.push(output);
         gate.set();
         outputQueue.unlock();
     }
+
+    void exportInstances(const TileKey& key, FeatureList& output)
+    {
+        GroundCoverInstanceGenerator::Tile tile;
+        if (instanceGen.createTile(key, factory.get(), tile).isError())
+            return;
+
+        std::vector<GroundCoverInstanceGenerator::Instance> instances;
+        instanceGen.generate(tile, instances);
+
+        // position from the tile coordinates, in double precision
+        const GeoExtent& e = key.getExtent();
+        for (auto& instance : instances)
+        {
+            Point* point = new Point();
+            point->push_back(osg::Vec3d(
+                e.xMin() + instance.tilec.x()*e.width(),
+                e.yMin() + instance.tilec.y()*e.height(),
+                0.0));
+
+            osg::ref_ptr<Feature> feature = new Feature(point, e.getSRS());
+            feature->set("elevation", instance.vertex.z());
+            feature->set("width", instance.width);
+            feature->set("height", instance.height);
+            feature->set("side_index", instance.sideIndex);
+            feature->set("top_index", instance.topIndex);
+            output.push_back(feature);
+        }
+    }
 };
 
+// Times the CPU port of the generate and cull passes over the keys,
+// at a few instance densities and thread counts.
+int
+runBenchmark(App& app, const std::vector<TileKey>& keys)
+{
+    using Generator = GroundCoverInstanceGenerator;
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+
+    std::vector<Generator::Tile> tiles;
+    tiles.reserve(keys.size());
+    for (const auto& key : keys)
+    {
+        Generator::Tile tile;
+        if (app.instanceGen.createTile(key, app.factory.get(), tile).isOK())
+            tiles.push_back(tile);
+    }
+
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+
+    if (tiles.empty())
+    {
+        OE_WARN << LC << "No tile data found; nothing to benchmark" << std::endl;
+        return -1;
+    }
+
+    std::cout
+        << "Fetched " << tiles.size() << " tiles in "
+        << osg::Timer::instance()->delta_s(t0, t1) << "s" << std::endl;
+
+    // Synthetic camera for each tile: 2m above the southern edge,
+    // looking north across the tile.
+    for (auto& tile : tiles)
+    {
+        osg::Vec3d eye(0.0, tile.LL.y(), 2.0);
+        tile.modelViewMatrix = osg::Matrixd::lookAt(eye, osg::Vec3d(0.0, tile.UR.y(), 0.0), osg::Vec3d(0, 0, 1));
+    }
+    osg::Matrixd proj = osg::Matrixd::perspective(45.0, 16.0 / 9.0, 1.0, 1e6);
+
+    float maxRange = app.gclayer->getMaxVisibleRange();
+    for (auto& zone : app.gclayer->getZones())
+        if (zone.options().maxDistance().isSet())
+            maxRange = std::min(maxRange, zone.options().maxDistance().get());
+
+    std::vector<unsigned> threadCounts = { 1u };
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    if (hw > 1u)
+        threadCounts.push_back(hw);
+
+    std::vector<float> densities = { 0.5f, 1.0f, 2.0f };
+
+    std::cout
+        << "density, threads, candidates, instances, generate(s), instances/s, culled, cull(s)"
+        << std::endl;
+
+    for (float density : densities)
+    {
+        std::vector<Generator::Tile> scaled = tiles;
+        std::size_t candidates = 0u;
+        for (auto& tile : scaled)
+        {
+            unsigned n = tile.numInstances1D > 0u ? tile.numInstances1D : app.instanceGen.getNumInstances1D();
+            tile.numInstances1D = std::max(2u, (unsigned)(n * density));
+            tile.numInstances1D += (tile.numInstances1D & 0x01);
+            candidates += tile.numInstances1D * tile.numInstances1D;
+        }
+
+        for (unsigned threads : threadCounts)
+        {
+            app.instanceGen.setConcurrency(threads);
+
+            Generator::Output generated, culled;
+            double bestGenerate = DBL_MAX, bestCull = DBL_MAX;
+
+            for (unsigned i = 0; i < app.iterations; ++i)
+            {
+                osg::Timer_t a = osg::Timer::instance()->tick();
+                app.instanceGen.generate(scaled, generated);
+                osg::Timer_t b = osg::Timer::instance()->tick();
+                app.instanceGen.cull(scaled, generated, proj, maxRange, culled);
+                osg::Timer_t c = osg::Timer::instance()->tick();
+
+                bestGenerate = std::min(bestGenerate, osg::Timer::instance()->delta_s(a, b));
+                bestCull = std::min(bestCull, osg::Timer::instance()->delta_s(b, c));
+            }
+
+            std::cout
+                << density << ", "
+                << threads << ", "
+                << candidates << ", "
+                << generated.instances.size() << ", "
+                << bestGenerate << ", "
+                << (bestGenerate > 0.0 ? (std::size_t)(generated.instances.size() / bestGenerate) : 0u) << ", "
+                << culled.instances.size() << ", "
+                << bestCull
+                << std::endl;
+        }
+    }
+
+    return 0;
+}
+
 struct ExportOperation : public osg::Operation
 {
     App& _app;
@@ -166,6 +332,9 @@ main(int argc, char** argv)
     if (keys.empty())
         return usage(argv[0], "No data in extent");
 
+    if (app.benchmark)
+        return runBenchmark(app, keys);
+
     std::cout << "Exporting " << keys.size() << " keys.." << std::endl;
 
     jobs::context ctx;
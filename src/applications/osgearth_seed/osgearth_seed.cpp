@@ -28,13 +28,13 @@
 
 #include <osgEarth/Common>
 #include <osgEarth/Cache>
-#include <osgEarth/CacheEstimator>
 #include <osgEarth/CacheSeed>
 #include <osgEarth/MapNode>
 #include <osgEarth/Registry>
 #include <osgEarth/FileUtils>
 #include <osgEarth/ImageLayer>
 #include <osgEarth/ElevationLayer>
+#include <osgEarth/TileEstimator>
 #include <osgEarth/TileVisitor>
 #include <osgEarth/FileUtils>
 
@@ -43,8 +43,12 @@
 #include <iostream>
 #include <sstream>
 #include <iterator>
+#include <iomanip>
+#include <memory>
+#include <mutex>
 
 using namespace osgEarth;
+using namespace osgEarth::Util;
 
 #define LC "[osgearth_cache] "
 
@@ -88,9 +92,10 @@ int usage( const std::string& msg )
         << "        [--max-level level]             ; Highest LOD level to seed (default=highest available)" << std::endl
         << "        [--bounds xmin ymin xmax ymax]* ; Geospatial bounding box to seed (in map coordinates; default=entire map)" << std::endl
         << "        [--index shapefile]             ; Use the feature extents in a shapefile to set the bounding boxes for seeding" << std::endl
-        << "        [--mp]                          ; Use multiprocessing to process the tiles.  Useful for GDAL sources as this avoids the global GDAL lock" << std::endl
         << "        [--mt]                          ; Use multithreading to process the tiles." << std::endl
-        << "        [--concurrency]                 ; The number of threads or processes to use if --mp or --mt are provided." << std::endl
+        << "        [--pipelined]                   ; Use the pipelined seeder: skips cached tiles in batches and seeds all layers at once" << std::endl
+        << "        [--checkpoint file]             ; Record progress in a file and resume from it (implies --pipelined)" << std::endl
+        << "        [--concurrency]                 ; The number of threads to use if --mt or --pipelined are provided." << std::endl
         << "        [--verbose]                     ; Displays progress of the seed operation" << std::endl
         << std::endl
         << "    --purge file.earth                  ; Purges a layer cache in a .earth file (interactive)" << std::endl
@@ -108,6 +113,28 @@ int message( const std::string& msg )
     return 0;
 }
 
+namespace
+{
+    // Prints the percentage done to the console. Seeders may report
+    // progress from several threads at once.
+    struct ConsoleProgressCallback : public ProgressCallback
+    {
+        bool reportProgress(double current, double total, unsigned currentStage, unsigned totalStages, const std::string& msg) override
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (total > 0.0)
+            {
+                std::cout << std::fixed << std::setprecision(1)
+                    << "\r" << (100.0 * current / total) << "% (" << (unsigned)current << " of " << (unsigned)total << ")"
+                    << std::flush;
+            }
+            return false;
+        }
+
+        std::mutex _mutex;
+    };
+}
+
 int seed( osg::ArgumentParser& args )
 {    
     osgDB::Registry::instance()->getReaderWriterForExtension("png");
@@ -135,9 +162,6 @@ int seed( osg::ArgumentParser& args )
         bounds.push_back( b );
     }    
 
-    std::string tileList;
-    while (args.read( "--tiles", tileList ) );
-
     bool verbose = args.read("--verbose");
 
     unsigned int batchSize = 0;
@@ -148,6 +172,13 @@ int seed( osg::ArgumentParser& args )
     args.read("-c", concurrency);
     args.read("--concurrency", concurrency);
 
+    std::string checkpoint;
+    args.read("--checkpoint", checkpoint);
+
+    bool pipelined = args.read("--pipelined") || !checkpoint.empty();
+
+    bool multithreaded = args.read("--mt");
+
     int imageLayerIndex = -1;
     args.read("--image", imageLayerIndex);
 
@@ -173,7 +204,7 @@ int seed( osg::ArgumentParser& args )
         features->setURL(index);
         if (features->open().isOK())
         {
-            osg::ref_ptr<FeatureCursor> cursor = features->createFeatureCursor(Query(), 0L);
+            osg::ref_ptr<FeatureCursor> cursor = features->createFeatureCursor(Query());
             while (cursor.valid() && cursor->hasMore())
             {
                 osg::ref_ptr< Feature > feature = cursor->nextFeature();
@@ -192,7 +223,7 @@ int seed( osg::ArgumentParser& args )
     // If they requested to do an estimate then don't do the seed, just print out the estimated values.
     if (estimate)
     {        
-        CacheEstimator est;
+        TileEstimator est;
         if ( minLevel >= 0 )
             est.setMinLevel( minLevel );
         if ( maxLevel >= 0 )
@@ -220,66 +251,22 @@ int seed( osg::ArgumentParser& args )
     
     osg::ref_ptr< TileVisitor > visitor;
 
-
-    // If we are given a task file, load it up and create a new TileKeyListVisitor
-    if (!tileList.empty())
-    {        
-        TaskList tasks( mapNode->getMap()->getProfile() );
-        tasks.load( tileList );
-
-        TileKeyListVisitor* v = new TileKeyListVisitor();
-        v->setKeys( tasks.getKeys() );
-        visitor = v;        
-        OE_DEBUG << "Read task list with " << tasks.getKeys().size() << " tasks" << std::endl;
-    }
-  
-
-    // If we dont' have a visitor create one.
-    if (!visitor.valid())
+    if (multithreaded && !pipelined)
     {
-        if (args.read("--mt"))
+        // Create a multithreaded visitor
+        MultithreadedTileVisitor* v = new MultithreadedTileVisitor();
+        if (concurrency > 0)
         {
-            // Create a multithreaded visitor
-            MultithreadedTileVisitor* v = new MultithreadedTileVisitor();
-            if (concurrency > 0)
-            {
-                v->setNumThreads(concurrency);
-            }
-            visitor = v;            
+            v->setNumThreads(concurrency);
         }
-        else if (args.read("--mp"))
-        {
-            // Create a multiprocess visitor
-            MultiprocessTileVisitor* v = new MultiprocessTileVisitor();
-            if (concurrency > 0)
-            {
-                v->setNumProcesses(concurrency);
-            }
-
-            if (batchSize > 0)
-            {                
-                v->setBatchSize(batchSize);
-            }
-
-            // Try to find the earth file
-            std::string earthFile;
-            for(int pos=1;pos<args.argc();++pos)
-            {
-                if (!args.isOption(pos))
-                {
-                    earthFile  = args[ pos ];
-                    break;
-                }
-            }
-            v->setEarthFile( earthFile );            
-            visitor = v;            
-        }
-        else
-        {
-            // Create a single thread visitor
-            visitor = new TileVisitor();            
-        }        
+        visitor = v;            
     }
+    else
+    {
+        // Create a single thread visitor. The pipelined seeder only uses it
+        // for the extents, levels and progress callback.
+        visitor = new TileVisitor();            
+    }        
 
     osg::ref_ptr< ProgressCallback > progress = new ConsoleProgressCallback();
     
@@ -303,87 +290,86 @@ int seed( osg::ArgumentParser& args )
     
 
     // Initialize the seeder
-    osgEarth::Contrib::CacheSeed seeder;
-    seeder.setVisitor(visitor.get());
+    std::unique_ptr<osgEarth::Contrib::CacheSeed> seeder;
+    osgEarth::Contrib::PipelinedCacheSeed* pipeline = nullptr;
+
+    if (pipelined)
+    {
+        pipeline = new osgEarth::Contrib::PipelinedCacheSeed();
+        if (concurrency > 0)
+            pipeline->setConcurrency(concurrency);
+        if (batchSize > 0)
+            pipeline->setBatchSize(batchSize);
+        pipeline->setCheckpointFile(checkpoint);
+        seeder.reset(pipeline);
+    }
+    else
+    {
+        seeder.reset(new osgEarth::Contrib::CacheSeed());
+    }
+
+    seeder->setVisitor(visitor.get());
 
     osgEarth::Map* map = mapNode->getMap();
 
+    TileLayerVector layers;
+
     // They want to seed an image layer
     if (imageLayerIndex >= 0)
     {
         osg::ref_ptr< ImageLayer > layer = map->getLayerAt<ImageLayer>( imageLayerIndex );
-        if (layer)
-        {
-            OE_NOTICE << "Seeding single layer " << layer->getName() << std::endl;
-            osg::Timer_t start = osg::Timer::instance()->tick();        
-            seeder.run(layer.get(), map);
-            osg::Timer_t end = osg::Timer::instance()->tick();
-            if (verbose)
-            {
-                OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << std::endl;
-            }    
-        }
-        else
+        if (!layer.valid())
         {
             std::cout << "Failed to find an image layer at index " << imageLayerIndex << std::endl;
             return 1;
         }
-
+        layers.push_back(layer.get());
     }
     // They want to seed an elevation layer
     else if (elevationLayerIndex >= 0)
     {
         osg::ref_ptr< ElevationLayer > layer = map->getLayerAt<ElevationLayer>( elevationLayerIndex );
-        if (layer)
-        {
-            OE_NOTICE << "Seeding single layer " << layer->getName() << std::endl;
-            osg::Timer_t start = osg::Timer::instance()->tick();        
-            seeder.run(layer.get(), map);
-            osg::Timer_t end = osg::Timer::instance()->tick();
-            if (verbose)
-            {
-                OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << std::endl;
-            }    
-        }
-        else
+        if (!layer.valid())
         {
             std::cout << "Failed to find an elevation layer at index " << elevationLayerIndex << std::endl;
             return 1;
         }
+        layers.push_back(layer.get());
     }
     // They want to seed the entire map
     else
     {
-        TileLayerVector terrainLayers;
-        map->getLayers(terrainLayers);
+        map->getLayers(layers);
+    }
 
-        // Seed all the map layers
-        for (unsigned int i = 0; i < terrainLayers.size(); ++i)
+    if (pipeline)
+    {
+        // Seed all the layers at once so they share the creation threads
+        OE_NOTICE << "Seeding " << layers.size() << " layer(s)" << std::endl;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        pipeline->run(layers, map);
+        osg::Timer_t end = osg::Timer::instance()->tick();
+        if (verbose)
+        {
+            OE_NOTICE << "Completed seeding in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << std::endl
+                << pipeline->getStats().toString() << std::endl;
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < layers.size(); ++i)
         {            
-            osg::ref_ptr< TileLayer > layer = terrainLayers[i].get();
-            OE_NOTICE << "Seeding layer" << layer->getName() << std::endl;            
+            osg::ref_ptr< TileLayer > layer = layers[i].get();
+            OE_NOTICE << "Seeding layer " << layer->getName() << std::endl;            
             osg::Timer_t start = osg::Timer::instance()->tick();
-            seeder.run(layer.get(), map);            
+            seeder->run(layer.get(), map);            
             osg::Timer_t end = osg::Timer::instance()->tick();
             if (verbose)
             {
                 OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << std::endl;
             }                
         }
-
-        //for (unsigned int i = 0; i < map->getNumElevationLayers(); ++i)
-        //{
-        //    osg::ref_ptr< ElevationLayer > layer = map->getElevationLayerAt(i);
-        //    OE_NOTICE << "Seeding layer" << layer->getName() << std::endl;
-        //    osg::Timer_t start = osg::Timer::instance()->tick();
-        //    seeder.run(layer.get(), map);            
-        //    osg::Timer_t end = osg::Timer::instance()->tick();
-        //    if (verbose)
-        //    {
-        //        OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << std::endl;
-        //    }                
-        //}        
-    }    
+    }
 
     return 0;
 }
@@ -524,13 +510,13 @@ purge( osg::ArgumentParser& args )
             unsigned k = as<unsigned>(input, 0L);
             if ( k > 0 && k <= entries.size() )
             {
-                Config meta = entries[k-1]._bin->readMetadata();
-                if ( !meta.empty() )
+                TileLayer::CacheBinMetadata* meta = dynamic_cast<TileLayer::CacheBinMetadata*>(entries[k-1]._bin->getMetadata());
+                if ( meta )
                 {
                     std::cout
                         << std::endl
                         << "Cache METADATA:" << std::endl
-                        << meta.toJSON() 
+                        << meta->getConfig().toJSON() 
                         << std::endl << std::endl;
                 }
 
@@ -25,6 +25,7 @@
 #include <osgEarth/ExampleResources>
 #include <osgEarth/MapNode>
 #include <osgEarth/PhongLightingEffect>
+#include <osgEarth/TileLayer>
 #include <osgGA/TrackballManipulator>
 #include <iostream>
 
@@ -40,6 +41,7 @@ usage(const char* name)
 {
     std::cout
         << "\nUsage: " << name << " file.earth" << std::endl
+        << "    --layer-stats : on exit, print tile timing and cache statistics for each layer" << std::endl
         << Util::MapNodeHelper().usage() << std::endl;
 
     return 0;
@@ -53,6 +55,8 @@ main(int argc, char** argv)
     if ( arguments.read("--help") )
         return usage(argv[0]);
 
+    bool printLayerStats = arguments.read("--layer-stats");
+
     // start up osgEarth
     osgEarth::initialize(arguments);
 
@@ -91,7 +95,18 @@ main(int argc, char** argv)
             viewer.setSceneData(group);
         }
 
-        return Metrics::run(viewer);
+        int result = Metrics::run(viewer);
+
+        MapNode* mapNode = MapNode::get(node);
+        if (printLayerStats && mapNode)
+        {
+            TileLayerVector layers;
+            mapNode->getMap()->getLayers(layers);
+            for (auto& layer : layers)
+                layer->getTileStatistics().print(std::cout, "Layer \"" + layer->getName() + "\"");
+        }
+
+        return result;
     }
 
     return usage(argv[0]);
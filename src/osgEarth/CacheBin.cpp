@@ -251,6 +251,41 @@ namespace
 }
 
 
+void
+CacheBin::getRecordStatusBatch(const std::vector<std::string>& keys,
+                               std::vector<RecordStatus>&      output)
+{
+    output.resize(keys.size());
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        output[i] = getRecordStatus(keys[i]);
+    }
+}
+
+std::vector<Threading::Future<ReadResult>>
+CacheBin::readImagesAsync(const std::vector<std::string>& keys,
+                          const osgDB::Options*           dbo)
+{
+    std::vector<Threading::Future<ReadResult>> output(keys.size());
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        output[i].resolve(readImage(keys[i], dbo));
+    }
+    return output;
+}
+
+std::vector<Threading::Future<ReadResult>>
+CacheBin::readObjectsAsync(const std::vector<std::string>& keys,
+                           const osgDB::Options*           dbo)
+{
+    std::vector<Threading::Future<ReadResult>> output(keys.size());
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        output[i].resolve(readObject(keys[i], dbo));
+    }
+    return output;
+}
+
 bool
 CacheBin::writeNode(const std::string&    key,
                     osg::Node*            node,
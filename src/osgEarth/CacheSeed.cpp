@@ -22,6 +22,18 @@
 
 #include <osgEarth/CacheSeed>
 #include <osgEarth/ImageLayer>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/TileEstimator>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Map>
+#include <osg/Timer>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <thread>
 
 #define LC "[CacheSeed] "
 
@@ -118,4 +130,535 @@ void CacheSeed::run( TileLayer* layer, const Map* map )
 {
     _visitor->setTileHandler( new CacheTileHandler( layer, map ) );
     _visitor->run( map->getProfile() );
-}
\ No newline at end of file
+}
+/***************************************************************************************/
+
+#undef LC
+#define LC "[PipelinedCacheSeed] "
+
+#define SEED_POOL "oe.cacheseed"
+
+namespace
+{
+    // Blocking FIFO with a maximum size that connects two pipeline stages.
+    template<typename T>
+    class BoundedQueue
+    {
+    public:
+        BoundedQueue(unsigned capacity) : _capacity(std::max(capacity, 1u)) { }
+
+        //! Blocks while the queue is full; false if the queue was closed
+        bool push(T&& value)
+        {
+            std::unique_lock<std::mutex> lock(_m);
+            _notFull.wait(lock, [&]() { return _queue.size() < _capacity || _closed; });
+            if (_closed)
+                return false;
+            _queue.emplace_back(std::move(value));
+            _notEmpty.notify_one();
+            return true;
+        }
+
+        //! Blocks while the queue is empty; false once closed and drained
+        bool pop(T& value)
+        {
+            std::unique_lock<std::mutex> lock(_m);
+            _notEmpty.wait(lock, [&]() { return !_queue.empty() || _closed; });
+            if (_queue.empty())
+                return false;
+            value = std::move(_queue.front());
+            _queue.pop_front();
+            _notFull.notify_one();
+            return true;
+        }
+
+        //! Non-blocking pop
+        bool tryPop(T& value)
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            if (_queue.empty())
+                return false;
+            value = std::move(_queue.front());
+            _queue.pop_front();
+            _notFull.notify_one();
+            return true;
+        }
+
+        //! No more pushes; poppers drain what's left
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            _closed = true;
+            _notEmpty.notify_all();
+            _notFull.notify_all();
+        }
+
+    private:
+        std::mutex _m;
+        std::condition_variable _notEmpty, _notFull;
+        std::deque<T> _queue;
+        unsigned _capacity;
+        bool _closed = false;
+    };
+
+    // Keys are numbered in (deterministic) generation order. The tracker
+    // maintains the length of the contiguous run of finished keys starting
+    // at zero; that number is what we save as the checkpoint.
+    class CompletionTracker
+    {
+    public:
+        void reset(std::uint64_t mark)
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            _mark = mark;
+            _done.clear();
+        }
+
+        void complete(std::uint64_t seq)
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            if (seq != _mark)
+            {
+                _done.insert(seq);
+                return;
+            }
+            ++_mark;
+            while (!_done.empty() && *_done.begin() == _mark)
+            {
+                _done.erase(_done.begin());
+                ++_mark;
+            }
+        }
+
+        std::uint64_t mark() const
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            return _mark;
+        }
+
+    private:
+        mutable std::mutex _m;
+        std::uint64_t _mark = 0u;
+        std::set<std::uint64_t> _done;
+    };
+
+    struct SeedItem
+    {
+        std::uint64_t seq = 0u;
+        TileKey key;
+        unsigned layer = 0u;
+    };
+
+    using SeedQueue = BoundedQueue<SeedItem>;
+
+    // Raises an atomic to at least the given value
+    void atomicMax(std::atomic<double>& target, double value)
+    {
+        double current = target.load();
+        while (current < value && !target.compare_exchange_weak(current, value));
+    }
+
+    // Shared counters for all the pipelines in a run
+    struct SeedCounters
+    {
+        std::atomic_uint generated = { 0u };
+        std::atomic_uint resumed = { 0u };
+        std::atomic_uint cached = { 0u };
+        std::atomic_uint created = { 0u };
+        std::atomic_uint empty = { 0u };
+    };
+
+    // One layer's generation and filtering stages
+    struct LayerPipeline
+    {
+        LayerPipeline(TileLayer* layer_, unsigned queueSize) :
+            layer(layer_),
+            keys(queueSize) { }
+
+        osg::ref_ptr<TileLayer> layer;
+        SeedQueue keys;
+        CompletionTracker tracker;
+        std::uint64_t resumeMark = 0u;
+    };
+
+    // Identifies the key sequence a checkpoint mark counts into: the
+    // levels and the extents (in order) all change which keys come out.
+    std::string makeCheckpointSignature(
+        unsigned minLevel,
+        unsigned maxLevel,
+        const std::vector<GeoExtent>& extents)
+    {
+        std::stringstream buf;
+        buf << std::setprecision(17) << minLevel << ' ' << maxLevel;
+        for (auto& extent : extents)
+        {
+            buf << ' ' << (extent.getSRS() ? extent.getSRS()->getHorizInitString() : std::string())
+                << ' ' << extent.xMin() << ' ' << extent.yMin()
+                << ' ' << extent.xMax() << ' ' << extent.yMax();
+        }
+        return hashToString(buf.str());
+    }
+
+    // Reads the per-layer resume marks from a checkpoint file.
+    // Format: one "signature mark length:name" record per layer. The name
+    // is length-prefixed so it may contain anything, separators included.
+    void readCheckpoint(
+        const std::string& filename,
+        const std::string& signature,
+        std::vector<std::unique_ptr<LayerPipeline>>& pipelines)
+    {
+        std::ifstream in(filename.c_str(), std::ios::binary);
+        std::string recordSignature;
+        std::uint64_t mark;
+        std::size_t length;
+        while (in >> recordSignature >> mark >> length && in.get() == ':')
+        {
+            std::string name(length, '\0');
+            if (length > 0 && !in.read(&name[0], length))
+                break;
+
+            if (recordSignature != signature)
+                continue;
+
+            for (auto& p : pipelines)
+            {
+                if (p->layer->getName() == name)
+                {
+                    p->resumeMark = mark;
+                    OE_INFO << LC << "Resuming \"" << name << "\" after " << p->resumeMark << " keys" << std::endl;
+                }
+            }
+        }
+    }
+
+    void writeCheckpoint(
+        const std::string& filename,
+        const std::string& signature,
+        const std::vector<std::unique_ptr<LayerPipeline>>& pipelines)
+    {
+        // write to a temporary file first so a crash cannot corrupt the checkpoint.
+        std::string temp = filename + ".tmp";
+        {
+            std::ofstream out(temp.c_str(), std::ios::binary);
+            for (auto& p : pipelines)
+            {
+                const std::string& name = p->layer->getName();
+                out << signature << ' '
+                    << p->tracker.mark() << ' '
+                    << name.size() << ':' << name << '\n';
+            }
+        }
+        ::remove(filename.c_str());
+        ::rename(temp.c_str(), filename.c_str());
+    }
+}
+
+std::string
+PipelinedCacheSeed::Stats::toString() const
+{
+    auto rate = [](unsigned count, double seconds) {
+        return seconds > 0.0 ? (double)count / seconds : 0.0;
+    };
+
+    std::stringstream buf;
+    buf << std::fixed << std::setprecision(1)
+        << "generate: " << generated << " keys (" << rate(generated, generateSeconds) << "/s); "
+        << "filter: " << cached << " cached, " << resumed << " resumed (" << rate(generated, filterSeconds) << "/s); "
+        << "create: " << created << " tiles, " << empty << " empty (" << rate(created + empty, createSeconds) << "/s)";
+    return buf.str();
+}
+
+PipelinedCacheSeed::PipelinedCacheSeed() :
+    _concurrency(std::max(1u, std::thread::hardware_concurrency())),
+    _batchSize(256u),
+    _queueSize(4096u)
+{
+    //nop
+}
+
+void
+PipelinedCacheSeed::run(TileLayer* layer, const Map* map)
+{
+    TileLayerVector layers;
+    layers.push_back(layer);
+    run(layers, map);
+}
+
+void
+PipelinedCacheSeed::run(const TileLayerVector& layers, const Map* map)
+{
+    _stats = Stats();
+
+    if (layers.empty() || !map || !map->getProfile())
+        return;
+
+    const Profile* profile = map->getProfile();
+    ProgressCallback* progress = _visitor->getProgressCallback();
+    unsigned minLevel = _visitor->getMinLevel();
+    unsigned maxLevel = _visitor->getMaxLevel();
+
+    std::vector<GeoExtent> extents = _visitor->getExtentsToVisit();
+    if (extents.empty())
+        extents.push_back(profile->getExtent());
+
+    // The visitor is only used for its data-extents index here.
+    _visitor->setTileHandler(nullptr);
+
+    auto canceled = [progress]() {
+        return progress && progress->isCanceled();
+    };
+
+    std::vector<std::unique_ptr<LayerPipeline>> pipelines;
+    for (auto& layer : layers)
+    {
+        if (layer.valid() && layer->isOpen())
+            pipelines.emplace_back(new LayerPipeline(layer.get(), _queueSize));
+    }
+
+    if (pipelines.empty())
+        return;
+
+    const std::string signature = makeCheckpointSignature(minLevel, maxLevel, extents);
+
+    if (!_checkpointFile.empty())
+    {
+        readCheckpoint(_checkpointFile, signature, pipelines);
+    }
+
+    for (auto& p : pipelines)
+    {
+        p->tracker.reset(p->resumeMark);
+    }
+
+    // Estimate the total for progress reporting:
+    TileEstimator estimator;
+    estimator.setMinLevel(minLevel);
+    estimator.setMaxLevel(maxLevel);
+    estimator.setProfile(profile);
+    for (auto& extent : extents)
+        estimator.addExtent(extent);
+    double total = (double)estimator.getNumTiles() * (double)pipelines.size();
+
+    SeedCounters counters;
+    SeedQueue work(_queueSize);
+    std::atomic_uint filtersRunning = { (unsigned)pipelines.size() };
+    std::mutex checkpointMutex;
+    std::atomic_uint sinceCheckpoint = { 0u };
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    std::atomic<double> generateEnd = { 0.0 }, filterEnd = { 0.0 };
+
+    auto elapsed = [start]() {
+        return osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    };
+
+    auto finished = [&](LayerPipeline& p, std::uint64_t seq)
+    {
+        p.tracker.complete(seq);
+
+        if (progress)
+        {
+            double done = counters.resumed + counters.cached + counters.created + counters.empty;
+            if (progress->reportProgress(done, total))
+                progress->cancel();
+        }
+
+        if (!_checkpointFile.empty() && ++sinceCheckpoint >= 1000u)
+        {
+            std::lock_guard<std::mutex> lock(checkpointMutex);
+            if (sinceCheckpoint >= 1000u)
+            {
+                sinceCheckpoint = 0u;
+                writeCheckpoint(_checkpointFile, signature, pipelines);
+            }
+        }
+    };
+
+    // Stage 1: key generation. Depth-first, so the order is deterministic
+    // and a checkpoint mark means the same thing from one run to the next.
+    auto generate = [&](LayerPipeline& p)
+    {
+        std::uint64_t seq = 0u;
+
+        std::function<void(const TileKey&)> visit = [&](const TileKey& key)
+        {
+            if (canceled())
+                return;
+
+            if (!_visitor->hasData(key) || !p.layer->mayHaveData(key))
+                return;
+
+            unsigned lod = key.getLOD();
+
+            bool intersects = false;
+            for (auto& extent : extents)
+            {
+                if (extent.intersects(key.getExtent()))
+                {
+                    intersects = true;
+                    break;
+                }
+            }
+
+            if (!intersects)
+                return;
+
+            if (lod >= minLevel)
+            {
+                SeedItem item;
+                item.seq = seq++;
+                item.key = key;
+                ++counters.generated;
+                if (!p.keys.push(std::move(item)))
+                    return;
+            }
+
+            if (lod < maxLevel)
+            {
+                for (unsigned i = 0; i < 4; ++i)
+                    visit(key.createChildKey(i));
+            }
+        };
+
+        std::vector<TileKey> roots;
+        profile->getRootKeys(roots);
+        for (auto& root : roots)
+            visit(root);
+
+        p.keys.close();
+        atomicMax(generateEnd, elapsed());
+    };
+
+    // Stage 2: filtering. Drops keys covered by the checkpoint, then looks up
+    // the rest in the cache in batches and forwards the ones that are missing.
+    auto filter = [&](LayerPipeline& p, unsigned layerIndex)
+    {
+        std::vector<SeedItem> batch;
+        std::vector<TileKey> batchKeys;
+        std::vector<bool> isCached;
+        SeedItem item;
+
+        while (!canceled() && p.keys.pop(item))
+        {
+            batch.clear();
+            do
+            {
+                if (item.seq < p.resumeMark)
+                {
+                    ++counters.resumed;
+                    continue;
+                }
+                item.layer = layerIndex;
+                batch.emplace_back(std::move(item));
+            }
+            while (batch.size() < _batchSize && p.keys.tryPop(item));
+
+            batchKeys.clear();
+            for (auto& i : batch)
+                batchKeys.push_back(i.key);
+
+            p.layer->isCached(batchKeys, isCached);
+
+            for (unsigned i = 0; i < batch.size(); ++i)
+            {
+                if (isCached[i])
+                {
+                    ++counters.cached;
+                    finished(p, batch[i].seq);
+                }
+                else if (!work.push(std::move(batch[i])))
+                {
+                    break;
+                }
+            }
+        }
+
+        // unblock the generator if we bailed out early
+        p.keys.close();
+
+        atomicMax(filterEnd, elapsed());
+        if (--filtersRunning == 0u)
+        {
+            work.close();
+        }
+    };
+
+    // Stage 3: creation. Creating the tile through the layer performs the
+    // source fetch, reprojection/mosaicking, and the cache write.
+    auto create = [&]()
+    {
+        SeedItem item;
+        while (!canceled() && work.pop(item))
+        {
+            LayerPipeline& p = *pipelines[item.layer];
+            bool ok = false;
+
+            if (auto imageLayer = dynamic_cast<ImageLayer*>(p.layer.get()))
+            {
+                ok = imageLayer->createImage(item.key, progress).valid();
+            }
+            else if (auto elevationLayer = dynamic_cast<ElevationLayer*>(p.layer.get()))
+            {
+                ok = elevationLayer->createHeightField(item.key, progress).valid();
+            }
+
+            if (canceled())
+                break;
+
+            if (ok)
+                ++counters.created;
+            else
+                ++counters.empty;
+
+            finished(p, item.seq);
+        }
+    };
+
+    // Start the stages. Generation and filtering mostly wait on queues, so they
+    // get dedicated threads; creation runs in the job pool.
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < pipelines.size(); ++i)
+    {
+        threads.emplace_back([&, i]() { generate(*pipelines[i]); });
+        threads.emplace_back([&, i]() { filter(*pipelines[i], i); });
+    }
+
+    auto pool = jobs::get_pool(SEED_POOL);
+    pool->set_concurrency(std::max(_concurrency, 1u));
+
+    auto group = jobs::jobgroup::create();
+    for (unsigned i = 0; i < std::max(_concurrency, 1u); ++i)
+    {
+        jobs::context job;
+        job.name = "cacheseed.create";
+        job.pool = pool;
+        job.group = group;
+        jobs::dispatch(create, job);
+    }
+
+    group->join();
+
+    // if creation stopped early (cancelation), release the upstream stages
+    work.close();
+    for (auto& p : pipelines)
+        p->keys.close();
+
+    for (auto& t : threads)
+        t.join();
+
+    if (!_checkpointFile.empty())
+    {
+        writeCheckpoint(_checkpointFile, signature, pipelines);
+    }
+
+    _stats.generated = counters.generated;
+    _stats.resumed = counters.resumed;
+    _stats.cached = counters.cached;
+    _stats.created = counters.created;
+    _stats.empty = counters.empty;
+    _stats.generateSeconds = generateEnd;
+    _stats.filterSeconds = filterEnd;
+    _stats.createSeconds = elapsed();
+
+    OE_INFO << LC << _stats.toString() << std::endl;
+}
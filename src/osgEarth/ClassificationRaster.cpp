@@ -0,0 +1,231 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/ClassificationRaster>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/GeoCommon>
+#include <osgEarth/Math>
+#include <algorithm>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+constexpr ClassificationRaster::value_type ClassificationRaster::NO_DATA;
+
+ClassificationRaster::ClassificationRaster() :
+    _width(0u),
+    _height(0u)
+{
+    //nop
+}
+
+ClassificationRaster::Ptr
+ClassificationRaster::create(const osg::Image* image)
+{
+    if (image == nullptr || image->s() <= 0 || image->t() <= 0 || image->s() > 65536)
+        return nullptr;
+
+    const unsigned width = image->s();
+    const unsigned height = image->t();
+
+    // Read the values. GL_RED/GL_FLOAT is what the land cover and biome
+    // layers make, so read that directly; anything else goes through PixelReader.
+    std::vector<value_type> values(width * height);
+
+    auto toValue = [](float f) {
+        return std::isfinite(f) && f > (float)INT32_MIN && f < (float)INT32_MAX ?
+            (value_type)f : NO_DATA;
+    };
+
+    if (image->getPixelFormat() == GL_RED && image->getDataType() == GL_FLOAT)
+    {
+        for (unsigned t = 0; t < height; ++t)
+        {
+            const float* ptr = (const float*)image->data(0, t);
+            for (unsigned s = 0; s < width; ++s)
+                values[t*width + s] = toValue(ptr[s]);
+        }
+    }
+    else
+    {
+        ImageUtils::PixelReader read(image);
+        osg::Vec4f pixel;
+        for (unsigned t = 0; t < height; ++t)
+        {
+            for (unsigned s = 0; s < width; ++s)
+            {
+                read(pixel, s, t);
+                values[t*width + s] = toValue(pixel.r());
+            }
+        }
+    }
+
+    std::shared_ptr<ClassificationRaster> result(new ClassificationRaster());
+    result->_width = width;
+    result->_height = height;
+
+    // palette of distinct values:
+    result->_palette = values;
+    std::sort(result->_palette.begin(), result->_palette.end());
+    result->_palette.erase(
+        std::unique(result->_palette.begin(), result->_palette.end()),
+        result->_palette.end());
+    result->_palette.shrink_to_fit();
+
+    if (result->_palette.size() > 65536)
+        return nullptr;
+
+    auto& palette = result->_palette;
+    auto paletteIndex = [&](value_type v) {
+        return (std::uint16_t)(std::lower_bound(palette.begin(), palette.end(), v) - palette.begin());
+    };
+
+    result->_rows.resize(height);
+    result->_data.reserve(width * height / 8);
+
+    std::vector<std::uint16_t> indices(width);
+
+    for (unsigned t = 0; t < height; ++t)
+    {
+        const value_type* row = &values[t*width];
+
+        unsigned runs = 1;
+        indices[0] = paletteIndex(row[0]);
+        for (unsigned s = 1; s < width; ++s)
+        {
+            indices[s] = row[s] == row[s - 1] ? indices[s - 1] : paletteIndex(row[s]);
+            if (indices[s] != indices[s - 1])
+                ++runs;
+        }
+
+        Row& r = result->_rows[t];
+        r.offset = (std::uint32_t)result->_data.size();
+
+        if (runs * 2u < width)
+        {
+            r.runs = (std::uint16_t)runs;
+            for (unsigned s = 0; s < width; ++s)
+            {
+                if (s == 0 || indices[s] != indices[s - 1])
+                {
+                    result->_data.push_back((std::uint16_t)s);
+                    result->_data.push_back(indices[s]);
+                }
+            }
+        }
+        else
+        {
+            r.runs = 0;
+            result->_data.insert(result->_data.end(), indices.begin(), indices.end());
+        }
+    }
+
+    result->_data.shrink_to_fit();
+
+    return result;
+}
+
+std::uint16_t
+ClassificationRaster::index(unsigned s, unsigned t) const
+{
+    const Row& row = _rows[t];
+    const std::uint16_t* data = &_data[row.offset];
+
+    if (row.runs == 0)
+        return data[s];
+
+    // binary search for the last run starting at or before s:
+    unsigned lo = 0, hi = row.runs;
+    while (hi - lo > 1)
+    {
+        unsigned mid = (lo + hi) / 2;
+        if (data[mid * 2] <= s)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return data[lo * 2 + 1];
+}
+
+ClassificationRaster::value_type
+ClassificationRaster::operator()(int s, int t) const
+{
+    s = clamp(s, 0, (int)_width - 1);
+    t = clamp(t, 0, (int)_height - 1);
+    return _palette[index((unsigned)s, (unsigned)t)];
+}
+
+ClassificationRaster::value_type
+ClassificationRaster::operator()(double u, double v) const
+{
+    unsigned s, t;
+    ImageUtils::nnUVtoST(u, v, s, t, _width, _height);
+    return _palette[index(s, t)];
+}
+
+void
+ClassificationRaster::readRow(unsigned t, value_type* output) const
+{
+    const Row& row = _rows[t];
+    const std::uint16_t* data = &_data[row.offset];
+
+    if (row.runs == 0)
+    {
+        for (unsigned s = 0; s < _width; ++s)
+            output[s] = _palette[data[s]];
+    }
+    else
+    {
+        for (unsigned r = 0; r < row.runs; ++r)
+        {
+            unsigned end = r + 1 < row.runs ? data[(r + 1) * 2] : _width;
+            value_type value = _palette[data[r * 2 + 1]];
+            for (unsigned s = data[r * 2]; s < end; ++s)
+                output[s] = value;
+        }
+    }
+}
+
+osg::Image*
+ClassificationRaster::createImage() const
+{
+    osg::Image* image = new osg::Image();
+    image->allocateImage(_width, _height, 1, GL_RED, GL_FLOAT);
+    image->setInternalTextureFormat(GL_R32F);
+
+    std::vector<value_type> row(_width);
+    for (unsigned t = 0; t < _height; ++t)
+    {
+        readRow(t, row.data());
+        float* ptr = (float*)image->data(0, t);
+        for (unsigned s = 0; s < _width; ++s)
+            ptr[s] = row[s] == NO_DATA ? NO_DATA_VALUE : (float)row[s];
+    }
+    return image;
+}
+
+std::size_t
+ClassificationRaster::getSizeInBytes() const
+{
+    return
+        sizeof(ClassificationRaster) +
+        _palette.capacity() * sizeof(value_type) +
+        _rows.capacity() * sizeof(Row) +
+        _data.capacity() * sizeof(std::uint16_t);
+}
@@ -21,6 +21,9 @@
 #include <osgEarth/Map>
 #include <osgEarth/Progress>
 #include <osgEarth/Metrics>
+#include <osgEarth/RasterPool>
+#include <algorithm>
+#include <cmath>
 
 using namespace osgEarth;
 
@@ -57,31 +60,74 @@ osgEarth::createEmptyNormalMapTexture()
     return tex;
 }
 
+namespace
+{
+    // Texture image that reads the heights of a heightfield in place
+    // instead of holding a copy of them.
+    class HeightFieldImage : public osg::Image
+    {
+    public:
+        HeightFieldImage(const osg::HeightField* hf) : _hf(hf)
+        {
+            setImage(
+                hf->getNumColumns(), hf->getNumRows(), 1,
+                GL_R32F, GL_RED, GL_FLOAT,
+                (unsigned char*)(hf->getFloatArray()->getDataPointer()),
+                osg::Image::NO_DELETE);
+        }
+
+    private:
+        osg::ref_ptr<const osg::HeightField> _hf;
+    };
+}
+
 ElevationTexture::ElevationTexture(
     const TileKey& key,
     const GeoHeightField& in_hf,
-    const std::vector<float>& resolutions) :
+    const std::vector<float>& resolutions,
+    float maxError) :
 
     _tilekey(key),
     _extent(in_hf.getExtent()),
-    _resolutions(std::move(resolutions))
+    _heights(nullptr),
+    _cols(0),
+    _rows(0)
 {
     setName(key.str() + ":elevation");
 
-    if (in_hf.valid())
+    // Most tiles come from a single source, so every sample has
+    // the same resolution; keep just the one value.
+    if (!resolutions.empty() &&
+        std::all_of(resolutions.begin(), resolutions.end(), [&](float r) { return r == resolutions.front(); }))
     {
-        _heightField = in_hf.getHeightField();
+        _resolutions.assign(1u, resolutions.front());
+    }
+    else
+    {
+        _resolutions = resolutions;
+    }
 
-        osg::Vec4 value;
+    if (in_hf.valid())
+    {
+        const osg::HeightField* hf = in_hf.getHeightField();
+        _cols = hf->getNumColumns();
+        _rows = hf->getNumRows();
 
-        osg::Image* heights = new osg::Image();
-        heights->allocateImage(_heightField->getNumColumns(), _heightField->getNumRows(), 1, GL_RED, GL_FLOAT);
-        heights->setInternalTextureFormat(GL_R32F);
+        if (maxError > 0.0f &&
+            _quantized.encode(hf->getFloatArray()->asVector().data(), _cols, _rows, maxError))
+        {
+            // quantized tiles have no image; see uncompressed().
+        }
+        else
+        {
+            _heightField = hf;
+            _heights = hf->getFloatArray()->asVector().data();
 
-        // Copy the float height data into the image
-        memcpy(heights->data(), _heightField->getHeightList().data(), sizeof(float) * _heightField->getNumRows() * _heightField->getNumColumns());
+            setImage(new HeightFieldImage(hf));
 
-        setImage(heights);
+            _read.setTexture(this);
+            _read.setSampleAsTexture(false);
+        }
 
         setDataVariance(osg::Object::STATIC);
         setInternalFormat(GL_R32F);
@@ -95,11 +141,8 @@ ElevationTexture::ElevationTexture(
         // Pooled, so never expire them.
         setUnRefImageDataAfterApply(false);
 
-        _read.setTexture(this);
-        _read.setSampleAsTexture(false);
-
         _resolution = Distance(
-            getExtent().height() / ((double)(getImage(0)->s()-1)),
+            getExtent().height() / ((double)(_cols-1)),
             getExtent().getSRS()->getUnits());
     }
 }
@@ -121,10 +164,62 @@ ElevationTexture::getElevation(double x, double y) const
 ElevationSample
 ElevationTexture::getElevationUV(double u, double v) const
 {
-    osg::Vec4 value;
+    if (_cols == 0)
+        return ElevationSample();
+
     u = osg::clampBetween(u, 0.0, 1.0), v = osg::clampBetween(v, 0.0, 1.0);
-    _read(value, u, v);
-    return ElevationSample(Distance(value.r(),Units::METERS), _resolution);
+    int s, t;
+    ImageUtils::nnUVtoST(u, v, s, t, _cols, _rows);
+    return ElevationSample(Distance(getHeight(s, t), Units::METERS), _resolution);
+}
+
+void
+ElevationTexture::getHeights(int t, float* out) const
+{
+    if (_heights)
+        std::copy(_heights + t*_cols, _heights + (t+1)*_cols, out);
+    else
+        _quantized.decodeRow(t, out);
+}
+
+osg::ref_ptr<ElevationTexture>
+ElevationTexture::uncompressed() const
+{
+    if (!isQuantized())
+        return const_cast<ElevationTexture*>(this);
+
+    osg::ref_ptr<osg::HeightField> hf = Util::RasterPool::instance().createHeightField(_cols, _rows);
+    float* heights = hf->getFloatArray()->asVector().data();
+    for (int t = 0; t < _rows; ++t)
+        _quantized.decodeRow(t, heights + t*_cols);
+
+    osg::ref_ptr<ElevationTexture> result = new ElevationTexture(
+        _tilekey,
+        GeoHeightField(hf.get(), _extent),
+        _resolutions);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    result->_normalTex = _normalTex;
+    result->_readNormal = _readNormal;
+    result->_ruggedness = _ruggedness;
+    result->_readRuggedness = _readRuggedness;
+    return result;
+}
+
+std::size_t
+ElevationTexture::getSizeInBytes() const
+{
+    std::size_t bytes =
+        _quantized.getSizeInBytes() +
+        _resolutions.size() * sizeof(float);
+
+    if (_heightField.valid())
+        bytes += _heightField->getFloatArray()->getTotalDataSize();
+
+    if (_normalTex.valid() && _normalTex->getImage())
+        bytes += _normalTex->getImage()->getTotalSizeInBytesIncludingMipmaps();
+
+    return bytes;
 }
 
 osg::Vec3
@@ -192,8 +287,8 @@ ElevationTexture::generateNormalMap(
 #ifdef USE_RUGGEDNESS
         if (!_ruggedness.valid())
         {
-            _ruggedness = new osg::Image();
-            _ruggedness->allocateImage(_read.s(), _read.t(), 1, GL_RED, GL_UNSIGNED_BYTE);
+            _ruggedness = Util::RasterPool::instance().createImage(
+                _cols, _rows, 1, GL_RED, GL_UNSIGNED_BYTE);
             _readRuggedness.setImage(_ruggedness.get());
             _readRuggedness.setBilinear(true);
         }
@@ -242,8 +337,8 @@ NormalMapGenerator::createNormalMap(
 
     ElevationPool::WorkingSet* workingSet = static_cast<ElevationPool::WorkingSet*>(ws);
 
-    osg::ref_ptr<osg::Image> image = new osg::Image();
-    image->allocateImage(ELEVATION_TILE_SIZE, ELEVATION_TILE_SIZE, 1, GL_RG, GL_UNSIGNED_BYTE);
+    osg::ref_ptr<osg::Image> image = Util::RasterPool::instance().createImage(
+        ELEVATION_TILE_SIZE, ELEVATION_TILE_SIZE, 1, GL_RG, GL_UNSIGNED_BYTE);
     image->setInternalTextureFormat(GL_RG8);
 
     ElevationPool* pool = map->getElevationPool();
@@ -253,15 +348,8 @@ NormalMapGenerator::createNormalMap(
     ImageUtils::PixelWriter writeRuggedness(ruggedness);
 
     osg::Vec3 normal;
-    osg::Vec2 packedNormal;
     osg::Vec4 pixel;
 
-    GeoPoint
-        north(key.getProfile()->getSRS()),
-        south(key.getProfile()->getSRS()),
-        east(key.getProfile()->getSRS()),
-        west(key.getProfile()->getSRS());
-
     osg::Vec3 a[4];
 
     const GeoExtent& ex = key.getExtent();
@@ -273,34 +361,74 @@ NormalMapGenerator::createNormalMap(
     if (!heights.valid())
         return NULL;
 
-    // build the sample set.
-    std::vector<osg::Vec4d> points(write.s() * write.t() * 4);
-    int p = 0;
-    for (int t = 0; t < write.t(); ++t)
+    const int size = write.s();
+
+    // Where a pixel's data resolution matches the tile's own sample spacing,
+    // the four points we'd sample around it are exactly its neighbours in
+    // the heightfield. Copy the heights into a grid with a one-sample
+    // apron taken from the neighbouring tiles, and compute those pixels a
+    // row at a time. Only pixels with coarser data (or a tile that fell
+    // back on a lower LOD) still need to sample the elevation pool.
+    std::pair<double, double> keyRes = key.getResolution(size);
+    const float gridRes = (float)keyRes.second;
+
+    bool useGrid =
+        heights->getTileKey() == key &&
+        heights->getNumColumns() == size &&
+        heights->getNumRows() == size &&
+        (float)keyRes.first == gridRes;
+
+    const int stride = size + 2;
+    std::vector<float> grid;
+    std::vector<unsigned> slowPixels;
+    std::vector<osg::Vec4d> points;
+
+    if (useGrid)
     {
-        double v = (double)t / (double)(write.t() - 1);
-        double y = ex.yMin() + v * ex.height();
-        east.y() = y;
-        west.y() = y;
+        grid.resize(stride * stride, NO_DATA_VALUE);
+        for (int t = 0; t < size; ++t)
+        {
+            heights->getHeights(t, &grid[(t + 1) * stride + 1]);
+        }
 
-        for (int s = 0; s < write.s(); ++s)
+        // apron: west and east columns, then south and north rows
+        points.reserve(4 * size);
+        for (int t = 0; t < size; ++t)
         {
-            double u = (double)s / (double)(write.s() - 1);
-            double x = ex.xMin() + u * ex.width();
-            north.x() = x;
-            south.x() = x;
+            double y = ex.yMin() + (double)t / (double)(size - 1) * ex.height();
+            points.emplace_back(ex.xMin() - gridRes, y, 0.0, gridRes);
+            points.emplace_back(ex.xMax() + gridRes, y, 0.0, gridRes);
+        }
+        for (int s = 0; s < size; ++s)
+        {
+            double x = ex.xMin() + (double)s / (double)(size - 1) * ex.width();
+            points.emplace_back(x, ex.yMin() - gridRes, 0.0, gridRes);
+            points.emplace_back(x, ex.yMax() + gridRes, 0.0, gridRes);
+        }
+    }
+
+    // build the sample set for the remaining pixels.
+    const std::size_t firstSlowPoint = points.size();
+    for (int t = 0; t < size; ++t)
+    {
+        double v = (double)t / (double)(size - 1);
+        double y = ex.yMin() + v * ex.height();
 
+        for (int s = 0; s < size; ++s)
+        {
             double r = heights->getResolution(s, t);
 
-            east.x() = x + r;
-            west.x() = x - r;
-            north.y() = y + r;
-            south.y() = y - r;
+            if (useGrid && r == gridRes)
+                continue;
+
+            double u = (double)s / (double)(size - 1);
+            double x = ex.xMin() + u * ex.width();
 
-            points[p++].set(west.x(), west.y(), 0.0, r);
-            points[p++].set(east.x(), east.y(), 0.0, r);
-            points[p++].set(south.x(), south.y(), 0.0, r);
-            points[p++].set(north.x(), north.y(), 0.0, r);
+            slowPixels.push_back(t * size + s);
+            points.emplace_back(x - r, y, 0.0, r);
+            points.emplace_back(x + r, y, 0.0, r);
+            points.emplace_back(x, y - r, 0.0, r);
+            points.emplace_back(x, y + r, 0.0, r);
         }
     }
 
@@ -323,69 +451,109 @@ NormalMapGenerator::createNormalMap(
 
     Distance res(0.0, key.getProfile()->getSRS()->getUnits());
     double dx, dy;
-    osg::Vec4 riPixel;
 
-    for (int t = 0; t < write.t(); ++t)
+    if (useGrid)
     {
-        double v = (double)t / (double)(write.t() - 1);
-        double y_or_lat = ex.yMin() + v * ex.height();
-
-        for (int s = 0; s < write.s(); ++s)
+        for (int t = 0; t < size; ++t)
+        {
+            grid[(t + 1) * stride] = points[2 * t].z();
+            grid[(t + 1) * stride + size + 1] = points[2 * t + 1].z();
+        }
+        for (int s = 0; s < size; ++s)
         {
-            int p = (4 * write.s() * t + 4 * s);
+            grid[s + 1] = points[2 * size + 2 * s].z();
+            grid[(size + 1) * stride + s + 1] = points[2 * size + 2 * s + 1].z();
+        }
 
-            res.set(points[p].w(), res.getUnits());
-            dx = res.asDistance(Units::METERS, y_or_lat);
-            dy = res.asDistance(Units::METERS, 0.0);
+        res.set(gridRes, res.getUnits());
+        dy = res.asDistance(Units::METERS, 0.0);
 
-            riPixel.r() = 0.0f;
+        bool writeRuggedRows =
+            ruggedness &&
+            ruggedness->s() == size && ruggedness->t() == size &&
+            ruggedness->getPixelFormat() == GL_RED &&
+            ruggedness->getDataType() == GL_UNSIGNED_BYTE;
 
-            // only attempt to create a normal vector if all the data is valid:
-            // a valid resolution value and four valid corner points.
-            if (res.getValue() != FLT_MAX &&
-                points[p + 0].z() != NO_DATA_VALUE &&
-                points[p + 1].z() != NO_DATA_VALUE &&
-                points[p + 2].z() != NO_DATA_VALUE &&
-                points[p + 3].z() != NO_DATA_VALUE)
-            {
-                a[0].set(-dx, 0, points[p + 0].z());
-                a[1].set(dx, 0, points[p + 1].z());
-                a[2].set(0, -dy, points[p + 2].z());
-                a[3].set(0, dy, points[p + 3].z());
+        for (int t = 0; t < size; ++t)
+        {
+            double v = (double)t / (double)(size - 1);
+            dx = res.asDistance(Units::METERS, ex.yMin() + v * ex.height());
+
+            createNormalRow(
+                &grid[t * stride],
+                &grid[(t + 1) * stride],
+                &grid[(t + 2) * stride],
+                size,
+                (float)dx, (float)dy,
+                image->data(0, t),
+                writeRuggedRows ? ruggedness->data(0, t) : nullptr);
+        }
+    }
 
-                normal = (a[1] - a[0]) ^ (a[3] - a[2]);
-                normal.normalize();
+    osg::Vec4 riPixel;
+    const osg::Vec4d* p = points.data() + firstSlowPoint;
 
-                if (ruggedness)
-                {
-                    // rudimentary normalized ruggedness index
-                    riPixel.r() = 0.25 * (
-                        fabs(points[p + 0].z() - points[p + 3].z()) +
-                        fabs(points[p + 1].z() - points[p + 0].z()) +
-                        fabs(points[p + 2].z() - points[p + 1].z()) +
-                        fabs(points[p + 3].z() - points[p + 2].z()));
-                    riPixel.r() = clamp(riPixel.r() / (float)dy, 0.0f, 1.0f);
-                    riPixel.r() = harden(harden(riPixel.r()));
-                }
-            }
-            else
-            {
-                normal.set(0, 0, 1);
-            }
+    for (unsigned pixelIndex : slowPixels)
+    {
+        int s = pixelIndex % size;
+        int t = pixelIndex / size;
 
-            NormalMapGenerator::pack(normal, pixel);
+        double v = (double)t / (double)(size - 1);
+        double y_or_lat = ex.yMin() + v * ex.height();
 
-            // TODO: won't actually be written until we make the format GL_RGB
-            // but we need to rewrite the curvature generator first
-            //pixel.b() = 0.0f; // 0.5f*(1.0f+normalMap->getCurvature(s, t));
+        res.set(p[0].w(), res.getUnits());
+        dx = res.asDistance(Units::METERS, y_or_lat);
+        dy = res.asDistance(Units::METERS, 0.0);
 
-            write(pixel, s, t);
+        riPixel.r() = 0.0f;
+
+        // only attempt to create a normal vector if all the data is valid:
+        // a valid resolution value and four valid corner points.
+        if (res.getValue() != FLT_MAX &&
+            p[0].z() != NO_DATA_VALUE &&
+            p[1].z() != NO_DATA_VALUE &&
+            p[2].z() != NO_DATA_VALUE &&
+            p[3].z() != NO_DATA_VALUE)
+        {
+            a[0].set(-dx, 0, p[0].z());
+            a[1].set(dx, 0, p[1].z());
+            a[2].set(0, -dy, p[2].z());
+            a[3].set(0, dy, p[3].z());
+
+            normal = (a[1] - a[0]) ^ (a[3] - a[2]);
+            normal.normalize();
 
             if (ruggedness)
             {
-                writeRuggedness(riPixel, s, t);
+                // rudimentary normalized ruggedness index
+                riPixel.r() = 0.25 * (
+                    fabs(p[0].z() - p[3].z()) +
+                    fabs(p[1].z() - p[0].z()) +
+                    fabs(p[2].z() - p[1].z()) +
+                    fabs(p[3].z() - p[2].z()));
+                riPixel.r() = clamp(riPixel.r() / (float)dy, 0.0f, 1.0f);
+                riPixel.r() = harden(harden(riPixel.r()));
             }
         }
+        else
+        {
+            normal.set(0, 0, 1);
+        }
+
+        NormalMapGenerator::pack(normal, pixel);
+
+        // TODO: won't actually be written until we make the format GL_RGB
+        // but we need to rewrite the curvature generator first
+        //pixel.b() = 0.0f; // 0.5f*(1.0f+normalMap->getCurvature(s, t));
+
+        write(pixel, s, t);
+
+        if (ruggedness)
+        {
+            writeRuggedness(riPixel, s, t);
+        }
+
+        p += 4;
     }
 
     osg::Texture2D* normalTex = new osg::Texture2D(image.get());
@@ -429,8 +597,7 @@ NormalMapGenerator::createNormalMap(
 
     ElevationPool::WorkingSet* workingSet = static_cast<ElevationPool::WorkingSet*>(ws);
 
-    osg::ref_ptr<osg::Image> image = new osg::Image();
-    image->allocateImage(
+    osg::ref_ptr<osg::Image> image = Util::RasterPool::instance().createImage(
         ELEVATION_TILE_SIZE, ELEVATION_TILE_SIZE, 1,
         GL_RG, GL_UNSIGNED_BYTE);
 
@@ -677,3 +844,172 @@ NormalMapGenerator::unpack(const osg::Vec4& packed, osg::Vec3& normal)
     normal.y() += (normal.y() > 0)? -t : t;
     normal.normalize();
 }
+
+void
+NormalMapGenerator::createNormalRow(
+    const float* south,
+    const float* row,
+    const float* north,
+    unsigned width,
+    float dx,
+    float dy,
+    unsigned char* out_normals,
+    unsigned char* out_ruggedness)
+{
+    // Same normal as createNormalMap's (E-W) x (N-S) cross product, but
+    // since the octohedral packing divides by the L1 norm anyway there is
+    // no need to normalize it first. The normals loop is branch-free, so
+    // compilers can vectorize it when trapping math is off.
+    const float nz = 2.0f * dx * dy;
+
+    for (unsigned c = 0; c < width; ++c)
+    {
+        float w = row[c], e = row[c + 2], s = south[c + 1], n = north[c + 1];
+
+        bool valid =
+            (w != NO_DATA_VALUE) & (e != NO_DATA_VALUE) &
+            (s != NO_DATA_VALUE) & (n != NO_DATA_VALUE);
+
+        // Zero the heights of an invalid pixel before any arithmetic: a NO_DATA
+        // neighbour (-FLT_MAX) would overflow to inf, and masking inf after the
+        // fact gives NaN (and casting NaN to a byte is undefined).
+        w = valid ? w : 0.0f;
+        e = valid ? e : 0.0f;
+        s = valid ? s : 0.0f;
+        n = valid ? n : 0.0f;
+        float nx = -dy * (e - w);
+        float ny = -dx * (n - s);
+        float d = 1.0f / (fabs(nx) + fabs(ny) + nz);
+
+        out_normals[2 * c + 0] = (unsigned char)(127.5f * (nx * d + 1.0f));
+        out_normals[2 * c + 1] = (unsigned char)(127.5f * (ny * d + 1.0f));
+    }
+
+    if (out_ruggedness)
+    {
+        for (unsigned c = 0; c < width; ++c)
+        {
+            float w = row[c], e = row[c + 2], s = south[c + 1], n = north[c + 1];
+
+            bool valid =
+                (w != NO_DATA_VALUE) & (e != NO_DATA_VALUE) &
+                (s != NO_DATA_VALUE) & (n != NO_DATA_VALUE);
+
+            // rudimentary normalized ruggedness index
+            float ri = valid ? 0.25f * (fabs(w - n) + fabs(e - w) + fabs(s - e) + fabs(n - s)) : 0.0f;
+            ri = harden(harden(clamp(ri / dy, 0.0f, 1.0f)));
+
+            out_ruggedness[c] = (unsigned char)(255.0f * ri);
+        }
+    }
+}
+
+QuantizedHeights::QuantizedHeights() :
+    _cols(0u),
+    _rows(0u),
+    _min(0.0f),
+    _step(0.0f)
+{
+    //nop
+}
+
+bool
+QuantizedHeights::encode(const float* heights, unsigned cols, unsigned rows, float maxError)
+{
+    _cols = _rows = 0u;
+    std::vector<std::uint8_t>().swap(_data8);
+    std::vector<std::uint16_t>().swap(_data16);
+
+    const std::size_t count = (std::size_t)cols * (std::size_t)rows;
+    if (count == 0u || maxError <= 0.0f)
+        return false;
+
+    float minValue = FLT_MAX, maxValue = -FLT_MAX;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        float h = heights[i];
+        if (h != NO_DATA_VALUE && std::isfinite(h))
+        {
+            minValue = std::min(minValue, h);
+            maxValue = std::max(maxValue, h);
+        }
+    }
+
+    // all NO_DATA?
+    if (minValue > maxValue)
+        minValue = maxValue = 0.0f;
+
+    // Rounding to the nearest step is off by at most half a step. Use the
+    // fewest bits that keep that within maxError, then spread the range
+    // over all of their codes. The top code in each depth means NO_DATA.
+    const double range = (double)maxValue - (double)minValue;
+    unsigned maxCode;
+    if (range <= 254.0 * 2.0 * (double)maxError)
+        maxCode = 254u;
+    else if (range <= 65534.0 * 2.0 * (double)maxError)
+        maxCode = 65534u;
+    else
+        return false;
+
+    const double step = range / (double)maxCode;
+    _min = minValue;
+    _step = (float)step;
+
+    auto quantize = [&](float h) -> unsigned
+    {
+        if (h == NO_DATA_VALUE || !std::isfinite(h))
+            return maxCode + 1u;
+        if (step == 0.0)
+            return 0u;
+        double code = std::floor(((double)h - (double)_min) / step + 0.5);
+        return (unsigned)osg::clampBetween(code, 0.0, (double)maxCode);
+    };
+
+    if (maxCode == 254u)
+    {
+        _data8.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+            _data8[i] = (std::uint8_t)quantize(heights[i]);
+    }
+    else
+    {
+        _data16.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+            _data16[i] = (std::uint16_t)quantize(heights[i]);
+    }
+
+    _cols = cols;
+    _rows = rows;
+    return true;
+}
+
+void
+QuantizedHeights::decodeRow(unsigned t, float* out) const
+{
+    const std::size_t first = (std::size_t)t * (std::size_t)_cols;
+
+    if (!_data16.empty())
+    {
+        const std::uint16_t* in = _data16.data() + first;
+        for (unsigned s = 0; s < _cols; ++s)
+            out[s] = decode(in[s], 0xFFFFu);
+    }
+    else
+    {
+        const std::uint8_t* in = _data8.data() + first;
+        for (unsigned s = 0; s < _cols; ++s)
+            out[s] = decode(in[s], 0xFFu);
+    }
+}
+
+unsigned
+QuantizedHeights::getBitsPerSample() const
+{
+    return !_data16.empty() ? 16u : !_data8.empty() ? 8u : 0u;
+}
+
+std::size_t
+QuantizedHeights::getSizeInBytes() const
+{
+    return _data8.size() + _data16.size() * sizeof(std::uint16_t);
+}
@@ -22,6 +22,8 @@
 #include <osgEarth/MemCache>
 #include <osgEarth/Metrics>
 #include <osgEarth/NetworkMonitor>
+#include <osgEarth/RasterPool>
+#include <chrono>
 #include <cinttypes>
 
 using namespace osgEarth;
@@ -217,6 +219,27 @@ ElevationLayer::applyProfileOverrides(osg::ref_ptr<const Profile>& inOutProfile)
     }
 }
 
+std::string
+ElevationLayer::getCacheKey(const TileKey& key) const
+{
+    // cache key combines the key with the horizontal profile signature
+    return Cache::makeCacheKey(key.str() + "-" + key.getProfile()->getHorizSignature(), "elevation");
+}
+
+void
+ElevationLayer::addedToMap(const Map* map)
+{
+    TileLayer::addedToMap(map);
+    _sourceTiles.setMaxSize(getSourceTileCacheSize());
+}
+
+void
+ElevationLayer::prefetchFromCacheBin(CacheBin* bin, const std::vector<std::string>& cacheKeys) const
+{
+    // same options as the cache read in createHeightFieldInKeyProfile
+    bin->prefetchObjects(cacheKeys, nullptr);
+}
+
 void
 ElevationLayer::assembleHeightField(const TileKey& key,
                                     osg::ref_ptr<osg::HeightField>& out_hf,
@@ -274,8 +297,20 @@ ElevationLayer::assembleHeightField(const TileKey& key,
 
             if ( isKeyInLegalRange(layerKey) )
             {
-                Threading::ScopedReadLock lock(inUseMutex());
-                GeoHeightField hf = createHeightFieldImplementation(layerKey, progress);
+                // neighboring output tiles tend to share source tiles, so check the cache first
+                const int revision = getRevision();
+                GeoHeightField hf;
+                if (!_sourceTiles.get(layerKey, revision, hf))
+                {
+                    Threading::ScopedReadLock lock(inUseMutex());
+                    hf = createHeightFieldImplementation(layerKey, progress);
+
+                    if (hf.valid() && !(progress && progress->isCanceled()))
+                    {
+                        _sourceTiles.insert(layerKey, revision, hf);
+                    }
+                }
+
                 if (hf.valid())
                 {
                     heightFields.push_back( hf );
@@ -300,8 +335,7 @@ ElevationLayer::assembleHeightField(const TileKey& key,
             //Now sort the heightfields by resolution to make sure we're sampling the highest resolution one first.
             std::sort( heightFields.begin(), heightFields.end(), GeoHeightField::SortByResolutionFunctor());
 
-            out_hf = new osg::HeightField();
-            out_hf->allocate(width, height);
+            out_hf = Util::RasterPool::instance().createHeightField(width, height);
 
             //Go ahead and set up the heightfield so we don't have to worry about it later
             double minx, miny, maxx, maxy;
@@ -377,14 +411,30 @@ ElevationLayer::createHeightField(const TileKey& key, ProgressCallback* progress
 
     NetworkMonitor::ScopedRequestLayer layerRequest(getName());
 
-    GeoHeightField result = createHeightFieldInKeyProfile(key, progress);
+    auto start = std::chrono::steady_clock::now();
+    TileLayerStatistics::Origin origin = TileLayerStatistics::ORIGIN_NONE;
+
+    GeoHeightField result = createHeightFieldInKeyProfile(key, progress, &origin);
+
+    const osg::HeightField* hf = result.valid() ? result.getHeightField() : nullptr;
+
+    _tileStats->record(
+        hf ? origin : TileLayerStatistics::ORIGIN_NONE,
+        key.getLOD(),
+        (std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count(),
+        hf ? hf->getFloatArray()->getTotalDataSize() : 0u);
 
     return result;
 }
 
 GeoHeightField
-ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallback* progress)
+ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallback* progress, TileLayerStatistics::Origin* origin)
 {
+    TileLayerStatistics::Origin unused;
+    if (!origin)
+        origin = &unused;
+
     GeoHeightField result;
     osg::ref_ptr<osg::HeightField> hf;
 
@@ -403,7 +453,7 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
 
     // cache key combines the key with the full signature (incl vdatum)
     // the cache key combines the Key and the horizontal profile.
-    auto cacheKey = Cache::makeCacheKey(key.str() + "-" + key.getProfile()->getHorizSignature(), "elevation");
+    auto cacheKey = getCacheKey(key);
     std::string memCacheKey;
 
     // see if there's a persistent cache.
@@ -435,6 +485,7 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
                 key.getExtent());
 
             fromMemCache = true;
+            *origin = TileLayerStatistics::ORIGIN_MEMORY_CACHE;
         }
     }
 
@@ -467,6 +518,7 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
                     {
                         hf = cachedHF;
                         fromCache = true;
+                        *origin = TileLayerStatistics::ORIGIN_CACHE_BIN;
                     }
                 }
             }
@@ -509,6 +561,7 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
             // The const_cast is safe here because we just created the
             // heightfield from scratch...not from a cache.
             hf = const_cast<osg::HeightField*>(result.getHeightField());
+            *origin = TileLayerStatistics::ORIGIN_SOURCE;
 
             // validate it to make sure it's legal.
             if ( hf.valid() && !validateHeightField(hf.get()) )
@@ -558,6 +611,7 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
             {
                 OE_DEBUG << LC << "Using cached but expired heightfield for " << key.str() << std::endl;
                 hf = cachedHF;
+                *origin = TileLayerStatistics::ORIGIN_CACHE_BIN;
             }
 
             // No luck on any path:
@@ -28,6 +28,7 @@
 
 #include <thread>
 #include <chrono>
+#include <cstdlib>
 
 using namespace osgEarth;
 
@@ -62,10 +63,16 @@ ElevationPool::StrongLRU::clear()
 ElevationPool::ElevationPool() :
     _index(nullptr),
     _tileSize(257),
+    _maxQuantizationError(0.0f),
     _L2(64u),
     _mapRevision(-1),
     _elevationHash(0)
 {
+    const char* maxError = ::getenv("OSGEARTH_ELEVATION_MAX_ERROR");
+    if (maxError)
+    {
+        _maxQuantizationError = std::max(0.0f, (float)atof(maxError));
+    }
 }
 
 
@@ -381,7 +388,8 @@ ElevationPool::getOrCreateRaster(
             result = new ElevationTexture(
                 keyToUse,
                 GeoHeightField(hf.get(), keyToUse.getExtent()),
-                resolutions);
+                resolutions,
+                _maxQuantizationError);
         }
         else
         {
@@ -432,13 +440,13 @@ namespace
     //};
 
     inline void quickSample(
-        const ImageUtils::PixelReader& reader,
+        const ElevationTexture& raster,
         double u, double v,
         osg::Vec4f& out,
         ElevationPool::Envelope::QuickSampleVars& a)
     {
-        const double sizeS = (double)(reader.s() - 1);
-        const double sizeT = (double)(reader.t() - 1);
+        const double sizeS = (double)(raster.getNumColumns() - 1);
+        const double sizeT = (double)(raster.getNumRows() - 1);
 
         // u, v => [0..1]
         const double s = u * sizeS;
@@ -456,10 +464,11 @@ namespace
         const int intT1 = t1;
         const double tmix = t0 < t1 ? (t - t0) / (t1 - t0) : 0.0;
 
-        reader(a.UL, intS0, intT0, 0, 0); // upper left
-        reader(a.UR, intS1, intT0, 0, 0); // upper right
-        reader(a.LL, intS0, intT1, 0, 0); // lower left
-        reader(a.LR, intS1, intT1, 0, 0); // lower right
+        // read the heights directly, since quantized tiles have no image
+        a.UL.r() = raster.getHeight(intS0, intT0); // upper left
+        a.UR.r() = raster.getHeight(intS1, intT0); // upper right
+        a.LL.r() = raster.getHeight(intS0, intT1); // lower left
+        a.LR.r() = raster.getHeight(intS1, intT1); // lower right
 
         const double minusSmix = 1.0 - smix;
         const double minusTmis = 1.0 - tmix;
@@ -607,7 +616,7 @@ ElevationPool::Envelope::sampleMapCoords(
                     u = osg::clampBetween(u, 0.0, 1.0);
                     v = osg::clampBetween(v, 0.0, 1.0);
 
-                    quickSample(_raster->reader(), u, v, elev, _vars);
+                    quickSample(*_raster, u, v, elev, _vars);
                     p.z() = elev.r();
                 }
                 else
@@ -748,7 +757,7 @@ ElevationPool::sampleMapCoords(
                     u = osg::clampBetween(u, 0.0, 1.0);
                     v = osg::clampBetween(v, 0.0, 1.0);
 
-                    quickSample(raster->reader(), u, v, elev, qvars);
+                    quickSample(*raster, u, v, elev, qvars);
                     p.z() = elev.r();
                 }
                 else
@@ -888,7 +897,7 @@ ElevationPool::sampleMapCoords(
                     u = osg::clampBetween(u, 0.0, 1.0);
                     v = osg::clampBetween(v, 0.0, 1.0);
 
-                    quickSample(raster->reader(), u, v, elev, qvars);
+                    quickSample(*raster, u, v, elev, qvars);
                     p.z() = elev.r();
                 }
                 else
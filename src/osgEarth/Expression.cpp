@@ -363,6 +363,60 @@ NumericExpression::eval() const
     return !osg::isNaN( _value ) ? _value : 0.0;
 }
 
+double
+NumericExpression::eval(const double* values) const
+{
+    // literals keep their value outside the program (negative numbers
+    // don't parse), and with no variables a clean result is final
+    if (_vars.empty() && !_dirty)
+        return !osg::isNaN(_value) ? _value : 0.0;
+
+    // the stack never gets deeper than the program is long
+    double local[32];
+    std::vector<double> heap;
+    double* stack = local;
+    if (_rpn.size() > 32)
+    {
+        heap.resize(_rpn.size());
+        stack = heap.data();
+    }
+
+    int top = -1;
+    unsigned var_i = 0;
+
+    for (auto& a : _rpn)
+    {
+        if (a.first == OPERAND)
+        {
+            stack[++top] = a.second;
+        }
+        else if (a.first == VARIABLE)
+        {
+            // variables appear in the program in the same order as in _vars
+            stack[++top] = values[var_i++];
+        }
+        else if (top >= 1)
+        {
+            double op2 = stack[top--];
+            double& op1 = stack[top];
+            switch (a.first)
+            {
+            case ADD:  op1 = op1 + op2; break;
+            case SUB:  op1 = op1 - op2; break;
+            case MULT: op1 = op1 * op2; break;
+            case DIV:  op1 = op1 / op2; break;
+            case MOD:  op1 = fmod(op1, op2); break;
+            case MIN:  op1 = osg::minimum(op1, op2); break;
+            case MAX:  op1 = osg::maximum(op1, op2); break;
+            default: break;
+            }
+        }
+    }
+
+    double value = top >= 0 ? stack[top] : 0.0;
+    return !osg::isNaN(value) ? value : 0.0;
+}
+
 //------------------------------------------------------------------------
 
 StringExpression::StringExpression() :
@@ -564,6 +618,24 @@ StringExpression::eval() const
     return _value;
 }
 
+std::string
+StringExpression::eval(const std::string* values) const
+{
+    // literals keep their value outside the infix, and with no
+    // variables a clean result is final
+    if (_vars.empty() && !_dirty)
+        return _value;
+
+    std::string result;
+    unsigned var_i = 0;
+    for (auto& a : _infix)
+    {
+        // variables appear in the same order as in _vars
+        result.append(a.first == VARIABLE ? values[var_i++] : a.second);
+    }
+    return result;
+}
+
 URI
 StringExpression::evalURI() const
 {
@@ -19,6 +19,7 @@
 #include <osgEarth/ExtrudeGeometryFilter>
 #include <osgEarth/Session>
 #include <osgEarth/FeatureSourceIndexNode>
+#include <osgEarth/FeatureExpression>
 
 #include <osgEarth/ResourceLibrary>
 #include <osgEarth/StyleSheet>
@@ -1191,6 +1192,24 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
     int fubar = 0;
 #endif
 
+    FeatureNumericExpression heightExpr;
+    if (_heightExpr.isSet())
+        heightExpr = FeatureNumericExpression(*_heightExpr);
+
+    FeatureStringExpression featureNameExpr(_featureNameExpr);
+
+    // Symbol scripts can change attributes as we go; without them,
+    // evaluate the heights for the whole batch up front.
+    std::vector<double> heights;
+    bool hasScripts =
+        (_polySymbol.valid() && _polySymbol->script().isSet()) ||
+        _extrusionSymbol->script().isSet();
+
+    if (!_heightCallback.valid() && !heightExpr.empty() && !hasScripts)
+    {
+        heightExpr.eval(features, &context, heights);
+    }
+
     for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
     {
         Feature* input = f->get();
@@ -1257,9 +1276,13 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             {
                 height = _heightCallback->operator()(input, context);
             }
+            else if (!heights.empty())
+            {
+                height = heights[f - features.begin()];
+            }
             else if (_heightExpr.isSet())
             {
-                height = input->eval(_heightExpr.mutable_value(), &context);
+                height = heightExpr.eval(input, &context);
             }
             else
             {
@@ -1268,8 +1291,8 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
 
             // Set up for feature naming and feature indexing:
             std::string name;
-            if (!_featureNameExpr.empty())
-                name = input->eval(_featureNameExpr, &context);
+            if (!featureNameExpr.empty())
+                name = featureNameExpr.eval(input, &context);
 
             osg::ref_ptr<osg::StateSet> wallStateSet;
             osg::ref_ptr<osg::StateSet> roofStateSet;
@@ -182,16 +182,165 @@ const std::vector<double>& AttributeValue::getDoubleArrayValue() const
 
 //----------------------------------------------------------------------------
 
+AttributeColumns::AttributeColumns() :
+    _numRows(0u)
+{
+    //nop
+}
+
+int
+AttributeColumns::addColumn(const std::string& name, AttributeType type)
+{
+    auto i = _index.find(name);
+    if (i != _index.end())
+        return i->second;
+
+    if (type != ATTRTYPE_STRING &&
+        type != ATTRTYPE_INT &&
+        type != ATTRTYPE_DOUBLE &&
+        type != ATTRTYPE_BOOL)
+    {
+        return -1;
+    }
+
+    int col = (int)_columns.size();
+    _columns.emplace_back();
+    Column& column = _columns.back();
+    column.name = name;
+    column.type = type;
+    column.cells.resize(_numRows);
+    column.set.resize(_numRows, false);
+    _index[name] = col;
+    return col;
+}
+
+int
+AttributeColumns::getColumn(const std::string& name) const
+{
+    auto i = _index.find(name);
+    return i != _index.end() ? i->second : -1;
+}
+
+unsigned
+AttributeColumns::addRow()
+{
+    for (auto& column : _columns)
+    {
+        column.cells.emplace_back();
+        column.set.push_back(false);
+    }
+    return _numRows++;
+}
+
+void
+AttributeColumns::set(unsigned row, int col, double value)
+{
+    _columns[col].cells[row].d = value;
+    _columns[col].set[row] = true;
+}
+
+void
+AttributeColumns::set(unsigned row, int col, long long value)
+{
+    _columns[col].cells[row].i = value;
+    _columns[col].set[row] = true;
+}
+
+void
+AttributeColumns::set(unsigned row, int col, bool value)
+{
+    _columns[col].cells[row].b = value;
+    _columns[col].set[row] = true;
+}
+
+void
+AttributeColumns::set(unsigned row, int col, const char* value)
+{
+    auto result = _stringIndex.emplace(value, (std::uint32_t)_strings.size());
+    if (result.second)
+    {
+        // map nodes don't move, so the pool can point at the keys
+        _strings.push_back(&result.first->first);
+    }
+    _columns[col].cells[row].s = result.first->second;
+    _columns[col].set[row] = true;
+}
+
+void
+AttributeColumns::get(unsigned row, int col, AttributeValue& output) const
+{
+    const Column& column = _columns[col];
+    output.type = column.type;
+    output.value.set = column.set[row];
+    if (output.value.set)
+    {
+        const Cell& cell = column.cells[row];
+        switch (column.type)
+        {
+        case ATTRTYPE_STRING: output.value.stringValue = *_strings[cell.s]; break;
+        case ATTRTYPE_DOUBLE: output.value.doubleValue = cell.d; break;
+        case ATTRTYPE_INT:    output.value.intValue = cell.i; break;
+        case ATTRTYPE_BOOL:   output.value.boolValue = cell.b; break;
+        default: break;
+        }
+    }
+}
+
+void
+AttributeColumns::get(unsigned row, AttributeTable& output) const
+{
+    // column names are unique, so skip the table's duplicate checks
+    output.clear();
+    output._container.resize(_columns.size());
+    for (unsigned col = 0; col < _columns.size(); ++col)
+    {
+        output._container[col].first = _columns[col].name;
+        get(row, col, output._container[col].second);
+    }
+}
+
+std::size_t
+AttributeColumns::getSizeInBytes() const
+{
+    std::size_t size = sizeof(AttributeColumns);
+
+    for (auto& column : _columns)
+    {
+        size += sizeof(Column) + column.name.capacity();
+        size += column.cells.capacity() * sizeof(Cell);
+        size += column.set.capacity() / 8u;
+    }
+
+    // rough cost of the index and pool nodes
+    size += _index.size() * (sizeof(std::string) + sizeof(int) + 4u * sizeof(void*));
+    size += _strings.capacity() * sizeof(const std::string*);
+    for (auto& entry : _stringIndex)
+    {
+        size += sizeof(entry) + 2u * sizeof(void*);
+        if (entry.first.capacity() > 15u)
+            size += entry.first.capacity() + 1u;
+    }
+    return size;
+}
+
+//----------------------------------------------------------------------------
+
 Feature::Feature() :
     _fid(0LL),
-    _srs(NULL)
+    _srs(NULL),
+    _row(0u),
+    _attrsCopied(false),
+    _revision(0u)
 {
     //nop
 }
 
 Feature::Feature(FeatureID fid) :
     _fid(fid),
-    _srs(0L)
+    _srs(0L),
+    _row(0u),
+    _attrsCopied(false),
+    _revision(0u)
 {
     //NOP
 }
@@ -199,7 +348,10 @@ Feature::Feature(FeatureID fid) :
 Feature::Feature(Geometry* geom, const SpatialReference* srs, const Style& style, FeatureID fid) :
     _geom(geom),
     _srs(srs),
-    _fid(fid)
+    _fid(fid),
+    _row(0u),
+    _attrsCopied(false),
+    _revision(0u)
 {
     if (!style.empty())
         _style = style;
@@ -209,11 +361,18 @@ Feature::Feature(Geometry* geom, const SpatialReference* srs, const Style& style
 
 Feature::Feature(const Feature& rhs) : //, const osg::CopyOp& copyOp) :
     _fid(rhs._fid),
-    _attrs(rhs._attrs),
     _style(rhs._style),
     _geoInterp(rhs._geoInterp),
-    _srs(rhs._srs.get())
+    _srs(rhs._srs.get()),
+    _columns(rhs._columns),
+    _row(rhs._row),
+    _attrsCopied(false),
+    _revision(0u)
 {
+    // a copy shares the column store row, if there is one
+    if (!_columns.valid())
+        _attrs = rhs._attrs;
+
     if (rhs._geom.valid())
         _geom = rhs._geom->clone();
 
@@ -228,6 +387,10 @@ Feature::Feature(Feature&& rhs) // : osg::Object(rhs)
     _geoInterp = std::move(rhs._geoInterp);
     _geom = std::move(rhs._geom);
     _cachedExtent = std::move(rhs._cachedExtent);
+    _columns = std::move(rhs._columns);
+    _row = rhs._row;
+    _attrsCopied = rhs._attrsCopied.load();
+    _revision = rhs._revision;
 }
 
 Feature::~Feature()
@@ -275,6 +438,7 @@ void
 Feature::dirty()
 {
     _cachedExtent = GeoExtent::INVALID;
+    ++_revision;
     //_cachedGeocentricBound._radius = -1.0; // invalidate
     //_cachedBoundingPolytopeValid = false;
 }
@@ -282,6 +446,7 @@ Feature::dirty()
 void
 Feature::set( const std::string& name, const std::string& value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.type = ATTRTYPE_STRING;
     a.value.stringValue = value;
@@ -291,6 +456,7 @@ Feature::set( const std::string& name, const std::string& value )
 void
 Feature::set( const std::string& name, double value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.type = ATTRTYPE_DOUBLE;
     a.value.doubleValue = value;
@@ -300,6 +466,7 @@ Feature::set( const std::string& name, double value )
 void
 Feature::set( const std::string& name, long long value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.type = ATTRTYPE_INT;
     a.value.intValue = value;
@@ -309,6 +476,7 @@ Feature::set( const std::string& name, long long value )
 void
 Feature::set(const std::string& name, int value)
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.type = ATTRTYPE_INT;
     a.value.intValue = value;
@@ -318,12 +486,14 @@ Feature::set(const std::string& name, int value)
 void
 Feature::set( const std::string& name, const AttributeValue& value)
 {
+    detach();
     _attrs[ name ] = value;
 }
 
 void
 Feature::set( const std::string& name, bool value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.type = ATTRTYPE_BOOL;
     a.value.boolValue = value;
@@ -333,6 +503,7 @@ Feature::set( const std::string& name, bool value )
 void
 Feature::set( const std::string& name, const std::vector<double>& value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.type = ATTRTYPE_DOUBLEARRAY;
     a.value.doubleArrayValue = value;
@@ -342,6 +513,7 @@ Feature::set( const std::string& name, const std::vector<double>& value )
 void
 Feature::setSwap( const std::string& name, std::vector<double>& value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.type = ATTRTYPE_DOUBLEARRAY;
     a.value.doubleArrayValue.swap(value);
@@ -351,6 +523,7 @@ Feature::setSwap( const std::string& name, std::vector<double>& value )
 void
 Feature::setNull( const std::string& name)
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.value.set = false;
 }
@@ -358,6 +531,7 @@ Feature::setNull( const std::string& name)
 void
 Feature::setNull( const std::string& name, AttributeType type)
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.type = type;
     a.value.set = false;
@@ -366,54 +540,133 @@ Feature::setNull( const std::string& name, AttributeType type)
 void
 Feature::removeAttribute(const std::string& name)
 {
+    detach();
     _attrs.erase(name);
 }
 
+const AttributeTable&
+Feature::getAttrs() const
+{
+    if (_columns.valid() && !_attrsCopied)
+    {
+        Threading::ScopedMutexLock lock(_columns->_mutex);
+        if (!_attrsCopied)
+        {
+            _columns->get(_row, _attrs);
+            _attrsCopied = true;
+        }
+    }
+    return _attrs;
+}
+
+void
+Feature::setAttributeRow(const AttributeColumns* columns, unsigned row)
+{
+    ++_revision;
+    _attrs.clear();
+    _columns = columns;
+    _row = row;
+    _attrsCopied = false;
+}
+
+void
+Feature::detach()
+{
+    ++_revision;
+
+    if (_columns.valid())
+    {
+        if (!_attrsCopied)
+            _columns->get(_row, _attrs);
+
+        _columns = nullptr;
+        _attrsCopied = false;
+    }
+}
+
+const AttributeValue*
+Feature::getAttr(const std::string& name, AttributeValue& temp) const
+{
+    if (_columns.valid())
+    {
+        int col = _columns->getColumn(name);
+        if (col < 0)
+            return nullptr;
+
+        _columns->get(_row, col, temp);
+        return &temp;
+    }
+    else
+    {
+        // the table's keys are case-insensitive
+        AttributeTable::const_iterator i = _attrs.find(name);
+        return i != _attrs.end() ? &i->second : nullptr;
+    }
+}
+
 bool
 Feature::hasAttr( const std::string& name ) const
 {
-    return _attrs.find(toLower(name)) != _attrs.end();
+    if (_columns.valid())
+        return _columns->getColumn(name) >= 0;
+    else
+        return _attrs.find(name) != _attrs.end();
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
+    AttributeValue temp;
+    const AttributeValue* a = getAttr(name, temp);
+    return a ? a->getString() : EMPTY_STRING;
 }
 
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
+    AttributeValue temp;
+    const AttributeValue* a = getAttr(name, temp);
+    return a ? a->getDouble(defaultValue) : defaultValue;
 }
 
 long long
 Feature::getInt( const std::string& name, long long defaultValue ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
+    AttributeValue temp;
+    const AttributeValue* a = getAttr(name, temp);
+    return a ? a->getInt(defaultValue) : defaultValue;
 }
 
 const std::vector<double>*
 Feature::getDoubleArray( const std::string& name ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    // column stores never hold arrays
+    static const std::vector<double> s_empty;
+    if (_columns.valid())
+        return _columns->getColumn(name) >= 0 ? &s_empty : 0L;
+
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? &i->second.getDoubleArrayValue() : 0L;
 }
 
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
+    AttributeValue temp;
+    const AttributeValue* a = getAttr(name, temp);
+    return a ? a->getBool(defaultValue) : defaultValue;
 }
 
 bool
 Feature::isSet( const std::string& name) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    if (_columns.valid())
+    {
+        int col = _columns->getColumn(name);
+        return col >= 0 ? _columns->isSet(_row, col) : false;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.value.set : false;
 }
 
@@ -424,10 +677,11 @@ Feature::eval( NumericExpression& expr, FilterContext const* context ) const
     for (NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i)
     {
         double val = 0.0;
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        AttributeValue temp;
+        const AttributeValue* a = getAttr(i->first, temp);
+        if (a)
         {
-            val = ai->second.getDouble(0.0);
+            val = a->getDouble(0.0);
         }
         else if (context && context->getSession())
         {
@@ -457,10 +711,11 @@ Feature::eval(NumericExpression& expr, Session* session) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         double val = 0.0;
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        AttributeValue temp;
+        const AttributeValue* a = getAttr(i->first, temp);
+        if (a)
         {
-            val = ai->second.getDouble(0.0);
+            val = a->getDouble(0.0);
         }
         else if (session)
         {
@@ -493,10 +748,11 @@ Feature::eval(StringExpression& expr, FilterContext const* context) const
     for (StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i)
     {
         std::string val = "";
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        AttributeValue temp;
+        const AttributeValue* a = getAttr(i->first, temp);
+        if (a)
         {
-            val = ai->second.getString();
+            val = a->getString();
         }
         else if (context && context->getSession())
         {
@@ -529,10 +785,11 @@ Feature::eval(StringExpression& expr, Session* session) const
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         std::string val = "";
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        AttributeValue temp;
+        const AttributeValue* a = getAttr(i->first, temp);
+        if (a)
         {
-            val = ai->second.getString();
+            val = a->getString();
         }
         else if (session)
         {
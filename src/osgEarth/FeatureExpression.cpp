@@ -0,0 +1,234 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/FeatureExpression>
+#include <osgEarth/FilterContext>
+#include <osgEarth/ScriptEngine>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[FeatureExpression] "
+
+namespace
+{
+    // Variable names resolved to the columns of one column store
+    struct Binding
+    {
+        const AttributeColumns* columns = nullptr;
+        std::vector<int> cols;
+
+        void bind(const AttributeColumns* value, const std::vector<std::string>& names)
+        {
+            if (value != columns)
+            {
+                columns = value;
+                cols.resize(names.size());
+                for (unsigned i = 0; i < names.size(); ++i)
+                    cols[i] = columns ? columns->getColumn(names[i]) : -1;
+            }
+        }
+    };
+
+    // Finds variable i of a feature, copying it into temp if necessary.
+    // Returns nullptr if the feature has no such attribute.
+    const AttributeValue* find(
+        const Feature* feature,
+        Binding& binding,
+        const std::vector<std::string>& names,
+        unsigned i,
+        AttributeValue& temp)
+    {
+        if (binding.columns)
+        {
+            int col = binding.cols[i];
+            if (col < 0)
+                return nullptr;
+
+            binding.columns->get(feature->getAttributeRow(), col, temp);
+            return &temp;
+        }
+        else
+        {
+            // case-insensitive, no need to convert the name
+            const AttributeTable& attrs = feature->getAttrs();
+            AttributeTable::const_iterator a = attrs.find(names[i]);
+            return a != attrs.end() ? &a->second : nullptr;
+        }
+    }
+
+    ScriptEngine* getScriptEngine(const FilterContext* context)
+    {
+        return context && context->getSession() ?
+            context->getSession()->getScriptEngine() :
+            nullptr;
+    }
+
+    double evalNumeric(
+        const NumericExpression& expr,
+        const std::vector<std::string>& names,
+        const Feature* feature,
+        const FilterContext* context,
+        Binding& binding,
+        std::vector<double>& values)
+    {
+        binding.bind(feature->getAttributeColumns(), names);
+
+        AttributeValue temp;
+        for (unsigned i = 0; i < names.size(); ++i)
+        {
+            values[i] = 0.0;
+
+            const AttributeValue* a = find(feature, binding, names, i, temp);
+            if (a)
+            {
+                values[i] = a->getDouble(0.0);
+            }
+            else if (ScriptEngine* engine = getScriptEngine(context))
+            {
+                //No attr found, look for script
+                ScriptResult result = engine->run(names[i], feature, context);
+                if (result.success())
+                    values[i] = result.asDouble();
+                else
+                    OE_WARN << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
+            }
+        }
+
+        return expr.eval(values.data());
+    }
+
+    std::string evalString(
+        const StringExpression& expr,
+        const std::vector<std::string>& names,
+        const Feature* feature,
+        const FilterContext* context,
+        Binding& binding,
+        std::vector<std::string>& values)
+    {
+        binding.bind(feature->getAttributeColumns(), names);
+
+        AttributeValue temp;
+        for (unsigned i = 0; i < names.size(); ++i)
+        {
+            values[i].clear();
+
+            const AttributeValue* a = find(feature, binding, names, i, temp);
+            if (a)
+            {
+                values[i] = a->getString();
+            }
+            else if (ScriptEngine* engine = getScriptEngine(context))
+            {
+                //No attr found, look for script
+                ScriptResult result = engine->run(names[i], feature, context);
+                if (result.success())
+                {
+                    values[i] = result.asString();
+                }
+                else
+                {
+                    // Couldn't execute it as code, just take it as a string literal.
+                    values[i] = names[i];
+                    OE_DEBUG << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
+                }
+            }
+        }
+
+        return expr.eval(values.data());
+    }
+}
+
+//........................................................................
+
+FeatureNumericExpression::FeatureNumericExpression(const NumericExpression& expr) :
+    _expr(expr)
+{
+    for (auto& var : _expr.variables())
+        _names.push_back(var.first);
+}
+
+double
+FeatureNumericExpression::eval(const Feature* feature, const FilterContext* context) const
+{
+    if (!feature)
+        return 0.0;
+
+    Binding binding;
+    std::vector<double> values(_names.size());
+    return evalNumeric(_expr, _names, feature, context, binding, values);
+}
+
+void
+FeatureNumericExpression::eval(
+    const FeatureList& features,
+    const FilterContext* context,
+    std::vector<double>& output) const
+{
+    // features from the same chunk share a column store,
+    // so the binding rarely changes
+    Binding binding;
+    std::vector<double> values(_names.size());
+
+    output.resize(features.size());
+    for (unsigned i = 0; i < features.size(); ++i)
+    {
+        output[i] = features[i].valid() ?
+            evalNumeric(_expr, _names, features[i].get(), context, binding, values) :
+            0.0;
+    }
+}
+
+//........................................................................
+
+FeatureStringExpression::FeatureStringExpression(const StringExpression& expr) :
+    _expr(expr)
+{
+    for (auto& var : _expr.variables())
+        _names.push_back(var.first);
+}
+
+std::string
+FeatureStringExpression::eval(const Feature* feature, const FilterContext* context) const
+{
+    if (!feature)
+        return std::string();
+
+    Binding binding;
+    std::vector<std::string> values(_names.size());
+    return evalString(_expr, _names, feature, context, binding, values);
+}
+
+void
+FeatureStringExpression::eval(
+    const FeatureList& features,
+    const FilterContext* context,
+    std::vector<std::string>& output) const
+{
+    Binding binding;
+    std::vector<std::string> values(_names.size());
+
+    output.resize(features.size());
+    for (unsigned i = 0; i < features.size(); ++i)
+    {
+        if (features[i].valid())
+            output[i] = evalString(_expr, _names, features[i].get(), context, binding, values);
+        else
+            output[i].clear();
+    }
+}
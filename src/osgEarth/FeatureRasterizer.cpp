@@ -21,6 +21,7 @@
 #include <osgEarth/Registry>
 
 #include <osgEarth/FeatureSource>
+#include <osgEarth/FeatureExpression>
 #include <osgEarth/StyleSheet>
 #include <osgText/String>
 #include <osgEarth/BuildConfig>
@@ -1370,7 +1371,7 @@ FeatureStyleSorter::sort_usingSelectors(
 
             // establish the working bounds and a context:
             FilterContext context(session, featureProfile);
-            StringExpression styleExprCopy(sel.styleExpression().get());
+            FeatureStringExpression styleExpr(sel.styleExpression().get());
 
             FeatureList features;
             getFeatures(session, defaultQuery, buffer, key.getExtent(), filters, features, progress);
@@ -1379,11 +1380,14 @@ FeatureStyleSorter::sort_usingSelectors(
                 std::unordered_map<std::string, Style> literal_styles;
                 std::map<const Style*, FeatureList> style_buckets;
 
-                for (FeatureList::iterator itr = features.begin(); itr != features.end(); ++itr)
+                std::vector<std::string> styleStrings;
+                styleExpr.eval(features, &context, styleStrings);
+
+                for (unsigned f = 0; f < features.size(); ++f)
                 {
-                    Feature* feature = itr->get();
+                    Feature* feature = features[f].get();
 
-                    const std::string& styleString = feature->eval(styleExprCopy, &context);
+                    const std::string& styleString = styleStrings[f];
                     if (!styleString.empty() && styleString != "null")
                     {
                         // resolve the style:
@@ -27,6 +27,7 @@
 #include <osgEarth/Capabilities>
 #include <osgEarth/Registry>
 #include <osgEarth/Notify>
+#include <osgEarth/MetricsRegistry>
 
 #include <osg/LineStipple>
 #include <osg/GraphicsContext>
@@ -1469,28 +1470,43 @@ GLTexture::storage3D(const Profile& profile)
     }
 }
 
+namespace
+{
+    // Bytes sent to the GPU through GLTexture, for MetricsRegistry
+    void countUpload(std::size_t bytes)
+    {
+        static Util::MetricsRegistry::Counter& uploaded = Util::MetricsRegistry::instance().counter(
+            "osgearth_gpu_texture_upload_bytes_total");
+        uploaded.add((std::int64_t)bytes);
+    }
+}
+
 void
 GLTexture::subImage2D(GLint level, GLint xoff, GLint yoff, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) const
 {
     glTexSubImage2D(_target, level, xoff, yoff, width, height, format, type, pixels);
+    countUpload(osg::Image::computeImageSizeInBytes(width, height, 1, format, type, 1));
 }
 
 void
 GLTexture::subImage3D(GLint level, GLint xoff, GLint yoff, GLint zoff, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels) const
 {
     ext()->glTexSubImage3D(_target, level, xoff, yoff, zoff, width, height, depth, format, type, pixels);
+    countUpload(osg::Image::computeImageSizeInBytes(width, height, depth, format, type, 1));
 }
 
 void
 GLTexture::compressedSubImage2D(GLint level, GLint xoff, GLint yoff, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void* data) const
 {
     ext()->glCompressedTexSubImage2D(_target, level, xoff, yoff, width, height, format, imageSize, data);
+    countUpload(imageSize);
 }
 
 void
 GLTexture::compressedSubImage3D(GLint level, GLint xoff, GLint yoff, GLint zoff, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize, const void* data) const
 {
     ext()->glCompressedTexSubImage3D(_target, level, xoff, yoff, zoff, width, height, depth, format, imageSize, data);
+    countUpload(imageSize);
 }
 
 
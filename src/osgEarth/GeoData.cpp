@@ -25,6 +25,7 @@
 #include "GDAL"
 #include "Metrics"
 #include "Math"
+#include "RasterPool"
 
 #include <osg/BoundingBox>
 #include <osg/Polytope>
@@ -2008,9 +2009,8 @@ namespace
             height = osg::minimum(image->s(), image->t());
         }
 
-        osg::Image *result = new osg::Image();
-        //result->allocateImage(width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE);
-        result->allocateImage(width, height, image->r(), image->getPixelFormat(), image->getDataType()); //GL_UNSIGNED_BYTE);
+        osg::Image *result = Util::RasterPool::instance().createImage(
+            width, height, image->r(), image->getPixelFormat(), image->getDataType());
         result->setInternalTextureFormat(image->getInternalTextureFormat());
 
         //Initialize the image to be completely transparent/black
@@ -2420,8 +2420,7 @@ GeoHeightField::createSubSample( const GeoExtent& destEx, unsigned int width, un
     double dx = destEx.width()/(double)(width-1);
     double dy = destEx.height()/(double)(height-1);    
 
-    osg::HeightField* dest = new osg::HeightField();
-    dest->allocate( width, height );
+    osg::HeightField* dest = Util::RasterPool::instance().createHeightField( width, height );
     dest->setXInterval( dx );
     dest->setYInterval( dy );
 
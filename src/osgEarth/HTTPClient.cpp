@@ -452,6 +452,9 @@ namespace
     static osg::ref_ptr< URLRewriter > s_rewriter;
 
     static osg::ref_ptr< ConfigHandler > s_curlConfigHandler;
+
+    // Total number of GETs satisfied by joining an identical GET in flight
+    static std::atomic_uint            s_numCoalescedRequests = { 0u };
 }
 
 //.........................................................................
@@ -1509,10 +1512,97 @@ HTTPClient::download(const std::string& uri,
     return getClient().doDownload( uri, localPath );
 }
 
+namespace
+{
+    // Makes an independent copy of a response for a coalesced caller, so that
+    // the callers do not share (and race on) the part streams.
+    HTTPResponse copyResponseForFollower(const HTTPResponse& in)
+    {
+        HTTPResponse src(in);
+        HTTPResponse out(in);
+        out.setDuration(in.getDuration());
+        out.setMessage(in.getMessage());
+        out.setLastModified(in.getLastModified());
+        out.getParts().clear();
+
+        for (auto& part : src.getParts())
+        {
+            osg::ref_ptr<HTTPResponse::Part> copy = new HTTPResponse::Part();
+            copy->_headers = part->_headers;
+            copy->_size = part->_size;
+            copy->_stream << part->_stream.str();
+            out.getParts().push_back(copy);
+        }
+        return out;
+    }
+
+    // Builds the key under which identical concurrent GETs are coalesced.
+    std::string makeCoalescingKey(const HTTPRequest& request, const osgDB::Options* options)
+    {
+        std::stringstream buf;
+        buf << request.getURL();
+
+        // sort the headers so the key does not depend on hash order
+        std::map<std::string, std::string> headers(
+            request.getHeaders().begin(),
+            request.getHeaders().end());
+
+        for (auto& header : headers)
+            buf << "|h:" << header.first << "=" << header.second;
+
+        if (options)
+        {
+            buf << "|p:" << options->getOptionString();
+
+            CacheSettings* cacheSettings = CacheSettings::get(options);
+            if (cacheSettings && cacheSettings->cachePolicy().isSet())
+                buf << "|c:" << cacheSettings->cachePolicy()->usageString();
+        }
+
+        return buf.str();
+    }
+}
+
 HTTPResponse
 HTTPClient::doGet(const HTTPRequest&    request,
                   const osgDB::Options* options,
                   ProgressCallback*     progress) const
+{
+    // Concurrent GETs of the same request share a single trip to the
+    // cache/server; the first caller does the work.
+    static Threading::SingleFlight<std::string, HTTPResponse> s_inflight(copyResponseForFollower);
+
+    bool coalesced = false;
+
+    HTTPResponse response = s_inflight.run(
+        makeCoalescingKey(request, options),
+        [&]() { return doGetImpl(request, options, progress); },
+        progress,
+        &coalesced);
+
+    if (coalesced)
+    {
+        ++s_numCoalescedRequests;
+    }
+    else if (response.getCode() == HTTPResponse::NONE && progress && progress->isCanceled())
+    {
+        // canceled while waiting on another caller's request
+        response.setCanceled(true);
+    }
+
+    return response;
+}
+
+unsigned
+HTTPClient::getNumCoalescedRequests()
+{
+    return s_numCoalescedRequests;
+}
+
+HTTPResponse
+HTTPClient::doGetImpl(const HTTPRequest&    request,
+                      const osgDB::Options* options,
+                      ProgressCallback*     progress) const
 {
     OE_PROFILING_ZONE;
     OE_PROFILING_ZONE_TEXT(Stringify() << "url " << request.getURL());
@@ -20,6 +20,7 @@
 
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/CullingUtils>
+#include <osgEarth/RasterPool>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -426,8 +427,7 @@ HeightFieldUtils::createSubSample(const osg::HeightField* input,
     double dy = div * yInterval;
 
 
-    osg::HeightField* dest = new osg::HeightField();
-    dest->allocate( numCols, numRows );
+    osg::HeightField* dest = RasterPool::instance().createHeightField( numCols, numRows );
     dest->setXInterval( dx );
     dest->setYInterval( dy );
     dest->setBorderWidth( input->getBorderWidth() );
@@ -474,8 +474,7 @@ HeightFieldUtils::resampleHeightField(osg::HeightField*      input,
     double stepX = spanX/(double)(newColumns-1);
     double stepY = spanY/(double)(newRows-1);
 
-    osg::HeightField* output = new osg::HeightField();
-    output->allocate( newColumns, newRows );
+    osg::HeightField* output = RasterPool::instance().createHeightField( newColumns, newRows );
     output->setXInterval( stepX );
     output->setYInterval( stepY );
     output->setOrigin( origin );
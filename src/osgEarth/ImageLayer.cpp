@@ -25,9 +25,11 @@
 #include <osgEarth/NetworkMonitor>
 #include <osgEarth/TimeSeriesImage>
 #include <osgEarth/Random>
+#include <osgEarth/RasterPool>
 #include <osgEarth/MetaTile>
 #include <osgEarth/Utils>
 #include <osg/ImageStream>
+#include <chrono>
 #include <cinttypes>
 
 using namespace osgEarth;
@@ -387,7 +389,10 @@ ImageLayer::createImage(const TileKey& key, ProgressCallback* progress)
 
     NetworkMonitor::ScopedRequestLayer layerRequest(getName());
 
-    GeoImage result = createImageInKeyProfile(key, progress);
+    auto start = std::chrono::steady_clock::now();
+    TileLayerStatistics::Origin origin = TileLayerStatistics::ORIGIN_NONE;
+
+    GeoImage result = createImageInKeyProfile(key, progress, &origin);
 
     // Post-cache operations:
 
@@ -412,9 +417,29 @@ ImageLayer::createImage(const TileKey& key, ProgressCallback* progress)
         postCreateImageImplementation(result, key, progress);
     }
 
+    _tileStats->record(
+        result.valid() ? origin : TileLayerStatistics::ORIGIN_NONE,
+        key.getLOD(),
+        (std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count(),
+        result.valid() ? result.getImage()->getTotalSizeInBytesIncludingMipmaps() : 0u);
+
     return result;
 }
 
+std::string
+ImageLayer::getCacheKey(const TileKey& key) const
+{
+    return Cache::makeCacheKey(key.str() + "-" + key.getProfile()->getHorizSignature(), "image");
+}
+
+void
+ImageLayer::prefetchFromCacheBin(CacheBin* bin, const std::vector<std::string>& cacheKeys) const
+{
+    // same options as the cache read in createImageInKeyProfile
+    bin->prefetchImages(cacheKeys, nullptr);
+}
+
 GeoImage
 ImageLayer::applyPostLayer(const GeoImage& canvas, const TileKey& key, Layer* post, ProgressCallback* progress) const
 {
@@ -434,8 +459,12 @@ ImageLayer::createImage(const GeoImage& canvas, const TileKey& key, ProgressCall
 }
 
 GeoImage
-ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progress)
+ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progress, TileLayerStatistics::Origin* origin)
 {
+    TileLayerStatistics::Origin unused;
+    if (!origin)
+        origin = &unused;
+
     // If the layer is disabled, bail out.
     if ( !isOpen() )
     {
@@ -463,9 +492,7 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         << key.getExtent().toString() << std::endl;
 
     // the cache key combines the Key and the horizontal profile.
-    std::string cacheKey = Cache::makeCacheKey(
-        Stringify() << key.str() << "-" << std::hex << key.getProfile()->getHorizSignature(),
-        "image");
+    std::string cacheKey = getCacheKey(key);
 
     // The L2 cache key includes the layer revision of course!
     char memCacheKey[64];
@@ -484,6 +511,7 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         ReadResult result = bin->readObject(memCacheKey, 0L);
         if (result.succeeded())
         {
+            *origin = TileLayerStatistics::ORIGIN_MEMORY_CACHE;
             return GeoImage(static_cast<osg::Image*>(result.releaseObject()), key.getExtent());
         }
     }
@@ -513,6 +541,7 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
             if (!expired)
             {
                 OE_DEBUG << "Got cached image for " << key.str() << std::endl;
+                *origin = TileLayerStatistics::ORIGIN_CACHE_BIN;
                 return GeoImage(cachedImage.get(), key.getExtent());
             }
             else
@@ -528,6 +557,7 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         // If it's cache only and we have an expired but cached image, just return it.
         if (cachedImage.valid())
         {
+            *origin = TileLayerStatistics::ORIGIN_CACHE_BIN;
             return GeoImage( cachedImage.get(), key.getExtent() );
         }
         else
@@ -586,6 +616,8 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
 
     if (result.valid())
     {        
+        *origin = TileLayerStatistics::ORIGIN_SOURCE;
+
         // invoke user callbacks
         invoke_onCreate(key, result);
 
@@ -627,6 +659,7 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         {
             OE_DEBUG << LC << "Using cached but expired image for " << key.str() << std::endl;
             result = GeoImage( cachedImage.get(), key.getExtent());
+            *origin = TileLayerStatistics::ORIGIN_CACHE_BIN;
         }
 #endif
     }
@@ -634,6 +667,193 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
     return result;
 }
 
+// job pool for fetching the source tiles of a mosaic in parallel
+#define ARENA_ASSEMBLE "oe.imagelayer.assemble"
+
+namespace
+{
+    jobs::jobpool* getAssemblyPool()
+    {
+        static std::once_flag s_once;
+        std::call_once(s_once, []()
+            {
+                // Never steal work: a thread in this pool must not pick up a job that
+                // might block waiting on another mosaic fetch.
+                auto pool = jobs::get_pool(ARENA_ASSEMBLE);
+                pool->set_can_steal_work(false);
+                pool->set_concurrency(std::max(4u, std::thread::hardware_concurrency()));
+            });
+        return jobs::get_pool(ARENA_ASSEMBLE);
+    }
+
+    // True on a thread that is running a mosaic fetch job. A nested mosaic
+    // on such a thread fetches its tiles inline instead of dispatching them
+    // to the pool and blocking, which could tie up every worker in the pool
+    // waiting on jobs that can never run.
+    thread_local bool s_inAssemblyJob = false;
+
+    // Resamples the tiles of a mosaic straight into a new image of the
+    // destination extent, skipping the intermediate composite image that
+    // ImageMosaic::createImage would create. Returns nullptr if the tiles
+    // do not form a uniform grid of 2D images, in which case the caller
+    // should fall back on the general method.
+    osg::Image* resampleMosaic(
+        ImageMosaic& mosaic,
+        const SpatialReference* mosaicSRS,
+        const GeoExtent& extent,
+        unsigned size,
+        bool interpolate)
+    {
+        OE_PROFILING_ZONE;
+
+        auto& tiles = mosaic.getImages();
+        if (tiles.empty() || size < 2)
+            return nullptr;
+
+        const osg::Image* first = tiles.front().getImage();
+        if (first == nullptr || first->r() != 1 || first->isCompressed())
+            return nullptr;
+
+        const int tileWidth = first->s();
+        const int tileHeight = first->t();
+
+        unsigned minTileX = tiles.front()._tileX, maxTileX = minTileX;
+        unsigned minTileY = tiles.front()._tileY, maxTileY = minTileY;
+
+        for (auto& tile : tiles)
+        {
+            const osg::Image* image = tile.getImage();
+            if (image == nullptr ||
+                image->s() != tileWidth ||
+                image->t() != tileHeight ||
+                image->r() != 1 ||
+                image->getPixelFormat() != first->getPixelFormat() ||
+                image->getDataType() != first->getDataType())
+            {
+                return nullptr;
+            }
+
+            minTileX = std::min(minTileX, tile._tileX);
+            maxTileX = std::max(maxTileX, tile._tileX);
+            minTileY = std::min(minTileY, tile._tileY);
+            maxTileY = std::max(maxTileY, tile._tileY);
+        }
+
+        const unsigned tilesWide = maxTileX - minTileX + 1;
+        const unsigned tilesHigh = maxTileY - minTileY + 1;
+
+        // cap the size of the lookup grid; sparse or very large mosaics
+        // go through the general method instead
+        if (tilesWide * tilesHigh > 64u)
+            return nullptr;
+
+        // index the tiles by their position in the mosaic; row 0 is the bottom (south).
+        std::vector<int> grid(tilesWide * tilesHigh, -1);
+        std::vector<ImageUtils::PixelReader> readers;
+        readers.reserve(tiles.size());
+
+        for (auto& tile : tiles)
+        {
+            unsigned col = tile._tileX - minTileX;
+            unsigned row = maxTileY - tile._tileY;
+            int& slot = grid[row * tilesWide + col];
+            if (slot >= 0)
+                return nullptr;
+            slot = (int)readers.size();
+            readers.emplace_back(tile.getImage());
+        }
+
+        double rxmin, rymin, rxmax, rymax;
+        mosaic.getExtents(rxmin, rymin, rxmax, rymax);
+
+        const int mosaicWidth = tilesWide * tileWidth;
+        const int mosaicHeight = tilesHigh * tileHeight;
+        const double xscale = (double)mosaicWidth / (rxmax - rxmin);
+        const double yscale = (double)mosaicHeight / (rymax - rymin);
+
+        // Missing tiles come out transparent white, just like in ImageMosaic.
+        const osg::Vec4 fill(1, 1, 1, 0);
+
+        auto read = [&](osg::Vec4& out, int x, int y)
+        {
+            x = osg::clampBetween(x, 0, mosaicWidth - 1);
+            y = osg::clampBetween(y, 0, mosaicHeight - 1);
+            int index = grid[(y / tileHeight) * tilesWide + (x / tileWidth)];
+            if (index >= 0)
+                readers[index](out, x % tileWidth, y % tileHeight);
+            else
+                out = fill;
+        };
+
+        // sample the destination pixel centers in the mosaic's SRS:
+        const unsigned numPixels = size * size;
+        std::vector<double> points(numPixels * 2);
+        double* srcX = &points[0];
+        double* srcY = srcX + numPixels;
+
+        const double dx = extent.width() / (double)size;
+        const double dy = extent.height() / (double)size;
+
+        if (!extent.getSRS()->transformGrid(
+            mosaicSRS,
+            extent.xMin() + 0.5 * dx, extent.yMin() + 0.5 * dy,
+            extent.xMax() - 0.5 * dx, extent.yMax() - 0.5 * dy,
+            srcX, srcY, size, size))
+        {
+            return nullptr;
+        }
+
+        osg::ref_ptr<osg::Image> result = Util::RasterPool::instance().createImage(
+            size, size, 1, first->getPixelFormat(), first->getDataType());
+        result->setInternalTextureFormat(first->getInternalTextureFormat());
+        memset(result->data(), 0, result->getImageSizeInBytes());
+
+        ImageUtils::PixelWriter write(result.get());
+        osg::Vec4 color, ll, lr, ul, ur;
+
+        // transformGrid outputs points in column-major order
+        unsigned pixel = 0;
+        for (unsigned c = 0; c < size; ++c)
+        {
+            for (unsigned r = 0; r < size; ++r, ++pixel)
+            {
+                if (srcX[pixel] < rxmin || srcX[pixel] > rxmax ||
+                    srcY[pixel] < rymin || srcY[pixel] > rymax)
+                {
+                    continue;
+                }
+
+                // mosaic pixel coordinates, relative to pixel centers
+                double px = (srcX[pixel] - rxmin) * xscale - 0.5;
+                double py = (srcY[pixel] - rymin) * yscale - 0.5;
+
+                if (interpolate)
+                {
+                    int x0 = (int)floor(px), y0 = (int)floor(py);
+                    float fx = (float)(px - (double)x0), fy = (float)(py - (double)y0);
+
+                    read(ll, x0, y0);
+                    read(lr, x0 + 1, y0);
+                    read(ul, x0, y0 + 1);
+                    read(ur, x0 + 1, y0 + 1);
+
+                    color =
+                        (ll * (1.0f - fx) + lr * fx) * (1.0f - fy) +
+                        (ul * (1.0f - fx) + ur * fx) * fy;
+                }
+                else
+                {
+                    read(color, (int)floor(px + 0.5), (int)floor(py + 0.5));
+                }
+
+                write(color, c, r);
+            }
+        }
+
+        return result.release();
+    }
+}
+
 GeoImage
 ImageLayer::assembleImage(
     const TileKey& key,
@@ -680,9 +900,58 @@ ImageLayer::assembleImage(
         // keep track of failed tiles.
         std::vector<TileKey> failedKeys;
 
-        for(auto& k : intersectingKeys)
+        // Fetch all the source tiles in parallel. The first one runs on this thread,
+        // and a nested mosaic (one inside a fetch job) fetches them all inline.
+        // Concurrent requests for the same source tile (from neighboring output tiles)
+        // collapse into one fetch by way of the tile gate and the L2 cache.
+        std::vector<GeoImage> images(intersectingKeys.size());
+
+        if (intersectingKeys.size() > 1 && !s_inAssemblyJob)
+        {
+            std::vector<Future<GeoImage>> results;
+            results.reserve(intersectingKeys.size() - 1);
+
+            jobs::context context;
+            context.name = key.str() + " " + getName();
+            context.pool = getAssemblyPool();
+
+            for (unsigned i = 1; i < intersectingKeys.size(); ++i)
+            {
+                TileKey k = intersectingKeys[i];
+                results.emplace_back(jobs::dispatch([this, k, progress](Cancelable&)
+                    {
+                        if (progress && progress->isCanceled())
+                            return GeoImage::INVALID;
+                        s_inAssemblyJob = true;
+                        GeoImage image = createImageInKeyProfile(k, progress);
+                        s_inAssemblyJob = false;
+                        return image;
+                    },
+                    context));
+            }
+
+            images[0] = createImageInKeyProfile(intersectingKeys[0], progress);
+
+            // join them all, even if canceled, since they hold our progress callback.
+            for (unsigned i = 1; i < intersectingKeys.size(); ++i)
+            {
+                images[i] = results[i - 1].join();
+            }
+        }
+        else
+        {
+            for (unsigned i = 0; i < intersectingKeys.size(); ++i)
+            {
+                if (progress && progress->isCanceled())
+                    break;
+                images[i] = createImageInKeyProfile(intersectingKeys[i], progress);
+            }
+        }
+
+        for(unsigned i = 0; i < intersectingKeys.size(); ++i)
         {
-            GeoImage image = createImageInKeyProfile(k, progress);
+            const TileKey& k = intersectingKeys[i];
+            GeoImage& image = images[i];
 
             if (image.valid())
             {
@@ -769,13 +1038,28 @@ ImageLayer::assembleImage(
             }
         }
 
-        // all set. Mosaic all the images together.
-        double rxmin, rymin, rxmax, rymax;
-        mosaic.getExtents( rxmin, rymin, rxmax, rymax );
+        // all set. Resample the source tiles directly into the output tile if we can.
+        osg::ref_ptr<osg::Image> direct = resampleMosaic(
+            mosaic,
+            getProfile()->getSRS(),
+            key.getExtent(),
+            getTileSize(),
+            !isCoverage());
 
-        mosaicedImage = GeoImage(
-            mosaic.createImage(),
-            GeoExtent( getProfile()->getSRS(), rxmin, rymin, rxmax, rymax ) );
+        if (direct.valid())
+        {
+            result = GeoImage(direct.get(), key.getExtent());
+        }
+        else
+        {
+            // Otherwise mosaic all the images together, and reproject below.
+            double rxmin, rymin, rxmax, rymax;
+            mosaic.getExtents(rxmin, rymin, rxmax, rymax);
+
+            mosaicedImage = GeoImage(
+                mosaic.createImage(),
+                GeoExtent(getProfile()->getSRS(), rxmin, rymin, rxmax, rymax));
+        }
     }
     else
     {
@@ -999,8 +1283,7 @@ ImageLayer::createFractalUpsampledImage(
     int ws_width = getTileSize() + 3;
     int ws_height = getTileSize() + 3;
 
-    osg::ref_ptr<osg::Image> workspace = new osg::Image();
-    workspace->allocateImage(
+    osg::ref_ptr<osg::Image> workspace = Util::RasterPool::instance().createImage(
         ws_width, ws_height, 1,
         input.getCenterTile().getImage()->getPixelFormat(),
         input.getCenterTile().getImage()->getDataType(),
@@ -1010,8 +1293,7 @@ ImageLayer::createFractalUpsampledImage(
     ImageUtils::PixelReader readFromWorkspace(workspace.get());
 
     // output image:
-    osg::ref_ptr<osg::Image> output = new osg::Image();
-    output->allocateImage(
+    osg::ref_ptr<osg::Image> output = Util::RasterPool::instance().createImage(
         getTileSize(), getTileSize(), 1,
         input.getCenterTile().getImage()->getPixelFormat(),
         input.getCenterTile().getImage()->getDataType(),
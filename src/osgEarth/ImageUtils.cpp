@@ -23,6 +23,7 @@
 #include <osgEarth/Metrics>
 #include <osgEarth/ImageLayer>
 #include <osgEarth/Math>
+#include <osgEarth/RasterPool>
 #include <osg/GLU>
 #include <osgDB/Registry>
 
@@ -644,19 +645,23 @@ ImageUtils::mipmapImageInPlace(osg::Image* input)
     const int totalSizeBytes = computeMipmapMemory(input, mipOffsets, 4, 4);
     const int numLevels = mipOffsets.size() + 1;
 
-    // allocate space for the new data and copy over level 0 of the old data
-    unsigned char* newData = new unsigned char[totalSizeBytes];
-    ::memcpy(newData, input->data(), input->getTotalSizeInBytes());
+    // allocate space for the new data and copy over level 0 of the old data.
+    // A pooled image gets a pooled buffer, so its old one is not pinned.
+    if (RasterPool::instance().resizeImageBuffer(input, totalSizeBytes) == nullptr)
+    {
+        unsigned char* newData = new unsigned char[totalSizeBytes];
+        ::memcpy(newData, input->data(), input->getTotalSizeInBytes());
 
-    input->setImage(
-        input->s(), input->t(), input->r(),
-        input->getInternalTextureFormat(),
-        input->getPixelFormat(),
-        input->getDataType(),
-        newData,
-        osg::Image::USE_NEW_DELETE,
-        input->getPacking(),
-        input->getRowLength());
+        input->setImage(
+            input->s(), input->t(), input->r(),
+            input->getInternalTextureFormat(),
+            input->getPixelFormat(),
+            input->getDataType(),
+            newData,
+            osg::Image::USE_NEW_DELETE,
+            input->getPacking(),
+            input->getRowLength());
+    }
 
     input->setMipmapLevels(mipOffsets);
 
@@ -1131,8 +1136,7 @@ ImageUtils::createEmptyImage()
 osg::Image*
 ImageUtils::createEmptyImage(unsigned int s, unsigned int t, unsigned int r)
 {
-    osg::Image* empty = new osg::Image;
-    empty->allocateImage(s,t, r, GL_RGBA, GL_UNSIGNED_BYTE);
+    osg::Image* empty = RasterPool::instance().createImage(s, t, r, GL_RGBA, GL_UNSIGNED_BYTE);
     empty->setInternalTextureFormat( GL_RGB8A_INTERNAL );
     unsigned char *data = empty->data(0,0);
     memset(data, 0, 4 * s * t * r);
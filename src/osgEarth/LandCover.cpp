@@ -19,6 +19,7 @@
 #include <osgEarth/LandCover>
 #include <osgEarth/XmlUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/RasterPool>
 #include <osg/Texture2D>
 
 #define LC "[LandCover] "
@@ -30,9 +31,8 @@ using namespace osgEarth;
 osg::Image*
 LandCover::createImage(unsigned s, unsigned t)
 {
-    osg::Image* image = new osg::Image();
     if (t==0) t=s;
-    image->allocateImage(s, t, 1, GL_RED, GL_FLOAT);
+    osg::Image* image = Util::RasterPool::instance().createImage(s, t, 1, GL_RED, GL_FLOAT);
     image->setInternalTextureFormat(getTextureFormat());
     return image;
 }
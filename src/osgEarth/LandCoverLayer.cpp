@@ -224,17 +224,15 @@ LandCoverLayer::readMetaImage(MetaImage& metaImage, const TileKey& key, int s, i
     if (actualKey.valid())
     {
         MetaImageComponent& comp = metaImage[dx+1][dy+1];
-        if (!comp.failed && !comp.image.valid())
+        if (!comp.failed && !comp.raster)
         {
             // Always use the immediate parent for fractal refinement.
             TileKey parentKey = actualKey.createParentKey();
 
-            GeoImage tile = const_cast<LandCoverLayer*>(this)->createImage(parentKey, progress);
-            if (tile.valid())
+            comp.raster = createClassification(parentKey, progress);
+            if (comp.raster)
             {
-                comp.image = tile.getImage();
                 actualKey.getExtent().createScaleBias(parentKey.getExtent(), comp.scaleBias);
-                comp.pixel.setImage(comp.image.get());
             }
             else
             {
@@ -242,14 +240,16 @@ LandCoverLayer::readMetaImage(MetaImage& metaImage, const TileKey& key, int s, i
             }
         }
 
-        if (comp.image.valid())
+        if (comp.raster)
         {
             s = s<0? tilesize+s : s>tilesize-1 ? s-tilesize : s;
             t = t<0? tilesize+t : t>tilesize-1 ? t-tilesize : t;
             s = (int)((double)s*comp.scaleBias(0,0)) + (int)(comp.scaleBias(3,0)*(double)tilesize);
             t = (int)((double)t*comp.scaleBias(1,1)) + (int)(comp.scaleBias(3,1)*(double)tilesize);
 
-            comp.pixel(output, s, t);
+            auto code = (*comp.raster)(s, t);
+            float value = code == ClassificationRaster::NO_DATA ? NO_DATA_VALUE : (float)code;
+            output.set(value, value, value, 1.0f);
 
             return true;
         }
@@ -259,6 +259,27 @@ LandCoverLayer::readMetaImage(MetaImage& metaImage, const TileKey& key, int s, i
     return false;
 }
 
+ClassificationRaster::Ptr
+LandCoverLayer::createClassification(const TileKey& key, ProgressCallback* progress) const
+{
+    ClassificationCache::Record record;
+    if (_classificationCache.get(key, record) && record.value().first == getRevision())
+    {
+        return record.value().second;
+    }
+
+    GeoImage tile = const_cast<LandCoverLayer*>(this)->createImage(key, progress);
+    if (!tile.valid())
+        return nullptr;
+
+    auto raster = ClassificationRaster::create(tile.getImage());
+    if (raster)
+    {
+        _classificationCache.insert(key, std::make_pair(getRevision(), raster));
+    }
+    return raster;
+}
+
 GeoImage
 LandCoverLayer::createImageImplementation(const TileKey& key, ProgressCallback* progress) const
 {
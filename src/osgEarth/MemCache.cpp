@@ -17,8 +17,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/MemCache>
+#include <osgEarth/MetricsRegistry>
 
 using namespace osgEarth;
+using namespace osgEarth::Util;
 
 #define LC "[MemCacheBin] "
 
@@ -42,9 +44,16 @@ namespace
 
         ReadResult readObject(const std::string& key, const osgDB::Options*)
         {
+            static MetricsRegistry::Counter& hits = MetricsRegistry::instance().counter(
+                "osgearth_cache_reads_total", { {"cache", "memory"}, {"result", "hit"} });
+            static MetricsRegistry::Counter& misses = MetricsRegistry::instance().counter(
+                "osgearth_cache_reads_total", { {"cache", "memory"}, {"result", "miss"} });
+
             MemCacheLRU::Record rec;
             _lru.get(key, rec);
 
+            (rec.valid() ? hits : misses).add();
+
             // clone required since the cache is in memory
 
             if ( rec.valid() )
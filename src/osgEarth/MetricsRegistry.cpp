@@ -0,0 +1,556 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/MetricsRegistry>
+#include <osgEarth/Threading>
+#include <osgEarth/Notify>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[MetricsRegistry] "
+
+namespace
+{
+    std::string escapeLabelValue(const std::string& in)
+    {
+        std::string out;
+        out.reserve(in.size());
+        for (char c : in)
+        {
+            if (c == '\\' || c == '"') { out.push_back('\\'); out.push_back(c); }
+            else if (c == '\n') out += "\\n";
+            else out.push_back(c);
+        }
+        return out;
+    }
+
+    std::string formatLabels(const MetricsRegistry::Labels& labels)
+    {
+        std::string out;
+        for (auto& label : labels)
+        {
+            if (!out.empty()) out.push_back(',');
+            out += label.first + "=\"" + escapeLabelValue(label.second) + "\"";
+        }
+        return out;
+    }
+
+    // Label string with an extra label appended
+    std::string withLabel(const std::string& labels, const std::string& name, const std::string& value)
+    {
+        std::string extra = name + "=\"" + value + "\"";
+        return labels.empty() ? extra : labels + "," + extra;
+    }
+
+    void writeSample(std::ostream& out, const std::string& name, const std::string& labels, double value)
+    {
+        out << name;
+        if (!labels.empty())
+            out << '{' << labels << '}';
+        out << ' ' << value << '\n';
+    }
+
+    std::string escapeJSON(const std::string& in)
+    {
+        std::string out;
+        out.reserve(in.size());
+        for (char c : in)
+        {
+            switch (c)
+            {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+                    out += buf;
+                }
+                else out.push_back(c);
+            }
+        }
+        return out;
+    }
+
+    const double s_quantiles[] = { 0.5, 0.9, 0.99 };
+
+    bool endsWith(const std::string& s, const std::string& suffix)
+    {
+        return s.size() >= suffix.size() &&
+            s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+}
+
+//...................................................................
+
+// out-of-line definitions for ODR use (pre-C++17)
+constexpr unsigned MetricsRegistry::NUM_SHARDS;
+constexpr unsigned MetricsRegistry::Histogram::SUB_BUCKET_BITS;
+constexpr unsigned MetricsRegistry::Histogram::SUB_BUCKETS;
+constexpr unsigned MetricsRegistry::Histogram::NUM_BUCKETS;
+
+MetricsRegistry::Counter::Counter()
+{
+    for (auto& shard : _shards)
+        shard.value.store(0, std::memory_order_relaxed);
+}
+
+std::int64_t
+MetricsRegistry::Counter::value() const
+{
+    std::int64_t total = 0;
+    for (auto& shard : _shards)
+        total += shard.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+void
+MetricsRegistry::Gauge::add(double delta)
+{
+    double v = _value.load(std::memory_order_relaxed);
+    while (!_value.compare_exchange_weak(v, v + delta, std::memory_order_relaxed));
+}
+
+//...................................................................
+
+MetricsRegistry::Histogram::Histogram(double scale) :
+    _scale(scale),
+    _count(0u),
+    _sum(0u),
+    _max(0u),
+    _buckets(new std::atomic<std::uint64_t>[NUM_BUCKETS])
+{
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+        _buckets[i].store(0u, std::memory_order_relaxed);
+}
+
+std::uint64_t
+MetricsRegistry::Histogram::bucketMin(unsigned bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    unsigned shift = bucket / SUB_BUCKETS - 1u;
+    std::uint64_t m = SUB_BUCKETS + (bucket % SUB_BUCKETS);
+    return m << shift;
+}
+
+std::uint64_t
+MetricsRegistry::Histogram::bucketMax(unsigned bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    unsigned shift = bucket / SUB_BUCKETS - 1u;
+    return bucketMin(bucket) + ((std::uint64_t(1) << shift) - 1u);
+}
+
+double
+MetricsRegistry::Histogram::sum() const
+{
+    return (double)_sum.load(std::memory_order_relaxed) * _scale;
+}
+
+double
+MetricsRegistry::Histogram::max() const
+{
+    return (double)_max.load(std::memory_order_relaxed) * _scale;
+}
+
+double
+MetricsRegistry::Histogram::quantile(double q) const
+{
+    // Buckets and count are updated separately, so total the buckets
+    // themselves for a consistent rank.
+    std::uint64_t total = 0u;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+        total += _buckets[i].load(std::memory_order_relaxed);
+
+    if (total == 0u)
+        return 0.0;
+
+    q = std::min(std::max(q, 0.0), 1.0);
+    std::uint64_t rank = std::max((std::uint64_t)1u, (std::uint64_t)(q * (double)total + 0.5));
+
+    std::uint64_t seen = 0u;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+    {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // middle of the bucket, but never more than the recorded max
+            std::uint64_t lo = bucketMin(i), hi = bucketMax(i);
+            std::uint64_t v = lo + (hi - lo) / 2u;
+            v = std::min(v, _max.load(std::memory_order_relaxed));
+            return (double)v * _scale;
+        }
+    }
+    return max();
+}
+
+//...................................................................
+
+struct MetricsRegistry::Exporter
+{
+    std::string path;
+    Format format;
+    std::chrono::milliseconds interval;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    std::thread thread;
+};
+
+MetricsRegistry&
+MetricsRegistry::instance()
+{
+    // never destroyed, so metrics stay valid in static destructors
+    static MetricsRegistry* s_registry = new MetricsRegistry();
+    return *s_registry;
+}
+
+MetricsRegistry::MetricsRegistry()
+{
+    describe("osgearth_jobs_pending", "Jobs waiting in a job pool");
+    describe("osgearth_jobs_running", "Jobs running in a job pool");
+    describe("osgearth_jobs_canceled", "Jobs canceled in a job pool");
+    describe("osgearth_jobs_concurrency", "Threads in a job pool");
+
+    // Job pools already count their jobs, so read them at export time
+    // rather than tracking them twice.
+    addCollector([](MetricsRegistry& registry)
+        {
+            for (auto* pool : jobs::get_metrics()->all())
+            {
+                if (!pool) continue;
+                Labels labels = { { "pool", pool->name } };
+                registry.gauge("osgearth_jobs_pending", labels).set(pool->pending);
+                registry.gauge("osgearth_jobs_running", labels).set(pool->running);
+                registry.gauge("osgearth_jobs_canceled", labels).set(pool->canceled);
+                registry.gauge("osgearth_jobs_concurrency", labels).set(pool->concurrency);
+            }
+        });
+
+    const char* path = ::getenv("OSGEARTH_METRICS_FILE");
+    if (path && *path)
+    {
+        double interval = 10.0;
+        const char* value = ::getenv("OSGEARTH_METRICS_INTERVAL");
+        if (value)
+            interval = std::max(0.1, atof(value));
+
+        startExport(path, interval);
+    }
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+    stopExport();
+}
+
+unsigned
+MetricsRegistry::threadShard()
+{
+    static std::atomic<unsigned> s_next(0u);
+    thread_local unsigned s_shard = s_next.fetch_add(1u, std::memory_order_relaxed) % NUM_SHARDS;
+    return s_shard;
+}
+
+MetricsRegistry::Entry&
+MetricsRegistry::getOrCreate(Type type, const std::string& name, const Labels& labels, double scale)
+{
+    std::string formatted = formatLabels(labels);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto& entry = _entries[std::make_pair(name, formatted)];
+    if (!entry)
+    {
+        entry.reset(new Entry());
+        entry->type = type;
+        entry->name = name;
+        entry->labels = formatted;
+        entry->labelPairs = labels;
+    }
+    else if (entry->type != type)
+    {
+        OE_WARN << LC << "Metric \"" << name << "\" was already registered with a different type" << std::endl;
+    }
+
+    // Create the instrument under the lock. A mismatched registration still
+    // gets one so the caller has something to update; it's never exported.
+    if (type == COUNTER && !entry->counter) entry->counter.reset(new Counter());
+    else if (type == GAUGE && !entry->gauge) entry->gauge.reset(new Gauge());
+    else if (type == HISTOGRAM && !entry->histogram) entry->histogram.reset(new Histogram(scale));
+
+    return *entry;
+}
+
+MetricsRegistry::Counter&
+MetricsRegistry::counter(const std::string& name, const Labels& labels)
+{
+    return *getOrCreate(COUNTER, name, labels, 1.0).counter;
+}
+
+MetricsRegistry::Gauge&
+MetricsRegistry::gauge(const std::string& name, const Labels& labels)
+{
+    return *getOrCreate(GAUGE, name, labels, 1.0).gauge;
+}
+
+MetricsRegistry::Histogram&
+MetricsRegistry::histogram(const std::string& name, const Labels& labels, double scale)
+{
+    return *getOrCreate(HISTOGRAM, name, labels, scale).histogram;
+}
+
+void
+MetricsRegistry::remove(const std::string& name, const Labels& labels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // entries are sorted by name, so the family is contiguous
+    auto i = _entries.lower_bound(std::make_pair(name, std::string()));
+    while (i != _entries.end() && i->first.first == name)
+    {
+        const Labels& pairs = i->second->labelPairs;
+        bool match = std::all_of(labels.begin(), labels.end(), [&](const Labels::value_type& label)
+            {
+                return std::find(pairs.begin(), pairs.end(), label) != pairs.end();
+            });
+
+        if (match)
+            i = _entries.erase(i);
+        else
+            ++i;
+    }
+}
+
+void
+MetricsRegistry::describe(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _help[name] = help;
+}
+
+void
+MetricsRegistry::addCollector(const Collector& collector)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _collectors.push_back(collector);
+}
+
+void
+MetricsRegistry::collect()
+{
+    std::vector<Collector> collectors;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        collectors = _collectors;
+    }
+    for (auto& collector : collectors)
+        collector(*this);
+}
+
+void
+MetricsRegistry::writePrometheus(std::ostream& out)
+{
+    collect();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    out << std::setprecision(10);
+
+    // entries are sorted by name, so each family is contiguous
+    std::string family;
+    for (auto& i : _entries)
+    {
+        const Entry& e = *i.second;
+
+        if (e.name != family)
+        {
+            family = e.name;
+            auto help = _help.find(e.name);
+            if (help != _help.end())
+                out << "# HELP " << e.name << ' ' << help->second << '\n';
+            out << "# TYPE " << e.name << ' ' <<
+                (e.type == COUNTER ? "counter" : e.type == GAUGE ? "gauge" : "summary") << '\n';
+        }
+
+        if (e.type == COUNTER && e.counter)
+        {
+            writeSample(out, e.name, e.labels, (double)e.counter->value());
+        }
+        else if (e.type == GAUGE && e.gauge)
+        {
+            writeSample(out, e.name, e.labels, e.gauge->value());
+        }
+        else if (e.type == HISTOGRAM && e.histogram)
+        {
+            // Exported as a summary: the full bucket set is too large
+            // to scrape, and quantiles are what HDR buckets are good at.
+            const Histogram& h = *e.histogram;
+            for (double q : s_quantiles)
+            {
+                std::ostringstream qs;
+                qs << q;
+                writeSample(out, e.name, withLabel(e.labels, "quantile", qs.str()), h.quantile(q));
+            }
+            writeSample(out, e.name + "_sum", e.labels, h.sum());
+            writeSample(out, e.name + "_count", e.labels, (double)h.count());
+        }
+    }
+}
+
+void
+MetricsRegistry::writeJSON(std::ostream& out)
+{
+    collect();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    out << std::setprecision(10);
+    out << "{\"metrics\":[";
+
+    bool first = true;
+    for (auto& i : _entries)
+    {
+        const Entry& e = *i.second;
+
+        if (!first) out << ',';
+        first = false;
+
+        out << "\n{\"name\":\"" << escapeJSON(e.name) << "\",\"labels\":{";
+
+        bool firstLabel = true;
+        for (auto& label : e.labelPairs)
+        {
+            if (!firstLabel) out << ',';
+            firstLabel = false;
+            out << '"' << escapeJSON(label.first) << "\":\"" << escapeJSON(label.second) << '"';
+        }
+        out << "},";
+
+        if (e.type == COUNTER && e.counter)
+        {
+            out << "\"type\":\"counter\",\"value\":" << e.counter->value();
+        }
+        else if (e.type == GAUGE && e.gauge)
+        {
+            out << "\"type\":\"gauge\",\"value\":" << e.gauge->value();
+        }
+        else if (e.type == HISTOGRAM && e.histogram)
+        {
+            const Histogram& h = *e.histogram;
+            out << "\"type\":\"histogram\""
+                << ",\"count\":" << h.count()
+                << ",\"sum\":" << h.sum()
+                << ",\"max\":" << h.max()
+                << ",\"p50\":" << h.quantile(0.5)
+                << ",\"p90\":" << h.quantile(0.9)
+                << ",\"p99\":" << h.quantile(0.99);
+        }
+        out << '}';
+    }
+    out << "\n]}\n";
+}
+
+bool
+MetricsRegistry::writeToFile(const std::string& path, Format format)
+{
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp.c_str(), std::ios::out | std::ios::trunc);
+        if (!out.is_open())
+        {
+            OE_WARN << LC << "Cannot write to " << temp << std::endl;
+            return false;
+        }
+
+        if (format == FORMAT_JSON)
+            writeJSON(out);
+        else
+            writePrometheus(out);
+
+        if (!out.good())
+            return false;
+    }
+
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows
+    ::remove(path.c_str());
+#endif
+    return ::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+void
+MetricsRegistry::startExport(const std::string& path, double interval)
+{
+    stopExport();
+
+    std::lock_guard<std::mutex> lock(_exporterMutex);
+
+    _exporter.reset(new Exporter());
+    _exporter->path = path;
+    _exporter->format = endsWith(path, ".json") ? FORMAT_JSON : FORMAT_PROMETHEUS;
+    _exporter->interval = std::chrono::milliseconds((long long)(interval * 1000.0));
+
+    Exporter* exporter = _exporter.get();
+    exporter->thread = std::thread([this, exporter]()
+        {
+            setThreadName("oe.metrics");
+            std::unique_lock<std::mutex> lock(exporter->mutex);
+            while (!exporter->done)
+            {
+                exporter->cv.wait_for(lock, exporter->interval);
+                lock.unlock();
+                writeToFile(exporter->path, exporter->format);
+                lock.lock();
+            }
+        });
+
+    OE_INFO << LC << "Exporting metrics to " << path << " every " << interval << "s" << std::endl;
+}
+
+void
+MetricsRegistry::stopExport()
+{
+    std::lock_guard<std::mutex> lock(_exporterMutex);
+
+    if (_exporter)
+    {
+        {
+            std::lock_guard<std::mutex> elock(_exporter->mutex);
+            _exporter->done = true;
+        }
+        _exporter->cv.notify_all();
+        if (_exporter->thread.joinable())
+            _exporter->thread.join();
+        _exporter.reset();
+    }
+}
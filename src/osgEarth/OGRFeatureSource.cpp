@@ -269,6 +269,10 @@ OGR::OGRFeatureCursor::readChunk()
     while( _queue.size() < _chunkSize && !_resultSetEndReached )
     {
         FeatureList filterList;
+
+        // features in a chunk share one attribute store
+        osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
+
         while( filterList.size() < _chunkSize && !_resultSetEndReached )
         {
             OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
@@ -283,7 +287,7 @@ OGR::OGRFeatureCursor::readChunk()
                     OGR_F_SetGeometry(handle, intersection);
                 }
                 */
-                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get(), _rewindPolygons);
+                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get(), _rewindPolygons, columns.get());
 
                 if (feature.valid())
                 {
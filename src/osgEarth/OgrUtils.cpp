@@ -462,24 +462,24 @@ OgrUtils::createOgrGeometry(const osgEarth::Geometry* geometry, OGRwkbGeometryTy
 }
 
 Feature*
-OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile, bool rewindPolygons)
+OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile, bool rewindPolygons, AttributeColumns* columns)
 {
     Feature* f = 0L;
     if ( profile )
     {
-        f = createFeature( handle, profile->getSRS(), rewindPolygons);
+        f = createFeature( handle, profile->getSRS(), rewindPolygons, columns);
         if ( f && profile->geoInterp().isSet() )
             f->geoInterp() = profile->geoInterp().get();
     }
     else
     {
-        f = createFeature( handle, (const SpatialReference*)0L, rewindPolygons);
+        f = createFeature( handle, (const SpatialReference*)0L, rewindPolygons, columns);
     }
     return f;
 }
 
 Feature*
-OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs, bool rewindPolygons)
+OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs, bool rewindPolygons, AttributeColumns* columns)
 {
     FeatureID fid = OGR_F_GetFID( handle );
 
@@ -494,6 +494,11 @@ OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs, bool r
 
     Feature* feature = new Feature( geom, srs, Style(), fid );
 
+    if (columns && createAttributeRow(handle, columns, feature))
+    {
+        return feature;
+    }
+
     int numAttrs = OGR_F_GetFieldCount(handle);
     for (int i = 0; i < numAttrs; ++i)
     {
@@ -566,6 +571,67 @@ OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs, bool r
     return feature;
 }
 
+bool
+OgrUtils::createAttributeRow(OGRFeatureH handle, AttributeColumns* columns, Feature* feature)
+{
+    int numAttrs = OGR_F_GetFieldCount(handle);
+
+    // match each field to a column first; if a field's type changed
+    // since the column was created, the row won't fit.
+    std::vector<int> cols(numAttrs);
+    for (int i = 0; i < numAttrs; ++i)
+    {
+        OGRFieldDefnH field_handle_ref = OGR_F_GetFieldDefnRef( handle, i );
+
+        AttributeType type;
+        switch (OGR_Fld_GetType(field_handle_ref))
+        {
+        case OFTInteger:
+#if GDAL_VERSION_AT_LEAST(2,0,0)
+        case OFTInteger64:
+#endif
+            type = ATTRTYPE_INT; break;
+        case OFTReal:
+            type = ATTRTYPE_DOUBLE; break;
+        default:
+            type = ATTRTYPE_STRING;
+        }
+
+        // lower case, to match the names of the per-feature path above
+        std::string name = osgEarth::toLower(std::string(OGR_Fld_GetNameRef(field_handle_ref)));
+        cols[i] = columns->addColumn(name, type);
+        if (cols[i] < 0 || columns->getColumnType(cols[i]) != type)
+            return false;
+    }
+
+    unsigned row = columns->addRow();
+
+    for (int i = 0; i < numAttrs; ++i)
+    {
+        if (!IsFieldSet(handle, i))
+            continue;
+
+        switch (columns->getColumnType(cols[i]))
+        {
+        case ATTRTYPE_INT:
+#if GDAL_VERSION_AT_LEAST(2,0,0)
+            columns->set(row, cols[i], (long long)OGR_F_GetFieldAsInteger64(handle, i));
+#else
+            columns->set(row, cols[i], (long long)OGR_F_GetFieldAsInteger(handle, i));
+#endif
+            break;
+        case ATTRTYPE_DOUBLE:
+            columns->set(row, cols[i], OGR_F_GetFieldAsDouble(handle, i));
+            break;
+        default:
+            columns->set(row, cols[i], OGR_F_GetFieldAsString(handle, i));
+        }
+    }
+
+    feature->setAttributeRow(columns, row);
+    return true;
+}
+
 AttributeType
 OgrUtils::getAttributeType( OGRFieldType type )
 {
@@ -0,0 +1,358 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/RasterPool>
+#include <osgEarth/MetricsRegistry>
+#include <osgEarth/Notify>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[RasterPool] "
+
+constexpr std::size_t RasterPool::MIN_POOLED_BYTES;
+
+namespace
+{
+    // Image that hands its buffer back to the pool when destroyed.
+    // The image never owns the buffer (NO_DELETE), so even if someone
+    // replaces the image data, the buffer is still ours to return.
+    class PooledImage : public osg::Image
+    {
+    public:
+        PooledImage(RasterPool* pool, unsigned char* buffer, std::size_t bytes) :
+            _pool(pool), _buffer(buffer), _bytes(bytes) { }
+
+        //! Swaps in a new buffer and returns the old one
+        unsigned char* swapBuffer(unsigned char* buffer, std::size_t& bytes)
+        {
+            std::swap(_buffer, buffer);
+            std::swap(_bytes, bytes);
+            return buffer;
+        }
+
+    protected:
+        virtual ~PooledImage()
+        {
+            _pool->release(_buffer, _bytes);
+        }
+
+    private:
+        RasterPool* _pool;
+        unsigned char* _buffer;
+        std::size_t _bytes;
+    };
+
+    // Heightfield that hands its height array back to the pool when
+    // destroyed, unless something else still holds the array.
+    class PooledHeightField : public osg::HeightField
+    {
+    public:
+        PooledHeightField(RasterPool* pool, osg::FloatArray* heights, unsigned numColumns, unsigned numRows) :
+            _pool(pool), _bytes(heights->size() * sizeof(float))
+        {
+            _heights = heights;
+            allocate(numColumns, numRows);
+        }
+
+    protected:
+        virtual ~PooledHeightField()
+        {
+            _pool->release(
+                _heights.valid() && _heights->referenceCount() == 1 ? _heights.get() : nullptr,
+                _bytes);
+        }
+
+    private:
+        RasterPool* _pool;
+        std::size_t _bytes;
+    };
+}
+
+RasterPool&
+RasterPool::instance()
+{
+    // never destroyed, since pooled rasters may outlive static destructors
+    static RasterPool* s_pool = new RasterPool();
+    return *s_pool;
+}
+
+RasterPool::RasterPool() :
+    _enabled(true),
+    _maxIdleBytes(64u * 1024u * 1024u)
+{
+    const char* value = ::getenv("OSGEARTH_RASTER_POOL_SIZE");
+    if (value)
+    {
+        double mb = std::max(0.0, atof(value));
+        _maxIdleBytes = (std::size_t)(mb * 1024.0 * 1024.0);
+        _enabled = _maxIdleBytes > 0u;
+        OE_INFO << LC << "Idle buffer limit set to " << mb << " MB" << std::endl;
+    }
+
+    auto& metrics = MetricsRegistry::instance();
+    metrics.describe("osgearth_raster_pool_bytes", "Bytes of pooled raster buffers, in use or idle");
+    metrics.describe("osgearth_raster_pool_allocations", "Raster buffers the pool allocated from the heap");
+    metrics.describe("osgearth_raster_pool_reuses", "Raster requests served from idle pooled buffers");
+    metrics.describe("osgearth_raster_pool_discards", "Idle raster buffers freed by the pool watermark");
+
+    metrics.addCollector([this](MetricsRegistry& registry)
+        {
+            Stats stats = getStats();
+            registry.gauge("osgearth_raster_pool_bytes", { { "state", "in_use" } }).set((double)stats.inUseBytes);
+            registry.gauge("osgearth_raster_pool_bytes", { { "state", "idle" } }).set((double)stats.idleBytes);
+            registry.gauge("osgearth_raster_pool_allocations").set((double)stats.allocations);
+            registry.gauge("osgearth_raster_pool_reuses").set((double)stats.reuses);
+            registry.gauge("osgearth_raster_pool_discards").set((double)stats.discards);
+        });
+}
+
+osg::Image*
+RasterPool::createImage(int s, int t, int r, GLenum pixelFormat, GLenum dataType, int packing)
+{
+    std::size_t bytes = osg::Image::computeImageSizeInBytes(s, t, r, pixelFormat, dataType, packing);
+
+    if (!_enabled || bytes < MIN_POOLED_BYTES)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(s, t, r, pixelFormat, dataType, packing);
+        return image;
+    }
+
+    unsigned char* buffer = acquire(bytes);
+    osg::Image* image = new PooledImage(this, buffer, bytes);
+    image->setImage(s, t, r, pixelFormat, pixelFormat, dataType, buffer, osg::Image::NO_DELETE, packing);
+    return image;
+}
+
+unsigned char*
+RasterPool::resizeImageBuffer(osg::Image* image, std::size_t bytes)
+{
+    PooledImage* pooled = dynamic_cast<PooledImage*>(image);
+    if (!pooled || !image->data())
+        return nullptr;
+
+    unsigned char* buffer = acquire(bytes);
+    ::memcpy(buffer, image->data(), std::min((std::size_t)image->getTotalSizeInBytes(), bytes));
+
+    image->setImage(
+        image->s(), image->t(), image->r(),
+        image->getInternalTextureFormat(),
+        image->getPixelFormat(),
+        image->getDataType(),
+        buffer,
+        osg::Image::NO_DELETE,
+        image->getPacking(),
+        image->getRowLength());
+
+    std::size_t oldBytes = bytes;
+    unsigned char* old = pooled->swapBuffer(buffer, oldBytes);
+    release(old, oldBytes);
+
+    return buffer;
+}
+
+osg::HeightField*
+RasterPool::createHeightField(unsigned numColumns, unsigned numRows)
+{
+    std::size_t count = (std::size_t)numColumns * (std::size_t)numRows;
+
+    if (!_enabled || count * sizeof(float) < MIN_POOLED_BYTES)
+    {
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(numColumns, numRows);
+        return hf;
+    }
+
+    return new PooledHeightField(this, acquireHeights(count), numColumns, numRows);
+}
+
+unsigned char*
+RasterPool::acquire(std::size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _stats.inUseBytes += bytes;
+        _stats.peakInUseBytes = std::max(_stats.peakInUseBytes, _stats.inUseBytes);
+
+        auto i = _idleImages.find(bytes);
+        if (i != _idleImages.end() && !i->second.empty())
+        {
+            unsigned char* buffer = i->second.back();
+            i->second.pop_back();
+            _stats.idleBytes -= bytes;
+            ++_stats.reuses;
+            return buffer;
+        }
+
+        ++_stats.allocations;
+    }
+
+    return new unsigned char[bytes];
+}
+
+osg::FloatArray*
+RasterPool::acquireHeights(std::size_t count)
+{
+    std::size_t bytes = count * sizeof(float);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _stats.inUseBytes += bytes;
+        _stats.peakInUseBytes = std::max(_stats.peakInUseBytes, _stats.inUseBytes);
+
+        auto i = _idleHeights.find(count);
+        if (i != _idleHeights.end() && !i->second.empty())
+        {
+            osg::ref_ptr<osg::FloatArray> heights = std::move(i->second.back());
+            i->second.pop_back();
+            _stats.idleBytes -= bytes;
+            ++_stats.reuses;
+            return heights.release();
+        }
+
+        ++_stats.allocations;
+    }
+
+    return new osg::FloatArray(count);
+}
+
+void
+RasterPool::release(unsigned char* data, std::size_t bytes)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _stats.inUseBytes -= bytes;
+    ++_stats.releases;
+
+    if (_enabled && _stats.idleBytes + bytes <= 2u * _maxIdleBytes)
+    {
+        _idleImages[bytes].push_back(data);
+        _stats.idleBytes += bytes;
+        _stats.peakIdleBytes = std::max(_stats.peakIdleBytes, _stats.idleBytes);
+    }
+    else
+    {
+        ++_stats.discards;
+        lock.unlock();
+        delete[] data;
+    }
+}
+
+void
+RasterPool::release(osg::FloatArray* heights, std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _stats.inUseBytes -= bytes;
+    ++_stats.releases;
+
+    // null means the array is still in use elsewhere
+    if (heights == nullptr)
+        return;
+
+    std::size_t actualBytes = heights->size() * sizeof(float);
+
+    if (_enabled && _stats.idleBytes + actualBytes <= 2u * _maxIdleBytes)
+    {
+        _idleHeights[heights->size()].push_back(heights);
+        _stats.idleBytes += actualBytes;
+        _stats.peakIdleBytes = std::max(_stats.peakIdleBytes, _stats.idleBytes);
+    }
+    else
+    {
+        // the heightfield's own reference frees it
+        ++_stats.discards;
+    }
+}
+
+void
+RasterPool::setMaxIdleBytes(std::size_t value)
+{
+    _maxIdleBytes = value;
+    trim();
+}
+
+void
+RasterPool::setEnabled(bool value)
+{
+    _enabled = value;
+    if (!value)
+        clear();
+}
+
+void
+RasterPool::trim()
+{
+    trim(_maxIdleBytes);
+}
+
+void
+RasterPool::clear()
+{
+    trim(0u);
+}
+
+void
+RasterPool::trim(std::size_t target)
+{
+    std::vector<unsigned char*> images;
+    std::vector<osg::ref_ptr<osg::FloatArray>> heights;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Free the largest buffers first; small ones are cheap to keep
+        // and most likely to be asked for again.
+        for (auto i = _idleImages.rbegin(); i != _idleImages.rend() && _stats.idleBytes > target; ++i)
+        {
+            while (!i->second.empty() && _stats.idleBytes > target)
+            {
+                images.push_back(i->second.back());
+                i->second.pop_back();
+                _stats.idleBytes -= i->first;
+                ++_stats.discards;
+            }
+        }
+
+        for (auto i = _idleHeights.rbegin(); i != _idleHeights.rend() && _stats.idleBytes > target; ++i)
+        {
+            while (!i->second.empty() && _stats.idleBytes > target)
+            {
+                heights.emplace_back(std::move(i->second.back()));
+                i->second.pop_back();
+                _stats.idleBytes -= i->first * sizeof(float);
+                ++_stats.discards;
+            }
+        }
+    }
+
+    // free outside the lock
+    for (auto* data : images)
+        delete[] data;
+}
+
+RasterPool::Stats
+RasterPool::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
@@ -61,6 +61,9 @@ ScreenSpaceLayoutOptions::fromConfig( const Config& conf )
     conf.get( "leader_line_max_length", _leaderLineMaxLen );
     conf.get( "leader_line_color", _leaderLineColor );
     conf.get( "leader_line_width", _leaderLineWidth );
+    conf.get( "grid_cell_size", _gridCellSize );
+    conf.get( "motion_threshold", _motionThreshold );
+    conf.get( "parallel", _parallel );
 }
 
 Config
@@ -81,6 +84,9 @@ ScreenSpaceLayoutOptions::getConfig() const
     conf.set( "leader_line_max_length", _leaderLineMaxLen );
     conf.set( "leader_line_color", _leaderLineColor );
     conf.set( "leader_line_width", _leaderLineWidth );
+    conf.set( "grid_cell_size", _gridCellSize );
+    conf.set( "motion_threshold", _motionThreshold );
+    conf.set( "parallel", _parallel );
     return conf;
 }
 
@@ -78,6 +78,7 @@ TerrainOptions::getConfig() const
 
     conf.set("create_tiles_async", createTilesAsync());
     conf.set("create_tiles_grouped", createTilesGrouped());
+    conf.set("concurrent_layer_fetch", concurrentLayerFetch());
 
     conf.set("expiration_range", minExpiryRange()); // legacy
     conf.set("expiration_threshold", minResidentTiles()); // legacy
@@ -134,6 +135,7 @@ TerrainOptions::fromConfig(const Config& conf)
 
     conf.get("create_tiles_async", createTilesAsync());
     conf.get("create_tiles_grouped", createTilesGrouped());
+    conf.get("concurrent_layer_fetch", concurrentLayerFetch());
 
     conf.get("expiration_range", minExpiryRange()); // legacy
     conf.get("expiration_threshold", minResidentTiles()); // legacy
@@ -217,6 +219,7 @@ OE_OPTION_IMPL(TerrainOptionsAPI, unsigned, MaxTextureSize, maxTextureSize);
 OE_OPTION_IMPL(TerrainOptionsAPI, bool, Visible, visible);
 OE_OPTION_IMPL(TerrainOptionsAPI, bool, CreateTilesAsync, createTilesAsync);
 OE_OPTION_IMPL(TerrainOptionsAPI, bool, CreateTilesGrouped, createTilesGrouped);
+OE_OPTION_IMPL(TerrainOptionsAPI, bool, ConcurrentLayerFetch, concurrentLayerFetch);
 
 bool
 TerrainOptionsAPI::getGPUTessellation() const
@@ -37,6 +37,122 @@ using namespace osgEarth;
 #define LABEL_ELEVATION "Terrain textures"
 #define LABEL_COVERAGE "Terrain textures"
 
+// job pool for fetching the individual layers of a tile in parallel
+#define ARENA_LAYER_FETCH "oe.layerfetch"
+
+//.........................................................................
+
+namespace
+{
+    /**
+     * Runs a set of independent tile-model building tasks and combines
+     * their results into a single model.
+     *
+     * In concurrent mode, each task writes to its own scratch model so that
+     * no two threads touch the same containers; the first task runs on the
+     * calling thread while the rest run in the layer fetch pool. The scratch
+     * models are merged into the target model in the order the tasks were
+     * added, so the result is identical to running them serially.
+     */
+    class FetchGroup
+    {
+    public:
+        using Task = std::function<void(TerrainTileModel*)>;
+
+        FetchGroup(TerrainTileModel* model, bool concurrent, ProgressCallback* progress) :
+            _model(model), _concurrent(concurrent), _progress(progress) { }
+
+        void add(Task&& task)
+        {
+            _tasks.emplace_back(std::move(task));
+        }
+
+        void join()
+        {
+            if (!_concurrent || _tasks.size() < 2)
+            {
+                for (auto& task : _tasks)
+                    task(_model);
+                return;
+            }
+
+            std::vector<osg::ref_ptr<TerrainTileModel>> parts(_tasks.size());
+            for (auto& part : parts)
+                part = new TerrainTileModel(_model->key, _model->revision);
+
+            std::vector<jobs::future<bool>> results;
+            results.reserve(_tasks.size() - 1);
+
+            jobs::context context;
+            context.name = _model->key.str();
+            context.pool = jobs::get_pool(ARENA_LAYER_FETCH);
+
+            for (unsigned i = 1; i < _tasks.size(); ++i)
+            {
+                Task& task = _tasks[i];
+                TerrainTileModel* part = parts[i].get();
+                ProgressCallback* progress = _progress;
+
+                results.emplace_back(jobs::dispatch([&task, part, progress](Cancelable&)
+                    {
+                        if (progress == nullptr || !progress->isCanceled())
+                            task(part);
+                        return true;
+                    },
+                    context));
+            }
+
+            if (_progress == nullptr || !_progress->isCanceled())
+            {
+                _tasks[0](parts[0].get());
+            }
+
+            // Always wait for every task, even when canceled, since they refer
+            // to data owned by the caller. The tasks themselves honor the
+            // progress callback and will return early.
+            for (auto& result : results)
+                result.join();
+
+            for (auto& part : parts)
+                merge(part.get());
+        }
+
+    private:
+        void merge(TerrainTileModel* part)
+        {
+            for (unsigned i = 0; i < part->colorLayers.size(); ++i)
+            {
+                if (std::find(part->sharedLayerIndices.begin(), part->sharedLayerIndices.end(), i) !=
+                    part->sharedLayerIndices.end())
+                {
+                    _model->sharedLayerIndices.push_back(_model->colorLayers.size());
+                }
+                _model->colorLayers.emplace_back(std::move(part->colorLayers[i]));
+            }
+
+            if (part->requiresUpdateTraversal)
+                _model->requiresUpdateTraversal = true;
+
+            if (part->elevation.texture)
+                _model->elevation = std::move(part->elevation);
+
+            if (part->normalMap.texture)
+                _model->normalMap = std::move(part->normalMap);
+
+            if (part->landCover.texture)
+                _model->landCover = std::move(part->landCover);
+
+            if (part->mesh.verts.valid() || part->mesh.indices.valid())
+                _model->mesh = std::move(part->mesh);
+        }
+
+        TerrainTileModel* _model;
+        bool _concurrent;
+        ProgressCallback* _progress;
+        std::vector<Task> _tasks;
+    };
+}
+
 //.........................................................................
 
 
@@ -140,7 +256,17 @@ void CreateTileManifest::setProgressive(bool value)
 TerrainTileModelFactory::TerrainTileModelFactory(const TerrainOptions& options) :
     _options(options)
 {
-    //nop
+    if (_options.concurrentLayerFetch() == true)
+    {
+        // Layer fetches are mostly I/O bound, so allow several per loading thread.
+        // This pool must never steal work; a stolen tile load would block one of
+        // its threads while waiting on its own layer fetches.
+        auto pool = jobs::get_pool(ARENA_LAYER_FETCH);
+        pool->set_can_steal_work(false);
+        pool->set_concurrency(std::max(
+            pool->concurrency(),
+            std::max(4u, _options.concurrency().get() * 4u)));
+    }
 }
 
 TerrainTileModel*
@@ -158,29 +284,45 @@ TerrainTileModelFactory::createTileModel(
         key,
         map->getDataModelRevision() );
 
-    // assemble all the components:
-    addColorLayers(model.get(), map, require, key, manifest, progress, false);
+    // assemble all the components. Each one is independent of the others,
+    // so when concurrent fetching is on, they all load in parallel.
+    FetchGroup group(model.get(), _options.concurrentLayerFetch() == true, progress);
+
+    group.add([&](TerrainTileModel* part)
+        {
+            addColorLayers(part, map, require, key, manifest, progress, false);
+        });
 
     if (require.elevationTextures)
     {
         unsigned border = (require.elevationBorder) ? 1u : 0u;
 
-        addElevation( model.get(), map, key, manifest, border, progress );
+        group.add([&, border](TerrainTileModel* part)
+            {
+                addElevation(part, map, key, manifest, border, progress);
+            });
     }
 
     if (require.landCoverTextures)
     {
-        addLandCover(model.get(), map, key, require, manifest, progress);
+        group.add([&](TerrainTileModel* part)
+            {
+                addLandCover(part, map, key, require, manifest, progress);
+            });
     }
 
     if (require.tileMesh)
     {
         if (key.getLOD() <= _options.maxLOD().value())
         {
-            addMesh(model.get(), map, key, require, manifest, progress);
+            group.add([&](TerrainTileModel* part)
+                {
+                    addMesh(part, map, key, require, manifest, progress);
+                });
         }
     }
-    
+
+    group.join();
 
     // done.
     return model.release();
@@ -202,15 +344,28 @@ TerrainTileModelFactory::createStandaloneTileModel(
         map->getDataModelRevision());
 
     // assemble all the components:
-    addColorLayers(model.get(), map, require, key, manifest, progress, true);
+    FetchGroup group(model.get(), _options.concurrentLayerFetch() == true, progress);
+
+    group.add([&](TerrainTileModel* part)
+        {
+            addColorLayers(part, map, require, key, manifest, progress, true);
+        });
 
     if (require.elevationTextures)
     {
         unsigned border = require.elevationBorder ? 1u : 0u;
-        addStandaloneElevation(model.get(), map, key, manifest, border, progress);
+        group.add([&, border](TerrainTileModel* part)
+            {
+                addStandaloneElevation(part, map, key, manifest, border, progress);
+            });
     }
 
-    addStandaloneLandCover(model.get(), map, key, require, manifest, progress);
+    group.add([&](TerrainTileModel* part)
+        {
+            addStandaloneLandCover(part, map, key, require, manifest, progress);
+        });
+
+    group.join();
 
     // done.
     return model.release();
@@ -371,11 +526,11 @@ TerrainTileModelFactory::addColorLayers(
 {
     OE_PROFILING_ZONE;
 
-    int order = 0;
-
     LayerVector layers;
     map->getLayers(layers);
 
+    FetchGroup group(model, _options.concurrentLayerFetch() == true, progress);
+
     for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
     {
         Layer* layer = i->get();
@@ -393,23 +548,31 @@ TerrainTileModelFactory::addColorLayers(
         ImageLayer* imageLayer = dynamic_cast<ImageLayer*>(layer);
         if (imageLayer)
         {
-            if (standalone)
-            {
-                addStandaloneImageLayer(model, imageLayer, key, require, progress);
-            }
-            else
-            {
-                addImageLayer(model, imageLayer, key, require, progress);
-            }
+            group.add([=, &key, &require](TerrainTileModel* part)
+                {
+                    if (standalone)
+                    {
+                        addStandaloneImageLayer(part, imageLayer, key, require, progress);
+                    }
+                    else
+                    {
+                        addImageLayer(part, imageLayer, key, require, progress);
+                    }
+                });
         }
         else // non-image kind of TILE layer (e.g., splatting)
         {
-            TerrainTileModel::ColorLayer colorModel;
-            colorModel.layer = layer;
-            colorModel.revision = layer->getRevision();
-            model->colorLayers.push_back(std::move(colorModel));
+            group.add([layer](TerrainTileModel* part)
+                {
+                    TerrainTileModel::ColorLayer colorModel;
+                    colorModel.layer = layer;
+                    colorModel.revision = layer->getRevision();
+                    part->colorLayers.push_back(std::move(colorModel));
+                });
         }
     }
+
+    group.join();
 }
 
 void
@@ -452,8 +615,12 @@ TerrainTileModelFactory::addElevation(
     {
         if (elevTex.valid())
         {
+            // The pool may hold the tile quantized; the terrain needs
+            // float heights to upload and to read back on the CPU.
+            osg::ref_ptr<ElevationTexture> renderTex = elevTex->uncompressed();
+
             model->elevation.revision = combinedRevision;
-            model->elevation.texture = Texture::create(elevTex.get());
+            model->elevation.texture = Texture::create(renderTex.get());
             model->elevation.texture->category() = LABEL_ELEVATION;
 
             if (_options.useNormalMaps() == true)
@@ -470,7 +637,7 @@ TerrainTileModelFactory::addElevation(
             }
 
             // Keep the heightfield pointer around for legacy 3rd party usage (VRF)
-            model->elevation.heightField = elevTex->getHeightField();
+            model->elevation.heightField = renderTex->getHeightField();
         }
     }
 }
@@ -23,6 +23,10 @@
 #include <osgEarth/Map>
 #include <osgEarth/MemCache>
 #include <osgEarth/rtree.h>
+#include <iomanip>
+#include <list>
+#include <mutex>
+#include <ostream>
 
 using namespace osgEarth;
 using namespace osgEarth::Threading;
@@ -30,6 +34,266 @@ using namespace osgEarth::Threading;
 namespace
 {
     using DataExtentsIndex = RTree<DataExtent, double, 2>;
+
+    // Tracks open tile layers so the metrics registry can export
+    // their statistics
+    class TileLayerStatisticsExporter
+    {
+    public:
+        static TileLayerStatisticsExporter& instance()
+        {
+            static TileLayerStatisticsExporter* s_instance = nullptr;
+            static std::once_flag s_once;
+            std::call_once(s_once, []()
+                {
+                    s_instance = new TileLayerStatisticsExporter();
+                    Util::MetricsRegistry::instance().addCollector(
+                        [](Util::MetricsRegistry& registry) { s_instance->collect(registry); });
+                });
+            return *s_instance;
+        }
+
+        void add(TileLayer* layer)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto& record : _layers)
+                if (record.ptr == layer)
+                    return;
+            _layers.emplace_back(layer);
+        }
+
+        // Stops exporting a layer and drops its series, so a closed layer
+        // (or a new one that reuses its name) doesn't report stale totals
+        void remove(const TileLayer* layer)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto i = _layers.begin(); i != _layers.end(); ++i)
+            {
+                if (i->ptr == layer)
+                {
+                    unregister(Util::MetricsRegistry::instance(), i->name);
+                    _layers.erase(i);
+                    return;
+                }
+            }
+        }
+
+        void collect(Util::MetricsRegistry& registry)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto i = _layers.begin(); i != _layers.end(); )
+            {
+                osg::ref_ptr<TileLayer> layer;
+                if (!i->layer.lock(layer))
+                {
+                    unregister(registry, i->name);
+                    i = _layers.erase(i);
+                    continue;
+                }
+
+                if (layer->getName() != i->name)
+                {
+                    unregister(registry, i->name);
+                    i->name = layer->getName();
+                }
+                ++i;
+
+                // a subclass may still fail to open after we add it
+                if (!layer->isOpen())
+                    continue;
+
+                const TileLayerStatistics& stats = layer->getTileStatistics();
+                for (unsigned o = 0; o < TileLayerStatistics::NUM_ORIGINS; ++o)
+                {
+                    auto origin = (TileLayerStatistics::Origin)o;
+                    Util::MetricsRegistry::Labels labels = {
+                        { "layer", layer->getName() },
+                        { "origin", TileLayerStatistics::toString(origin) } };
+
+                    TileLayerStatistics::Totals totals = stats.getTotals(origin);
+                    advance(registry.counter("osgearth_layer_tile_requests_total", labels), totals.count);
+                    advance(registry.counter("osgearth_layer_tile_bytes_total", labels), totals.bytes);
+
+                    const auto& latency = stats.getLatency(origin);
+                    for (auto q : { std::make_pair("0.5", 0.5), std::make_pair("0.99", 0.99) })
+                    {
+                        Util::MetricsRegistry::Labels qlabels(labels);
+                        qlabels.emplace_back("quantile", q.first);
+                        registry.gauge("osgearth_layer_tile_seconds", qlabels).set(latency.quantile(q.second));
+                    }
+                }
+            }
+        }
+
+    private:
+        TileLayerStatisticsExporter()
+        {
+            auto& registry = Util::MetricsRegistry::instance();
+            registry.describe("osgearth_layer_tile_requests_total", "Tile requests a layer has served, by origin");
+            registry.describe("osgearth_layer_tile_bytes_total", "Bytes of tile data a layer has produced, by origin");
+            registry.describe("osgearth_layer_tile_seconds", "Tile request latency quantiles, by layer and origin");
+        }
+
+        // The layer keeps its own totals; bring the exported counter up to them
+        static void advance(Util::MetricsRegistry::Counter& counter, std::uint64_t total)
+        {
+            std::int64_t delta = (std::int64_t)total - counter.value();
+            if (delta > 0)
+                counter.add(delta);
+        }
+
+        static void unregister(Util::MetricsRegistry& registry, const std::string& name)
+        {
+            Util::MetricsRegistry::Labels labels = { { "layer", name } };
+            registry.remove("osgearth_layer_tile_requests_total", labels);
+            registry.remove("osgearth_layer_tile_bytes_total", labels);
+            registry.remove("osgearth_layer_tile_seconds", labels);
+        }
+
+        struct Record
+        {
+            Record(TileLayer* layer) : layer(layer), ptr(layer), name(layer->getName()) { }
+            osg::observer_ptr<TileLayer> layer;
+            const TileLayer* ptr; // identity only; never dereferenced
+            std::string name;     // name the series were exported under
+        };
+
+        std::mutex _mutex;
+        std::list<Record> _layers;
+    };
+}
+
+//------------------------------------------------------------------------
+
+constexpr unsigned TileLayerStatistics::MAX_LOD;
+
+TileLayerStatistics::TileLayerStatistics() :
+    _latency{ {1e-6}, {1e-6}, {1e-6}, {1e-6} } // record microseconds, report seconds
+{
+    for (auto& row : _cells)
+    {
+        for (auto& cell : row)
+        {
+            cell.count.store(0u, std::memory_order_relaxed);
+            cell.microseconds.store(0u, std::memory_order_relaxed);
+            cell.bytes.store(0u, std::memory_order_relaxed);
+        }
+    }
+}
+
+void
+TileLayerStatistics::record(Origin origin, unsigned lod, std::uint64_t microseconds, std::uint64_t bytes)
+{
+    Cell& cell = _cells[origin][std::min(lod, MAX_LOD)];
+    cell.count.fetch_add(1u, std::memory_order_relaxed);
+    cell.microseconds.fetch_add(microseconds, std::memory_order_relaxed);
+    cell.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    _latency[origin].record(microseconds);
+}
+
+TileLayerStatistics::Totals
+TileLayerStatistics::getTotals(Origin origin, unsigned lod) const
+{
+    const Cell& cell = _cells[origin][std::min(lod, MAX_LOD)];
+    Totals totals;
+    totals.count = cell.count.load(std::memory_order_relaxed);
+    totals.microseconds = cell.microseconds.load(std::memory_order_relaxed);
+    totals.bytes = cell.bytes.load(std::memory_order_relaxed);
+    return totals;
+}
+
+TileLayerStatistics::Totals
+TileLayerStatistics::getTotals(Origin origin) const
+{
+    Totals totals;
+    for (unsigned lod = 0; lod <= MAX_LOD; ++lod)
+    {
+        Totals t = getTotals(origin, lod);
+        totals.count += t.count;
+        totals.microseconds += t.microseconds;
+        totals.bytes += t.bytes;
+    }
+    return totals;
+}
+
+const char*
+TileLayerStatistics::toString(Origin origin)
+{
+    switch (origin)
+    {
+    case ORIGIN_MEMORY_CACHE: return "memory_cache";
+    case ORIGIN_CACHE_BIN: return "cache_bin";
+    case ORIGIN_SOURCE: return "source";
+    default: return "none";
+    }
+}
+
+void
+TileLayerStatistics::print(std::ostream& out, const std::string& title) const
+{
+    std::ios::fmtflags flags(out.flags());
+    out << std::fixed << std::setprecision(2);
+
+    out << title << "\n"
+        << "  " << std::left << std::setw(14) << "origin" << std::right
+        << std::setw(10) << "tiles"
+        << std::setw(10) << "avg ms"
+        << std::setw(10) << "p50 ms"
+        << std::setw(10) << "p99 ms"
+        << std::setw(10) << "max ms"
+        << std::setw(12) << "MB" << "\n";
+
+    for (unsigned o = 0; o < NUM_ORIGINS; ++o)
+    {
+        Totals t = getTotals((Origin)o);
+        if (t.count == 0u)
+            continue;
+
+        const auto& h = _latency[o];
+        out << "  " << std::left << std::setw(14) << toString((Origin)o) << std::right
+            << std::setw(10) << t.count
+            << std::setw(10) << (double)t.microseconds / (double)t.count * 1e-3
+            << std::setw(10) << h.quantile(0.5) * 1e3
+            << std::setw(10) << h.quantile(0.99) * 1e3
+            << std::setw(10) << h.max() * 1e3
+            << std::setw(12) << (double)t.bytes / 1048576.0 << "\n";
+    }
+
+    out << "  " << std::left << std::setw(14) << "LOD" << std::right
+        << std::setw(10) << "tiles"
+        << std::setw(10) << "avg ms"
+        << std::setw(10) << "cached %"
+        << std::setw(10) << "empty %"
+        << std::setw(10) << ""
+        << std::setw(12) << "MB" << "\n";
+
+    for (unsigned lod = 0; lod <= MAX_LOD; ++lod)
+    {
+        Totals all, cached, empty;
+        for (unsigned o = 0; o < NUM_ORIGINS; ++o)
+        {
+            Totals t = getTotals((Origin)o, lod);
+            all.count += t.count;
+            all.microseconds += t.microseconds;
+            all.bytes += t.bytes;
+            if (o == ORIGIN_MEMORY_CACHE || o == ORIGIN_CACHE_BIN)
+                cached.count += t.count;
+            else if (o == ORIGIN_NONE)
+                empty.count += t.count;
+        }
+        if (all.count == 0u)
+            continue;
+
+        out << "  " << std::left << std::setw(14) << (lod < MAX_LOD ? std::to_string(lod) : std::to_string(lod) + "+") << std::right
+            << std::setw(10) << all.count
+            << std::setw(10) << (double)all.microseconds / (double)all.count * 1e-3
+            << std::setw(10) << 100.0 * (double)cached.count / (double)all.count
+            << std::setw(10) << 100.0 * (double)empty.count / (double)all.count
+            << std::setw(10) << ""
+            << std::setw(12) << (double)all.bytes / 1048576.0 << "\n";
+    }
+
+    out.flags(flags);
 }
 
 #define LC "[" << className() << "] \"" << getName() << "\" "
@@ -52,6 +316,7 @@ TileLayer::Options::getConfig() const
     conf.set("profile", _profile);
     conf.set("tile_size", _tileSize);
     conf.set("upsample", upsample());
+    conf.set("source_tile_cache_size", sourceTileCacheSize());
 
     return conf;
 }
@@ -71,6 +336,7 @@ TileLayer::Options::fromConfig(const Config& conf)
     conf.get( "min_valid_value", _minValidValue);
     conf.get( "max_valid_value", _maxValidValue);
     conf.get("upsample", upsample());
+    conf.get("source_tile_cache_size", sourceTileCacheSize());
 }
 
 //------------------------------------------------------------------------
@@ -187,6 +453,8 @@ TileLayer::CacheBinMetadata::getConfig() const
 
 TileLayer::~TileLayer()
 {
+    TileLayerStatisticsExporter::instance().remove(this);
+
     if (_dataExtentsIndex)
     {
         delete static_cast<DataExtentsIndex*>(_dataExtentsIndex);
@@ -313,7 +581,9 @@ TileLayer::init()
 {
     VisibleLayer::init();
     _writingRequested = false;
+    _sourceTileCacheSize = 0u;
     _dataExtentsIndex = nullptr;
+    _tileStats = std::make_shared<TileLayerStatistics>();
 }
 
 Status
@@ -333,12 +603,17 @@ TileLayer::openImplementation()
     if (_memCache.valid())
         _memCache->clear();
 
+    if (isOpen())
+        TileLayerStatisticsExporter::instance().add(this);
+
     return getStatus();
 }
 
 Status
 TileLayer::closeImplementation()
 {
+    TileLayerStatisticsExporter::instance().remove(this);
+
     _dataExtents.clear();
     dirtyDataExtents();
 
@@ -351,18 +626,26 @@ TileLayer::addedToMap(const Map* map)
     VisibleLayer::addedToMap(map);
 
     unsigned l2CacheSize = 0u;
+    _sourceTileCacheSize = 0u;
 
     // If the profiles don't match, mosaicing will be likely so set up a
-    // small L2 cache for this layer.
+    // small L2 cache for this layer, and keep recently used source tiles
+    // around for neighboring output tiles to share.
     if (map &&
         map->getProfile() &&
         getProfile() &&
         !map->getProfile()->getSRS()->isHorizEquivalentTo(getProfile()->getSRS()))
     {
         l2CacheSize = 16u;
+        _sourceTileCacheSize = 32u;
         OE_INFO << LC << "Map/Layer profiles differ; requesting L2 cache" << std::endl;
     }
 
+    if (options().sourceTileCacheSize().isSet())
+    {
+        _sourceTileCacheSize = options().sourceTileCacheSize().get();
+    }
+
     // Use the user defined option if it's set.
     if (options().l2CacheSize().isSet())
     {
@@ -727,7 +1010,122 @@ TileLayer::isCached(const TileKey& key) const
     if ( !bin )
         return false;
 
-    return bin->getRecordStatus( key.str() ) == CacheBin::STATUS_OK;
+    return bin->getRecordStatus( getCacheKey(key) ) == CacheBin::STATUS_OK;
+}
+
+void
+TileLayer::isCached(const std::vector<TileKey>& keys, std::vector<bool>& output) const
+{
+    output.assign(keys.size(), false);
+
+    if (keys.empty() || getCacheSettings()->isCacheDisabled())
+        return;
+
+    if (getCacheSettings()->cachePolicy()->isCacheOnly())
+    {
+        output.assign(keys.size(), true);
+        return;
+    }
+
+    // group the keys by profile since each profile has its own bin:
+    std::map<const Profile*, std::vector<unsigned>> groups;
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        groups[keys[i].getProfile()].push_back(i);
+    }
+
+    std::vector<std::string> cacheKeys;
+    std::vector<CacheBin::RecordStatus> status;
+
+    for (auto& group : groups)
+    {
+        CacheBin* bin = const_cast<TileLayer*>(this)->getCacheBin(group.first);
+        if (!bin)
+            continue;
+
+        cacheKeys.clear();
+        for (auto i : group.second)
+        {
+            cacheKeys.push_back(getCacheKey(keys[i]));
+        }
+
+        bin->getRecordStatusBatch(cacheKeys, status);
+
+        for (unsigned j = 0; j < group.second.size(); ++j)
+        {
+            output[group.second[j]] = (status[j] == CacheBin::STATUS_OK);
+        }
+    }
+}
+
+// job pool for setting up a cache bin before prefetching from it
+#define ARENA_PREFETCH "oe.layer.prefetch"
+
+void
+TileLayer::prefetchCached(const std::vector<TileKey>& keys) const
+{
+    if (keys.empty() || !isOpen() ||
+        getCacheSettings()->isCacheDisabled() ||
+        getCacheSettings()->cachePolicy()->isCacheReadable() == false)
+    {
+        return;
+    }
+
+    // group the keys by profile since each profile has its own bin:
+    std::map<const Profile*, std::vector<std::string>> groups;
+    for (auto& key : keys)
+    {
+        if (isKeyInLegalRange(key))
+        {
+            groups[key.getProfile()].push_back(getCacheKey(key));
+        }
+    }
+
+    // This usually runs on the cull thread. Once a profile's bin is set up
+    // it's just a lookup, but setting it up reads (and may write) the bin
+    // metadata, so do that in the background along with the prefetch.
+    osg::observer_ptr<const TileLayer> layer_ptr(this);
+
+    for (auto& group : groups)
+    {
+        if (const_cast<TileLayer*>(this)->getCacheBinMetadata(group.first))
+        {
+            CacheBin* bin = getCacheSettings()->getCacheBin();
+            if (bin)
+            {
+                prefetchFromCacheBin(bin, group.second);
+            }
+        }
+        else
+        {
+            osg::ref_ptr<const Profile> profile(group.first);
+            std::vector<std::string> cacheKeys(std::move(group.second));
+
+            jobs::context context;
+            context.name = "prefetch " + getName();
+            context.pool = jobs::get_pool(ARENA_PREFETCH);
+
+            jobs::dispatch([layer_ptr, profile, cacheKeys]()
+                {
+                    osg::ref_ptr<const TileLayer> layer;
+                    if (layer_ptr.lock(layer) && layer->isOpen())
+                    {
+                        CacheBin* bin = const_cast<TileLayer*>(layer.get())->getCacheBin(profile.get());
+                        if (bin)
+                        {
+                            layer->prefetchFromCacheBin(bin, cacheKeys);
+                        }
+                    }
+                },
+                context);
+        }
+    }
+}
+
+std::string
+TileLayer::getCacheKey(const TileKey& key) const
+{
+    return Cache::makeCacheKey(key.str() + "-" + key.getProfile()->getHorizSignature(), "tile");
 }
 
 unsigned int TileLayer::getDataExtentsSize() const
@@ -46,7 +46,25 @@ using namespace osgEarth::Threading;
 
 namespace
 {
-    static Gate<std::string> uri_gate;    
+    // Deep-copies images handed to coalesced readers, since image consumers
+    // often modify pixels in place. Other objects are shared, as they are
+    // with the URIResultCache.
+    ReadResult copyResultForFollower(const ReadResult& in)
+    {
+        osg::Image* image = in.getImage();
+        if (!image)
+            return in;
+
+        ReadResult out(in.code(), new osg::Image(*image, osg::CopyOp::DEEP_COPY_ALL), in.metadata());
+        out.setIsFromCache(in.isFromCache());
+        out.setLastModifiedTime(in.lastModifiedTime());
+        out.setDuration(in.duration());
+        out.setErrorDetail(in.errorDetail());
+        return out;
+    }
+
+    // Total number of reads satisfied by joining an identical read in flight
+    std::atomic_uint s_numCoalescedReads = { 0u };
 }
 
 //------------------------------------------------------------------------
@@ -524,13 +542,11 @@ namespace
     // have 4 95%-identical code paths to maintain...
 
     template<typename READ_FUNCTOR>
-    ReadResult doRead(
+    ReadResult doReadImpl(
         const URI&            inputURI,
         const osgDB::Options* dbOptions,
         ProgressCallback*     progress)
     {
-        ScopedGate<std::string> gatelock(uri_gate, inputURI.full());
-
         //osg::Timer_t startTime = osg::Timer::instance()->tick();
 
         unsigned long handle = NetworkMonitor::begin(inputURI.full(), "pending", "URI");
@@ -704,6 +720,73 @@ namespace
 
         return result;
     }
+
+    // Builds the key under which identical concurrent reads are coalesced.
+    // Two reads are identical if they resolve to the same location with
+    // the same plugin options, headers, caching policy and callbacks.
+    std::string makeCoalescingKey(const URI& uri, const osgDB::Options* dbOptions)
+    {
+        std::stringstream buf;
+        buf << uri.full();
+
+        if (uri.optionString().isSet())
+            buf << "|o:" << uri.optionString().get();
+
+        const osgDB::Options* options = dbOptions ? dbOptions : Registry::instance()->getDefaultOptions();
+        if (options)
+        {
+            buf << "|p:" << options->getOptionString();
+
+            CacheSettings* cacheSettings = CacheSettings::get(options);
+            if (cacheSettings && cacheSettings->cachePolicy().isSet())
+                buf << "|c:" << cacheSettings->cachePolicy()->usageString();
+
+            buf << "|a:" << URIAliasMap::from(options)
+                << "|r:" << URIResultCache::from(options)
+                << "|q:" << URIPostReadCallback::from(options);
+        }
+
+        // sort the headers so the key does not depend on hash order
+        std::map<std::string, std::string> headers(
+            uri.context().getHeaders().begin(),
+            uri.context().getHeaders().end());
+
+        for (auto& header : headers)
+            buf << "|h:" << header.first << "=" << header.second;
+
+        return buf.str();
+    }
+
+    // Reads a URI, sharing the result among concurrent callers reading
+    // the same thing so that only one of them hits the cache or network.
+    template<typename READ_FUNCTOR>
+    ReadResult doRead(
+        const URI&            inputURI,
+        const osgDB::Options* dbOptions,
+        ProgressCallback*     progress)
+    {
+        // one group per read type, so that (for example) a readString and
+        // a readImage of the same URL never share a result.
+        static SingleFlight<std::string, ReadResult> s_inflight(copyResultForFollower);
+
+        bool coalesced = false;
+
+        ReadResult result = s_inflight.run(
+            makeCoalescingKey(inputURI, dbOptions),
+            [&]() { return doReadImpl<READ_FUNCTOR>(inputURI, dbOptions, progress); },
+            progress,
+            &coalesced);
+
+        if (coalesced)
+        {
+            ++s_numCoalescedReads;
+
+            unsigned long handle = NetworkMonitor::begin(inputURI.full(), "pending", "URI");
+            NetworkMonitor::end(handle, result.getResultCodeString() + " (coalesced)");
+        }
+
+        return result;
+    }
 }
 
 ReadResult
@@ -734,6 +817,12 @@ URI::readString(const osgDB::Options* dbOptions,
     return doRead<ReadString>( *this, dbOptions, progress );
 }
 
+unsigned
+URI::getNumCoalescedReads()
+{
+    return s_numCoalescedReads;
+}
+
 //------------------------------------------------------------------------
 
 void
@@ -373,11 +373,12 @@ WFSFeatureSource::getFeatures(const std::string& buffer, const std::string& mime
     {
         OGR_L_ResetReading(layer);
         OGRFeatureH feat_handle;
+        osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
         while ((feat_handle = OGR_L_GetNextFeature(layer)) != NULL)
         {
             if (feat_handle)
             {
-                osg::ref_ptr<Feature> f = OgrUtils::createFeature(feat_handle, getFeatureProfile(), *_options->rewindPolygons());
+                osg::ref_ptr<Feature> f = OgrUtils::createFeature(feat_handle, getFeatureProfile(), *_options->rewindPolygons(), columns.get());
                 if (f.valid() && !isBlacklisted(f->getFID()))
                 {
                     features.push_back(f.release());
@@ -27,14 +27,19 @@
 #include <osgEarth/Registry>
 #include <osgEarth/NetworkMonitor>
 #include <osgEarth/Metrics>
+#include <osgEarth/MetricsRegistry>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/WriteFile>
+#include <atomic>
 #include <fstream>
+#include <list>
+#include <memory>
 #include <sys/stat.h>
 
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
+using namespace osgEarth::Util;
 
 #ifndef _WIN32
 #   include <unistd.h>
@@ -46,6 +51,21 @@ using namespace osgEarth::Drivers;
 //#define IMAGE_FORMAT "tif"
 //#define IMAGE_EXT "." IMAGE_FORMAT
 
+namespace
+{
+    // Records a read in the metrics registry and passes it through
+    const ReadResult& countRead(const ReadResult& r)
+    {
+        static MetricsRegistry::Counter& hits = MetricsRegistry::instance().counter(
+            "osgearth_cache_reads_total", { {"cache", "filesystem"}, {"result", "hit"} });
+        static MetricsRegistry::Counter& misses = MetricsRegistry::instance().counter(
+            "osgearth_cache_reads_total", { {"cache", "filesystem"}, {"result", "miss"} });
+
+        (r.succeeded() ? hits : misses).add();
+        return r;
+    }
+}
+
 namespace
 {
     /**
@@ -77,6 +97,8 @@ namespace
         std::string _rootPath;
         FileSystemCacheOptions _options;
         jobs::jobpool* _pool = nullptr;
+        jobs::jobpool* _readPool = nullptr;
+        jobs::jobpool* _decodePool = nullptr;
     };
 
     struct WriteCacheRecord {
@@ -96,7 +118,9 @@ namespace
             const std::string& name,
             const std::string& rootPath,
             const FileSystemCacheOptions& options,
-            jobs::jobpool* pool);
+            jobs::jobpool* pool,
+            jobs::jobpool* readPool,
+            jobs::jobpool* decodePool);
 
         static bool _s_debug;
 
@@ -118,9 +142,45 @@ namespace
 
         bool clear() override;
 
+        std::vector<Future<ReadResult>> readImagesAsync(const std::vector<std::string>& keys, const osgDB::Options* dbo) override;
+
+        std::vector<Future<ReadResult>> readObjectsAsync(const std::vector<std::string>& keys, const osgDB::Options* dbo) override;
+
+        void prefetchImages(const std::vector<std::string>& keys, const osgDB::Options* dbo) override;
+
+        void prefetchObjects(const std::vector<std::string>& keys, const osgDB::Options* dbo) override;
+
     protected:
         bool purgeDirectory( const std::string& dir );
 
+        //! Starts an asynchronous read of one record. The file is read on
+        //! the read pool and decoded on the decode pool, so one record's
+        //! disk I/O overlaps with another's decompression.
+        //! If "size" is set, it receives the approximate memory used by
+        //! the decoded record.
+        Future<ReadResult> readAsync(
+            const std::string& key,
+            bool image,
+            const osgDB::Options* dbo,
+            std::shared_ptr<std::atomic<std::size_t>> size = nullptr);
+
+        //! Turns the raw bytes of a record into an object
+        ReadResult decode(const std::string& bytes, bool image, const osgDB::Options* dbo, const Config& meta, TimeStamp timeStamp);
+
+        void prefetch(const std::vector<std::string>& keys, bool image, const osgDB::Options* dbo);
+
+        //! Removes the prefetched read for a file, and returns it if it
+        //! was made with the same read options
+        bool takePrefetched(const std::string& path, const osgDB::Options* dbo, Future<ReadResult>& output);
+
+        //! Drops any prefetched reads of a record (image or object)
+        void forgetPrefetched(const std::string& fullPath);
+
+        //! Drops the oldest prefetched reads until they fit the limits
+        void trimPrefetched();
+
+        std::string recordPath(const std::string& fullPath, bool image) const;
+
         bool binValidForReading(bool silent =true);
 
         bool binValidForWriting(bool silent =false);
@@ -138,6 +198,22 @@ namespace
         // pool for asynchronous writes
         jobs::jobpool* _pool = nullptr;
 
+        // pools for asynchronous reads
+        jobs::jobpool* _readPool = nullptr;
+        jobs::jobpool* _decodePool = nullptr;
+
+        // prefetched reads waiting to be picked up, by file path,
+        // with the oldest first in _prefetchOrder.
+        struct Prefetched {
+            Future<ReadResult> result;
+            osg::ref_ptr<const osgDB::Options> options;
+            std::shared_ptr<std::atomic<std::size_t>> size;
+            std::list<std::string>::iterator order;
+        };
+        std::unordered_map<std::string, Prefetched> _prefetched;
+        std::list<std::string> _prefetchOrder;
+        std::mutex _prefetchedMutex;
+
     public:
         // cache for objects waiting to be written; this supports reading from
         // the cache before the object has been asynchronously written to disk.
@@ -216,6 +292,16 @@ namespace
 
         // create a thread pool dedicated to asynchronous cache writes
         setNumThreads(_options.threads().get());
+
+        // and pools for asynchronous reads; reading and decoding get separate
+        // pools so that waiting on the disk never starves decompression.
+        _readPool = jobs::get_pool("oe.fscache.read");
+        _readPool->set_can_steal_work(false);
+        _readPool->set_concurrency(osg::clampBetween(_options.readThreads().get(), 1u, 16u));
+
+        _decodePool = jobs::get_pool("oe.fscache.decode");
+        _decodePool->set_can_steal_work(false);
+        _decodePool->set_concurrency(osg::clampBetween(_options.decodeThreads().get(), 1u, 16u));
     }
 
     void
@@ -239,7 +325,7 @@ namespace
         if (getStatus().isError())
             return NULL;
 
-        return _bins.getOrCreate(name, new FileSystemCacheBin(name, _rootPath, _options, _pool));
+        return _bins.getOrCreate(name, new FileSystemCacheBin(name, _rootPath, _options, _pool, _readPool, _decodePool));
     }
 
     CacheBin*
@@ -254,7 +340,7 @@ namespace
             std::lock_guard<std::mutex> lock( s_defaultBinMutex );
             if ( !_defaultBin.valid() ) // double-check
             {
-                _defaultBin = new FileSystemCacheBin("__default", _rootPath, _options, _pool);
+                _defaultBin = new FileSystemCacheBin("__default", _rootPath, _options, _pool, _readPool, _decodePool);
             }
         }
         return _defaultBin.get();
@@ -326,10 +412,14 @@ namespace
         const std::string& binID,
         const std::string& rootPath,
         const FileSystemCacheOptions& options,
-        jobs::jobpool* pool) :
+        jobs::jobpool* pool,
+        jobs::jobpool* readPool,
+        jobs::jobpool* decodePool) :
 
         CacheBin(binID, options.enableNodeCaching().get()),
         _pool(pool),
+        _readPool(readPool),
+        _decodePool(decodePool),
         _binPathExists(false),
         _options(options),
         _ok(true)
@@ -384,13 +474,23 @@ namespace
     FileSystemCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
     {
         if ( !binValidForReading() )
-            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+            return countRead(ReadResult(ReadResult::RESULT_NOT_FOUND));
 
         // mangle "key" into a legal path name
         URI fileURI( key, _metaPath );
         //std::string path = fileURI.full() + OSG_EXT;
         std::string path = fileURI.full() + "." + _options.format().get();
 
+        // if the record was prefetched, wait for that read to finish.
+        // (Do this before locking the file, since the prefetch locks it too.)
+        Future<ReadResult> prefetched;
+        if (takePrefetched(path, readOptions, prefetched))
+        {
+            prefetched.join();
+            if (prefetched.available())
+                return countRead(prefetched.value());
+        }
+
         osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);        
 
         // lock the file:
@@ -413,14 +513,14 @@ namespace
 
                 rr.setLastModifiedTime(DateTime().asTimeStamp());        
 
-                return rr;
+                return countRead(rr);
             }
         }        
 
         // Not in the pool, now check the file system
         if (!osgDB::fileExists(path))
         {
-            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+            return countRead(ReadResult(ReadResult::RESULT_NOT_FOUND));
         }
 
         unsigned long handle = NetworkMonitor::begin(path, "pending", "Cache");
@@ -431,14 +531,14 @@ namespace
             osgDB::Registry::instance()->getReaderWriterForExtension(_options.format().get());
 
         if (!image_rw.valid())
-            return ReadResult(Stringify() << "Unknown image format \"" << _options.format().get() << "\"");
+            return countRead(ReadResult(Stringify() << "Unknown image format \"" << _options.format().get() << "\""));
 
         osgDB::ReaderWriter::ReadResult r = image_rw->readImage(path, dbo.get());
         //osgDB::ReaderWriter::ReadResult r = _rw->readImage(path, dbo.get());
         if (!r.success())
         {
             NetworkMonitor::end(handle, "failed");
-            return ReadResult(r.message());
+            return countRead(ReadResult(r.message()));
         }
         else
         {
@@ -462,7 +562,7 @@ namespace
             rr.getImage() == nullptr || rr.getImage()->isCompressed() == false, 
             ReadResult());
 
-        return rr;
+        return countRead(rr);
     }
     
     ReadResult
@@ -471,12 +571,21 @@ namespace
         OE_PROFILING_ZONE;
 
         if ( !binValidForReading() )
-            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+            return countRead(ReadResult(ReadResult::RESULT_NOT_FOUND));
 
         // mangle "key" into a legal path name
         URI fileURI( key, _metaPath );
         std::string path = fileURI.full() + OSG_EXT;
 
+        // if the record was prefetched, wait for that read to finish.
+        Future<ReadResult> prefetched;
+        if (takePrefetched(path, readOptions, prefetched))
+        {
+            prefetched.join();
+            if (prefetched.available())
+                return countRead(prefetched.value());
+        }
+
         osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);        
 
         // lock the file:
@@ -499,14 +608,14 @@ namespace
 
                 rr.setLastModifiedTime(DateTime().asTimeStamp());
 
-                return rr;
+                return countRead(rr);
             }
         }
 
         // Not in the pool, now check the file system
         if (!osgDB::fileExists(path))
         {            
-            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+            return countRead(ReadResult(ReadResult::RESULT_NOT_FOUND));
         }
 
         unsigned long handle = NetworkMonitor::begin(path, "pending", "Cache");
@@ -516,7 +625,7 @@ namespace
         if (!r.success())
         {
             NetworkMonitor::end(handle, "failed");
-            return ReadResult(r.message());
+            return countRead(ReadResult(r.message()));
         }
         else
         {
@@ -535,7 +644,7 @@ namespace
         if (_s_debug)
             OE_NOTICE << LC << "Read object \"" << key << "\" from cache bin [" << getID() << "] path=" << fileURI.full() << "." << OSG_EXT << std::endl;
 
-        return rr;
+        return countRead(rr);
     }
 
     ReadResult
@@ -590,6 +699,9 @@ namespace
         if (isNode && _options.enableNodeCaching() == false)
             return true;
 
+        // any prefetched copy of this record is now out of date.
+        forgetPrefetched(fileURI.full());
+
         // Wrap input objects in ref_ptrs so they will persist in our write functor lambda
         osg::ref_ptr<const osg::Object> object(raw_object);
         osg::ref_ptr<const osgDB::Options> writeOptions(dbo);
@@ -707,6 +819,9 @@ namespace
         URI fileURI( key, _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
 
+        // a prefetched copy would outlive the record.
+        forgetPrefetched(fileURI.full());
+
         // exclusive file access:
         ScopedGate<std::string> lockFile(_fileGate, fileURI.full());
         return ::unlink( path.c_str() ) == 0;
@@ -724,6 +839,283 @@ namespace
         return osgEarth::touchFile( path );
     }
 
+    std::string
+    FileSystemCacheBin::recordPath(const std::string& fullPath, bool image) const
+    {
+        return image ? fullPath + "." + _options.format().get() : fullPath + OSG_EXT;
+    }
+
+    ReadResult
+    FileSystemCacheBin::decode(
+        const std::string& bytes,
+        bool image,
+        const osgDB::Options* dbo,
+        const Config& meta,
+        TimeStamp timeStamp)
+    {
+        OE_PROFILING_ZONE_NAMED("OE FS Cache Decode");
+
+        std::istringstream in(bytes);
+        osgDB::ReaderWriter::ReadResult r;
+
+        if (image)
+        {
+            osg::ref_ptr<osgDB::ReaderWriter> image_rw =
+                osgDB::Registry::instance()->getReaderWriterForExtension(_options.format().get());
+
+            if (!image_rw.valid())
+                return ReadResult(Stringify() << "Unknown image format \"" << _options.format().get() << "\"");
+
+            r = image_rw->readImage(in, dbo);
+        }
+        else
+        {
+            r = _rw->readObject(in, dbo);
+        }
+
+        if (!r.success())
+            return ReadResult(r.message());
+
+        ReadResult rr(r.getObject(), meta);
+        rr.setLastModifiedTime(timeStamp);
+
+        // compressed cache data means there was an internal error
+        OE_SOFT_ASSERT_AND_RETURN(
+            rr.getImage() == nullptr || rr.getImage()->isCompressed() == false,
+            ReadResult());
+
+        return rr;
+    }
+
+    Future<ReadResult>
+    FileSystemCacheBin::readAsync(
+        const std::string& key,
+        bool image,
+        const osgDB::Options* readOptions,
+        std::shared_ptr<std::atomic<std::size_t>> size)
+    {
+        Future<ReadResult> result;
+
+        if (!binValidForReading())
+        {
+            result.resolve(ReadResult(ReadResult::RESULT_NOT_FOUND));
+            return result;
+        }
+
+        URI fileURI(key, _metaPath);
+        std::string fullPath = fileURI.full();
+        std::string path = recordPath(fullPath, image);
+
+        if (_pool)
+        {
+            // the record may still be waiting in the write cache.
+            ScopedReadLock lock(_writeCacheRWM);
+            auto i = _writeCache.find(fullPath);
+            if (i != _writeCache.end())
+            {
+                ReadResult rr(const_cast<osg::Object*>(i->second.object.get()), i->second.meta);
+                rr.setLastModifiedTime(DateTime().asTimeStamp());
+                result.resolve(rr);
+                return result;
+            }
+        }
+
+        osg::ref_ptr<FileSystemCacheBin> bin(this);
+        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+
+        auto read_op = [bin, fullPath, path, image, dbo, result, size]() mutable
+        {
+            OE_PROFILING_ZONE_NAMED("OE FS Cache Read");
+
+            // nobody is waiting for the result any more
+            if (result.canceled())
+                return;
+
+            auto bytes = std::make_shared<std::string>();
+            Config meta;
+            TimeStamp timeStamp = 0;
+            {
+                ScopedGate<std::string> lockFile(bin->_fileGate, fullPath);
+
+                std::ifstream in(path.c_str(), std::ios::binary);
+                if (!in.is_open())
+                {
+                    result.resolve(ReadResult(ReadResult::RESULT_NOT_FOUND));
+                    return;
+                }
+
+                unsigned long handle = NetworkMonitor::begin(path, "pending", "Cache");
+
+                in.seekg(0, std::ios::end);
+                bytes->resize((size_t)in.tellg());
+                in.seekg(0, std::ios::beg);
+                if (!bytes->empty())
+                    in.read(&(*bytes)[0], bytes->size());
+
+                NetworkMonitor::end(handle, in.good() ? "OK" : "failed");
+
+                timeStamp = osgEarth::getLastModifiedTime(path);
+
+                std::string metafile = fullPath + ".meta";
+                if (osgDB::fileExists(metafile))
+                    readMeta(metafile, meta);
+            }
+
+            // hand off to the decoders so this thread can go read the next file.
+            auto decode_op = [bin, path, image, dbo, result, bytes, meta, timeStamp, size]() mutable
+            {
+                if (result.canceled())
+                    return;
+
+                ReadResult rr = bin->decode(*bytes, image, dbo.get(), meta, timeStamp);
+
+                if (size)
+                {
+                    size->store(rr.getImage() ?
+                        (std::size_t)rr.getImage()->getTotalSizeInBytesIncludingMipmaps() :
+                        bytes->size());
+                }
+
+                result.resolve(rr);
+
+                // a prefetch just grew; make sure they all still fit.
+                if (size)
+                    bin->trimPrefetched();
+
+                if (_s_debug)
+                    OE_NOTICE << LC << "Async read \"" << path << "\" from cache bin [" << bin->getID() << "]" << std::endl;
+            };
+
+            jobs::dispatch(decode_op, jobs::context{ path, bin->_decodePool });
+        };
+
+        jobs::dispatch(read_op, jobs::context{ path, _readPool });
+
+        return result;
+    }
+
+    std::vector<Future<ReadResult>>
+    FileSystemCacheBin::readImagesAsync(const std::vector<std::string>& keys, const osgDB::Options* dbo)
+    {
+        std::vector<Future<ReadResult>> output;
+        output.reserve(keys.size());
+        for (auto& key : keys)
+            output.emplace_back(readAsync(key, true, dbo));
+        return output;
+    }
+
+    std::vector<Future<ReadResult>>
+    FileSystemCacheBin::readObjectsAsync(const std::vector<std::string>& keys, const osgDB::Options* dbo)
+    {
+        std::vector<Future<ReadResult>> output;
+        output.reserve(keys.size());
+        for (auto& key : keys)
+            output.emplace_back(readAsync(key, false, dbo));
+        return output;
+    }
+
+    void
+    FileSystemCacheBin::prefetchImages(const std::vector<std::string>& keys, const osgDB::Options* dbo)
+    {
+        prefetch(keys, true, dbo);
+    }
+
+    void
+    FileSystemCacheBin::prefetchObjects(const std::vector<std::string>& keys, const osgDB::Options* dbo)
+    {
+        prefetch(keys, false, dbo);
+    }
+
+    void
+    FileSystemCacheBin::prefetch(const std::vector<std::string>& keys, bool image, const osgDB::Options* dbo)
+    {
+        if (!binValidForReading() || _options.maxPrefetched().get() == 0u)
+            return;
+
+        for (auto& key : keys)
+        {
+            std::string path = recordPath(URI(key, _metaPath).full(), image);
+
+            {
+                std::lock_guard<std::mutex> lock(_prefetchedMutex);
+                if (_prefetched.find(path) != _prefetched.end())
+                    continue;
+            }
+
+            auto size = std::make_shared<std::atomic<std::size_t>>(0u);
+            Future<ReadResult> result = readAsync(key, image, dbo, size);
+
+            std::lock_guard<std::mutex> lock(_prefetchedMutex);
+            if (_prefetched.find(path) != _prefetched.end())
+                continue;
+
+            _prefetchOrder.push_back(path);
+            _prefetched[path] = Prefetched{ result, dbo, size, std::prev(_prefetchOrder.end()) };
+        }
+
+        trimPrefetched();
+    }
+
+    void
+    FileSystemCacheBin::trimPrefetched()
+    {
+        const std::size_t maxBytes = (std::size_t)_options.maxPrefetchedMB().get() * 1024u * 1024u;
+
+        std::lock_guard<std::mutex> lock(_prefetchedMutex);
+
+        std::size_t total = 0u;
+        for (auto& i : _prefetched)
+            total += i.second.size->load();
+
+        // forget the oldest prefetches; if they are still in progress,
+        // dropping the future cancels them.
+        while (!_prefetched.empty() &&
+            (_prefetched.size() > _options.maxPrefetched().get() || total > maxBytes))
+        {
+            auto i = _prefetched.find(_prefetchOrder.front());
+            total -= i->second.size->load();
+            _prefetched.erase(i);
+            _prefetchOrder.pop_front();
+        }
+    }
+
+    bool
+    FileSystemCacheBin::takePrefetched(const std::string& path, const osgDB::Options* dbo, Future<ReadResult>& output)
+    {
+        std::lock_guard<std::mutex> lock(_prefetchedMutex);
+        if (_prefetched.empty())
+            return false;
+
+        auto i = _prefetched.find(path);
+        if (i == _prefetched.end())
+            return false;
+
+        // a read with different options might decode differently, so
+        // the prefetch is no use to this caller (or likely anyone else).
+        bool match = (i->second.options.get() == dbo);
+        if (match)
+            output = i->second.result;
+
+        _prefetchOrder.erase(i->second.order);
+        _prefetched.erase(i);
+        return match;
+    }
+
+    void
+    FileSystemCacheBin::forgetPrefetched(const std::string& fullPath)
+    {
+        std::lock_guard<std::mutex> lock(_prefetchedMutex);
+        for (bool image : { true, false })
+        {
+            auto i = _prefetched.find(recordPath(fullPath, image));
+            if (i != _prefetched.end())
+            {
+                _prefetchOrder.erase(i->second.order);
+                _prefetched.erase(i);
+            }
+        }
+    }
+
     bool
     FileSystemCacheBin::purgeDirectory( const std::string& dir )
     {
@@ -773,6 +1165,12 @@ namespace
         if ( !binValidForReading() )
             return false;
 
+        {
+            std::lock_guard<std::mutex> lock(_prefetchedMutex);
+            _prefetched.clear();
+            _prefetchOrder.clear();
+        }
+
         std::string binDir = osgDB::getFilePath( _metaPath );
         return purgeDirectory( binDir );
     }
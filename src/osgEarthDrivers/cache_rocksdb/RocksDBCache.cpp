@@ -19,6 +19,7 @@
 #include "RocksDBCache"
 #include "RocksDBCacheBin"
 #include <osgEarth/URI>
+#include <osgEarth/StringUtils>
 #include <osgEarth/Threading>
 #include <osgDB/Registry>
 #include <osgDB/ReaderWriter>
@@ -29,6 +30,7 @@
 #include <rocksdb/filter_policy.h>
 #include <rocksdb/table.h>
 #include <sys/stat.h>
+#include <memory>
 #ifndef _WIN32
 #   include <unistd.h>
 #endif
@@ -39,6 +41,8 @@
 
 #define ROCKSDB_CACHE_VERSION 1
 
+#define BIN_COLUMN_FAMILY_PREFIX "bin."
+
 using namespace osgEarth;
 using namespace osgEarth::RocksDBCache;
 
@@ -46,7 +50,8 @@ using namespace osgEarth::RocksDBCache;
 RocksDBCacheImpl::RocksDBCacheImpl( const CacheOptions& options ) :
 osgEarth::Cache( options ),
 _options       ( options ),
-_active        ( true )
+_active        ( true ),
+_db            ( 0L )
 {
     // Force OSG to initialize the image wrapper. Failure to do this can result
     // in a race condition within OSG when the cache is accessed from multiple threads.
@@ -107,10 +112,25 @@ RocksDBCacheImpl::~RocksDBCacheImpl()
 {
     if ( _db )
     {
-        // problem. This destructor causes a lockup sometimes. Perhaps try
-        // upgrading to a newer version of LDB. In the meantime, that's why it
-        // is commented out
-        //delete _db;
+        // Commit pending writes and detach every bin we handed out, since
+        // callers may hold on to a bin after the cache goes away.
+        {
+            std::lock_guard<std::mutex> lock(_columnFamiliesMutex);
+            for(auto& i : _openBins)
+            {
+                osg::ref_ptr<RocksDBCacheBin> bin;
+                if ( i.lock(bin) )
+                    bin->close();
+            }
+            _openBins.clear();
+
+            for(auto& cf : _columnFamilies)
+                _db->DestroyColumnFamilyHandle(cf.second);
+            _columnFamilies.clear();
+        }
+
+        // releases the LOCK file so the path can be opened again
+        delete _db;
         _db = 0L;
     }
 }
@@ -169,9 +189,60 @@ RocksDBCacheImpl::open()
 	options.max_bytes_for_level_base = options.write_buffer_size * options.min_write_buffer_number_to_merge * options.level0_file_num_compaction_trigger;
 	options.target_file_size_base = options.max_bytes_for_level_base / 10;
 
+    _cfOptions = rocksdb::ColumnFamilyOptions(options);
+
+    // With a column family per bin, all existing families must be opened.
+    auto openDB = [&]()
+    {
+        if ( _options.columnFamilyPerBin() == false )
+            return rocksdb::DB::Open(options, _rootPath, &_db);
+
+        std::vector<std::string> names;
+        if ( !rocksdb::DB::ListColumnFamilies(options, _rootPath, &names).ok() || names.empty() )
+            names = { rocksdb::kDefaultColumnFamilyName };
+
+        bool hasBinFamilies = false;
+        for(auto& name : names)
+            if ( startsWith(name, BIN_COLUMN_FAMILY_PREFIX) )
+                hasBinFamilies = true;
+
+        if ( !hasBinFamilies )
+        {
+            // New cache, or one written without per-bin families. Bins
+            // would not see records already in the default family, so
+            // in that case keep using it.
+            rocksdb::Status s = rocksdb::DB::Open(options, _rootPath, &_db);
+            if ( s.ok() )
+            {
+                std::unique_ptr<rocksdb::Iterator> it(_db->NewIterator(rocksdb::ReadOptions()));
+                it->SeekToFirst();
+                if ( it->Valid() )
+                {
+                    OE_WARN << LC << "Cache at \"" << _rootPath << "\" already holds data "
+                        "in a single column family; ignoring column_family_per_bin" << std::endl;
+                    _options.columnFamilyPerBin() = false;
+                }
+            }
+            return s;
+        }
+
+        std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+        for(auto& name : names)
+            descriptors.emplace_back(name, _cfOptions);
+
+        std::vector<rocksdb::ColumnFamilyHandle*> handles;
+        rocksdb::Status s = rocksdb::DB::Open(options, _rootPath, descriptors, &handles, &_db);
+        if ( s.ok() )
+        {
+            for(unsigned i = 0; i < handles.size(); ++i)
+                _columnFamilies[names[i]] = handles[i];
+        }
+        return s;
+    };
+
     rocksdb::Status status;
         
-    status = rocksdb::DB::Open(options, _rootPath, &_db);
+    status = openDB();
     if ( status.ok() )
         return;
 
@@ -179,7 +250,7 @@ RocksDBCacheImpl::open()
     status = rocksdb::RepairDB(_rootPath, options);
     if ( status.ok() )
     {
-        status = rocksdb::DB::Open(options, _rootPath, &_db);
+        status = openDB();
         if ( status.ok() )
         {
             OE_WARN << LC << "...repair complete!" << std::endl;
@@ -196,12 +267,42 @@ RocksDBCacheImpl::open()
     }
 }
 
+rocksdb::ColumnFamilyHandle*
+RocksDBCacheImpl::getOrCreateColumnFamily(const std::string& binID)
+{
+    if ( !_db || _options.columnFamilyPerBin() == false )
+        return _db ? _db->DefaultColumnFamily() : nullptr;
+
+    std::string name = BIN_COLUMN_FAMILY_PREFIX + binID;
+
+    std::lock_guard<std::mutex> lock(_columnFamiliesMutex);
+
+    auto i = _columnFamilies.find(name);
+    if ( i != _columnFamilies.end() )
+        return i->second;
+
+    rocksdb::ColumnFamilyHandle* handle = nullptr;
+    rocksdb::Status status = _db->CreateColumnFamily(_cfOptions, name, &handle);
+    if ( !status.ok() )
+    {
+        OE_WARN << LC << "Failed to create column family for bin \"" << binID
+            << "\"; using the default. msg = \"" << status.ToString() << "\"" << std::endl;
+        return _db->DefaultColumnFamily();
+    }
+
+    _columnFamilies[name] = handle;
+    return handle;
+}
+
 CacheBin*
 RocksDBCacheImpl::addBin( const std::string& name )
 {
-    return _db ?
-        _bins.getOrCreate(name, new RocksDBCacheBin(name, _db, _tracker.get())) :
-        0L;
+    if ( !_db )
+        return 0L;
+
+    CacheBin* bin = _bins.getOrCreate(name, new RocksDBCacheBin(name, _db, getOrCreateColumnFamily(name), _options, _tracker.get()));
+    track(static_cast<RocksDBCacheBin*>(bin));
+    return bin;
 }
 
 CacheBin*
@@ -216,12 +317,24 @@ RocksDBCacheImpl::getOrCreateDefaultBin()
         std::lock_guard<std::mutex> lock( s_defaultBinMutex );
         if ( !_defaultBin.valid() ) // double-check
         {
-            _defaultBin = new RocksDBCacheBin("_default", _db, _tracker.get());
+            osg::ref_ptr<RocksDBCacheBin> bin = new RocksDBCacheBin("_default", _db, getOrCreateColumnFamily("_default"), _options, _tracker.get());
+            track(bin.get());
+            _defaultBin = bin.get();
         }
     }
     return _defaultBin.get();
 }
 
+void
+RocksDBCacheImpl::track(RocksDBCacheBin* bin)
+{
+    std::lock_guard<std::mutex> lock(_columnFamiliesMutex);
+    for(auto& i : _openBins)
+        if ( i.get() == bin )
+            return;
+    _openBins.emplace_back(bin);
+}
+
 off_t
 RocksDBCacheImpl::getApproximateSize() const
 {
@@ -234,7 +347,16 @@ RocksDBCacheImpl::compact()
     if ( !_db )
         return false;
 
-    _db->CompactRange({}, nullptr, nullptr);
+    std::lock_guard<std::mutex> lock(_columnFamiliesMutex);
+    if ( _columnFamilies.empty() )
+    {
+        _db->CompactRange({}, nullptr, nullptr);
+    }
+    else
+    {
+        for(auto& cf : _columnFamilies)
+            _db->CompactRange({}, cf.second, nullptr, nullptr);
+    }
 
     return true;
 }
@@ -248,11 +370,40 @@ RocksDBCacheImpl::clear()
     // No WriteBatch because it doesn't seem to allow compaction to occur
     // -- need to figure out why someday.
 
-    rocksdb::Iterator* it = _db->NewIterator(rocksdb::ReadOptions());
-    for(it->SeekToFirst(); it->Valid(); it->Next())
+    std::vector<rocksdb::ColumnFamilyHandle*> handles;
+    {
+        std::lock_guard<std::mutex> lock(_columnFamiliesMutex);
+        for(auto& cf : _columnFamilies)
+            handles.push_back(cf.second);
+    }
+    if ( handles.empty() )
+        handles.push_back(_db->DefaultColumnFamily());
+
+    for(auto handle : handles)
     {
-        _db->Delete(rocksdb::WriteOptions(), it->key());
+        rocksdb::Iterator* it = _db->NewIterator(rocksdb::ReadOptions(), handle);
+        for(it->SeekToFirst(); it->Valid(); it->Next())
+        {
+            _db->Delete(rocksdb::WriteOptions(), handle, it->key());
+        }
+        delete it;
     }
 
     return true;
 }
+
+Config
+RocksDBCacheImpl::getStatistics() const
+{
+    Config conf = _tracker->getStatistics();
+    conf.set("path", _rootPath);
+    conf.set("column_family_per_bin", _options.columnFamilyPerBin().value());
+
+    std::string value;
+    if ( _db && _db->GetProperty("rocksdb.estimate-num-keys", &value) )
+        conf.set("estimated_num_keys", value);
+    if ( _db && _db->GetProperty("rocksdb.cur-size-all-mem-tables", &value) )
+        conf.set("memtable_bytes", value);
+
+    return conf;
+}
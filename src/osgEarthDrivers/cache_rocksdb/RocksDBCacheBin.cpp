@@ -23,6 +23,7 @@
 #include <osgDB/Registry>
 #include <rocksdb/write_batch.h>
 #include <string>
+#include <algorithm>
 
 using namespace osgEarth;
 using namespace osgEarth::Threading;
@@ -79,13 +80,20 @@ namespace
 #define TIME_FIELD "rocksdb.time"
 
 
-RocksDBCacheBin::RocksDBCacheBin(const std::string& binID,
-                                 rocksdb::DB*       db,
-                                 Tracker*           tracker) :
+RocksDBCacheBin::RocksDBCacheBin(const std::string&           binID,
+                                 rocksdb::DB*                 db,
+                                 rocksdb::ColumnFamilyHandle* columnFamily,
+                                 const RocksDBCacheOptions&   options,
+                                 Tracker*                     tracker) :
 osgEarth::CacheBin( binID ),
 _db               ( db ),
+_cf               ( columnFamily ),
 _tracker          ( tracker ),
-_debug            ( false )
+_debug            ( false ),
+_batchBytes       ( options.writeBatchBytes().value() ),
+_batchPeriodMs    ( std::max(options.writeBatchPeriod().value(), 1u) ),
+_batchCount       ( 0u ),
+_flushThreadDone  ( false )
 {
     // reader to parse data:
     _rw = osgDB::Registry::instance()->getReaderWriterForExtension( "osgb" );
@@ -93,11 +101,154 @@ _debug            ( false )
     
     if ( ::getenv("OSGEARTH_CACHE_DEBUG") )
         _debug = true;
+
+    if ( _cf == nullptr && _db != nullptr )
+        _cf = _db->DefaultColumnFamily();
+
+    // overwrite_key=true so the latest write to a key is the one we read back
+    if ( _batchBytes > 0u )
+        _batch.reset(new rocksdb::WriteBatchWithIndex(rocksdb::BytewiseComparator(), 0, true));
 }
 
 RocksDBCacheBin::~RocksDBCacheBin()
 {
-    // nop
+    stopFlushThread();
+    flush();
+}
+
+void
+RocksDBCacheBin::close()
+{
+    stopFlushThread();
+    flush();
+
+    std::lock_guard<std::mutex> lock(_batchMutex);
+    _db = 0L;
+    _cf = 0L;
+}
+
+rocksdb::Status
+RocksDBCacheBin::get(const std::string& dbkey, std::string* value)
+{
+    // Records still waiting in the write batch take precedence.
+    // The only deletes that go into the batch are for time-index records,
+    // which are never read by key, so NotFound here is reliable.
+    if ( _batchCount > 0u )
+    {
+        std::lock_guard<std::mutex> lock(_batchMutex);
+        if ( _batchCount > 0u )
+        {
+            rocksdb::Status status = _batch->GetFromBatch(_cf, rocksdb::DBOptions(), dbkey, value);
+            if ( status.ok() )
+                return status;
+        }
+    }
+
+    return _db->Get( rocksdb::ReadOptions(), _cf, dbkey, value );
+}
+
+bool
+RocksDBCacheBin::apply(const std::function<void(rocksdb::WriteBatchBase&)>& build)
+{
+    if ( !_batch )
+    {
+        rocksdb::WriteBatch batch;
+        build(batch);
+        return _db->Write( rocksdb::WriteOptions(), &batch ).ok();
+    }
+
+    startFlushThread();
+
+    std::lock_guard<std::mutex> lock(_batchMutex);
+
+    if ( _batchCount == 0u )
+        _batchStart = std::chrono::steady_clock::now();
+
+    build(*_batch);
+    ++_batchCount;
+    ++_tracker->batchedWrites;
+
+    if ( _batch->GetWriteBatch()->GetDataSize() >= _batchBytes )
+    {
+        return flushLocked();
+    }
+
+    return true;
+}
+
+bool
+RocksDBCacheBin::flush()
+{
+    if ( !_batch )
+        return true;
+
+    std::lock_guard<std::mutex> lock(_batchMutex);
+    return flushLocked();
+}
+
+bool
+RocksDBCacheBin::flushLocked()
+{
+    if ( _batchCount == 0u || !_db )
+        return true;
+
+    rocksdb::Status status = _db->Write( rocksdb::WriteOptions(), _batch->GetWriteBatch() );
+    if ( !status.ok() )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": FAILED to commit " << (unsigned)_batchCount
+            << " batched write(s); msg = \"" << status.ToString() << "\"" << std::endl;
+    }
+    else if ( _debug )
+    {
+        OE_NOTICE << LC << "Bin " << getID() << ": committed " << (unsigned)_batchCount
+            << " batched write(s)" << std::endl;
+    }
+
+    _batch->Clear();
+    _batchCount = 0u;
+    ++_tracker->batchFlushes;
+    return status.ok();
+}
+
+void
+RocksDBCacheBin::stopFlushThread()
+{
+    if ( _flushThread.joinable() )
+    {
+        {
+            std::lock_guard<std::mutex> lock(_batchMutex);
+            _flushThreadDone = true;
+        }
+        _flushCondition.notify_all();
+        _flushThread.join();
+    }
+}
+
+void
+RocksDBCacheBin::startFlushThread()
+{
+    // Flushes batches that sit around longer than the batch period
+    // because writes have slowed down or stopped.
+    std::call_once(_flushThreadOnce, [this]()
+    {
+        _flushThread = std::thread([this]()
+        {
+            setThreadName("oe.rocksdb.flush");
+            const auto period = std::chrono::milliseconds(_batchPeriodMs);
+
+            std::unique_lock<std::mutex> lock(_batchMutex);
+            while ( !_flushThreadDone )
+            {
+                _flushCondition.wait_for(lock, period);
+
+                if ( _batchCount > 0u &&
+                     std::chrono::steady_clock::now() - _batchStart >= period )
+                {
+                    flushLocked();
+                }
+            }
+        });
+    });
 }
 
 bool
@@ -172,6 +323,12 @@ RocksDBCacheBin::dataEnd() const
     return "d" + SEP + getID() + SEP + "\xff";
 }
 
+std::string
+RocksDBCacheBin::keyFromDataKey(const std::string& datakey) const
+{
+    return datakey.substr(dataBegin().size());
+}
+
 std::string
 RocksDBCacheBin::metaKey(const std::string& key) const
 {
@@ -249,11 +406,10 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
 
     Config metadata;
     rocksdb::Status status;
-    rocksdb::ReadOptions ro;
 
     // first read the metadata record.
     std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
+    status = get( metaKey(key), &metavalue );
     TimeStamp lastModified = (TimeStamp)0;
     if ( status.ok() )
     {        
@@ -265,7 +421,7 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
     // next read the data record.
     std::string datakey = dataKey(key);
     std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
+    status = get( datakey, &datavalue );
     if ( !status.ok() )
     {
         // main record not found for some reason.
@@ -372,24 +528,27 @@ RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const
     if (objWriteOK)
     {
         DateTime now;
-        rocksdb::WriteBatch batch;
 
-        // write the data:
         data = datastream.str();
         if ( _tracker->seed().isSet() )
             blend(data, _tracker->seed().value());
-        batch.Put( dataKey(key), data );
 
-        // write the timestamp index:
-        batch.Put( timeKey(now, key), binDataKeyTuple(key) );
-
-        // write the metadata:
         Config metadata(meta);
         metadata.set( TIME_FIELD, now.asCompactISO8601() );
-        encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
+        std::string metavalue;
+        encodeMeta( metadata, metavalue );
+
+        objWriteOK = apply([&](rocksdb::WriteBatchBase& batch)
+        {
+            // write the data:
+            batch.Put( _cf, dataKey(key), data );
 
-        objWriteOK = _db->Write( rocksdb::WriteOptions(), &batch ).ok();
+            // write the timestamp index:
+            batch.Put( _cf, timeKey(now, key), binDataKeyTuple(key) );
+
+            // write the metadata:
+            batch.Put( _cf, metaKey(key), metavalue );
+        });
 
         if ( objWriteOK )
         {
@@ -456,11 +615,10 @@ RocksDBCacheBin::getRecordStatus(const std::string& key)
         return STATUS_NOT_FOUND;
 
     rocksdb::Status status;
-    rocksdb::ReadOptions ro;
 
     // read the metadata record.
     std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
+    status = get( metaKey(key), &metavalue );
     if ( status.ok() )
     {        
         return STATUS_OK;
@@ -471,15 +629,78 @@ RocksDBCacheBin::getRecordStatus(const std::string& key)
     }
 }
 
+void
+RocksDBCacheBin::getRecordStatusBatch(const std::vector<std::string>& keys,
+                                      std::vector<RecordStatus>& output)
+{
+    output.assign(keys.size(), STATUS_NOT_FOUND);
+
+    if ( keys.empty() || !binValidForReading() )
+        return;
+
+    std::vector<std::string> metakeys;
+    metakeys.reserve(keys.size());
+    for(auto& key : keys)
+        metakeys.emplace_back(metaKey(key));
+
+    // Records still waiting in the write batch count as found. Look them up
+    // there instead of committing the batch, so that interleaving status
+    // checks with writes (e.g. while seeding) doesn't defeat the batching.
+    // As in get(), NotFound from the batch is reliable for metadata keys.
+    std::vector<unsigned> misses;
+    misses.reserve(keys.size());
+    if ( _batchCount > 0u )
+    {
+        std::lock_guard<std::mutex> lock(_batchMutex);
+        std::string value;
+        for(unsigned i = 0; i < metakeys.size(); ++i)
+        {
+            if ( _batchCount > 0u && _batch->GetFromBatch(_cf, rocksdb::DBOptions(), metakeys[i], &value).ok() )
+                output[i] = STATUS_OK;
+            else
+                misses.push_back(i);
+        }
+    }
+    else
+    {
+        for(unsigned i = 0; i < metakeys.size(); ++i)
+            misses.push_back(i);
+    }
+
+    if ( misses.empty() )
+        return;
+
+    // everything else in a single MultiGet
+    std::vector<rocksdb::Slice> slices;
+    slices.reserve(misses.size());
+    for(auto i : misses)
+        slices.emplace_back(metakeys[i]);
+
+    std::vector<rocksdb::ColumnFamilyHandle*> cfs(slices.size(), _cf);
+    std::vector<std::string> values;
+
+    std::vector<rocksdb::Status> statuses = _db->MultiGet(
+        rocksdb::ReadOptions(), cfs, slices, &values);
+
+    for(unsigned i = 0; i < statuses.size(); ++i)
+    {
+        if ( statuses[i].ok() )
+            output[misses[i]] = STATUS_OK;
+    }
+}
+
 bool
 RocksDBCacheBin::remove(const std::string& key)
 {
     if ( !binValidForReading() )
         return false;
 
+    // deletes bypass the write batch, so commit anything pending first.
+    flush();
+
     // first read in the time from the metadata record.
     std::string metavalue;
-    if ( _db->Get(rocksdb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
+    if ( _db->Get(rocksdb::ReadOptions(), _cf, metaKey(key), &metavalue).ok() == false )
         return false;
 
     Config metadata;
@@ -487,9 +708,9 @@ RocksDBCacheBin::remove(const std::string& key)
     DateTime t(metadata.value(TIME_FIELD));
 
     rocksdb::WriteBatch batch;
-    batch.Delete( dataKey(key) );
-    batch.Delete( metaKey(key) );
-    batch.Delete( timeKey(t, key) );
+    batch.Delete( _cf, dataKey(key) );
+    batch.Delete( _cf, metaKey(key) );
+    batch.Delete( _cf, timeKey(t, key) );
         
     rocksdb::Status status = _db->Write(rocksdb::WriteOptions(), &batch);
     if ( !status.ok() )
@@ -513,29 +734,30 @@ RocksDBCacheBin::touch(const std::string& key)
 
     // first read in the time from the metadata record.
     std::string metavalue;
-    if ( _db->Get(rocksdb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
+    if ( get(metaKey(key), &metavalue).ok() == false )
         return false;
 
     Config metadata;
     decodeMeta(metavalue, metadata);
     DateTime oldtime(metadata.value(TIME_FIELD));
-        
-    rocksdb::WriteBatch batch;
 
-    // In a transaction, update the metadata record with the current time.
     std::string newtime = DateTime().asCompactISO8601();
     metadata.set(TIME_FIELD, newtime);
     encodeMeta(metadata, metavalue);
-    batch.Put(metaKey(key), metavalue);
 
-    // ...remove the old time index record:
-    batch.Delete( timeKey(oldtime, key) );
+    // In a transaction, update the metadata record with the current time.
+    bool ok = apply([&](rocksdb::WriteBatchBase& batch)
+    {
+        batch.Put( _cf, metaKey(key), metavalue );
 
-    // ...and write a new time index record.
-    batch.Put( timeKey(newtime, key), binDataKeyTuple(key) );
+        // ...remove the old time index record:
+        batch.Delete( _cf, timeKey(oldtime, key) );
 
-    rocksdb::Status status = _db->Write(rocksdb::WriteOptions(), &batch);
-    if ( !status.ok() )
+        // ...and write a new time index record.
+        batch.Put( _cf, timeKey(newtime, key), binDataKeyTuple(key) );
+    });
+
+    if ( !ok )
     {
         OE_WARN << LC << "Failed to touch (" << key << ") in bin " << getID() << std::endl;
     }
@@ -543,7 +765,7 @@ RocksDBCacheBin::touch(const std::string& key)
     {
         OE_NOTICE << LC << "Bin " << getID() << ": touch (" << key << ")\n";
     }
-    return status.ok();
+    return ok;
 }
 
 bool
@@ -552,16 +774,17 @@ RocksDBCacheBin::clear()
     if ( !binValidForWriting() )
         return false;
     
+    flush();
+
     rocksdb::WriteOptions wo;
     std::string binphrase = binPhrase();
-    rocksdb::WriteBatch batch;
-    rocksdb::Iterator* i = _db->NewIterator(rocksdb::ReadOptions());
+    rocksdb::Iterator* i = _db->NewIterator(rocksdb::ReadOptions(), _cf);
     for(i->SeekToFirst(); i->Valid(); i->Next())
     {
         std::string key = i->key().ToString();
         if ( key.find(binphrase) != std::string::npos )
         {
-            _db->Delete( wo, i->key() );
+            _db->Delete( wo, _cf, i->key() );
         }
     }
     delete i;
@@ -580,8 +803,10 @@ RocksDBCacheBin::compact()
     if ( !binValidForWriting() )
         return false;
 
+    flush();
+
     // This could take a while.
-    _db->CompactRange({}, nullptr, nullptr);
+    _db->CompactRange({}, _cf, nullptr, nullptr);
 
     return false;
 }
@@ -592,17 +817,173 @@ RocksDBCacheBin::getStorageSize()
     if ( !binValidForReading() )
         return false;
 
-    //Note: doesn't work..
+    // The range bounds must outlive the Range objects (which hold Slices).
+    std::string bounds[6] = {
+        dataBegin(), dataEnd(), metaBegin(), metaEnd(), timeBegin(), timeEnd() };
+
     rocksdb::Range ranges[3];
     uint64_t       sizes[3];
 
-    ranges[0] = rocksdb::Range(dataBegin(), dataEnd());
-    ranges[1] = rocksdb::Range(metaBegin(), metaEnd());
-    ranges[2] = rocksdb::Range(timeBegin(), timeEnd());
+    ranges[0] = rocksdb::Range(bounds[0], bounds[1]);
+    ranges[1] = rocksdb::Range(bounds[2], bounds[3]);
+    ranges[2] = rocksdb::Range(bounds[4], bounds[5]);
     sizes[0] = sizes[1] = sizes[2] = 0;
 
-    _db->GetApproximateSizes( ranges, 3, sizes );
-    return sizes[0] + sizes[1] + sizes[2];
+    // include the memtables so that recent writes are counted too.
+    rocksdb::SizeApproximationOptions sao;
+    sao.include_memtables = true;
+    sao.include_files = true;
+    _db->GetApproximateSizes( sao, _cf, ranges, 3, sizes );
+
+    uint64_t total = sizes[0] + sizes[1] + sizes[2];
+
+    if ( _batchCount > 0u )
+    {
+        std::lock_guard<std::mutex> lock(_batchMutex);
+        total += _batch->GetWriteBatch()->GetDataSize();
+    }
+
+    return (unsigned)std::min(total, (uint64_t)UINT_MAX);
+}
+
+Config
+RocksDBCacheBin::getStatistics()
+{
+    Config conf = _tracker->getStatistics();
+    conf.set("bin", getID());
+    conf.set("bin_size_bytes", getStorageSize());
+    conf.set("pending_writes", (unsigned)_batchCount);
+
+    std::string estimate;
+    if ( _db && _db->GetProperty(_cf, "rocksdb.estimate-num-keys", &estimate) )
+        conf.set("estimated_num_keys", estimate);
+
+    return conf;
+}
+
+unsigned
+RocksDBCacheBin::readPrefix(const std::string&        keyPrefix,
+                            const osgDB::Options*     dbo,
+                            const PrefixReadCallback& callback)
+{
+    if ( !binValidForReading() || !callback )
+        return 0u;
+
+    flush();
+
+    ObjectReader reader(_rw.get(), dbo);
+
+    // Data and metadata records share the same key suffix, so we can
+    // walk the two ranges in lockstep instead of doing a Get per record.
+    std::string dataLower = dataKey(keyPrefix);
+    std::string dataUpper = dataLower + "\xff";
+    std::string metaLower = metaKey(keyPrefix);
+    std::string metaUpper = metaLower + "\xff";
+    rocksdb::Slice dataUpperSlice(dataUpper), metaUpperSlice(metaUpper);
+
+    rocksdb::ReadOptions dataRO, metaRO;
+    dataRO.iterate_upper_bound = &dataUpperSlice;
+    metaRO.iterate_upper_bound = &metaUpperSlice;
+    std::unique_ptr<rocksdb::Iterator> data(_db->NewIterator(dataRO, _cf));
+    std::unique_ptr<rocksdb::Iterator> meta(_db->NewIterator(metaRO, _cf));
+
+    unsigned count = 0u;
+    unsigned prefixSize = metaBegin().size();
+    meta->Seek(metaLower);
+
+    for(data->Seek(dataLower); data->Valid(); data->Next())
+    {
+        std::string key = keyFromDataKey(data->key().ToString());
+
+        Config metadata;
+        TimeStamp lastModified = (TimeStamp)0;
+        while ( meta->Valid() && meta->key().ToString().substr(prefixSize) < key )
+            meta->Next();
+        if ( meta->Valid() && meta->key().ToString().substr(prefixSize) == key )
+        {
+            decodeMeta(meta->value().ToString(), metadata);
+            lastModified = DateTime(metadata.value(TIME_FIELD)).asTimeStamp();
+        }
+
+        std::string datavalue = data->value().ToString();
+        if ( _tracker->seed().isSet() )
+            unblend(datavalue, _tracker->seed().value());
+
+        std::istringstream datastream(datavalue);
+        osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+
+        ReadResult rr = r.success() ?
+            ReadResult(r.getObject(), metadata) :
+            ReadResult(ReadResult::RESULT_READER_ERROR);
+        rr.setLastModifiedTime(lastModified);
+
+        ++count;
+        if ( callback(key, rr) == false )
+            break;
+    }
+
+    _tracker->prefixReads += count;
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Bin " << getID() << ": read " << count
+            << " record(s) with prefix (" << keyPrefix << ")\n";
+    }
+
+    return count;
+}
+
+unsigned
+RocksDBCacheBin::removePrefix(const std::string& keyPrefix)
+{
+    if ( !binValidForWriting() )
+        return 0u;
+
+    flush();
+
+    std::string metaLower = metaKey(keyPrefix);
+    std::string metaUpper = metaLower + "\xff";
+    rocksdb::Slice metaUpperSlice(metaUpper);
+    rocksdb::ReadOptions ro;
+    ro.iterate_upper_bound = &metaUpperSlice;
+
+    // Time-index records are keyed by time, so we have to visit the
+    // metadata records to find them. Data and metadata go by range.
+    rocksdb::WriteBatch batch;
+    unsigned count = 0u;
+    unsigned prefixSize = metaBegin().size();
+
+    std::unique_ptr<rocksdb::Iterator> meta(_db->NewIterator(ro, _cf));
+    for(meta->Seek(metaLower); meta->Valid(); meta->Next())
+    {
+        Config metadata;
+        decodeMeta(meta->value().ToString(), metadata);
+        DateTime t(metadata.value(TIME_FIELD));
+        batch.Delete( _cf, timeKey(t, meta->key().ToString().substr(prefixSize)) );
+        ++count;
+    }
+
+    std::string dataLower = dataKey(keyPrefix);
+    batch.DeleteRange( _cf, dataLower, dataLower + "\xff" );
+    batch.DeleteRange( _cf, metaLower, metaUpper );
+
+    rocksdb::Status status = _db->Write(rocksdb::WriteOptions(), &batch);
+    if ( !status.ok() )
+    {
+        OE_WARN << LC << "Failed to remove prefix (" << keyPrefix << ") from bin " << getID()
+            << "; msg = \"" << status.ToString() << "\"" << std::endl;
+        return 0u;
+    }
+
+    _tracker->prefixRemovals += count;
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Bin " << getID() << ": removed " << count
+            << " record(s) with prefix (" << keyPrefix << ")\n";
+    }
+
+    return count;
 }
 
 Config
@@ -614,7 +995,7 @@ RocksDBCacheBin::readMetadata()
     std::lock_guard<std::mutex> exclusiveLock( _rwMutex );
 
     std::string binvalue;
-    rocksdb::Status status = _db->Get(rocksdb::ReadOptions(), binKey(), &binvalue);
+    rocksdb::Status status = _db->Get(rocksdb::ReadOptions(), _cf, binKey(), &binvalue);
     if ( !status.ok() )
         return Config();
 
@@ -638,7 +1019,7 @@ RocksDBCacheBin::writeMetadata(const Config& conf)
     std::string value;
     encodeMeta(mutableConf, value);
 
-    if ( _db->Put(rocksdb::WriteOptions(), binKey(), value).ok() == false )
+    if ( _db->Put(rocksdb::WriteOptions(), _cf, binKey(), value).ok() == false )
     {
         OE_WARN << LC << "Failed to write metadata record for bin (" << getID() << ")" << std::endl;
         return false;
@@ -653,14 +1034,22 @@ RocksDBCacheBin::purgeOldest(unsigned maxnum)
     if ( !binValidForWriting() )
         return false;
 
-    rocksdb::Iterator* it = _db->NewIterator(rocksdb::ReadOptions());
+    // the time index must be up to date before we walk it.
+    flush();
 
-    unsigned count = 0;
     std::string limit = timeEndGlobal();
+    rocksdb::Slice limitSlice(limit);
+    rocksdb::ReadOptions ro;
+    ro.iterate_upper_bound = &limitSlice;
+
+    rocksdb::Iterator* it = _db->NewIterator(ro, _cf);
+
+    unsigned count = 0;
 
-    // note: this will delete records NOT OF THIS BIN as well!
+    // note: unless each bin has its own column family, 
+    // this will delete records NOT OF THIS BIN as well!
     for(it->Seek(timeBeginGlobal());
-        count < maxnum && it->Valid() && it->key().ToString() < limit;
+        count < maxnum && it->Valid();
         it->Next(), ++count )
     {
         if ( !it->status().ok() )
@@ -671,9 +1060,9 @@ RocksDBCacheBin::purgeOldest(unsigned maxnum)
         // doing this in a WriteBatch did not work. The size of the
         // database would never go down.
         rocksdb::WriteOptions wo;
-        _db->Delete( wo, dataKeyFromTuple(tuple) );
-        _db->Delete( wo, metaKeyFromTuple(tuple) );
-        _db->Delete( wo, it->key() );
+        _db->Delete( wo, _cf, dataKeyFromTuple(tuple) );
+        _db->Delete( wo, _cf, metaKeyFromTuple(tuple) );
+        _db->Delete( wo, _cf, it->key() );
     }
 
     delete it;
@@ -0,0 +1,1484 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "TilePackCache"
+#include <osgEarth/Cache>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Threading>
+#include <osgEarth/URI>
+#include <osgEarth/FileUtils>
+#include <osgEarth/Registry>
+#include <osgEarth/DateTime>
+#include <osgEarth/Metrics>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <osgDB/Registry>
+#include <osgDB/ObjectWrapper>
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#ifdef _WIN32
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#   include <io.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+using namespace osgEarth::Threading;
+
+#define OSG_FORMAT "osgb"
+
+#define SEGMENT_PREFIX "pack_"
+#define SEGMENT_EXT    ".oetp"
+#define INDEX_FILE     "pack.index"
+#define INDEX_VERSION  2u
+
+//------------------------------------------------------------------------
+
+#undef  LC
+#define LC "[TilePackCache] "
+
+namespace
+{
+    // Segment files are a sequence of records, each starting on a
+    // RECORD_ALIGN boundary:
+    //
+    //   RecordHeader | key | metadata (JSON) | pad | payload | pad
+    //
+    // The payload also starts on a RECORD_ALIGN boundary so that raw
+    // image data can be handed to osg::Image straight from the mapping.
+    // Values are stored in native byte order.
+
+    const uint32_t RECORD_MAGIC = 0x5054454f; // "OETP"
+    const uint64_t RECORD_ALIGN = 16u;
+
+    enum RecordType : uint8_t
+    {
+        RECORD_TOMBSTONE  = 0,  // key was removed
+        RECORD_RAW_IMAGE  = 1,  // ImageHeader followed by pixels
+        RECORD_OSGB_IMAGE = 2,  // image serialized with the osgb plugin
+        RECORD_OSGB_OBJECT = 3, // object serialized with the osgb plugin
+        RECORD_OSGB_NODE  = 4   // node serialized with the osgb plugin
+    };
+
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint8_t  type;
+        uint8_t  reserved0[3];
+        uint32_t keySize;
+        uint32_t metaSize;
+        uint64_t dataSize;
+        int64_t  timestamp;     // last-modified time; rewritten in place by touch()
+        uint32_t dataOffset;    // from the start of the record to the payload
+        uint32_t reserved1;
+    };
+    static_assert(sizeof(RecordHeader) == 40, "RecordHeader layout changed");
+
+    struct ImageHeader
+    {
+        int32_t  s, t, r;
+        uint32_t internalFormat;
+        uint32_t pixelFormat;
+        uint32_t dataType;
+        uint32_t packing;
+        int32_t  rowLength;
+        uint8_t  reserved[16];
+    };
+    static_assert(sizeof(ImageHeader) == 48, "ImageHeader layout changed");
+
+    inline uint64_t align(uint64_t value)
+    {
+        return (value + RECORD_ALIGN - 1u) & ~(RECORD_ALIGN - 1u);
+    }
+
+    inline uint64_t recordSize(const RecordHeader& h)
+    {
+        return align((uint64_t)h.dataOffset + h.dataSize);
+    }
+
+    bool truncateFile(std::FILE* file, uint64_t size)
+    {
+#ifdef _WIN32
+        return _chsize_s(_fileno(file), (__int64)size) == 0;
+#else
+        return ::ftruncate(::fileno(file), (off_t)size) == 0;
+#endif
+    }
+
+    bool seekFile(std::FILE* file, uint64_t offset)
+    {
+#ifdef _WIN32
+        return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+        return ::fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+    }
+
+    /**
+     * Read-only view of the first "size" bytes of a file.
+     * The mapping is private (copy-on-write), so callers may modify the
+     * memory (for example, an image handed out without copying) without
+     * touching the file.
+     */
+    class MappedFile : public osg::Referenced
+    {
+    public:
+        MappedFile(const std::string& path, uint64_t size) :
+            _data(nullptr), _size(0u)
+        {
+            if (size == 0u)
+                return;
+
+#ifdef _WIN32
+            HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return;
+            HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_WRITECOPY,
+                (DWORD)(size >> 32), (DWORD)(size & 0xffffffff), nullptr);
+            ::CloseHandle(file);
+            if (mapping == nullptr)
+                return;
+            void* ptr = ::MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, (SIZE_T)size);
+            ::CloseHandle(mapping);
+            if (ptr == nullptr)
+                return;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            void* ptr = ::mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (ptr == MAP_FAILED)
+                return;
+#endif
+            _data = static_cast<unsigned char*>(ptr);
+            _size = size;
+        }
+
+        bool valid() const { return _data != nullptr; }
+        unsigned char* data() const { return _data; }
+        uint64_t size() const { return _size; }
+
+    protected:
+        virtual ~MappedFile()
+        {
+            if (_data)
+            {
+#ifdef _WIN32
+                ::UnmapViewOfFile(_data);
+#else
+                ::munmap(_data, (size_t)_size);
+#endif
+            }
+        }
+
+    private:
+        unsigned char* _data;
+        uint64_t _size;
+    };
+
+    /**
+     * Image whose pixels live in a mapped segment. Holds a reference
+     * to the mapping so it stays valid for the lifetime of the image.
+     */
+    class MappedImage : public osg::Image
+    {
+    public:
+        MappedImage(MappedFile* mapping) : _mapping(mapping) { }
+
+    protected:
+        virtual ~MappedImage() { }
+
+        osg::ref_ptr<MappedFile> _mapping;
+    };
+
+    //! Read-only streambuf over a block of memory, so the osgb plugin
+    //! can deserialize straight from the mapping.
+    struct MemoryStreamBuf : public std::streambuf
+    {
+        MemoryStreamBuf(const unsigned char* data, uint64_t size)
+        {
+            char* begin = reinterpret_cast<char*>(const_cast<unsigned char*>(data));
+            setg(begin, begin, begin + size);
+        }
+
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+        {
+            char* target =
+                dir == std::ios_base::beg ? eback() + off :
+                dir == std::ios_base::cur ? gptr() + off :
+                egptr() + off;
+            if (target < eback() || target > egptr())
+                return pos_type(off_type(-1));
+            setg(eback(), target, egptr());
+            return pos_type(target - eback());
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+        {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+
+    /**
+     * One append-only segment file.
+     */
+    class Segment : public osg::Referenced
+    {
+    public:
+        Segment(unsigned id, const std::string& path) :
+            _id(id), _path(path), _file(nullptr), _size(0u) { }
+
+        bool open(bool create)
+        {
+            _file = std::fopen(_path.c_str(), "r+b");
+            if (!_file && create)
+                _file = std::fopen(_path.c_str(), "w+b");
+            if (!_file)
+                return false;
+
+            std::fseek(_file, 0, SEEK_END);
+#ifdef _WIN32
+            _size = (uint64_t)_ftelli64(_file);
+#else
+            _size = (uint64_t)::ftello(_file);
+#endif
+            return true;
+        }
+
+        void close()
+        {
+            if (_file)
+            {
+                std::fclose(_file);
+                _file = nullptr;
+            }
+            std::lock_guard<std::mutex> lock(_mappingMutex);
+            _mapping = nullptr;
+        }
+
+        unsigned id() const { return _id; }
+        const std::string& path() const { return _path; }
+        uint64_t size() const { return _size; }
+        std::FILE* file() const { return _file; }
+
+        //! Writes a block at the end of the segment. Caller serializes appends.
+        bool append(const void* data, uint64_t size)
+        {
+            if (size == 0u)
+                return true;
+            if (std::fwrite(data, 1, (size_t)size, _file) != (size_t)size)
+                return false;
+            _size += size;
+            return true;
+        }
+
+        //! Positions the write pointer at the end of the segment.
+        bool seekEnd()
+        {
+            return seekFile(_file, _size);
+        }
+
+        //! Discards everything past "size" (a torn write at the tail).
+        bool truncate(uint64_t size)
+        {
+            std::fflush(_file);
+            if (!truncateFile(_file, size))
+                return false;
+            _size = size;
+            return true;
+        }
+
+        //! Returns a mapping that covers at least the first "end" bytes,
+        //! remapping the file if it has grown since the last mapping.
+        osg::ref_ptr<MappedFile> map(uint64_t end)
+        {
+            std::lock_guard<std::mutex> lock(_mappingMutex);
+            if (!_mapping.valid() || _mapping->size() < end)
+            {
+                if (end > _size)
+                    return nullptr;
+
+                osg::ref_ptr<MappedFile> mapping = new MappedFile(_path, _size);
+                if (!mapping->valid())
+                    return nullptr;
+                _mapping = mapping;
+            }
+            return _mapping;
+        }
+
+    protected:
+        virtual ~Segment()
+        {
+            close();
+        }
+
+    private:
+        unsigned _id;
+        std::string _path;
+        std::FILE* _file;
+        std::atomic<uint64_t> _size;
+        std::mutex _mappingMutex;
+        osg::ref_ptr<MappedFile> _mapping;
+    };
+
+    struct IndexEntry
+    {
+        unsigned segment;   // position in the bin's segment list
+        uint64_t offset;    // start of the record in the segment
+        uint64_t size;      // aligned size of the record
+        int64_t  timestamp;
+    };
+
+    class TilePackCacheBin;
+
+    /**
+     * Cache that packs records into segment files.
+     */
+    class TilePackCache : public Cache
+    {
+    public:
+        TilePackCache() { } // unused
+        TilePackCache( const TilePackCache& rhs, const osg::CopyOp& op ) { } // unused
+        META_Object( osgEarth, TilePackCache );
+
+        TilePackCache( const CacheOptions& options );
+
+    public: // Cache interface
+
+        CacheBin* addBin( const std::string& binID ) override;
+
+        CacheBin* getOrCreateDefaultBin() override;
+
+        off_t getApproximateSize() const override;
+
+        bool compact() override;
+
+        bool clear() override;
+
+    protected:
+        std::string _rootPath;
+        TilePackCacheOptions _options;
+
+        // opening a bin scans its segments, so only do it once per bin
+        std::mutex _addBinMutex;
+
+        // every bin we've handed out, for cache-wide operations
+        mutable std::mutex _allBinsMutex;
+        std::vector<osg::ref_ptr<TilePackCacheBin>> _allBins;
+
+        CacheBin* track(CacheBin* bin);
+    };
+
+    /**
+     * Cache bin that lives in its own folder of segment files.
+     */
+    class TilePackCacheBin : public CacheBin
+    {
+    public:
+        TilePackCacheBin(
+            const std::string& binID,
+            const std::string& rootPath,
+            const TilePackCacheOptions& options);
+
+        static bool _s_debug;
+
+    public: // CacheBin interface
+
+        ReadResult readObject(const std::string& key, const osgDB::Options* dbo) override;
+
+        ReadResult readImage(const std::string& key, const osgDB::Options* dbo) override;
+
+        ReadResult readString(const std::string& key, const osgDB::Options* dbo) override;
+
+        bool write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo) override;
+
+        bool remove(const std::string& key) override;
+
+        bool touch(const std::string& key) override;
+
+        RecordStatus getRecordStatus(const std::string& key) override;
+
+        void getRecordStatusBatch(const std::vector<std::string>& keys, std::vector<RecordStatus>& output) override;
+
+        bool clear() override;
+
+        bool compact() override;
+
+        unsigned getStorageSize() override;
+
+    public:
+        uint64_t getTotalBytes() const { return _totalBytes; }
+
+    protected:
+        virtual ~TilePackCacheBin();
+
+        bool open();
+
+        bool loadIndex(std::unordered_map<unsigned, uint64_t>& scanned);
+
+        void dropSegmentsBefore(unsigned id);
+
+        bool saveIndex();
+
+        void scan(unsigned segmentIndex, uint64_t from);
+
+        ReadResult read(const std::string& key, const osgDB::Options* dbo, bool wantImage);
+
+        bool append(
+            const std::string& key,
+            RecordType type,
+            const Config& meta,
+            const void* data,
+            uint64_t dataSize,
+            const ImageHeader* imageHeader);
+
+        Segment* getSegmentForAppend(uint64_t recordSize);
+
+        std::string segmentPath(unsigned id) const;
+
+        std::string _binPath;
+        std::string _indexPath;
+        TilePackCacheOptions _options;
+        bool _ok;
+
+        // record index, and the segments it points into
+        std::unordered_map<std::string, IndexEntry> _index;
+        std::vector<osg::ref_ptr<Segment>> _segments;
+        ReadWriteMutex _indexMutex;
+
+        // Segments with lower IDs were replaced by a compaction or a clear
+        // and are garbage, even if deleting them failed. New segments get
+        // IDs above any file in the folder so they never reopen a leftover.
+        unsigned _firstSegmentID;
+        unsigned _nextSegmentID;
+
+        // serializes appends, touches, checkpoints, and compaction
+        std::mutex _writeMutex;
+        unsigned _writesSinceCheckpoint;
+
+        std::atomic<uint64_t> _totalBytes;
+        std::atomic<uint64_t> _deadBytes;
+
+        // OSG reader-writer used to serialize non-image objects
+        osg::ref_ptr<osgDB::ReaderWriter> _rw;
+    };
+
+    bool TilePackCacheBin::_s_debug = false;
+
+    //------------------------------------------------------------------------
+
+    TilePackCache::TilePackCache(const CacheOptions& options) :
+        Cache(options),
+        _options(options)
+    {
+        // read the root path from ENV is necessary:
+        if ( !_options.rootPath().isSet())
+        {
+            const char* cachePath = ::getenv(OSGEARTH_ENV_CACHE_PATH);
+            if ( cachePath )
+                _options.rootPath() = cachePath;
+        }
+
+        _rootPath = URI( *_options.rootPath(), options.referrer() ).full();
+
+        if (osgDB::makeDirectory(_rootPath) == false)
+        {
+            _status.set(Status::ResourceUnavailable, Stringify()
+                << "Failed to create or access folder \"" << _rootPath << "\"");
+            return;
+        }
+
+        // Force OSG to initialize the wrappers. Failure to do this can result
+        // in a race condition within OSG when the cache is accessed from multiple threads.
+        osgDB::ObjectWrapperManager* owm = osgDB::Registry::instance()->getObjectWrapperManager();
+        owm->findWrapper("osg::Image");
+        owm->findWrapper("osg::HeightField");
+
+        OE_INFO << LC << "Opened a tile pack cache at \"" << _rootPath << "\"\n";
+    }
+
+    CacheBin*
+    TilePackCache::track(CacheBin* bin)
+    {
+        std::lock_guard<std::mutex> lock(_allBinsMutex);
+        auto* tpbin = static_cast<TilePackCacheBin*>(bin);
+        for (auto& existing : _allBins)
+            if (existing.get() == tpbin)
+                return bin;
+        _allBins.push_back(tpbin);
+        return bin;
+    }
+
+    CacheBin*
+    TilePackCache::addBin( const std::string& name )
+    {
+        if (getStatus().isError())
+            return NULL;
+
+        CacheBin* existing = _bins.get(name);
+        if (existing)
+            return existing;
+
+        std::lock_guard<std::mutex> lock(_addBinMutex);
+        existing = _bins.get(name);
+        if (existing)
+            return existing;
+
+        return track(_bins.getOrCreate(name, new TilePackCacheBin(name, _rootPath, _options)));
+    }
+
+    CacheBin*
+    TilePackCache::getOrCreateDefaultBin()
+    {
+        if (getStatus().isError())
+            return NULL;
+
+        static Mutex s_defaultBinMutex;
+        if ( !_defaultBin.valid() )
+        {
+            std::lock_guard<std::mutex> lock( s_defaultBinMutex );
+            if ( !_defaultBin.valid() ) // double-check
+            {
+                _defaultBin = track(new TilePackCacheBin("__default", _rootPath, _options));
+            }
+        }
+        return _defaultBin.get();
+    }
+
+    off_t
+    TilePackCache::getApproximateSize() const
+    {
+        std::lock_guard<std::mutex> lock(_allBinsMutex);
+        uint64_t total = 0u;
+        for (auto& bin : _allBins)
+            total += bin->getTotalBytes();
+        return (off_t)total;
+    }
+
+    bool
+    TilePackCache::compact()
+    {
+        std::vector<osg::ref_ptr<TilePackCacheBin>> bins;
+        {
+            std::lock_guard<std::mutex> lock(_allBinsMutex);
+            bins = _allBins;
+        }
+        bool ok = true;
+        for (auto& bin : bins)
+            ok = bin->compact() && ok;
+        return ok;
+    }
+
+    bool
+    TilePackCache::clear()
+    {
+        std::vector<osg::ref_ptr<TilePackCacheBin>> bins;
+        {
+            std::lock_guard<std::mutex> lock(_allBinsMutex);
+            bins = _allBins;
+        }
+        bool ok = true;
+        for (auto& bin : bins)
+            ok = bin->clear() && ok;
+        return ok;
+    }
+
+    //------------------------------------------------------------------------
+
+    TilePackCacheBin::TilePackCacheBin(
+        const std::string& binID,
+        const std::string& rootPath,
+        const TilePackCacheOptions& options) :
+
+        CacheBin(binID, options.enableNodeCaching().get()),
+        _options(options),
+        _ok(false),
+        _writesSinceCheckpoint(0u),
+        _firstSegmentID(0u),
+        _nextSegmentID(0u),
+        _totalBytes(0u),
+        _deadBytes(0u)
+    {
+        _binPath = osgDB::concatPaths(rootPath, binID);
+        _indexPath = osgDB::concatPaths(_binPath, INDEX_FILE);
+
+        _rw = osgDB::Registry::instance()->getReaderWriterForExtension(OSG_FORMAT);
+
+        _s_debug = ::getenv("OSGEARTH_CACHE_DEBUG") != 0L;
+
+        _ok = _rw.valid() && open();
+    }
+
+    TilePackCacheBin::~TilePackCacheBin()
+    {
+        if (_ok)
+        {
+            std::lock_guard<std::mutex> lock(_writeMutex);
+            if (_writesSinceCheckpoint > 0u)
+                saveIndex();
+        }
+    }
+
+    std::string
+    TilePackCacheBin::segmentPath(unsigned id) const
+    {
+        char buf[32];
+        sprintf(buf, SEGMENT_PREFIX "%06u" SEGMENT_EXT, id);
+        return osgDB::concatPaths(_binPath, buf);
+    }
+
+    bool
+    TilePackCacheBin::open()
+    {
+        if (osgDB::makeDirectory(_binPath) == false)
+        {
+            OE_WARN << LC << "Failed to create cache bin at [" << _binPath << "]" << std::endl;
+            return false;
+        }
+
+        // find the segments, in the order they were written:
+        std::vector<unsigned> ids;
+        for (auto& name : osgDB::getDirectoryContents(_binPath))
+        {
+            if (startsWith(name, SEGMENT_PREFIX) && endsWith(name, SEGMENT_EXT))
+            {
+                std::string number = name.substr(
+                    strlen(SEGMENT_PREFIX),
+                    name.size() - strlen(SEGMENT_PREFIX) - strlen(SEGMENT_EXT));
+                ids.push_back(as<unsigned>(number, 0u));
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+        _nextSegmentID = ids.empty() ? 0u : ids.back() + 1u;
+
+        for (auto id : ids)
+        {
+            osg::ref_ptr<Segment> segment = new Segment(id, segmentPath(id));
+            if (!segment->open(false))
+            {
+                OE_WARN << LC << "Failed to open segment " << segment->path() << std::endl;
+                return false;
+            }
+            _segments.push_back(segment);
+        }
+
+        // The index is a checkpoint. Anything appended after it was saved
+        // is recovered by scanning the tail of each segment.
+        std::unordered_map<unsigned, uint64_t> scanned;
+        if (!loadIndex(scanned))
+        {
+            _index.clear();
+            scanned.clear();
+            _deadBytes = 0u;
+        }
+
+        for (unsigned i = 0; i < _segments.size(); ++i)
+        {
+            auto s = scanned.find(_segments[i]->id());
+            scan(i, s != scanned.end() ? s->second : 0u);
+            _totalBytes += _segments[i]->size();
+        }
+
+        if (_s_debug)
+        {
+            OE_NOTICE << LC << "Bin [" << getID() << "] opened with " << _index.size()
+                << " records in " << _segments.size() << " segments" << std::endl;
+        }
+
+        float threshold = _options.compactionThreshold().get();
+        if (threshold > 0.0f && _totalBytes > 0u &&
+            (float)_deadBytes / (float)_totalBytes > threshold)
+        {
+            compact();
+        }
+
+        return true;
+    }
+
+    bool
+    TilePackCacheBin::loadIndex(std::unordered_map<unsigned, uint64_t>& scanned)
+    {
+        std::ifstream in(_indexPath.c_str(), std::ios::binary);
+        if (!in.is_open())
+            return false;
+
+        char magic[8];
+        uint32_t version = 0u, numSegments = 0u;
+        uint64_t numEntries = 0u, deadBytes = 0u;
+        in.read(magic, 8);
+        in.read((char*)&version, sizeof(version));
+        if (!in.good() || memcmp(magic, "OETPIDX\0", 8) != 0 || version != INDEX_VERSION)
+            return false;
+
+        // The index is saved before the segments it replaces are deleted,
+        // so anything older than its first segment is left over from an
+        // interrupted compaction or clear. Scanning it would resurrect
+        // replaced and removed records.
+        uint32_t firstSegmentID = 0u;
+        in.read((char*)&firstSegmentID, sizeof(firstSegmentID));
+        if (!in.good())
+            return false;
+        dropSegmentsBefore(firstSegmentID);
+
+        // segment id -> position in _segments
+        std::unordered_map<unsigned, unsigned> positions;
+        for (unsigned i = 0; i < _segments.size(); ++i)
+            positions[_segments[i]->id()] = i;
+
+        in.read((char*)&numSegments, sizeof(numSegments));
+        std::vector<unsigned> indexToPosition(numSegments);
+        for (unsigned i = 0; i < numSegments && in.good(); ++i)
+        {
+            uint32_t id = 0u;
+            uint64_t size = 0u;
+            in.read((char*)&id, sizeof(id));
+            in.read((char*)&size, sizeof(size));
+
+            // a segment the index knows about is missing or shorter
+            // than it was, so the index can't be trusted.
+            auto p = positions.find(id);
+            if (p == positions.end() || _segments[p->second]->size() < size)
+                return false;
+
+            indexToPosition[i] = p->second;
+            scanned[id] = size;
+        }
+
+        in.read((char*)&deadBytes, sizeof(deadBytes));
+        in.read((char*)&numEntries, sizeof(numEntries));
+        if (!in.good())
+            return false;
+
+        _index.reserve((size_t)numEntries);
+        std::string key;
+        for (uint64_t i = 0; i < numEntries; ++i)
+        {
+            uint32_t keySize = 0u, segment = 0u;
+            IndexEntry entry;
+            in.read((char*)&keySize, sizeof(keySize));
+            if (!in.good())
+                return false;
+            key.resize(keySize);
+            in.read(&key[0], keySize);
+            in.read((char*)&segment, sizeof(segment));
+            in.read((char*)&entry.offset, sizeof(entry.offset));
+            in.read((char*)&entry.size, sizeof(entry.size));
+            in.read((char*)&entry.timestamp, sizeof(entry.timestamp));
+            if (!in.good() || segment >= numSegments)
+                return false;
+            entry.segment = indexToPosition[segment];
+            _index[key] = entry;
+        }
+
+        _deadBytes = deadBytes;
+        return true;
+    }
+
+    void
+    TilePackCacheBin::dropSegmentsBefore(unsigned id)
+    {
+        _firstSegmentID = id;
+        _nextSegmentID = std::max(_nextSegmentID, id);
+
+        std::vector<osg::ref_ptr<Segment>> kept;
+        for (auto& segment : _segments)
+        {
+            if (segment->id() >= id)
+            {
+                kept.push_back(segment);
+                continue;
+            }
+
+            segment->close();
+            if (::remove(segment->path().c_str()) != 0)
+            {
+                OE_WARN << LC << "Ignoring leftover segment " << segment->path()
+                    << ", which could not be deleted" << std::endl;
+            }
+        }
+        _segments.swap(kept);
+    }
+
+    bool
+    TilePackCacheBin::saveIndex()
+    {
+        // caller holds _writeMutex, so the segment sizes match the index.
+        std::string tempPath = _indexPath + ".tmp";
+        {
+            std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+            if (!out.is_open())
+                return false;
+
+            ScopedReadLock lock(_indexMutex);
+
+            uint32_t version = INDEX_VERSION;
+            uint32_t firstSegmentID = _firstSegmentID;
+            uint32_t numSegments = (uint32_t)_segments.size();
+            uint64_t deadBytes = _deadBytes;
+            uint64_t numEntries = _index.size();
+
+            out.write("OETPIDX\0", 8);
+            out.write((const char*)&version, sizeof(version));
+            out.write((const char*)&firstSegmentID, sizeof(firstSegmentID));
+            out.write((const char*)&numSegments, sizeof(numSegments));
+            for (auto& segment : _segments)
+            {
+                uint32_t id = segment->id();
+                uint64_t size = segment->size();
+                out.write((const char*)&id, sizeof(id));
+                out.write((const char*)&size, sizeof(size));
+            }
+            out.write((const char*)&deadBytes, sizeof(deadBytes));
+            out.write((const char*)&numEntries, sizeof(numEntries));
+            for (auto& i : _index)
+            {
+                uint32_t keySize = (uint32_t)i.first.size();
+                uint32_t segment = i.second.segment;
+                out.write((const char*)&keySize, sizeof(keySize));
+                out.write(i.first.data(), keySize);
+                out.write((const char*)&segment, sizeof(segment));
+                out.write((const char*)&i.second.offset, sizeof(i.second.offset));
+                out.write((const char*)&i.second.size, sizeof(i.second.size));
+                out.write((const char*)&i.second.timestamp, sizeof(i.second.timestamp));
+            }
+            if (!out.good())
+                return false;
+        }
+
+        ::remove(_indexPath.c_str());
+        if (::rename(tempPath.c_str(), _indexPath.c_str()) != 0)
+        {
+            OE_WARN << LC << "Failed to save index for bin [" << getID() << "]" << std::endl;
+            return false;
+        }
+
+        _writesSinceCheckpoint = 0u;
+        return true;
+    }
+
+    void
+    TilePackCacheBin::scan(unsigned segmentIndex, uint64_t from)
+    {
+        Segment* segment = _segments[segmentIndex].get();
+        uint64_t end = segment->size();
+        if (from >= end)
+            return;
+
+        osg::ref_ptr<MappedFile> mapping = segment->map(end);
+        if (!mapping.valid())
+            return;
+
+        uint64_t offset = from;
+        while (offset + sizeof(RecordHeader) <= end)
+        {
+            const RecordHeader* h = reinterpret_cast<const RecordHeader*>(mapping->data() + offset);
+            if (h->magic != RECORD_MAGIC ||
+                h->dataOffset < sizeof(RecordHeader) + h->keySize + h->metaSize ||
+                offset + recordSize(*h) > end)
+            {
+                break;
+            }
+
+            std::string key(reinterpret_cast<const char*>(h + 1), h->keySize);
+            uint64_t size = recordSize(*h);
+
+            auto i = _index.find(key);
+            if (i != _index.end())
+                _deadBytes += i->second.size;
+
+            if (h->type == RECORD_TOMBSTONE)
+            {
+                if (i != _index.end())
+                    _index.erase(i);
+                _deadBytes += size;
+            }
+            else
+            {
+                _index[key] = IndexEntry{ segmentIndex, offset, size, h->timestamp };
+            }
+
+            offset += size;
+        }
+
+        // anything left over is an incomplete write; discard it.
+        if (offset < end)
+        {
+            OE_WARN << LC << "Discarding " << (end - offset) << " bytes of incomplete data at the end of "
+                << segment->path() << std::endl;
+            segment->truncate(offset);
+        }
+    }
+
+    Segment*
+    TilePackCacheBin::getSegmentForAppend(uint64_t size)
+    {
+        uint64_t maxSize = (uint64_t)_options.segmentSizeMB().get() * 1048576u;
+
+        if (_segments.empty() ||
+            (_segments.back()->size() > 0u && _segments.back()->size() + size > maxSize))
+        {
+            unsigned id = _nextSegmentID++;
+            osg::ref_ptr<Segment> segment = new Segment(id, segmentPath(id));
+            if (!segment->open(true))
+            {
+                OE_WARN << LC << "Failed to create segment " << segment->path() << std::endl;
+                return nullptr;
+            }
+
+            ScopedWriteLock lock(_indexMutex);
+            _segments.push_back(segment);
+        }
+
+        return _segments.back().get();
+    }
+
+    bool
+    TilePackCacheBin::append(
+        const std::string& key,
+        RecordType type,
+        const Config& meta,
+        const void* data,
+        uint64_t dataSize,
+        const ImageHeader* imageHeader)
+    {
+        std::string metaString = meta.empty() ? std::string() : meta.toJSON(false);
+
+        RecordHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic = RECORD_MAGIC;
+        h.type = type;
+        h.keySize = (uint32_t)key.size();
+        h.metaSize = (uint32_t)metaString.size();
+        h.dataSize = dataSize + (imageHeader ? sizeof(ImageHeader) : 0u);
+        h.timestamp = (int64_t)DateTime().asTimeStamp();
+        h.dataOffset = (uint32_t)align(sizeof(RecordHeader) + h.keySize + h.metaSize);
+
+        uint64_t size = recordSize(h);
+        static const char zeros[RECORD_ALIGN] = { 0 };
+
+        std::lock_guard<std::mutex> lock(_writeMutex);
+
+        Segment* segment = getSegmentForAppend(size);
+        if (!segment || !segment->seekEnd())
+            return false;
+
+        uint64_t offset = segment->size();
+        uint64_t keyMetaEnd = sizeof(RecordHeader) + h.keySize + h.metaSize;
+
+        bool ok =
+            segment->append(&h, sizeof(h)) &&
+            segment->append(key.data(), key.size()) &&
+            segment->append(metaString.data(), metaString.size()) &&
+            segment->append(zeros, h.dataOffset - keyMetaEnd) &&
+            (imageHeader == nullptr || segment->append(imageHeader, sizeof(ImageHeader))) &&
+            segment->append(data, dataSize) &&
+            segment->append(zeros, size - (h.dataOffset + h.dataSize));
+
+        if (!ok || std::fflush(segment->file()) != 0)
+        {
+            // roll back the partial record so the segment stays consistent.
+            segment->truncate(offset);
+            OE_WARN << LC << "FAILED to write \"" << key << "\" to cache bin [" << getID() << "]" << std::endl;
+            return false;
+        }
+
+        _totalBytes += size;
+
+        {
+            ScopedWriteLock indexLock(_indexMutex);
+            unsigned segmentIndex = (unsigned)_segments.size() - 1u;
+
+            auto i = _index.find(key);
+            if (i != _index.end())
+                _deadBytes += i->second.size;
+
+            if (type == RECORD_TOMBSTONE)
+            {
+                if (i != _index.end())
+                    _index.erase(i);
+                _deadBytes += size;
+            }
+            else
+            {
+                _index[key] = IndexEntry{ segmentIndex, offset, size, h.timestamp };
+            }
+        }
+
+        if (++_writesSinceCheckpoint >= std::max(_options.indexCheckpointInterval().get(), 1u))
+        {
+            saveIndex();
+        }
+
+        return true;
+    }
+
+    ReadResult
+    TilePackCacheBin::read(const std::string& key, const osgDB::Options* dbo, bool wantImage)
+    {
+        OE_PROFILING_ZONE;
+
+        if (!_ok)
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        IndexEntry entry;
+        osg::ref_ptr<Segment> segment;
+        {
+            ScopedReadLock lock(_indexMutex);
+            auto i = _index.find(key);
+            if (i == _index.end())
+                return ReadResult(ReadResult::RESULT_NOT_FOUND);
+            entry = i->second;
+            segment = _segments[entry.segment];
+        }
+
+        osg::ref_ptr<MappedFile> mapping = segment->map(entry.offset + entry.size);
+        if (!mapping.valid())
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        const unsigned char* record = mapping->data() + entry.offset;
+        const RecordHeader* h = reinterpret_cast<const RecordHeader*>(record);
+        if (h->magic != RECORD_MAGIC)
+        {
+            OE_WARN << LC << "Corrupt record for \"" << key << "\" in bin [" << getID() << "]" << std::endl;
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+        }
+
+        Config meta;
+        if (h->metaSize > 0u)
+        {
+            meta.fromJSON(std::string(
+                reinterpret_cast<const char*>(record + sizeof(RecordHeader) + h->keySize),
+                h->metaSize));
+        }
+
+        const unsigned char* payload = record + h->dataOffset;
+        osg::ref_ptr<osg::Object> object;
+
+        if (h->type == RECORD_RAW_IMAGE)
+        {
+            // zero-copy: the image points directly into the mapping.
+            const ImageHeader* ih = reinterpret_cast<const ImageHeader*>(payload);
+            osg::ref_ptr<MappedImage> image = new MappedImage(mapping.get());
+            image->setImage(
+                ih->s, ih->t, ih->r,
+                ih->internalFormat, ih->pixelFormat, ih->dataType,
+                const_cast<unsigned char*>(payload + sizeof(ImageHeader)),
+                osg::Image::NO_DELETE,
+                ih->packing, ih->rowLength);
+            object = image.get();
+        }
+        else if (h->type != RECORD_TOMBSTONE)
+        {
+            MemoryStreamBuf buf(payload, h->dataSize);
+            std::istream in(&buf);
+            osgDB::ReaderWriter::ReadResult r =
+                h->type == RECORD_OSGB_IMAGE ? _rw->readImage(in, dbo) :
+                h->type == RECORD_OSGB_NODE ? _rw->readNode(in, dbo) :
+                _rw->readObject(in, dbo);
+
+            if (!r.success())
+                return ReadResult(r.message());
+
+            object = r.getObject();
+        }
+
+        if (wantImage && dynamic_cast<osg::Image*>(object.get()) == nullptr)
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        if (_s_debug)
+            OE_NOTICE << LC << "Read \"" << key << "\" from cache bin [" << getID() << "]" << std::endl;
+
+        ReadResult rr(object.get(), meta);
+        rr.setLastModifiedTime((TimeStamp)entry.timestamp);
+        return rr;
+    }
+
+    ReadResult
+    TilePackCacheBin::readImage(const std::string& key, const osgDB::Options* dbo)
+    {
+        return read(key, dbo, true);
+    }
+
+    ReadResult
+    TilePackCacheBin::readObject(const std::string& key, const osgDB::Options* dbo)
+    {
+        return read(key, dbo, false);
+    }
+
+    ReadResult
+    TilePackCacheBin::readString(const std::string& key, const osgDB::Options* dbo)
+    {
+        ReadResult r = readObject(key, dbo);
+        if ( r.succeeded() )
+        {
+            if ( r.get<StringObject>() )
+                return r;
+            else
+                return ReadResult("Empty string");
+        }
+        else
+        {
+            return r;
+        }
+    }
+
+    bool
+    TilePackCacheBin::write(
+        const std::string& key,
+        const osg::Object* object,
+        const Config& meta,
+        const osgDB::Options* dbo)
+    {
+        OE_PROFILING_ZONE;
+
+        if (!_ok || !object)
+            return false;
+
+        const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+        const osg::Node* node = dynamic_cast<const osg::Node*>(object);
+
+        if (node && _enableNodeCaching == false)
+            return true;
+
+        // Uncompressed, contiguous images go in raw so they can be
+        // read back without decoding or copying.
+        if (image && !image->isCompressed() && image->isDataContiguous() && image->data())
+        {
+            ImageHeader ih;
+            memset(&ih, 0, sizeof(ih));
+            ih.s = image->s();
+            ih.t = image->t();
+            ih.r = image->r();
+            ih.internalFormat = (uint32_t)image->getInternalTextureFormat();
+            ih.pixelFormat = (uint32_t)image->getPixelFormat();
+            ih.dataType = (uint32_t)image->getDataType();
+            ih.packing = image->getPacking();
+            ih.rowLength = image->getRowLength();
+
+            return append(key, RECORD_RAW_IMAGE, meta, image->data(), image->getTotalSizeInBytes(), &ih);
+        }
+
+        // Everything else goes through the osgb serializer.
+        std::stringstream buf;
+        osgDB::ReaderWriter::WriteResult r;
+        RecordType type;
+
+        if (image)
+        {
+            r = _rw->writeImage(*image, buf, dbo);
+            type = RECORD_OSGB_IMAGE;
+        }
+        else if (node)
+        {
+            r = _rw->writeNode(*node, buf, dbo);
+            type = RECORD_OSGB_NODE;
+        }
+        else
+        {
+            r = _rw->writeObject(*object, buf, dbo);
+            type = RECORD_OSGB_OBJECT;
+        }
+
+        if (!r.success())
+        {
+            OE_WARN << LC << "FAILED to serialize \"" << key << "\" for cache bin [" << getID()
+                << "]; msg = \"" << r.message() << "\"" << std::endl;
+            return false;
+        }
+
+        std::string data = buf.str();
+        return append(key, type, meta, data.data(), data.size(), nullptr);
+    }
+
+    CacheBin::RecordStatus
+    TilePackCacheBin::getRecordStatus(const std::string& key)
+    {
+        ScopedReadLock lock(_indexMutex);
+        return _index.find(key) != _index.end() ? STATUS_OK : STATUS_NOT_FOUND;
+    }
+
+    void
+    TilePackCacheBin::getRecordStatusBatch(
+        const std::vector<std::string>& keys,
+        std::vector<RecordStatus>& output)
+    {
+        output.resize(keys.size());
+        ScopedReadLock lock(_indexMutex);
+        for (unsigned i = 0; i < keys.size(); ++i)
+            output[i] = _index.find(keys[i]) != _index.end() ? STATUS_OK : STATUS_NOT_FOUND;
+    }
+
+    bool
+    TilePackCacheBin::remove(const std::string& key)
+    {
+        if (!_ok || getRecordStatus(key) == STATUS_NOT_FOUND)
+            return false;
+
+        return append(key, RECORD_TOMBSTONE, Config(), nullptr, 0u, nullptr);
+    }
+
+    bool
+    TilePackCacheBin::touch(const std::string& key)
+    {
+        if (!_ok)
+            return false;
+
+        std::lock_guard<std::mutex> lock(_writeMutex);
+
+        IndexEntry entry;
+        {
+            ScopedReadLock indexLock(_indexMutex);
+            auto i = _index.find(key);
+            if (i == _index.end())
+                return false;
+            entry = i->second;
+        }
+
+        // The timestamp is the one field we rewrite in place.
+        // Readers always take it from the index, never the mapping.
+        int64_t now = (int64_t)DateTime().asTimeStamp();
+        Segment* segment = _segments[entry.segment].get();
+        bool ok =
+            seekFile(segment->file(), entry.offset + offsetof(RecordHeader, timestamp)) &&
+            std::fwrite(&now, sizeof(now), 1, segment->file()) == 1 &&
+            std::fflush(segment->file()) == 0;
+
+        if (ok)
+        {
+            ScopedWriteLock indexLock(_indexMutex);
+            auto i = _index.find(key);
+            if (i != _index.end())
+                i->second.timestamp = now;
+        }
+
+        return ok;
+    }
+
+    bool
+    TilePackCacheBin::clear()
+    {
+        if (!_ok)
+            return false;
+
+        std::lock_guard<std::mutex> lock(_writeMutex);
+
+        std::vector<osg::ref_ptr<Segment>> oldSegments;
+        {
+            ScopedWriteLock indexLock(_indexMutex);
+            oldSegments.swap(_segments);
+            _index.clear();
+        }
+        _totalBytes = 0u;
+        _deadBytes = 0u;
+
+        // Commit an empty index that disowns every existing segment before
+        // deleting them, so a segment that can't be deleted stays cleared.
+        _firstSegmentID = _nextSegmentID;
+        if (!saveIndex())
+            ::remove(_indexPath.c_str());
+
+        // Images already handed out keep their segment mapped until they
+        // go away, so on some platforms the files can't be deleted yet.
+        bool ok = true;
+        for (auto& segment : oldSegments)
+        {
+            segment->close();
+            if (::remove(segment->path().c_str()) != 0)
+                ok = false;
+        }
+
+        _writesSinceCheckpoint = 0u;
+
+        if (!ok)
+        {
+            OE_WARN << LC << "Some segment files in bin [" << getID() << "] are still in use and were not deleted" << std::endl;
+        }
+
+        return ok;
+    }
+
+    bool
+    TilePackCacheBin::compact()
+    {
+        OE_PROFILING_ZONE;
+
+        if (!_ok)
+            return false;
+
+        std::lock_guard<std::mutex> lock(_writeMutex);
+
+        uint64_t totalBefore = _totalBytes;
+
+        // Copy the live records, in file order, into brand new segments.
+        // New segments get higher IDs than the old ones, so if we are
+        // interrupted before the new index is saved, the next open will
+        // simply see duplicate records. Once it is saved, its first segment
+        // ID tells the next open to ignore the old segments.
+        std::vector<std::pair<std::string, IndexEntry>> live;
+        std::vector<osg::ref_ptr<Segment>> oldSegments;
+        {
+            ScopedReadLock indexLock(_indexMutex);
+            live.assign(_index.begin(), _index.end());
+            oldSegments = _segments;
+        }
+
+        std::sort(live.begin(), live.end(),
+            [](const std::pair<std::string, IndexEntry>& a, const std::pair<std::string, IndexEntry>& b) {
+                return a.second.segment < b.second.segment ||
+                    (a.second.segment == b.second.segment && a.second.offset < b.second.offset);
+            });
+
+        uint64_t maxSize = (uint64_t)_options.segmentSizeMB().get() * 1048576u;
+        unsigned firstID = _nextSegmentID;
+        unsigned nextID = firstID;
+
+        std::vector<osg::ref_ptr<Segment>> newSegments;
+        std::unordered_map<std::string, IndexEntry> newIndex;
+        newIndex.reserve(live.size());
+
+        for (auto& record : live)
+        {
+            osg::ref_ptr<MappedFile> mapping = oldSegments[record.second.segment]->map(
+                record.second.offset + record.second.size);
+            if (!mapping.valid())
+                continue;
+
+            if (newSegments.empty() ||
+                (newSegments.back()->size() > 0u && newSegments.back()->size() + record.second.size > maxSize))
+            {
+                osg::ref_ptr<Segment> segment = new Segment(nextID, segmentPath(nextID));
+                ++nextID;
+                if (!segment->open(true))
+                {
+                    OE_WARN << LC << "Compaction of bin [" << getID() << "] failed; could not create "
+                        << segment->path() << std::endl;
+                    _nextSegmentID = nextID;
+                    for (auto& s : newSegments) { s->close(); ::remove(s->path().c_str()); }
+                    segment->close();
+                    ::remove(segment->path().c_str());
+                    return false;
+                }
+                newSegments.push_back(segment);
+            }
+
+            Segment* segment = newSegments.back().get();
+            uint64_t offset = segment->size();
+            if (!segment->append(mapping->data() + record.second.offset, record.second.size))
+            {
+                OE_WARN << LC << "Compaction of bin [" << getID() << "] failed writing "
+                    << segment->path() << std::endl;
+                _nextSegmentID = nextID;
+                for (auto& s : newSegments) { s->close(); ::remove(s->path().c_str()); }
+                return false;
+            }
+
+            IndexEntry entry = record.second;
+            entry.segment = (unsigned)newSegments.size() - 1u;
+            entry.offset = offset;
+            newIndex[record.first] = entry;
+        }
+
+        uint64_t totalAfter = 0u;
+        for (auto& segment : newSegments)
+        {
+            std::fflush(segment->file());
+            totalAfter += segment->size();
+        }
+
+        {
+            ScopedWriteLock indexLock(_indexMutex);
+            _segments.swap(newSegments);
+            _index.swap(newIndex);
+        }
+        _totalBytes = totalAfter;
+        _deadBytes = 0u;
+        _firstSegmentID = firstID;
+        _nextSegmentID = nextID;
+
+        // Commit the new index before deleting anything it no longer uses.
+        saveIndex();
+
+        for (auto& segment : oldSegments)
+        {
+            segment->close();
+            if (::remove(segment->path().c_str()) != 0)
+            {
+                OE_WARN << LC << "Segment " << segment->path() << " is still in use and was not deleted" << std::endl;
+            }
+        }
+
+        OE_INFO << LC << "Compacted bin [" << getID() << "] from "
+            << (totalBefore / 1048576) << " MB to " << (totalAfter / 1048576) << " MB" << std::endl;
+
+        return true;
+    }
+
+    unsigned
+    TilePackCacheBin::getStorageSize()
+    {
+        return (unsigned)std::min(_totalBytes.load(), (uint64_t)UINT_MAX);
+    }
+}
+
+//------------------------------------------------------------------------
+
+/**
+ * Cache driver that packs records into memory-mapped segment files.
+ */
+class TilePackCacheDriver : public CacheDriver
+{
+public:
+    TilePackCacheDriver()
+    {
+        supportsExtension( "osgearth_cache_tilepack", "Tile pack cache for osgEarth" );
+    }
+
+    virtual const char* className() const
+    {
+        return "Tile pack cache for osgEarth";
+    }
+
+    virtual ReadResult readObject(const std::string& file_name, const Options* options) const
+    {
+        if ( !acceptsExtension(osgDB::getLowerCaseFileExtension( file_name )))
+            return ReadResult::FILE_NOT_HANDLED;
+
+        return ReadResult( new TilePackCache( getCacheOptions(options) ) );
+    }
+};
+
+REGISTER_OSGPLUGIN(osgearth_cache_tilepack, TilePackCacheDriver)
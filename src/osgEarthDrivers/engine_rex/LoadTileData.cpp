@@ -24,6 +24,7 @@
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/Terrain>
 #include <osgEarth/Metrics>
+#include <osgEarth/MetricsRegistry>
 #include <osg/NodeVisitor>
 
 using namespace osgEarth::REX;
@@ -88,6 +89,8 @@ LoadTileDataOperation::dispatch(bool async)
 
     auto load = [engine, map, key, manifest, enableCancel] (Cancelable& progress)
     {
+        OE_METRICS_TIMER("osgearth_terrain_tile_load_seconds");
+
         osg::ref_ptr<ProgressCallback> wrapper =
             enableCancel ? new ProgressCallback(&progress) : nullptr;
 
@@ -97,6 +100,9 @@ LoadTileDataOperation::dispatch(bool async)
             manifest,
             wrapper.get());
 
+        if (progress.canceled())
+            OE_METRICS_COUNT("osgearth_terrain_tile_loads_canceled_total", 1);
+
         return result;
     };
 
@@ -175,11 +181,13 @@ LoadTileDataOperation::merge()
         OE_DEBUG << LC << "Request for tile " << tilenode->getKey().str() << " out of date and will be requeued" << std::endl;
         _manifest.updateRevisions(map.get());
         _tilenode->refreshLayers(_manifest);
+        OE_METRICS_COUNT("osgearth_terrain_tile_loads_requeued_total", 1);
         return false;
     }
 
     // Merge the new data into the tile.
     tilenode->merge(model.get(), _manifest);
+    OE_METRICS_COUNT("osgearth_terrain_tiles_merged_total", 1);
 
     return true;
 }
@@ -660,11 +660,32 @@ TileNode::update(osg::NodeVisitor& nv)
     }
 }
 
+void
+TileNode::prefetchChildData()
+{
+    // The children's data loads right after they're created; starting the
+    // cache reads now lets the disk work overlap with building the tiles.
+    osg::ref_ptr<const Map> map = _context->getMap();
+    if (!map.valid())
+        return;
+
+    std::vector<TileKey> childKeys(4);
+    for (unsigned quadrant = 0; quadrant < 4; ++quadrant)
+        childKeys[quadrant] = _key.createChildKey(quadrant);
+
+    std::vector<osg::ref_ptr<TileLayer>> layers;
+    map->getOpenLayers(layers);
+    for (auto& layer : layers)
+        layer->prefetchCached(childKeys);
+}
+
 bool
 TileNode::createChildren()
 {
     if (_context->options().getCreateTilesAsync() == false)
     {
+        prefetchChildData();
+
         // synchronous mode: do it now.
         for (unsigned quadrant = 0; quadrant < 4; ++quadrant)
         {
@@ -683,6 +704,8 @@ TileNode::createChildren()
         // create all 4 children in a single job.
         if (_createChildrenFutureResult.empty())
         {
+            prefetchChildData();
+
             EngineContext* context(_context.get());
             osg::observer_ptr<TileNode> tile_weakptr(this);
 
@@ -746,6 +769,8 @@ TileNode::createChildren()
         // create each child is a separate job.
         if (_createChildResults[0].empty())
         {
+            prefetchChildData();
+
             TileKey parentkey(_key);
             EngineContext* context(_context.get());
             for (unsigned quadrant = 0; quadrant < 4; ++quadrant)
@@ -22,6 +22,7 @@
 
 #include <osgEarth/Metrics>
 #include <osgEarth/NodeUtils>
+#include <osgEarth/RasterPool>
 
 #undef  LC
 #define LC "[UnloaderGroup] "
@@ -100,6 +101,11 @@ UnloaderGroup::traverse(osg::NodeVisitor& nv)
             if (_deadpool.empty() == false)
             {
                 OE_DEBUG << LC << "Unloaded " << count << " of " << _deadpool.size() << " dormant tiles; " << _tiles->size() << " remain active." << std::endl;
+
+                // Unloaded tiles return their rasters to the pool;
+                // free whatever exceeds the pool's watermark here, on the
+                // update thread, rather than on the next loader thread.
+                Util::RasterPool::instance().trim();
             }
 
             _deadpool.clear();
@@ -134,6 +134,212 @@ namespace
 
 //............................................................................
 
+namespace
+{
+    // Converts an attribute to a JS value on the stack
+    void pushAttribute(duk_context* ctx, const AttributeValue& a)
+    {
+        switch(a.type) {
+        case ATTRTYPE_DOUBLE: duk_push_number(ctx, a.getDouble()); break;
+        case ATTRTYPE_INT:    duk_push_number(ctx, (double)a.getInt()); break;
+        case ATTRTYPE_BOOL:   duk_push_boolean(ctx, a.getBool()?1:0); break;
+        case ATTRTYPE_STRING:
+        default:              duk_push_string(ctx, a.getString().c_str()); break;
+        }
+    }
+
+    // The heap's user data is the binding of the Context that owns it
+    FeatureBinding& getBinding(duk_context* ctx)
+    {
+        duk_memory_functions funcs;
+        duk_get_memory_functions(ctx, &funcs);
+        return *static_cast<FeatureBinding*>(funcs.udata);
+    }
+
+    inline bool isName(duk_context* ctx, duk_idx_t i)
+    {
+        return duk_is_string(ctx, i) && !duk_is_symbol(ctx, i);
+    }
+
+    // feature.properties proxy traps. The proxy target holds anything a
+    // script assigns, which hides the feature's own value of the same name.
+    // The target inherits from Object.prototype, but a feature attribute
+    // hides an inherited member of the same name.
+
+    // Whether the object at obj_i has an own property named by the key at key_i
+    inline bool hasOwnProp(duk_context* ctx, duk_idx_t obj_i, duk_idx_t key_i)
+    {
+        duk_dup(ctx, key_i);                // [... key]
+        duk_get_prop_desc(ctx, obj_i, 0);   // [... desc | undefined]
+        bool has = duk_is_object(ctx, -1) != 0;
+        duk_pop(ctx);                       // [...]
+        return has;
+    }
+
+    // get(target, key, receiver)
+    static duk_ret_t oe_duk_props_get(duk_context* ctx)
+    {
+        if (!hasOwnProp(ctx, 0, 1))
+        {
+            const Feature* feature = getBinding(ctx).feature;
+            if (feature && isName(ctx, 1))
+            {
+                AttributeValue temp;
+                const AttributeValue* a = feature->getAttr(duk_get_string(ctx, 1), temp);
+                if (a)
+                {
+                    pushAttribute(ctx, *a); // [target, key, receiver, value]
+                    return 1;
+                }
+            }
+        }
+
+        duk_dup(ctx, 1);                    // [target, key, receiver, key]
+        duk_get_prop(ctx, 0);               // [target, key, receiver, value | undefined]
+        return 1;
+    }
+
+    // hasOwnProperty(target, key); Duktape has no getOwnPropertyDescriptor
+    // trap, so the target's hasOwnProperty comes here instead.
+    static duk_ret_t oe_duk_props_has_own(duk_context* ctx)
+    {
+        bool has = hasOwnProp(ctx, 0, 1);
+        if (!has && isName(ctx, 1))
+        {
+            const Feature* feature = getBinding(ctx).feature;
+            has = feature && feature->hasAttr(duk_get_string(ctx, 1));
+        }
+        duk_push_boolean(ctx, has ? 1 : 0);
+        return 1;
+    }
+
+    // has(target, key)
+    static duk_ret_t oe_duk_props_has(duk_context* ctx)
+    {
+        duk_dup(ctx, 1);                    // [target, key, key]
+        bool has = duk_has_prop(ctx, 0) != 0; // [target, key]
+        if (!has && isName(ctx, 1))
+        {
+            const Feature* feature = getBinding(ctx).feature;
+            has = feature && feature->hasAttr(duk_get_string(ctx, 1));
+        }
+        duk_push_boolean(ctx, has ? 1 : 0);
+        return 1;
+    }
+
+    // set(target, key, value, receiver)
+    static duk_ret_t oe_duk_props_set(duk_context* ctx)
+    {
+        duk_dup(ctx, 1);                    // [target, key, value, receiver, key]
+        duk_dup(ctx, 2);                    // [target, key, value, receiver, key, value]
+        duk_put_prop(ctx, 0);               // [target, key, value, receiver]
+        getBinding(ctx).overlayDirty = true;
+        duk_push_true(ctx);
+        return 1;
+    }
+
+    // ownKeys(target)
+    // Duktape only enumerates keys that exist on the target, so this
+    // copies the feature's attributes into it first. Scripts rarely
+    // enumerate, and then they need every value anyway.
+    static duk_ret_t oe_duk_props_keys(duk_context* ctx)
+    {
+        FeatureBinding& binding = getBinding(ctx);
+        if (binding.feature)
+        {
+            for (auto& a : binding.feature->getAttrs())
+            {
+                if (!duk_has_prop_string(ctx, 0, a.first.c_str()))
+                {
+                    pushAttribute(ctx, a.second);                   // [target, value]
+                    duk_put_prop_string(ctx, 0, a.first.c_str());   // [target]
+                    binding.overlayDirty = true;
+                }
+            }
+        }
+
+        duk_idx_t keys_i = duk_push_array(ctx);         // [target, keys]
+        duk_uarridx_t n = 0;
+        duk_enum(ctx, 0, DUK_ENUM_OWN_PROPERTIES_ONLY); // [target, keys, enum]
+        while (duk_next(ctx, -1, 0))                    // [target, keys, enum, key]
+        {
+            duk_put_prop_index(ctx, keys_i, n++);       // [target, keys, enum]
+        }
+        duk_pop(ctx);                                   // [target, keys]
+        return 1;
+    }
+
+    // feature.id getter
+    static duk_ret_t oe_duk_feature_id(duk_context* ctx)
+    {
+        const Feature* feature = getBinding(ctx).feature;
+        if (!feature)
+            return 0;
+        duk_push_number(ctx, (double)feature->getFID());
+        return 1;
+    }
+
+    // feature.geometry.type getter
+    static duk_ret_t oe_duk_feature_geometry_type(duk_context* ctx)
+    {
+        const Feature* feature = getBinding(ctx).feature;
+        if (!feature || !feature->getGeometry())
+            return 0;
+        duk_push_string(ctx, Geometry::toString(feature->getGeometry()->getComponentType()).c_str());
+        return 1;
+    }
+
+    // Creates the global "feature" object, backed by the native bindings.
+    // stack: [global]
+    void installFeatureBindings(duk_context* ctx)
+    {
+        duk_push_c_function(ctx, oe_duk_props_get, 3);
+        duk_put_prop_string(ctx, -2, "oe_duk_props_get");
+        duk_push_c_function(ctx, oe_duk_props_has, 2);
+        duk_put_prop_string(ctx, -2, "oe_duk_props_has");
+        duk_push_c_function(ctx, oe_duk_props_has_own, 2);
+        duk_put_prop_string(ctx, -2, "oe_duk_props_has_own");
+        duk_push_c_function(ctx, oe_duk_props_set, 4);
+        duk_put_prop_string(ctx, -2, "oe_duk_props_set");
+        duk_push_c_function(ctx, oe_duk_props_keys, 1);
+        duk_put_prop_string(ctx, -2, "oe_duk_props_keys");
+        duk_push_c_function(ctx, oe_duk_feature_id, 0);
+        duk_put_prop_string(ctx, -2, "oe_duk_feature_id");
+        duk_push_c_function(ctx, oe_duk_feature_geometry_type, 0);
+        duk_put_prop_string(ctx, -2, "oe_duk_feature_geometry_type");
+
+        duk_eval_string_noresult(ctx,
+            "var feature = {};"
+            "Object.defineProperty(feature, 'id', {get: oe_duk_feature_id});"
+            "feature.geometry = {};"
+            "Object.defineProperty(feature.geometry, 'type', {get: oe_duk_feature_geometry_type});"
+            "(function() {"
+            "    var overlay = Object.create(Object.create(Object.prototype, {"
+            "        hasOwnProperty: { value: function(key) {"
+            "            return oe_duk_props_has_own(overlay, key); } } }));"
+            "    feature.properties = new Proxy(overlay, {"
+            "        get: oe_duk_props_get, has: oe_duk_props_has,"
+            "        set: oe_duk_props_set, ownKeys: oe_duk_props_keys });"
+            "    oe_duk_clear_overlay = function() {"
+            "        for (var key in overlay) delete overlay[key];"
+            "    };"
+            "})();");
+    }
+
+    // Points the native bindings at a new feature
+    void bindFeature(duk_context* ctx, FeatureBinding& binding, Feature const* feature)
+    {
+        binding.feature = feature;
+        if (binding.overlayDirty)
+        {
+            duk_eval_string_noresult(ctx, "oe_duk_clear_overlay();");
+            binding.overlayDirty = false;
+        }
+    }
+}
+
+//............................................................................
+
 namespace
 {
     // Create a "feature" object in the global namespace.
@@ -181,23 +387,14 @@ namespace
                     const AttributeTable& attrs = feature->getAttrs();
                     for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
                     {
-                        AttributeType type = a->second.type;
-                        switch(type) {
-                        case ATTRTYPE_DOUBLE: duk_push_number (ctx, a->second.getDouble()); break;          // [global] [feature] [properties] [name]
-                        case ATTRTYPE_INT:    duk_push_number(ctx, (double)a->second.getInt()); break;             // [global] [feature] [properties] [name]
-                        case ATTRTYPE_BOOL:   duk_push_boolean(ctx, a->second.getBool()?1:0); break;            // [global] [feature] [properties] [name]
-#if 0
-                        case ATTRTYPE_DOUBLEARRAY: break;
-#endif
-                        case ATTRTYPE_STRING:
-                        default:              duk_push_string (ctx, a->second.getString().c_str()); break;  // [global] [feature] [properties] [name]
-                        }
+                        pushAttribute(ctx, a->second);                       // [global] [feature] [properties] [value]
                         duk_put_prop_string(ctx, props_i, a->first.c_str()); // [global] [feature] [properties]
                     }
                 }
                 duk_put_prop_string(ctx, feature_i, "properties"); // [global] [feature]
 
                 duk_idx_t geometry_i = duk_push_object(ctx);  // [global] [feature] [geometry]
+                if (feature->getGeometry())
                 {
                     duk_push_string(ctx, Geometry::toString(feature->getGeometry()->getComponentType()).c_str()); // [global] [feature] [geometry] [type]
                     duk_put_prop_string(ctx, geometry_i, "type"); // [global] [feature] [geometry]
@@ -214,11 +411,101 @@ namespace
 
 //............................................................................
 
+namespace
+{
+    // Whether a script only reads the feature, so running it again
+    // against the same unchanged feature must give the same result.
+    // This is a conservative scan of the source: any name that isn't
+    // known to be side-effect free (globals, library functions, log,
+    // Date, Math.random), any assignment or increment, and any template
+    // string make the script impure.
+    bool isPure(const std::string& code)
+    {
+        static const std::set<std::string> pureNames = {
+            "feature", "Math", "String", "Number", "Boolean",
+            "parseInt", "parseFloat", "isNaN", "isFinite",
+            "true", "false", "null", "undefined", "NaN", "Infinity",
+            "return", "typeof", "instanceof", "in", "if", "else"
+        };
+
+        const std::size_t n = code.length();
+        char prev = 0; // last non-space character outside strings/comments
+
+        for (std::size_t i = 0; i < n; )
+        {
+            char c = code[i];
+
+            if (isspace((unsigned char)c))
+            {
+                ++i;
+            }
+            else if (c == '/' && i + 1 < n && code[i + 1] == '/')
+            {
+                while (i < n && code[i] != '\n') ++i;
+            }
+            else if (c == '/' && i + 1 < n && code[i + 1] == '*')
+            {
+                std::size_t end = code.find("*/", i + 2);
+                i = (end == std::string::npos) ? n : end + 2;
+            }
+            else if (c == '\'' || c == '"')
+            {
+                for (++i; i < n && code[i] != c; ++i)
+                    if (code[i] == '\\') ++i;
+                ++i;
+                prev = c;
+            }
+            else if (c == '`')
+            {
+                return false;
+            }
+            else if (isdigit((unsigned char)c))
+            {
+                // numbers, including 1e5 and 0x1f
+                while (i < n && (isalnum((unsigned char)code[i]) || code[i] == '.'))
+                    ++i;
+                prev = '0';
+            }
+            else if (isalpha((unsigned char)c) || c == '_' || c == '$')
+            {
+                std::size_t start = i;
+                while (i < n && (isalnum((unsigned char)code[i]) || code[i] == '_' || code[i] == '$'))
+                    ++i;
+                std::string name = code.substr(start, i - start);
+
+                // members are fine, except for the one that isn't
+                if (prev == '.' ? name == "random" : pureNames.count(name) == 0)
+                    return false;
+
+                prev = 'a';
+            }
+            else
+            {
+                char next = i + 1 < n ? code[i + 1] : 0;
+
+                // assignment (not ==, !=, <=, >=, or =>), ++ and --
+                if (c == '=' && next != '=' && prev != '=' && prev != '!' && prev != '<' && prev != '>')
+                    return false;
+                if ((c == '+' || c == '-') && next == c)
+                    return false;
+
+                prev = c;
+                ++i;
+            }
+        }
+        return true;
+    }
+}
+
+//............................................................................
+
 DuktapeEngine::Context::Context()
 {
     _ctx = nullptr;
-    _bytecode = nullptr;
     _errorCount = 0u;
+    _numFunctions = 0u;
+    _featureRevision = 0u;
+    _filterContext = nullptr;
 }
 
 void
@@ -226,8 +513,9 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
 {
     if ( _ctx == nullptr)
     {
-        // new heap + context.
-        _ctx = duk_create_heap_default();
+        // new heap + context. The native bindings find the current
+        // feature through the heap's user data.
+        _ctx = duk_create_heap(nullptr, nullptr, nullptr, &_binding, nullptr);
 
         // if there is a static script, evaluate it first. This will register
         // any functions or objects with the EcmaScript global object.
@@ -243,6 +531,12 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
             duk_pop(_ctx); // []
         }
 
+        // cache for compiled functions
+        duk_push_global_stash(_ctx);                    // [stash]
+        duk_push_object(_ctx);                          // [stash, functions]
+        duk_put_prop_string(_ctx, -2, "functions");     // [stash]
+        duk_pop(_ctx);                                  // []
+
         duk_push_global_object( _ctx );
 
         // Add global log function.
@@ -257,6 +551,10 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
 
             GeometryAPI::install(_ctx);
         }
+        else
+        {
+            installFeatureBindings(_ctx);
+        }
 
         duk_pop(_ctx); // []
     }
@@ -293,54 +591,55 @@ DuktapeEngine::compile(
 {
     //OE_PROFILING_ZONE;
 
-    duk_context* ctx = c._ctx;
+    // Keep this many compiled functions per thread before starting over
+    const unsigned maxFunctions = 256u;
 
-    if (code != c._bytecodeSource)
-    {
-        c._bytecodeSource = code;
-        c._errorCount = 0u;
+    duk_context* ctx = c._ctx;
 
-        if (duk_pcompile_string(ctx, 0, code.c_str()) != 0) // [function|error]
-        {
-            std::string resultString = duk_safe_to_string(ctx, -1);
-            OE_WARN << LC << "Compile error: " << resultString << std::endl;
-            c._errorCount++;
-            duk_pop(ctx); // []
-            result = ScriptResult("", false, resultString); // return error.
-            return false;
-        }
+    duk_push_global_stash(ctx);                                     // [stash]
+    duk_get_prop_string(ctx, -1, "functions");                      // [stash, functions]
 
-        duk_dump_function(ctx); // [buffer]
-        duk_size_t size;
-        void* bytecode = duk_get_buffer(ctx, 0, &size);
-        if (bytecode == nullptr)
-        {
-            // error. remove the buffer and return.
-            duk_pop(ctx); // []
-            OE_WARN << LC << "Allocation error; cannot continue" << std::endl;
-            result = ScriptResult("", false, "Allocation error"); // return error
-            c._errorCount++;
-            return false;
-        }
+    if (duk_get_prop_lstring(ctx, -1, code.c_str(), code.length())) // [stash, functions, function]
+    {
+        duk_insert(ctx, -3);                                        // [function, stash, functions]
+        duk_pop_2(ctx);                                             // [function]
+        return true;
+    }
+    duk_pop(ctx);                                                   // [stash, functions]
 
-        if (c._bytecode) delete[] c._bytecode;
-        c._bytecode = new unsigned char[size];
-        ::memcpy(c._bytecode, (unsigned char*)bytecode, size);
-        c._bytecodeSize = size;
+    if (c._compileErrors.count(code) > 0)
+    {
+        // this code caused a previous compile error, so bail out.
+        duk_pop_2(ctx); // []
+        result = ScriptResult("", false, "Compile error");
+        return false;
     }
-    else if (c._errorCount == 0u)
+
+    if (c._numFunctions >= maxFunctions)
     {
-        void* buf = duk_push_buffer(ctx, (duk_size_t)c._bytecodeSize, (duk_bool_t)0); // [buffer]
-        ::memcpy(buf, c._bytecode, c._bytecodeSize);
+        duk_pop(ctx);                                   // [stash]
+        duk_push_object(ctx);                           // [stash, functions]
+        duk_dup_top(ctx);                               // [stash, functions, functions]
+        duk_put_prop_string(ctx, -3, "functions");      // [stash, functions]
+        c._numFunctions = 0u;
     }
-    else
+
+    if (duk_pcompile_lstring(ctx, 0, code.c_str(), code.length()) != 0) // [stash, functions, function|error]
     {
-        // this code caused a previous compile error, so bail out.
+        std::string resultString = duk_safe_to_string(ctx, -1);
+        OE_WARN << LC << "Compile error: " << resultString << std::endl;
+        c._errorCount++;
+        c._compileErrors.insert(code);
+        duk_pop_3(ctx); // []
+        result = ScriptResult("", false, resultString); // return error.
         return false;
     }
 
-    // convert bytecode to a function object:
-    duk_load_function(ctx); // [function]
+    duk_dup_top(ctx);                                               // [stash, functions, function, function]
+    duk_put_prop_lstring(ctx, -3, code.c_str(), code.length());     // [stash, functions, function]
+    duk_insert(ctx, -3);                                            // [function, stash, functions]
+    duk_pop_2(ctx);                                                 // [function]
+    c._numFunctions++;
 
     return true;
 }
@@ -378,10 +677,15 @@ DuktapeEngine::run(
         return false;
     }
 
+    const bool eager = (getProfile() == "eager");
+
     for (auto& feature : features)
     {
         // Load the next feature into the global object:
-        setFeature(c._ctx, feature.get(), complete);
+        if (eager || complete)
+            setFeature(c._ctx, feature.get(), complete);
+        else
+            bindFeature(ctx, c._binding, feature.get());
 
         // Duplicate the function on the top since we'll be calling it multiple times
         duk_dup_top(ctx); // [function function]
@@ -406,6 +710,12 @@ DuktapeEngine::run(
     // Pop the function, clearing the stack
     duk_pop(ctx); // []
 
+    // the global feature no longer matches the single-feature cache
+    c._binding.feature = nullptr;
+    c._feature = nullptr;
+    c._filterContext = nullptr;
+    c._results.clear();
+
     return true;
 }
 
@@ -430,26 +740,62 @@ DuktapeEngine::run(
     c.initialize( _options, complete );
     duk_context* ctx = c._ctx;
 
+    const bool eager = (getProfile() == "eager");
+
+    // load the feature into the global namespace:
+    if ( feature != c._feature.get() || feature->getRevision() != c._featureRevision )
+    {
+        if (eager || complete)
+            setFeature(ctx, feature, complete);
+        else
+            bindFeature(ctx, c._binding, feature);
+
+        c._feature = feature;
+        c._featureRevision = feature->getRevision();
+        c._results.clear();
+    }
+    else if (context != c._filterContext)
+    {
+        c._results.clear();
+    }
+    else
+    {
+        // same pure script, same unchanged feature, same answer
+        auto cached = c._results.find(code);
+        if (cached != c._results.end())
+            return cached->second;
+    }
+    c._filterContext = context;
+
+    // only pure scripts are worth remembering
+    auto pure = c._pure.find(code);
+    if (pure == c._pure.end())
+    {
+        if (c._pure.size() >= 256u)
+            c._pure.clear();
+        pure = c._pure.emplace(code, isPure(code)).first;
+    }
+
+    // the feature is only valid for the duration of the call:
+    c._binding.feature = feature;
+
     // compile the function:
     ScriptResult result;
     if (!compile(c, code, result)) // [function]
     {
+        c._binding.feature = nullptr;
         return result;
     }
 
-    // load the feature into the global namespace:
-	if ( feature != c._feature.get() )
-    {
-		setFeature(ctx, feature, complete);
-        c._feature = feature;
-	}
-
     std::string resultString;
 
     duk_int_t rc = duk_pcall(ctx, 0); // [result]
     resultString = duk_safe_to_string(ctx, -1);
     duk_pop(ctx); // []
 
+    // don't leave the bindings pointing at a feature the caller may delete
+    c._binding.feature = nullptr;
+
     if (rc != DUK_EXEC_SUCCESS)
     {
         OE_WARN << LC << "Runtime error: " << resultString << std::endl;
@@ -457,5 +803,8 @@ DuktapeEngine::run(
         return ScriptResult(EMPTY_STRING, false, resultString); // error
     }
 
-    return ScriptResult(resultString, true);
+    result = ScriptResult(resultString, true);
+    if (pure->second)
+        c._results[code] = result;
+    return result;
 }
@@ -268,7 +268,7 @@ BiomeLayer::createImageImplementation(
 
         auto iter = _imageCache.find(key);
         osg::ref_ptr<osg::Image> image;
-        if (iter != _imageCache.end() && iter->second.lock(image))
+        if (iter != _imageCache.end() && iter->second.image.lock(image))
         {
             return GeoImage(image.get(), key.getExtent());
         }
@@ -485,13 +485,58 @@ BiomeLayer::createImageImplementation(
     // local cache:
     {
         std::lock_guard<std::mutex> lock(_imageCache.mutex());
-        _imageCache[key] = image.get();
+        _imageCache[key] = CachedTile{ image.get(), {} };
     }
 #endif
 
     return result;
 }
 
+ClassificationRaster::Ptr
+BiomeLayer::getBiomeIndexRaster(
+    const TileKey& key,
+    osg::ref_ptr<osg::Object>& out_token,
+    ProgressCallback* progress) const
+{
+    out_token = nullptr;
+
+    GeoImage image = const_cast<BiomeLayer*>(this)->createImage(key, progress);
+    if (!image.valid())
+        return nullptr;
+
+    out_token = image.getTrackingToken();
+
+    std::lock_guard<std::mutex> lock(_imageCache.mutex());
+
+    // reuse the encoding if someone still holds one for this very image
+    CachedTile& tile = _imageCache[key];
+    osg::ref_ptr<osg::Image> cached;
+    if (tile.image.lock(cached) && cached.get() == image.getImage())
+    {
+        ClassificationRaster::Ptr raster = tile.raster.lock();
+        if (raster)
+            return raster;
+    }
+
+    ClassificationRaster::Ptr raster = ClassificationRaster::create(image.getImage());
+    tile.image = const_cast<osg::Image*>(image.getImage());
+    tile.raster = raster;
+
+    // drop entries that nothing refers to anymore
+    if (_imageCache.size() > 256u)
+    {
+        for (auto i = _imageCache.begin(); i != _imageCache.end(); )
+        {
+            if (!i->second.image.valid() && i->second.raster.expired())
+                i = _imageCache.erase(i);
+            else
+                ++i;
+        }
+    }
+
+    return raster;
+}
+
 void
 BiomeLayer::postCreateImageImplementation(
     GeoImage& createdImage,
@@ -540,12 +585,13 @@ BiomeLayer::trackImage(
     std::set<int>& biome_index_set) const
 {
     // inform the biome manager that we are using the biomes corresponding
-    // to the set of biome indices collected from the raster.
+    // to the set of biome indices collected from the raster. Finer tiles
+    // are closer to the camera, so their assets load first.
     for (auto biome_index : biome_index_set)
     {
         const Biome* biome = getBiomeCatalog()->getBiomeByIndex(biome_index);
         if (biome)
-            const_cast<BiomeManager*>(&_biomeMan)->ref(biome);
+            const_cast<BiomeManager*>(&_biomeMan)->ref(biome, (float)key.getLOD());
     }
 
     // Create a "token" object that we can track for destruction.
@@ -28,6 +28,7 @@
 #include <osgEarth/MeshConsolidator>
 #include <osg/ComputeBoundsVisitor>
 #include <osg/MatrixTransform>
+#include <osg/Timer>
 #include <osgUtil/SmoothingVisitor>
 #include <osgDB/WriteFile>
 
@@ -40,6 +41,8 @@ using namespace osgEarth::Procedural;
 #define NORMAL_MAP_TEX_UNIT 1
 #define PBR_TEX_UNIT 2
 
+#define ARENA_ASSET_LOADING "oe.biomes.assets"
+
 //...................................................................
 
 ResidentModelAsset::Ptr
@@ -118,62 +121,160 @@ namespace
 
         return (float)best_t / (float)(in->t() - 1);
     }
+
+    // rough estimate of the memory held by a resident asset
+    std::size_t estimateSize(const ResidentModelAsset& asset)
+    {
+        std::size_t bytes = 0u;
+
+        std::set<const osg::Image*> images;
+        for (auto& tex : {
+            asset.sideBillboardTex(), asset.sideBillboardNormalMap(), asset.sideBillboardPBRMap(),
+            asset.topBillboardTex(), asset.topBillboardNormalMap(), asset.topBillboardPBRMap() })
+        {
+            if (tex.valid() && tex->getImage(0) && images.insert(tex->getImage(0)).second)
+                bytes += tex->getImage(0)->getTotalSizeInBytesIncludingMipmaps();
+        }
+
+        if (asset.chonk())
+        {
+            bytes += asset.chonk()->_vbo_store.size() * sizeof(Chonk::VertexGPU);
+            bytes += asset.chonk()->_ebo_store.size() * sizeof(Chonk::element_t);
+        }
+
+        return bytes;
+    }
 }
 
+// URI-keyed caches shared by a batch of asset loads, so that
+// assets referencing the same model or billboard only load it once.
+struct BiomeManager::LoadCaches
+{
+    struct ModelCacheEntry
+    {
+        osg::ref_ptr<osg::Node> _node;
+        osg::BoundingBox _modelAABB;
+    };
+
+    std::mutex mutex;
+    std::map<URI, ResidentModelAsset::Ptr> texcache;
+    std::map<URI, ModelCacheEntry> modelcache;
+    vector_map<std::string, CreateImpostorFunction> createImpostorFunctions;
+    osg::ref_ptr<const osgDB::Options> readOptions;
+};
+
 //...................................................................
 
 BiomeManager::BiomeManager() :
     _revision(0),
     _lodTransitionPixelScale(16.0f),
-    _locked(false)
+    _asyncLoading(true),
+    _memoryBudget(0u),
+    _unusedAssetRetention(30.0),
+    _locked(false),
+    _nextEvictionTime(0.0),
+    _assetGeneration(0u),
+    _shuttingDown(false)
 {
     // this arena will hold all the textures for loaded assets.
     _textures = new TextureArena();
     _textures->setAutoRelease(true);
     _textures->setName("Biomes");
     _textures->setBindingPoint(1);
+
+    // Asset loads may be waited on from other pools' threads,
+    // so don't let this pool pick up unrelated work.
+    static std::once_flag s_poolConfigured;
+    std::call_once(s_poolConfigured, []()
+        {
+            auto pool = jobs::get_pool(ARENA_ASSET_LOADING);
+            pool->set_can_steal_work(false);
+            pool->set_concurrency(std::max(pool->concurrency(), 4u));
+        });
+}
+
+BiomeManager::~BiomeManager()
+{
+    // loads in flight reference this object, so wait for them.
+    std::vector<Future<bool>> pending;
+    {
+        std::lock_guard<std::mutex> lock(_residentData_mutex);
+        _shuttingDown = true;
+        for (auto& iter : _pendingAssets)
+            pending.push_back(iter.second->done);
+        pending.insert(pending.end(), _abandonedLoads.begin(), _abandonedLoads.end());
+    }
+
+    for (auto& p : pending)
+        p.join();
 }
 
 void
 BiomeManager::ref(const Biome* biome)
 {
-    std::lock_guard<std::mutex> lock(_refsAndRevision_mutex);
+    ref(biome, 0.0f);
+}
 
-    auto item = _refs.emplace(biome, 0);
-    ++item.first->second;
-    if (item.first->second == 1) // ref count of 1 means it's new
+void
+BiomeManager::ref(const Biome* biome, float priority)
+{
     {
-        ++_revision;
-        OE_DEBUG << LC << "Hello, " << biome->name().get() << " (" << biome->index() << ")" << std::endl;
+        std::lock_guard<std::mutex> lock(_refsAndRevision_mutex);
+
+        auto p = _priorities.emplace(biome, priority);
+        if (!p.second && priority > p.first->second)
+            p.first->second = priority;
+
+        auto item = _refs.emplace(biome, 0);
+        ++item.first->second;
+        if (item.first->second == 1) // ref count of 1 means it's new
+        {
+            ++_revision;
+            OE_DEBUG << LC << "Hello, " << biome->name().get() << " (" << biome->index() << ")" << std::endl;
+        }
     }
+
+    // clients only come back on a revision change, so use the
+    // paging traffic to expire assets nobody has used in a while.
+    evictUnusedAssets(false);
 }
 
 void
 BiomeManager::unref(const Biome* biome)
 {
-    std::lock_guard<std::mutex> lock(_refsAndRevision_mutex);
-
-    auto iter = _refs.find(biome);
-    
-    // silent assertion
-    if (iter == _refs.end() || iter->second == 0)
+    bool released = false;
     {
-        OE_SOFT_ASSERT(iter != _refs.end() && iter->second != 0);
-        return;
-    }
+        std::lock_guard<std::mutex> lock(_refsAndRevision_mutex);
 
-    if (!_locked)
-    {
-        --iter->second;
-        if (iter->second == 0)
+        auto iter = _refs.find(biome);
+
+        // silent assertion
+        if (iter == _refs.end() || iter->second == 0)
         {
-            // Technically yes, this creates a new revision, but it
-            // would also result in re-loading assets that are already
-            // resident... think on this -gw
-            //++_revision;
-            OE_DEBUG << LC << "Goodbye, " << biome->name().get() << "(" << biome->index() << ")" << std::endl;
+            OE_SOFT_ASSERT(iter != _refs.end() && iter->second != 0);
+            return;
+        }
+
+        if (!_locked)
+        {
+            --iter->second;
+            if (iter->second == 0)
+            {
+                _priorities.erase(biome);
+                released = true;
+
+                // Technically yes, this creates a new revision, but it
+                // would also result in re-loading assets that are already
+                // resident... think on this -gw
+                //++_revision;
+                OE_DEBUG << LC << "Goodbye, " << biome->name().get() << "(" << biome->index() << ")" << std::endl;
+            }
         }
     }
+
+    // start the retention clock on the biome's assets now rather
+    // than at the next revision.
+    evictUnusedAssets(released);
 }
 
 int
@@ -190,7 +291,20 @@ BiomeManager::setLODTransitionPixelScale(float value)
     // We need to rebuild the assets, so clear everything out,
     // recalculate the biome set, and bump the revision.
     _residentData_mutex.lock();
-    _residentModelAssets.clear();
+    while (!_residentModelAssets.empty())
+        unloadAsset_no_lock(_residentModelAssets.begin()->first);
+    // discard anything loading with the old settings. The jobs still
+    // reference this object, so hang on to them for the destructor.
+    _abandonedLoads.erase(
+        std::remove_if(_abandonedLoads.begin(), _abandonedLoads.end(),
+            [](const Future<bool>& f) { return f.available(); }),
+        _abandonedLoads.end());
+    for (auto& iter : _pendingAssets)
+        _abandonedLoads.push_back(iter.second->done);
+    _pendingAssets.clear();
+    // assets that failed may work with the new settings
+    _failedAssets.clear();
+    ++_assetGeneration;
     _residentData_mutex.unlock();
 
     _refsAndRevision_mutex.lock();
@@ -223,20 +337,99 @@ BiomeManager::reset()
     }
 
     // Resolve the references and unload any resident assets from memory.
-    recalculateResidentBiomes();
+    recalculateResidentBiomes(true);
+
+    std::lock_guard<std::mutex> lock(_residentData_mutex);
+    _failedAssets.clear();
 }
 
 void
 BiomeManager::flush()
 {
-    recalculateResidentBiomes();
+    recalculateResidentBiomes(true);
+
+    {
+        std::lock_guard<std::mutex> lock(_residentData_mutex);
+        _failedAssets.clear();
+    }
 
     if (_textures.valid())
         _textures->flush();
 }
 
 void
-BiomeManager::recalculateResidentBiomes()
+BiomeManager::setAsyncLoading(bool value)
+{
+    _asyncLoading = value;
+}
+
+bool
+BiomeManager::getAsyncLoading() const
+{
+    return _asyncLoading;
+}
+
+void
+BiomeManager::setMemoryBudget(std::size_t bytes)
+{
+    _memoryBudget = bytes;
+}
+
+std::size_t
+BiomeManager::getMemoryBudget() const
+{
+    return _memoryBudget;
+}
+
+void
+BiomeManager::setUnusedAssetRetention(double seconds)
+{
+    _unusedAssetRetention = seconds;
+}
+
+double
+BiomeManager::getUnusedAssetRetention() const
+{
+    return _unusedAssetRetention;
+}
+
+BiomeManager::Stats
+BiomeManager::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_residentData_mutex);
+
+    Stats stats = _stats;
+    stats.residentAssets = _residentModelAssets.size();
+    stats.pendingAssets = _pendingAssets.size();
+    stats.failedAssets = _failedAssets.size();
+    stats.unusedAssets = 0u;
+    for (auto& r : _residency)
+    {
+        if (r.second.unusedSince >= 0.0)
+            ++stats.unusedAssets;
+    }
+    return stats;
+}
+
+void
+BiomeManager::unloadAsset_no_lock(const std::string& name)
+{
+    auto r = _residency.find(name);
+    if (r != _residency.end())
+    {
+        _stats.residentBytes -= std::min(_stats.residentBytes, r->second.bytes);
+        _stats.bytesUnloaded += r->second.bytes;
+        _residency.erase(r);
+    }
+    if (_residentModelAssets.erase(name) > 0)
+    {
+        ++_stats.assetsUnloaded;
+    }
+    OE_DEBUG << LC << "Unloaded asset " << name << std::endl;
+}
+
+void
+BiomeManager::recalculateResidentBiomes(bool purgeUnused)
 {
     std::vector<const Biome*> biomes_to_add;
     std::vector<const Biome*> biomes_to_remove;
@@ -278,27 +471,79 @@ BiomeManager::recalculateResidentBiomes()
             _residentBiomes.erase(biome->id());
         }
 
-
         // finally, update the collection of resident assets to
         // reflect the reference counts.
-        std::list<std::string> to_delete;
+        evictUnusedAssets_no_lock(purgeUnused);
+    }
+}
 
-        for (auto& entry : _residentModelAssets)
+void
+BiomeManager::evictUnusedAssets_no_lock(bool purgeUnused)
+{
+    // Assets nobody is using stick around for a while in case their
+    // biomes come back, unless we are over the memory budget; then
+    // the oldest go first.
+    const double now = osg::Timer::instance()->time_s();
+    std::vector<std::pair<double, std::string>> unused;
+
+    // assets wanted by a resident biome are in use even if the
+    // biome's instance list hasn't picked them up yet.
+    std::unordered_set<std::string> wanted;
+    for (auto& entry : _residentBiomes)
+    {
+        for (auto& asset_ptr : entry.second.biome->getModelAssets())
         {
-            if (entry.second.use_count() == 1)
-            {
-                to_delete.push_back(entry.first);
-            }
+            if (asset_ptr->asset())
+                wanted.insert(asset_ptr->asset()->name());
         }
+    }
+
+    for (auto& entry : _residentModelAssets)
+    {
+        auto& residency = _residency[entry.first];
 
-        for (auto& asset_name : to_delete)
+        if (entry.second.use_count() == 1 && wanted.count(entry.first) == 0)
         {
-            _residentModelAssets.erase(asset_name);
-            OE_DEBUG << LC << "Unloaded asset " << asset_name << std::endl;
+            if (residency.unusedSince < 0.0)
+                residency.unusedSince = now;
+
+            unused.emplace_back(residency.unusedSince, entry.first);
+        }
+        else
+        {
+            residency.unusedSince = -1.0;
+        }
+    }
+
+    std::sort(unused.begin(), unused.end());
+
+    for (auto& entry : unused)
+    {
+        bool expired = (now - entry.first) >= _unusedAssetRetention;
+        bool overBudget = _memoryBudget > 0u && _stats.residentBytes > _memoryBudget;
+
+        if (purgeUnused || expired || overBudget)
+        {
+            unloadAsset_no_lock(entry.second);
         }
     }
 }
 
+void
+BiomeManager::evictUnusedAssets(bool force)
+{
+    const double now = osg::Timer::instance()->time_s();
+    double next = _nextEvictionTime;
+
+    if (!force && (now < next || !_nextEvictionTime.compare_exchange_strong(next, now + 1.0)))
+        return;
+
+    if (force)
+        _nextEvictionTime = now + 1.0;
+
+    recalculateResidentBiomes(false);
+}
+
 std::vector<const Biome*>
 BiomeManager::getActiveBiomes() const
 {
@@ -349,12 +594,6 @@ BiomeManager::getResidentAssetsIfNotLocked() const
 
 namespace
 {
-    struct ModelCacheEntry
-    {
-        osg::ref_ptr<osg::Node> _node;
-        osg::BoundingBox _modelAABB;
-    };
-
     osg::Geometry* makeDebugModel(osg::Node* node)
     {
         auto geom = new osg::Geometry();
@@ -416,36 +655,218 @@ namespace
 }
 
 void
-BiomeManager::materializeNewAssets(const osgDB::Options* readOptions)
+BiomeManager::materializeNewAssets(
+    const osgDB::Options* readOptions,
+    bool waitForAssets)
 {
     OE_PROFILING_ZONE;
 
-    // exclusive access to the resident dataset
-    std::lock_guard<std::mutex> lock(_residentData_mutex);
+    std::map<const Biome*, float> priorities;
+    {
+        std::lock_guard<std::mutex> lock(_refsAndRevision_mutex);
+        priorities = _priorities;
 
-    // Some caches to avoid duplicating data
-    std::map<URI, ResidentModelAsset::Ptr> texcache;
-    std::map<URI, ModelCacheEntry> modelcache;
+        // start over, so a biome that was needed up close a while ago
+        // doesn't keep its loads ahead of what's needed up close now.
+        for (auto& p : _priorities)
+            p.second = 0.0f;
+    }
 
-    // Factory for loading chonk data. It will use our texture arena.
-    ChonkFactory factory(_textures.get());
-    factory.setGetOrCreateFunction(ChonkFactory::getWeakTextureCacheFunction(_texturesCache, _texturesCacheMutex));
+    std::vector<Future<bool>> pending;
+    {
+        std::lock_guard<std::mutex> lock(_residentData_mutex);
+        updateInstances_no_lock(readOptions, priorities, waitForAssets ? &pending : nullptr);
+    }
+
+    if (!pending.empty())
+    {
+        // wait for the loads to finish and then pick up the results.
+        for (auto& p : pending)
+            p.join();
+
+        std::lock_guard<std::mutex> lock(_residentData_mutex);
+        updateInstances_no_lock(readOptions, priorities, nullptr);
+    }
+}
+
+void
+BiomeManager::updateInstances_no_lock(
+    const osgDB::Options* readOptions,
+    const std::map<const Biome*, float>& priorities,
+    std::vector<Future<bool>>* pending)
+{
+    std::shared_ptr<LoadCaches> caches;
+
+    // loads whose priority was already set during this call
+    std::unordered_set<const PendingAsset*> prioritized;
 
     // Clear out each biome's instances so we can start fresh.
     // This is a low-cost operation since anything we can re-use
-    // will already by in the _residentModelAssetData collection.
+    // will already by in the _residentModelAssets collection.
     OE_DEBUG << LC << "Found " << _residentBiomes.size() << " resident biomes..." << std::endl;
-    for (auto& iter : _residentBiomes)
+
+    // Go through the residency list and build the instances for each
+    // biome from the resident assets. Any asset that's not resident
+    // gets queued up for loading in the background.
+    for (auto& e : _residentBiomes)
     {
-        iter.second.instances.clear();
+        const Biome* biome = e.second.biome;
+
+        auto& assetsToUse = biome->getModelAssets();
+
+        auto p = priorities.find(biome);
+        float priority = p != priorities.end() ? p->second : 0.0f;
+
+        // this is the collection of instances we're going to populate
+        ResidentModelAssetInstances& assetInstances = e.second.instances;
+        assetInstances.clear();
+        e.second.complete = true;
+
+        for (auto& asset_ptr : assetsToUse)
+        {
+            const ModelAsset* assetDef = asset_ptr->asset();
+
+            OE_SOFT_ASSERT(assetDef != nullptr);
+            if (assetDef == nullptr)
+                continue;
+
+            auto iter = _residentModelAssets.find(assetDef->name());
+            if (iter != _residentModelAssets.end())
+            {
+                auto& residentAsset = iter->second;
+
+                // If this data successfully materialized, add it to the
+                // biome's instance collection.
+                if (residentAsset->sideBillboardTex().valid() || residentAsset->model().valid())
+                {
+                    ResidentModelAssetInstance instance;
+                    instance.residentAsset() = residentAsset;
+                    instance.weight() = asset_ptr->weight();
+                    instance.coverage() = asset_ptr->coverage();
+                    assetInstances.push_back(std::move(instance));
+                }
+                continue;
+            }
+
+            // Already tried and got nothing; don't keep at it.
+            if (_failedAssets.count(assetDef->name()) > 0)
+                continue;
+
+            // Not resident; queue it up if it isn't already, and set its
+            // priority to the highest of the biomes that need it now.
+            e.second.complete = false;
+            auto& load = _pendingAssets[assetDef->name()];
+            if (load == nullptr)
+            {
+                if (caches == nullptr)
+                {
+                    caches = std::make_shared<LoadCaches>();
+                    caches->createImpostorFunctions = _createImpostorFunctions;
+                    caches->readOptions = readOptions;
+                }
+
+                load = std::make_shared<PendingAsset>();
+                load->assetDef = assetDef;
+                load->priority = priority;
+
+                std::shared_ptr<PendingAsset> load_ptr = load;
+                unsigned generation = _assetGeneration;
+
+                auto job = [this, load_ptr, caches, generation](Cancelable& c) -> bool
+                {
+                    OE_PROFILING_ZONE_NAMED("BiomeManager::loadAsset(job)");
+
+                    const std::string& name = load_ptr->assetDef->name();
+
+                    ResidentModelAsset::Ptr asset;
+                    if (!_shuttingDown && !c.canceled())
+                    {
+                        asset = loadAsset(load_ptr->assetDef, *caches, caches->readOptions.get());
+                    }
+
+                    bool stored = false;
+                    {
+                        std::lock_guard<std::mutex> lock(_residentData_mutex);
+
+                        auto p = _pendingAssets.find(name);
+                        if (p != _pendingAssets.end() && p->second == load_ptr)
+                            _pendingAssets.erase(p);
+
+                        if (asset && generation == _assetGeneration && !_shuttingDown)
+                        {
+                            if (asset->sideBillboardTex().valid() || asset->model().valid())
+                            {
+                                std::size_t bytes = estimateSize(*asset);
+
+                                _residentModelAssets[name] = asset;
+                                _residency[name].bytes = bytes;
+
+                                ++_stats.assetsLoaded;
+                                _stats.bytesLoaded += bytes;
+                                _stats.residentBytes += bytes;
+                                stored = true;
+
+                                // a new asset can push us over the budget
+                                if (_memoryBudget > 0u && _stats.residentBytes > _memoryBudget)
+                                    evictUnusedAssets_no_lock(false);
+                            }
+                            else
+                            {
+                                OE_WARN << LC << "Asset \"" << name << "\" has nothing to render" << std::endl;
+                                _failedAssets.insert(name);
+                            }
+                        }
+                    }
+
+                    // new revision, so clients know to come get the new asset
+                    if (stored)
+                    {
+                        std::lock_guard<std::mutex> lock(_refsAndRevision_mutex);
+                        ++_revision;
+                    }
+
+                    return stored;
+                };
+
+                jobs::context context;
+                context.name = "BiomeManager asset loader";
+                context.pool = jobs::get_pool(ARENA_ASSET_LOADING);
+                context.priority = [load_ptr]() { return load_ptr->priority.load(); };
+                context.can_cancel = false;
+
+                load->done = jobs::dispatch(job, context);
+                prioritized.insert(load.get());
+            }
+            else if (prioritized.insert(load.get()).second || priority > load->priority)
+            {
+                load->priority = priority;
+            }
+
+            if (pending)
+            {
+                pending->push_back(load->done);
+            }
+        }
     }
+}
+
+ResidentModelAsset::Ptr
+BiomeManager::loadAsset(
+    const ModelAsset* assetDef,
+    LoadCaches& caches,
+    const osgDB::Options* readOptions)
+{
+    OE_PROFILING_ZONE;
+
+    // Factory for loading chonk data. It will use our texture arena.
+    ChonkFactory factory(_textures.get());
+    factory.setGetOrCreateFunction(ChonkFactory::getWeakTextureCacheFunction(_texturesCache, _texturesCacheMutex));
 
     // This loader will find material textures and install them on
     // secondary texture image units.. in this case, normal maps.
     // We can expand this later to include other types of material maps.
     Util::MaterialLoader materialLoader;
 
-
     auto getNormalMapFileName = MaterialUtils::getDefaultNormalMapNameMangler();
 
     materialLoader.setMangler(
@@ -476,364 +897,359 @@ BiomeManager::materializeNewAssets(const osgDB::Options* readOptions)
     materialLoader.setMangler(
         PBR_TEX_UNIT, getPBRMapFileName);
 
-    // Go through the residency list and materialize any model assets
-    // that are not already loaded (and present in _residentModelAssets);
-    // Along the way, build the instances for each biome.
-    for (auto& e : _residentBiomes)
-    {
-        const Biome* biome = e.second.biome;
+    // billboard URIs this asset loaded, to share once it's complete
+    std::vector<URI> texturesToShare;
 
-        auto& assetsToUse = biome->getModelAssets();
+    OE_DEBUG << LC << "  Loading asset " << assetDef->name() << std::endl;
 
-        // this is the collection of instances we're going to populate
-        ResidentModelAssetInstances& assetInstances = e.second.instances;
+    ResidentModelAsset::Ptr residentAsset = ResidentModelAsset::create();
 
-        // The group points to multiple assets, which we will analyze and load.
-        for (auto& asset_ptr : assetsToUse)
-        {
-            const ModelAsset* assetDef = asset_ptr->asset();
+    residentAsset->assetDef() = assetDef;
 
-            OE_SOFT_ASSERT(assetDef != nullptr);
-            if (assetDef == nullptr)
-                continue;
+    if (assetDef->modelURI().isSet())
+    {
+        const URI& uri = assetDef->modelURI().get();
+
+        LoadCaches::ModelCacheEntry cached;
+        {
+            std::lock_guard<std::mutex> lock(caches.mutex);
+            auto cache_iter = caches.modelcache.find(uri);
+            if (cache_iter != caches.modelcache.end())
+                cached = cache_iter->second;
+        }
 
-            // Look up this model asset. If it's already in the resident set,
-            // do nothing; otherwise make it resident by loading all the data.
-            ResidentModelAsset::Ptr& residentAsset = _residentModelAssets[assetDef->name()];
+        if (cached._node.valid())
+        {
+            residentAsset->model() = cached._node.get();
+            residentAsset->boundingBox() = cached._modelAABB;
+        }
+        else
+        {
+            residentAsset->model() = uri.getNode(readOptions);
 
-            // First reference to this instance? Populate it:
-            if (residentAsset == nullptr)
+            if (residentAsset->model().valid())
             {
-                OE_DEBUG << LC << "  Loading asset " << assetDef->name() << std::endl;
+                // apply a static scale:
+                if (assetDef->scale().isSet())
+                {
+                    osg::MatrixTransform* mt = new osg::MatrixTransform();
+                    mt->setMatrix(osg::Matrix::scale(assetDef->scale().get(), assetDef->scale().get(), assetDef->scale().get()));
+                    mt->addChild(residentAsset->model().get());
+                    residentAsset->model() = mt;
+                }
 
-                residentAsset = ResidentModelAsset::create();
+                // find materials:
+                materialLoader.setReferrer(uri.full());
+                residentAsset->model()->accept(materialLoader);
 
-                residentAsset->assetDef() = assetDef;
+                // add flexors:
+                bool isUndergrowth = assetDef->group() == "undergrowth";
+                addFlexors(residentAsset->model(), assetDef->stiffness().get(), isUndergrowth);
+
+                osg::ComputeBoundsVisitor cbv;
+                residentAsset->model()->accept(cbv);
+                residentAsset->boundingBox() = cbv.getBoundingBox();
 
-                if (assetDef->modelURI().isSet())
                 {
-                    const URI& uri = assetDef->modelURI().get();
+                    std::lock_guard<std::mutex> lock(caches.mutex);
+                    auto& entry = caches.modelcache[uri];
+                    entry._node = residentAsset->model().get();
+                    entry._modelAABB = residentAsset->boundingBox();
+                }
 
-                    auto cache_iter = modelcache.find(uri);
-                    if (cache_iter != modelcache.end())
-                    {
-                        residentAsset->model() = cache_iter->second._node.get();
-                        residentAsset->boundingBox() = cache_iter->second._modelAABB;
-                    }
-                    else
-                    {
-                        residentAsset->model() = uri.getNode(readOptions);
+                OE_DEBUG << LC << "Loaded model: " << uri.base() << 
+                    " with bbox " << residentAsset->boundingBox().xMin() << " "
+                    << residentAsset->boundingBox().yMin() << " "
+                    << residentAsset->boundingBox().xMax() << " "
+                    << residentAsset->boundingBox().yMax() <<
+                    std::endl;
+            }
+            else
+            {
+                OE_WARN << LC << "Failed to load model " << uri.full() << std::endl;
+            }
+        }
+    }
 
-                        if (residentAsset->model().valid())
-                        {
-                            // apply a static scale:
-                            if (assetDef->scale().isSet())
-                            {
-                                osg::MatrixTransform* mt = new osg::MatrixTransform();
-                                mt->setMatrix(osg::Matrix::scale(assetDef->scale().get(), assetDef->scale().get(), assetDef->scale().get()));
-                                mt->addChild(residentAsset->model().get());
-                                residentAsset->model() = mt;
-                            }
+    // If the width is expressly set (height is optional) we will use it to override any
+    // bounding box computed by the model.
+    if (assetDef->width().isSet() || !residentAsset->boundingBox().valid())
+    {
+        double width = assetDef->width().get();
 
-                            // find materials:
-                            materialLoader.setReferrer(uri.full());
-                            residentAsset->model()->accept(materialLoader);
+        double height =
+            assetDef->height().isSet() ? assetDef->height().get() :
+            residentAsset->boundingBox().valid() ? residentAsset->boundingBox().zMax() :
+            assetDef->height().get();
 
-                            // add flexors:
-                            bool isUndergrowth = assetDef->group() == "undergrowth";
-                            addFlexors(residentAsset->model(), assetDef->stiffness().get(), isUndergrowth);
+        residentAsset->boundingBox().set(-width, -width, 0.0, width, width, height);
+    }
 
-                            modelcache[uri]._node = residentAsset->model().get();
+    URI sideBB;
+    if (assetDef->sideBillboardURI().isSet())
+        sideBB = assetDef->sideBillboardURI().get();
+    else if (assetDef->modelURI().isSet())
+        sideBB = URI(assetDef->modelURI()->full() + ".side.png", assetDef->modelURI()->context());
 
-                            osg::ComputeBoundsVisitor cbv;
-                            residentAsset->model()->accept(cbv);
-                            residentAsset->boundingBox() = cbv.getBoundingBox();
-                            modelcache[uri]._modelAABB = residentAsset->boundingBox();
+    float impostorFarLODScale = 1.0f;
 
-                            OE_DEBUG << LC << "Loaded model: " << uri.base() << 
-                                " with bbox " << residentAsset->boundingBox().xMin() << " "
-                                << residentAsset->boundingBox().yMin() << " "
-                                << residentAsset->boundingBox().xMax() << " "
-                                << residentAsset->boundingBox().yMax() <<
-                                std::endl;
-                        }
-                        else
-                        {
-                            OE_WARN << LC << "Failed to load model " << uri.full() << std::endl;
-                        }
-                    }
+    if (!sideBB.empty())
+    {
+        const URI& uri = sideBB;
+
+        ResidentModelAsset::Ptr sharedSide;
+        {
+            std::lock_guard<std::mutex> lock(caches.mutex);
+            auto ic = caches.texcache.find(uri);
+            if (ic != caches.texcache.end())
+                sharedSide = ic->second;
+        }
+
+        if (sharedSide)
+        {
+            residentAsset->sideBillboardTex() = sharedSide->sideBillboardTex();
+            residentAsset->sideBillboardNormalMap() = sharedSide->sideBillboardNormalMap();
+            residentAsset->sideBillboardPBRMap() = sharedSide->sideBillboardPBRMap();
+        }
+        else
+        {
+            osg::ref_ptr<osg::Image> image = uri.getImage(readOptions);
+            if (image.valid())
+            {
+                residentAsset->sideBillboardTex() = new osg::Texture2D(image.get());
+
+                OE_DEBUG << LC << "Loaded side BB: " << uri.base() << std::endl;
+                texturesToShare.push_back(uri);
+
+                // normal map:
+                URI normalMapURI(getNormalMapFileName(uri.full()));
+                osg::ref_ptr<osg::Image> normalMap = normalMapURI.getImage(readOptions);
+                if (normalMap.valid())
+                {
+                    OE_DEBUG << LC << "Loaded NML: " << normalMapURI.base() << std::endl;
+                    residentAsset->sideBillboardNormalMap() = new osg::Texture2D(normalMap.get());
+                }
+                else
+                {
+                    OE_INFO << LC << "Failed to load: " << normalMapURI.base() << std::endl;
                 }
 
-                // If the width is expressly set (height is optional) we will use it to override any
-                // bounding box computed by the model.
-                if (assetDef->width().isSet() || !residentAsset->boundingBox().valid())
+                URI pbrMapURI(getPBRMapFileName(uri.full()));
+                osg::ref_ptr<osg::Image> pbrMap = pbrMapURI.getImage(readOptions);
+                if (pbrMap.valid())
+                {
+                    OE_DEBUG << LC << "Loaded PBR: " << pbrMapURI.base() << std::endl;
+                    residentAsset->sideBillboardPBRMap() = new osg::Texture2D(pbrMap);
+                }
+                else
                 {
-                    double width = assetDef->width().get();
+                    OE_INFO << LC << "Failed to load: " << pbrMapURI.base() << std::endl;
+                }
+            }
+            else
+            {
+                OE_WARN << LC << "Failed to load side billboard " << uri.full() << std::endl;
+            }
+        }
 
-                    double height =
-                        assetDef->height().isSet() ? assetDef->height().get() :
-                        residentAsset->boundingBox().valid() ? residentAsset->boundingBox().zMax() :
-                        assetDef->height().get();
+        URI topBB;
+        if (assetDef->topBillboardURI().isSet())
+            topBB = assetDef->topBillboardURI().get();
+        else if (assetDef->modelURI().isSet())
+            topBB = URI(assetDef->modelURI()->full() + ".top.png", assetDef->modelURI()->context());
 
-                    residentAsset->boundingBox().set(-width, -width, 0.0, width, width, height);
-                }
+        if (!topBB.empty())
+        {
+            const URI& uri = topBB;
 
-                URI sideBB;
-                if (assetDef->sideBillboardURI().isSet())
-                    sideBB = assetDef->sideBillboardURI().get();
-                else if (assetDef->modelURI().isSet())
-                    sideBB = URI(assetDef->modelURI()->full() + ".side.png", assetDef->modelURI()->context());
-                
-                float impostorFarLODScale = 1.0f;
+            ResidentModelAsset::Ptr sharedTop;
+            {
+                std::lock_guard<std::mutex> lock(caches.mutex);
+                auto ic = caches.texcache.find(uri);
+                if (ic != caches.texcache.end())
+                    sharedTop = ic->second;
+            }
 
-                if (!sideBB.empty())
+            if (sharedTop)
+            {
+                residentAsset->topBillboardTex() = sharedTop->topBillboardTex();
+                residentAsset->topBillboardNormalMap() = sharedTop->topBillboardNormalMap();
+                residentAsset->topBillboardPBRMap() = sharedTop->topBillboardPBRMap();
+            }
+            else
+            {
+                osg::ref_ptr<osg::Image> image = uri.getImage(readOptions);
+                if (image.valid())
                 {
-                    const URI& uri = sideBB;
+                    residentAsset->topBillboardTex() = new osg::Texture2D(image.get());
+
+                    OE_DEBUG << LC << "Loaded top BB: " << uri.base() << std::endl;
+                    texturesToShare.push_back(uri);
 
-                    auto ic = texcache.find(uri);
-                    if (ic != texcache.end())
+                    // normal map:
+                    URI normalMapURI(getNormalMapFileName(uri.full()));
+                    osg::ref_ptr<osg::Image> normalMap = normalMapURI.getImage(readOptions);
+                    if (normalMap.valid())
                     {
-                        residentAsset->sideBillboardTex() = ic->second->sideBillboardTex();
-                        residentAsset->sideBillboardNormalMap() = ic->second->sideBillboardNormalMap();
-                        residentAsset->sideBillboardPBRMap() = ic->second->sideBillboardPBRMap();
+                        OE_DEBUG << LC << "Loaded NML: " << normalMapURI.base() << std::endl;
+                        residentAsset->topBillboardNormalMap() = new osg::Texture2D(normalMap.get());
                     }
                     else
                     {
-                        osg::ref_ptr<osg::Image> image = uri.getImage(readOptions);
-                        if (image.valid())
-                        {
-                            residentAsset->sideBillboardTex() = new osg::Texture2D(image.get());
-
-                            OE_DEBUG << LC << "Loaded side BB: " << uri.base() << std::endl;
-                            texcache[uri] = residentAsset;
-
-                            // normal map:
-                            URI normalMapURI(getNormalMapFileName(uri.full()));
-                            osg::ref_ptr<osg::Image> normalMap = normalMapURI.getImage(readOptions);
-                            if (normalMap.valid())
-                            {
-                                OE_DEBUG << LC << "Loaded NML: " << normalMapURI.base() << std::endl;
-                                residentAsset->sideBillboardNormalMap() = new osg::Texture2D(normalMap.get());
-                            }
-                            else
-                            {
-                                OE_INFO << LC << "Failed to load: " << normalMapURI.base() << std::endl;
-                            }
-
-                            URI pbrMapURI(getPBRMapFileName(uri.full()));
-                            osg::ref_ptr<osg::Image> pbrMap = pbrMapURI.getImage(readOptions);
-                            if (pbrMap.valid())
-                            {
-                                OE_DEBUG << LC << "Loaded PBR: " << pbrMapURI.base() << std::endl;
-                                residentAsset->sideBillboardPBRMap() = new osg::Texture2D(pbrMap);
-                            }
-                            else
-                            {
-                                OE_INFO << LC << "Failed to load: " << pbrMapURI.base() << std::endl;
-                            }
-                        }
-                        else
-                        {
-                            OE_WARN << LC << "Failed to load side billboard " << uri.full() << std::endl;
-                        }
+                        OE_INFO << LC << "Failed to load: " << normalMapURI.base() << std::endl;
                     }
 
-                    URI topBB;
-                    if (assetDef->topBillboardURI().isSet())
-                        topBB = assetDef->topBillboardURI().get();
-                    else if (assetDef->modelURI().isSet())
-                        topBB = URI(assetDef->modelURI()->full() + ".top.png", assetDef->modelURI()->context());
-
-                    if (!topBB.empty())
+                    // PBR map:
+                    URI pbrMapURI(getPBRMapFileName(uri.full()));
+                    osg::ref_ptr<osg::Image> pbrMap = pbrMapURI.getImage(readOptions);
+                    if (pbrMap.valid())
                     {
-                        const URI& uri = topBB;
-
-                        auto ic = texcache.find(uri);
-                        if (ic != texcache.end())
-                        {
-                            residentAsset->topBillboardTex() = ic->second->topBillboardTex();
-                            residentAsset->topBillboardNormalMap() = ic->second->topBillboardNormalMap();
-                            residentAsset->topBillboardPBRMap() = ic->second->topBillboardPBRMap();
-                        }
-                        else
-                        {
-                            osg::ref_ptr<osg::Image> image = uri.getImage(readOptions);
-                            if (image.valid())
-                            {
-                                residentAsset->topBillboardTex() = new osg::Texture2D(image.get());
-
-                                OE_DEBUG << LC << "Loaded top BB: " << uri.base() << std::endl;
-                                texcache[uri] = residentAsset;
-
-                                // normal map:
-                                URI normalMapURI(getNormalMapFileName(uri.full()));
-                                osg::ref_ptr<osg::Image> normalMap = normalMapURI.getImage(readOptions);
-                                if (normalMap.valid())
-                                {
-                                    OE_DEBUG << LC << "Loaded NML: " << normalMapURI.base() << std::endl;
-                                    residentAsset->topBillboardNormalMap() = new osg::Texture2D(normalMap.get());
-                                }
-                                else
-                                {
-                                    OE_INFO << LC << "Failed to load: " << normalMapURI.base() << std::endl;
-                                }
-
-                                // PBR map:
-                                URI pbrMapURI(getPBRMapFileName(uri.full()));
-                                osg::ref_ptr<osg::Image> pbrMap = pbrMapURI.getImage(readOptions);
-                                if (pbrMap.valid())
-                                {
-                                    OE_DEBUG << LC << "Loaded PBR: " << pbrMapURI.base() << std::endl;
-                                    residentAsset->topBillboardPBRMap() = new osg::Texture2D(pbrMap);
-                                }
-                                else
-                                {
-                                    OE_INFO << LC << "Failed to load: " << pbrMapURI.base() << std::endl;
-                                }
-                            }
-                            else
-                            {
-                                OE_WARN << LC << "Failed to load top billboard " << uri.full() << std::endl;
-                            }
-                        }
+                        OE_DEBUG << LC << "Loaded PBR: " << pbrMapURI.base() << std::endl;
+                        residentAsset->topBillboardPBRMap() = new osg::Texture2D(pbrMap);
                     }
-
-                    std::vector<osg::Texture*> textures(6);
-                    textures[0] = residentAsset->sideBillboardTex().get();
-                    textures[1] = residentAsset->sideBillboardNormalMap().get();
-                    textures[2] = residentAsset->sideBillboardPBRMap().get();
-                    textures[3] = residentAsset->topBillboardTex().get();
-                    textures[4] = residentAsset->topBillboardNormalMap().get();
-                    textures[5] = residentAsset->topBillboardPBRMap().get();
-
-                    // if this group has an impostor creation function, call it
-                    auto iter = _createImpostorFunctions.find(assetDef->group());
-                    if (iter != _createImpostorFunctions.end())
+                    else
                     {
-                        auto& createImpostor = iter->second;
-
-                        if (createImpostor != nullptr)
-                        {
-                            auto& bbox = residentAsset->boundingBox();
+                        OE_INFO << LC << "Failed to load: " << pbrMapURI.base() << std::endl;
+                    }
+                }
+                else
+                {
+                    OE_WARN << LC << "Failed to load top billboard " << uri.full() << std::endl;
+                }
+            }
+        }
 
-                            float top_z = 0.33f * (bbox.zMax() - bbox.zMin());
+        std::vector<osg::Texture*> textures(6);
+        textures[0] = residentAsset->sideBillboardTex().get();
+        textures[1] = residentAsset->sideBillboardNormalMap().get();
+        textures[2] = residentAsset->sideBillboardPBRMap().get();
+        textures[3] = residentAsset->topBillboardTex().get();
+        textures[4] = residentAsset->topBillboardNormalMap().get();
+        textures[5] = residentAsset->topBillboardPBRMap().get();
+
+        // if this group has an impostor creation function, call it
+        auto iter = caches.createImpostorFunctions.find(assetDef->group());
+        if (iter != caches.createImpostorFunctions.end())
+        {
+            auto& createImpostor = iter->second;
 
-                            if (residentAsset->assetDef()->topBillboardHeight().isSet())
-                            {
-                                top_z = residentAsset->assetDef()->topBillboardHeight().value();
-                            }
-                            else if (residentAsset->sideBillboardTex().valid())
-                            {
-                                float v = computeTopBillboardPosition(residentAsset->sideBillboardTex()->getImage(0));
-                                if (v >= 0.0f)
-                                {
-                                    top_z = v * (bbox.zMax() - bbox.zMin());
-                                }
-                            }
+            if (createImpostor != nullptr)
+            {
+                auto& bbox = residentAsset->boundingBox();
 
-                            Impostor imp = createImpostor(
-                                bbox,
-                                top_z,
-                                textures);
+                float top_z = 0.33f * (bbox.zMax() - bbox.zMin());
 
-                            // post-process if there's a post-URI callback.
-                            // This is so the Impostor can have extended materials injected.
-                            URIPostReadCallback* post = URIPostReadCallback::from(readOptions);
-                            if (post)
-                            {
-                               ReadResult result(imp._node);
-                               (*post)(result);
-                            }
+                if (residentAsset->assetDef()->topBillboardHeight().isSet())
+                {
+                    top_z = residentAsset->assetDef()->topBillboardHeight().value();
+                }
+                else if (residentAsset->sideBillboardTex().valid())
+                {
+                    float v = computeTopBillboardPosition(residentAsset->sideBillboardTex()->getImage(0));
+                    if (v >= 0.0f)
+                    {
+                        top_z = v * (bbox.zMax() - bbox.zMin());
+                    }
+                }
 
-                            residentAsset->impostor() = imp._node;
-                            impostorFarLODScale = imp._farLODScale;
+                Impostor imp = createImpostor(
+                    bbox,
+                    top_z,
+                    textures);
 
-                            // if no MAIN model exists, just re-use the impostor as the 
-                            // main model!
-                            if (!residentAsset->model().valid())
-                            {
-                                residentAsset->model() = residentAsset->impostor().get();
-                            }
-                        }
-                    }
+                // post-process if there's a post-URI callback.
+                // This is so the Impostor can have extended materials injected.
+                URIPostReadCallback* post = URIPostReadCallback::from(readOptions);
+                if (post)
+                {
+                   ReadResult result(imp._node);
+                   (*post)(result);
                 }
 
-                // Finally, chonkify.
-                if (residentAsset->model().valid())
+                residentAsset->impostor() = imp._node;
+                impostorFarLODScale = imp._farLODScale;
+
+                // if no MAIN model exists, just re-use the impostor as the 
+                // main model!
+                if (!residentAsset->model().valid())
                 {
-                    // Replace impostor with 3D model "N" times closer than the SSE:
-                    float far_pixel_scale = getLODTransitionPixelScale();
+                    residentAsset->model() = residentAsset->impostor().get();
+                }
+            }
+        }
+    }
+
+    // Finally, chonkify.
+    if (residentAsset->model().valid())
+    {
+        // Replace impostor with 3D model "N" times closer than the SSE:
+        float far_pixel_scale = getLODTransitionPixelScale();
 
-                    // Real model can get as close as it wants:
-                    float near_pixel_scale = FLT_MAX;
+        // Real model can get as close as it wants:
+        float near_pixel_scale = FLT_MAX;
 
-                    if (residentAsset->chonk() == nullptr)
-                    {
-                        residentAsset->chonk() = Chonk::create();
-                        residentAsset->chonk()->name() = residentAsset->assetDef()->name();
-                    }
+        if (residentAsset->chonk() == nullptr)
+        {
+            residentAsset->chonk() = Chonk::create();
+            residentAsset->chonk()->name() = residentAsset->assetDef()->name();
+        }
 
 #if 0
-                    // FOR DEBUGGING - ADD A CHONK THAT VISUALIZES THE NORMALS
-                    osg::ref_ptr<osg::Group> debuggroup = new osg::Group();
-                    debuggroup->addChild(residentAsset->model());
-                    debuggroup->addChild(makeDebugModel(residentAsset->model().get()));
+        // FOR DEBUGGING - ADD A CHONK THAT VISUALIZES THE NORMALS
+        osg::ref_ptr<osg::Group> debuggroup = new osg::Group();
+        debuggroup->addChild(residentAsset->model());
+        debuggroup->addChild(makeDebugModel(residentAsset->model().get()));
 
-                    if (residentAsset->chonk() == nullptr)
-                        residentAsset->chonk() = Chonk::create();
+        if (residentAsset->chonk() == nullptr)
+            residentAsset->chonk() = Chonk::create();
 
-                    residentAsset->chonk()->add(
-                        debuggroup,
-                        getLODTransitionPixelScale(),
-                        FLT_MAX,
-                        factory);
+        residentAsset->chonk()->add(
+            debuggroup,
+            getLODTransitionPixelScale(),
+            FLT_MAX,
+            factory);
 
 #else
 
-                    residentAsset->chonk()->add(
-                        residentAsset->model().get(),
-                        far_pixel_scale,
-                        near_pixel_scale,
-                        factory);
+        residentAsset->chonk()->add(
+            residentAsset->model().get(),
+            far_pixel_scale,
+            near_pixel_scale,
+            factory);
 #endif
-                }
+    }
 
-                if (residentAsset->impostor().valid())
-                {
-                    // Fade out the impostor at this pixel scale (i.e., multiple of SSE)
-                    float far_pixel_scale = impostorFarLODScale;
+    if (residentAsset->impostor().valid())
+    {
+        // Fade out the impostor at this pixel scale (i.e., multiple of SSE)
+        float far_pixel_scale = impostorFarLODScale;
 
-                    // Fade the impostor to the 3D model at this pixel scale:
-                    float near_pixel_scale = residentAsset->model().valid() ?
-                        getLODTransitionPixelScale() : 
-                        FLT_MAX;
+        // Fade the impostor to the 3D model at this pixel scale:
+        float near_pixel_scale = residentAsset->model().valid() ?
+            getLODTransitionPixelScale() : 
+            FLT_MAX;
 
-                    if (residentAsset->chonk() == nullptr)
-                    {
-                        residentAsset->chonk() = Chonk::create();
-                        residentAsset->chonk()->name() = residentAsset->assetDef()->name();
-                    }
+        if (residentAsset->chonk() == nullptr)
+        {
+            residentAsset->chonk() = Chonk::create();
+            residentAsset->chonk()->name() = residentAsset->assetDef()->name();
+        }
 
-                    residentAsset->chonk()->add(
-                        residentAsset->impostor().get(),
-                        far_pixel_scale,
-                        near_pixel_scale,
-                        factory);
-                }
-            }
+        residentAsset->chonk()->add(
+            residentAsset->impostor().get(),
+            far_pixel_scale,
+            near_pixel_scale,
+            factory);
+    }
 
-            // If this data successfully materialized, add it to the
-            // biome's instance collection.
-            if (residentAsset->sideBillboardTex().valid() || residentAsset->model().valid())
-            {
-                ResidentModelAssetInstance instance;
-                instance.residentAsset() = residentAsset;
-                instance.weight() = asset_ptr->weight();
-                instance.coverage() = asset_ptr->coverage();
-                assetInstances.push_back(std::move(instance));
-            }
-        }   
+    if (!texturesToShare.empty())
+    {
+        std::lock_guard<std::mutex> lock(caches.mutex);
+        for (auto& uri : texturesToShare)
+            caches.texcache[uri] = residentAsset;
     }
+
+    return residentAsset;
 }
 
 void
@@ -846,17 +1262,20 @@ BiomeManager::setCreateImpostorFunction(
 }
 
 BiomeManager::ResidentBiomesById
-BiomeManager::getResidentBiomes(const osgDB::Options* readOptions)
+BiomeManager::getResidentBiomes(
+    const osgDB::Options* readOptions,
+    bool waitForAssets)
 {
     OE_PROFILING_ZONE;
 
     // First refresh the resident biome collection based on current refcounts
-    recalculateResidentBiomes();
+    recalculateResidentBiomes(false);
 
     // Next go through and load any assets that are not yet loaded
-    materializeNewAssets(readOptions);
+    materializeNewAssets(readOptions, waitForAssets || !_asyncLoading);
 
     // Make a copy:
+    std::lock_guard<std::mutex> lock(_residentData_mutex);
     ResidentBiomesById result = _residentBiomes;
 
     return std::move(result);
@@ -36,6 +36,8 @@
 
 #define LC "[" << className() << "] \"" << getName() << "\" "
 
+#define ARENA_LIFEMAP "oe.lifemap"
+
 using namespace osgEarth;
 using namespace osgEarth::Procedural;
 
@@ -56,6 +58,7 @@ LifeMapLayer::Options::getConfig() const
     conf.set("color_weight", colorWeight());
     conf.set("noise_weight", noiseWeight());
     conf.set("lush_factor", lushFactor());
+    conf.set("threads", threads());
     return conf;
 }
 
@@ -73,6 +76,7 @@ LifeMapLayer::Options::fromConfig(const Config& conf)
     conf.get("color_weight", colorWeight());
     conf.get("noise_weight", noiseWeight());
     conf.get("lush_factor", lushFactor());
+    conf.get("threads", threads());
 }
 
 //........................................................................
@@ -101,7 +105,7 @@ namespace
             _invFactor = 1.0f / _factor;
         }
 
-        void scaleCoordsToRefLOD(osg::Vec2d& tc, const TileKey& key)
+        void scaleCoordsToRefLOD(osg::Vec2d& tc, const TileKey& key) const
         {
             if (key.getLOD() <= _refLOD)
                 return;
@@ -182,12 +186,19 @@ LifeMapLayer::openImplementation()
 
     setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
 
+    // Row jobs are always joined by the thread creating the tile,
+    // so the pool must not steal work or it could end up waiting on itself.
+    auto pool = jobs::get_pool(ARENA_LIFEMAP);
+    pool->set_can_steal_work(false);
+    pool->set_concurrency(std::max(1u, getThreads()));
+
     return Status::OK();
 }
 
 Status
 LifeMapLayer::closeImplementation()
 {
+    _landCoverWorkingSet.clear();
     return super::closeImplementation();
 }
 
@@ -250,6 +261,7 @@ void
 LifeMapLayer::removedFromMap(const Map* map)
 {
     _map = nullptr;
+    _landCoverWorkingSet.clear();
     options().biomeLayer().removedFromMap(map);
     options().maskLayer().removedFromMap(map);
     options().waterLayer().removedFromMap(map);
@@ -390,6 +402,19 @@ LifeMapLayer::getUseNoise() const
     return getNoiseWeight() > 0.0f;
 }
 
+void
+LifeMapLayer::setThreads(unsigned value)
+{
+    options().threads() = value;
+    jobs::get_pool(ARENA_LIFEMAP)->set_concurrency(std::max(1u, value));
+}
+
+unsigned
+LifeMapLayer::getThreads() const
+{
+    return options().threads().get();
+}
+
 #define NUM_INPUTS 4
 
 #define NOISE 0
@@ -427,8 +452,19 @@ LifeMapLayer::createImageImplementation(
     MetaTile<GeoCoverage<LandCoverSample>> landcover;
     if (_landCoverFactory)
     {
-        auto creator = [&](const TileKey& key, ProgressCallback* p) {
-            return _landCoverFactory->createCoverage(key, p);
+        // coverage made before the land cover layer changed is stale
+        const int revision = getLandCoverLayer() ? getLandCoverLayer()->getRevision() : 0;
+
+        auto creator = [&](const TileKey& key, ProgressCallback* p)
+            {
+                LandCoverWorkingSet::Record record;
+                if (_landCoverWorkingSet.get(key, record) && record.value().first == revision)
+                    return record.value().second;
+
+                auto coverage = _landCoverFactory->createCoverage(key, p);
+                if (coverage.valid())
+                    _landCoverWorkingSet.insert(key, std::make_pair(revision, coverage));
+                return coverage;
             };
         landcover.setCreateTileFunction(creator);
         landcover.setCenterTileKey(key, progress);
@@ -517,25 +553,15 @@ LifeMapLayer::createImageImplementation(
         GL_RGBA,
         GL_UNSIGNED_BYTE);
 
-    ImageUtils::PixelWriter write(image.get());
-
-    float elevation;
-    osg::Vec3 normal;
-    float slope;
     const osg::Vec3 up(0, 0, 1);
 
-    std::string lu_id;
-    osg::Vec4f hsl;
-
-    osg::Vec2d noiseCoords[NOISE_LEVELS];
-    osg::Vec4 noise[NOISE_LEVELS];
     const unsigned noiseLOD[NOISE_LEVELS] = { 10u, 14u };
     //    12u, 13u, 14u, 15u //, 16u // 0u, 9u, 13u, 16u
     //};
     const unsigned noisePattern[NOISE_LEVELS] = { RANDOM, CLUMPY };
     //RANDOM, SMOOTH, CLUMPY, RANDOM2 };
 
-    CoordScaler coordScalers[NOISE_LEVELS] = {
+    const CoordScaler coordScalers[NOISE_LEVELS] = {
         CoordScaler(key.getProfile(), key.getLOD(), noiseLOD[0]),
         CoordScaler(key.getProfile(), key.getLOD(), noiseLOD[1]) //,
         //CoordScaler(key.getProfile(), key.getLOD(), noiseLOD[2]),
@@ -553,8 +579,6 @@ LifeMapLayer::createImageImplementation(
 
     // land cover blurring values
     double lc_blur_m = std::max(0.0, options().landCoverBlur()->as(Units::METERS));
-    double lc_blur_u = lc_blur_m / width_m;
-    double lc_blur_v = lc_blur_m / height_m;
 
     double mpp_x = width_m / (double)getTileSize();
     double mpp_y = height_m / (double)getTileSize();
@@ -570,25 +594,63 @@ LifeMapLayer::createImageImplementation(
         }
     }
 
-    std::minstd_rand gen(key.hash());
+    // Everything the pixel kernel needs to know about the layer settings,
+    // resolved once per tile instead of once per pixel:
+    const bool useNoise = getUseNoise();
+    const float noiseWeight = getNoiseWeight();
+    const bool useLandCover = getLandCoverLayer() && landcover.valid();
+    const float landCoverWeight = getLandCoverWeight();
+    const bool useLandCoverBlur = !equivalent(lc_blur_m, 0.0);
+    const int lc_blur_s = (int)(lc_blur_m / mpp_x);
+    const int lc_blur_t = (int)(lc_blur_m / mpp_y);
+    const bool useMaterials = getBiomeLayer() != nullptr;
+    const float colorWeight = getColorWeight();
+    const bool useTerrain = getUseTerrain() && elevTile.valid();
+    const float terrainWeight = getTerrainWeight();
+    const float slopeIntensity = options().slopeIntensity().get();
+
+    // The metatile loads neighboring land cover tiles the first time a read
+    // lands in them, which isn't thread-safe. So touch the corners and edges
+    // of the area the kernel will read (including the blur radius) up front.
+    if (useLandCover)
+    {
+        const int size = (int)getTileSize();
+        const int ds = useLandCoverBlur ? lc_blur_s : 0;
+        const int dt = useLandCoverBlur ? lc_blur_t : 0;
+        for (int ss : { -ds, size / 2, size - 1 + ds })
+            for (int tt : { -dt, size / 2, size - 1 + dt })
+                landcover.read(ss, tt);
+    }
 
-    GeoImage result(image.get(), extent);
+    const double bu = 0.5 / (double)image->s();
+    const double bv = 0.5 / (double)image->t();
 
-    {
-        OE_PROFILING_ZONE_NAMED("RasterizeLifeMap");
+    // same conversion PixelWriter uses for GL_UNSIGNED_BYTE
+    const double byteScale = 1.0 / 255.0;
 
-        double bu = 0.5 / (double)image->s();
-        double bv = 0.5 / (double)image->t();
+    // Rasterizes rows [t0, t1) straight into the RGBA8 image. Rows are
+    // independent, so any number of these can run at once as long as each
+    // has its own copy of the (already loaded) land cover metatile.
+    auto rasterizeRows = [&](unsigned t0, unsigned t1, MetaTile<GeoCoverage<LandCoverSample>>& lc)
+    {
+        osg::Vec2d noiseCoords[NOISE_LEVELS];
+        osg::Vec4 noise[NOISE_LEVELS];
+        osg::Vec4f hsl;
 
-        for (unsigned int t = 0; t < result.t(); ++t)
+        for (unsigned int t = t0; t < t1; ++t)
         {
+            if (progress && progress->isCanceled())
+                return;
+
             double v = bv + ((double)t * 2.0 * bv);
-            double y = result.getExtent().yMin() + result.getExtent().height() * v;
+            double y = extent.yMin() + extent.height() * v;
 
-            for (unsigned int s = 0; s < result.s(); ++s)
+            GLubyte* out = image->data(0, t);
+
+            for (unsigned int s = 0; s < (unsigned)image->s(); ++s, out += 4)
             {
                 double u = bu + ((double)s * 2.0 * bu);
-                double x = result.getExtent().xMin() + result.getExtent().width() * u;
+                double x = extent.xMin() + extent.width() * u;
 
                 osg::Vec4f pixel[NUM_INPUTS];
                 float weight[NUM_INPUTS] = { 0,0,0,0 };
@@ -598,7 +660,7 @@ LifeMapLayer::createImageImplementation(
                 unsigned customMaterialIndex = 0u;
 
                 // NOISE contribution
-                if (getUseNoise())
+                if (useNoise)
                 {
                     for (int n = 0; n < NOISE_LEVELS; ++n)
                     {
@@ -608,62 +670,37 @@ LifeMapLayer::createImageImplementation(
                             coordScalers[n].scaleCoordsToRefLOD(noiseCoords[n], key);
                             getNoise(noise[n], noiseSampler, noiseCoords[n]);
 
-                            //double L = 1.0; // 1.0 / pow(2.0, double(NOISE_LEVELS - 1 - n));
                             int p = noisePattern[n];
-                            double L = 1.0; //  n == 0 ? 0.25 : 1.0;
 
-                            pixel[NOISE][LIFEMAP_DENSE] += noise[n][p] * L; // 3
-                            pixel[NOISE][LIFEMAP_LUSH] = 0.0; // += noise[n][p] * L; // = 0.0;
+                            pixel[NOISE][LIFEMAP_DENSE] += noise[n][p];
+                            pixel[NOISE][LIFEMAP_LUSH] = 0.0;
 
                             noiseCoords[n].set(v, u);
                             getNoise(noise[n], noiseSampler, noiseCoords[n]);
-                            pixel[NOISE][LIFEMAP_RUGGED] += noise[n][p] * L; // 2
+                            pixel[NOISE][LIFEMAP_RUGGED] += noise[n][p];
                         }
                     }
 
-                    //pixel[NOISE][LIFEMAP_DENSE] = clamp(pixel[NOISE][LIFEMAP_DENSE], 0.0f, 1.0f);
-                    //pixel[NOISE][LIFEMAP_RUGGED] = clamp(pixel[NOISE][LIFEMAP_RUGGED], 0.0f, 1.0f);
-
-                    weight[NOISE] = getNoiseWeight();
+                    weight[NOISE] = noiseWeight;
                 }
 
                 // LAND COVER CONTRIBUTION
-                if (getLandCoverLayer() && landcover.valid())
+                if (useLandCover)
                 {
                     const LandCoverSample* temp;
-                    LandCoverSample sample;
-                    int dense_samples = 0;
-                    int lush_samples = 0;
-                    int rugged_samples = 0;
 
-                    if (equivalent(lc_blur_m, 0.0))
+                    if (!useLandCoverBlur)
                     {
-                        temp = landcover.read((int)s, (int)t);
+                        temp = lc.read((int)s, (int)t);
                         if (temp)
                         {
-#if 0
-                            // RNG with normal distribution between approx +1/-1
-                            const float coverage_stddev = 1.0f / 12.0f; // 6.0f;
-                            {
-                                std::normal_distribution<float> normal_dist(temp->dense().get(), coverage_stddev);
-                                pixel[LANDCOVER][LIFEMAP_DENSE] = clamp(normal_dist(gen), 0.0f, 1.0f);
-                            }
-                            {
-                                std::normal_distribution<float> normal_dist(temp->lush().get(), coverage_stddev);
-                                pixel[LANDCOVER][LIFEMAP_LUSH] = clamp(normal_dist(gen), 0.0f, 1.0f);
-                            }
-                            {
-                                std::normal_distribution<float> normal_dist(temp->rugged().get(), coverage_stddev);
-                                pixel[LANDCOVER][LIFEMAP_RUGGED] = clamp(normal_dist(gen), 0.0f, 1.0f);
-                            }
-#else
                             pixel[LANDCOVER][LIFEMAP_DENSE] = temp->dense().get();
                             pixel[LANDCOVER][LIFEMAP_LUSH] = temp->lush().get();
                             pixel[LANDCOVER][LIFEMAP_RUGGED] = temp->rugged().get();
-#endif
-                            weight[LANDCOVER] = getLandCoverWeight();
 
-                            if (temp->material().isSet() && getBiomeLayer())
+                            weight[LANDCOVER] = landCoverWeight;
+
+                            if (temp->material().isSet() && useMaterials)
                             {
                                 // land cover asked for a custom material. Find its index.
                                 auto i = materialLUT.find(temp->material().get());
@@ -674,15 +711,17 @@ LifeMapLayer::createImageImplementation(
                     }
                     else
                     {
+                        LandCoverSample sample;
+                        int dense_samples = 0;
+                        int lush_samples = 0;
+                        int rugged_samples = 0;
+
                         // read the landcover with a blurring filter.
                         for (int a = -1; a <= 1; ++a)
                         {
                             for (int b = -1; b <= 1; ++b)
                             {
-                                int ss = a * (int)(lc_blur_m / mpp_x);
-                                int tt = b * (int)(lc_blur_m / mpp_y);
-
-                                temp = landcover.read((int)s + ss, (int)t + tt);
+                                temp = lc.read((int)s + a * lc_blur_s, (int)t + b * lc_blur_t);
 
                                 if (temp)
                                 {
@@ -704,7 +743,7 @@ LifeMapLayer::createImageImplementation(
                                         ++rugged_samples;
                                     }
 
-                                    if (temp->material().isSet() && getBiomeLayer())
+                                    if (temp->material().isSet() && useMaterials)
                                     {
                                         // land cover asked for a custom material. Find its index.
                                         auto i = materialLUT.find(temp->material().get());
@@ -720,17 +759,17 @@ LifeMapLayer::createImageImplementation(
                         if (dense_samples > 0)
                         {
                             pixel[LANDCOVER][LIFEMAP_DENSE] = sample.dense().get() / (float)dense_samples;
-                            weight[LANDCOVER] = getLandCoverWeight();
+                            weight[LANDCOVER] = landCoverWeight;
                         }
                         if (lush_samples > 0)
                         {
                             pixel[LANDCOVER][LIFEMAP_LUSH] = sample.lush().get() / (float)lush_samples;
-                            weight[LANDCOVER] = getLandCoverWeight();
+                            weight[LANDCOVER] = landCoverWeight;
                         }
                         if (rugged_samples > 0)
                         {
                             pixel[LANDCOVER][LIFEMAP_RUGGED] = sample.rugged().get() / (float)rugged_samples;
-                            weight[LANDCOVER] = getLandCoverWeight();
+                            weight[LANDCOVER] = landCoverWeight;
                         }
                     }
                 }
@@ -789,8 +828,6 @@ LifeMapLayer::createImageImplementation(
                     greenness = pow(greenness, green_amp);
                     redness = pow(redness, red_amp);
 
-                    float w = options().colorWeight().get();
-
                     pixel[COLOR][LIFEMAP_DENSE] = greenness;
                     pixel[COLOR][LIFEMAP_LUSH] = greenness * (1.0 - hsl.z()); // lighter green is less lush.
                     pixel[COLOR][LIFEMAP_RUGGED] = redness;
@@ -800,26 +837,23 @@ LifeMapLayer::createImageImplementation(
                     if (pow(hsl[2], 5.0f) > 0.5f)
                         weight[COLOR] = 0.0f;
                     else
-                        weight[COLOR] = getColorWeight(); // * max(greeness, redness) ...???
+                        weight[COLOR] = colorWeight; // * max(greeness, redness) ...???
                 }
 
                 // TERRAIN CONTRIBUTION:
-                if (getUseTerrain() && elevTile.valid())
+                if (useTerrain)
                 {
-                    // Establish elevation at this pixel:
-                    elevation = elevTile->getElevation(x, y).elevation().as(Units::METERS);
-
                     // Normal map at this pixel:
-                    normal = elevTile->getNormal(x, y);
+                    osg::Vec3 normal = elevTile->getNormal(x, y);
 
                     // exaggerate the slope value
-                    slope = 1.0 - (normal * up);
-                    float r = decel(slope * options().slopeIntensity().get());
+                    float slope = 1.0 - (normal * up);
+                    float r = decel(slope * slopeIntensity);
                     pixel[TERRAIN][LIFEMAP_RUGGED] = r;
                     pixel[TERRAIN][LIFEMAP_DENSE] = -r;
                     pixel[TERRAIN][LIFEMAP_LUSH] = -r;
 
-                    weight[TERRAIN] = getTerrainWeight();
+                    weight[TERRAIN] = terrainWeight;
                 }
 
                 // CONBINE WITH WEIGHTS:
@@ -878,14 +912,59 @@ LifeMapLayer::createImageImplementation(
                 // Clamp everything to [0..1] and write it out.
                 for (int i = 0; i < 4; ++i)
                 {
-                    combined_pixel[i] = clamp(combined_pixel[i], 0.0f, 1.0f);
+                    out[i] = (GLubyte)(clamp(combined_pixel[i], 0.0f, 1.0f) / byteScale);
                 }
+            }
+        }
+    };
+
+    {
+        OE_PROFILING_ZONE_NAMED("RasterizeLifeMap");
+
+        const unsigned numRows = image->t();
+        const unsigned numJobs = std::min(std::max(1u, getThreads()), numRows);
+        const unsigned rowsPerJob = (numRows + numJobs - 1) / numJobs;
 
-                write(combined_pixel, s, t);
+        if (numJobs > 1u)
+        {
+            jobs::context context;
+            context.name = "LifeMap rows";
+            context.pool = jobs::get_pool(ARENA_LIFEMAP);
+
+            std::vector<Future<bool>> results;
+            for (unsigned j = 1; j < numJobs; ++j)
+            {
+                unsigned t0 = j * rowsPerJob;
+                unsigned t1 = std::min(t0 + rowsPerJob, numRows);
+                if (t0 >= t1)
+                    break;
+
+                results.emplace_back(jobs::dispatch([&rasterizeRows, &landcover, t0, t1](Cancelable&)
+                    {
+                        auto lc = landcover;
+                        rasterizeRows(t0, t1, lc);
+                        return true;
+                    },
+                    context));
             }
+
+            auto lc = landcover;
+            rasterizeRows(0u, std::min(rowsPerJob, numRows), lc);
+
+            for (auto& r : results)
+                r.join();
+        }
+        else
+        {
+            rasterizeRows(0u, numRows, landcover);
         }
     }
 
+    if (progress && progress->isCanceled())
+        return GeoImage::INVALID;
+
+    GeoImage result(image.get(), extent);
+
     return std::move(result);
 }
 
@@ -2,6 +2,7 @@
 #include <osgEarth/SimplePager>
 #include <osgEarth/CropFilter>
 #include <osgEarth/rtree.h>
+#include <osgEarth/Containers>
 #include <osgEarth/FeatureSDFLayer>
 #include <osgEarth/TiledModelLayer>
 #include <osgEarth/TerrainConstraintLayer>
@@ -191,6 +192,7 @@ namespace
         float width; // m
         const properties_t* props = nullptr;
         int order = 0; // render order
+        int base_order = 0; // render order before compile() adjusts it
 
         float angle = 0.0f; // relative to +x axis, used for sorting
 
@@ -351,6 +353,12 @@ namespace
             const auto node2 = nodes.emplace(x2, y2, z).first;
             if (node1->uid == node2->uid) // safety catch; shouldn't happen
                 return nullptr;
+
+            // same segment seen twice (e.g., from overlapping feature queries)
+            for (auto a : node1->edges)
+                if (a->other_node(*node1) == *node2)
+                    return a;
+
             const auto edge_emplace_result = edges.emplace(*node1, *node2, width, props);
             auto edge = const_cast<edge_t*>(&(*edge_emplace_result.first));
             if (!edge_emplace_result.second)
@@ -787,46 +795,44 @@ namespace
         }
     }
 
-    // Calculates all the values needed to render the graph
-    void compile(graph_t& g)
+    // Calculates the values needed to render the graph around the given nodes,
+    // e.g. after new edges were connected to them. Every edge meeting at one
+    // of these nodes gets recompiled at both ends.
+    void compile(const std::unordered_set<node_t*>& nodes)
     {
-        // sort each node's edges by angle.
-        for (auto& n : g.nodes)
-        {
-            auto& node = const_cast<node_t&>(n);
-            std::sort(node.edges.begin(), node.edges.end(), angle_sort(node));
-        }
-
-        // calculate crossing types and backoff distances
-        for (auto& n : g.nodes)
+        // sort each node's edges by angle,
+        // and calculate crossing types and backoff distances
+        std::unordered_set<edge_t*> edges;
+        for (auto node : nodes)
         {
-            auto& node = const_cast<node_t&>(n);
-            compile_intersection(node);
+            std::sort(node->edges.begin(), node->edges.end(), angle_sort(*node));
+            compile_intersection(*node);
+            edges.insert(node->edges.begin(), node->edges.end());
         }
 
         // calculate the join points
-        for (auto& e : g.edges)
+        for (auto edge : edges)
         {
-            auto& edge = const_cast<edge_t&>(e);
+            edge->order = edge->base_order;
 
-            for (const node_t* node : { &edge.node1, &edge.node2 })
+            for (const node_t* node : { &edge->node1, &edge->node2 })
             {
                 if (node->edges.size() == 1)
                 {
-                    compile_end_cap(edge, *node, false); // no backoff needed
+                    compile_end_cap(*edge, *node, false); // no backoff needed
                 }
                 else if (node->edges.size() == 2)
                 {
-                    compile_2way_join(edge, *node);
+                    compile_2way_join(*edge, *node);
                 }
                 else if (node->edges.size() == 3)
                 {
-                    compile_3way_join(edge, *node);
+                    compile_3way_join(*edge, *node);
                 }
                 else
                 {
                     // TODO? Just render the intersection separately in this case.
-                    compile_end_cap(edge, *node, true);
+                    compile_end_cap(*edge, *node, true);
                 }
             }
         }
@@ -858,6 +864,251 @@ namespace
         }
     }
 
+    // Road segment or crossing read from the source features, in the working SRS
+    struct segment_t
+    {
+        point_t p1, p2;
+        float width;
+        int layer;
+        const properties_t* props;
+    };
+
+    // Everything the features of one cell contribute to the network
+    struct cell_data_t
+    {
+        std::vector<segment_t> segments;
+        std::vector<std::pair<point_t, const properties_t*>> crossings;
+    };
+
+    // Something a cell contributed to the road network:
+    // either a road segment or a crossing on a node.
+    struct cell_item_t
+    {
+        edge_t* edge = nullptr;
+        node_t* crossing = nullptr;
+
+        bool operator == (const cell_item_t& rhs) const {
+            return edge == rhs.edge && crossing == rhs.crossing;
+        }
+
+        // hash function for unordered_set/map
+        std::size_t operator()(const cell_item_t& me) const {
+            return std::hash<const void*>()(me.edge ? (const void*)me.edge : (const void*)me.crossing);
+        }
+    };
+
+    // Road topology shared by all the tiles of a layer.
+    //
+    // Features are read and noded one cell (a tile at a fixed LOD) at a time,
+    // so a road that spans many tiles is only assembled once, and adding a
+    // cell only recompiles the junctions its segments touch. Tiles copy their
+    // piece out of the network with extract().
+    //
+    // Each cell holds references to the edges and crossings it read, which
+    // neighboring cells may share. Evicting the least recently used cells
+    // removes the parts no other cell refers to and recompiles the junctions
+    // around them.
+    //
+    // The network is planar; tiles clamp their own copies to the terrain.
+    // Not thread-safe; lock the mutex.
+    struct road_network_t
+    {
+        using index_t = RTree<edge_t*, double, 2>;
+
+        graph_t graph;
+        index_t index;
+        LRUReferences<TileKey, cell_item_t, cell_item_t> cells;
+        std::mutex mutex;
+
+        bool contains(const TileKey& cell) const {
+            return cells.has(cell);
+        }
+
+        // marks a cell as recently used
+        void touch(const TileKey& cell) {
+            cells.touch(cell);
+        }
+
+        void clear() {
+            index.RemoveAll();
+            graph.edges.clear();
+            graph.nodes.clear();
+            graph.num_subgraphs = -1;
+            cells.clear();
+        }
+
+        static void get_bounds(const edge_t* edge, double* min, double* max) {
+            min[0] = std::min(edge->node1.p.x(), edge->node2.p.x());
+            min[1] = std::min(edge->node1.p.y(), edge->node2.p.y());
+            max[0] = std::max(edge->node1.p.x(), edge->node2.p.x());
+            max[1] = std::max(edge->node1.p.y(), edge->node2.p.y());
+        }
+
+        // adds a cell's segments to the network and compiles the junctions they touch.
+        void add(const TileKey& cell, const cell_data_t& data)
+        {
+            std::unordered_set<node_t*> dirty;
+
+            // record the cell even if it has no roads, so we don't read it again
+            cells.touch(cell);
+
+            for (auto& seg : data.segments)
+            {
+                auto num_edges = graph.edges.size();
+                auto* edge = graph.add_edge(seg.p1.x(), seg.p1.y(), seg.p2.x(), seg.p2.y(), 0.0, seg.width, seg.props);
+                if (edge)
+                {
+                    if (graph.edges.size() > num_edges)
+                    {
+                        // higher layers draw later
+                        edge->base_order = seg.layer;
+
+                        double min[2], max[2];
+                        get_bounds(edge, min, max);
+                        index.Insert(min, max, edge);
+
+                        dirty.insert(const_cast<node_t*>(&edge->node1));
+                        dirty.insert(const_cast<node_t*>(&edge->node2));
+                    }
+
+                    cells.add(cell, cell_item_t{ edge, nullptr });
+                }
+            }
+
+            for (auto& crossing : data.crossings)
+            {
+                // the node may already exist, so its junction needs another look
+                auto node = graph.add_node(crossing.first.x(), crossing.first.y(), 0.0, crossing.second);
+                node->has_crossing = true;
+                dirty.insert(node);
+
+                cells.add(cell, cell_item_t{ nullptr, node });
+            }
+
+            compile(dirty);
+        }
+
+        // Evicts the least recently used cells, except the ones in "keep",
+        // until at most "max" remain.
+        void trim(std::size_t max, const std::vector<TileKey>& keep)
+        {
+            if (cells.size() <= max)
+                return;
+
+            std::unordered_set<node_t*> dirty;
+            std::vector<edge_t*> dead_edges;
+
+            cells.trim(
+                max,
+                [&](const TileKey& cell) {
+                    return std::find(keep.begin(), keep.end(), cell) != keep.end();
+                },
+                [&](const cell_item_t& item) {
+                    if (item.edge)
+                    {
+                        dead_edges.push_back(item.edge);
+                    }
+                    else
+                    {
+                        item.crossing->has_crossing = false;
+                        dirty.insert(item.crossing);
+                    }
+                });
+
+            for (auto edge : dead_edges)
+            {
+                double min[2], max[2];
+                get_bounds(edge, min, max);
+                index.Remove(min, max, edge);
+
+                for (const node_t* node : { &edge->node1, &edge->node2 })
+                {
+                    auto& edges = node->edges;
+                    edges.erase(std::remove(edges.begin(), edges.end(), edge), edges.end());
+                    dirty.insert(const_cast<node_t*>(node));
+                }
+
+                graph.edges.erase(graph.edges.find(*edge));
+            }
+
+            // drop the nodes nothing uses anymore
+            for (auto i = dirty.begin(); i != dirty.end(); )
+            {
+                node_t* node = *i;
+                if (node->edges.empty() && !node->has_crossing)
+                {
+                    i = dirty.erase(i);
+                    graph.nodes.erase(graph.nodes.find(*node));
+                }
+                else ++i;
+            }
+
+            compile(dirty);
+        }
+
+        // Copies the edges that intersect the bounds, plus every edge that meets
+        // at a node inside the bounds, into a standalone graph. Only nodes inside
+        // the bounds keep their junction and crossing data, so that each one is
+        // drawn by exactly one tile.
+        void extract(const Bounds& bounds, graph_t& out) const
+        {
+            auto inside = [&](const node_t& n) {
+                return
+                    n.p.x() >= bounds.xMin() && n.p.x() < bounds.xMax() &&
+                    n.p.y() >= bounds.yMin() && n.p.y() < bounds.yMax();
+            };
+
+            std::set<const edge_t*> edges;
+            double min[2] = { bounds.xMin(), bounds.yMin() }, max[2] = { bounds.xMax(), bounds.yMax() };
+            index.Search(min, max, [&](const edge_t* edge) {
+                edges.insert(edge);
+                for (const node_t* node : { &edge->node1, &edge->node2 })
+                    if (inside(*node))
+                        edges.insert(node->edges.begin(), node->edges.end());
+                return true;
+            });
+
+            std::unordered_map<const node_t*, node_t*> nodes;
+
+            for (auto edge : edges)
+            {
+                auto copy = out.add_edge(
+                    edge->node1.p.x(), edge->node1.p.y(),
+                    edge->node2.p.x(), edge->node2.p.y(),
+                    edge->node1.p.z(), edge->width, edge->props);
+
+                if (copy)
+                {
+                    copy->fid = edge->fid;
+                    copy->order = edge->order;
+                    copy->base_order = edge->base_order;
+                    copy->node1_left = edge->node1_left;
+                    copy->node1_right = edge->node1_right;
+                    copy->node2_left = edge->node2_left;
+                    copy->node2_right = edge->node2_right;
+
+                    nodes[&edge->node1] = const_cast<node_t*>(&copy->node1);
+                    nodes[&edge->node2] = const_cast<node_t*>(&copy->node2);
+                }
+            }
+
+            for (auto& iter : nodes)
+            {
+                const node_t& source = *iter.first;
+                node_t& node = *iter.second;
+                bool owner = inside(source);
+
+                node.props = source.props;
+                node.intersection = source.intersection;
+                if (!owner)
+                    node.intersection.type = intersection_t::NONE;
+                node.has_crossing = owner && source.has_crossing;
+
+                std::sort(node.edges.begin(), node.edges.end(), angle_sort(node));
+            }
+        }
+    };
+
 #if 0
     osg::Node* tessellate_edge(const edge_t& edge, std::function<osg::Vec3(const osg::Vec3d&)>& transform)
     {
@@ -1593,6 +1844,8 @@ namespace
         FeatureFilterChain _filterChain; // not needed, use filteredfeaturesource
         art_t _art;
         bool _drawRoadsAtopTerrainSkin = false;
+        unsigned _maxCells = 1024u;
+        mutable road_network_t _network;
 
         void init() override
         {
@@ -1650,82 +1903,69 @@ namespace
         {
             super::removedFromMap(map);
             _features.removedFromMap(map);
+
+            std::lock_guard<std::mutex> lock(_network.mutex);
+            _network.clear();
         }
 
-        void prepareForRendering(TerrainEngine* engine) override
+        // Cells (tiles at the network LOD) covering a key, plus one cell all around.
+        // A low-LOD key uses cells at most two levels down so it doesn't fan out
+        // into thousands of reads; the graph dedupes edges, so mixing is fine.
+        void getCells(const TileKey& key, std::vector<TileKey>& cells) const
         {
-            super::prepareForRendering(engine);
-
-            // blending on, backface culling on
-            auto ss = getOrCreateStateSet();
-            ss->setMode(GL_BLEND, 1);
-            ss->setAttributeAndModes(new osg::CullFace(osg::CullFace::BACK), 1);
-            ss->setAttributeAndModes(new osg::PolygonOffset(-1, -1), 1);
+            unsigned cellLOD = std::min(getMaxLevel(), key.getLOD() + 2u);
 
-            // if the roads aren't cut in, we need some depth magic.
-            if (_drawRoadsAtopTerrainSkin)
+            if (key.getLOD() >= cellLOD)
             {
-                auto vp = VirtualProgram::getOrCreate(getOrCreateStateSet());
-                ShaderLoader::load(vp, decal_shaders);
-                vp->setName("Road Decals");
-
-                ss->setAttributeAndModes(new osg::Depth(osg::Depth::LEQUAL, 0, 1, false), 1);
+                auto cell = key.createAncestorKey(cellLOD);
+                for (int y = -1; y <= 1; ++y)
+                {
+                    for (int x = -1; x <= 1; ++x)
+                    {
+                        auto neighbor = cell.createNeighborKey(x, y);
+                        if (neighbor.valid())
+                            cells.push_back(neighbor);
+                    }
+                }
             }
-        }
-
-        const Profile* getProfile() const override
-        {
-            return Profile::create(Profile::GLOBAL_GEODETIC);
-
-            auto fs = _features.getLayer();
-
-            if (fs && fs->getFeatureProfile())
-                return fs->getFeatureProfile()->getTilingProfile();
             else
-                return nullptr;
+            {
+                unsigned d = cellLOD - key.getLOD();
+                unsigned tx, ty;
+                key.getProfile()->getNumTiles(cellLOD, tx, ty);
+                int x0 = (int)(key.getTileX() << d), y0 = (int)(key.getTileY() << d);
+                int n = (int)(1u << d);
+                for (int y = y0 - 1; y <= y0 + n; ++y)
+                    for (int x = x0 - 1; x <= x0 + n; ++x)
+                        if (y >= 0 && y < (int)ty)
+                            cells.emplace_back(cellLOD, (unsigned)((x + (int)tx) % (int)tx), (unsigned)y, key.getProfile());
+            }
+
+            std::sort(cells.begin(), cells.end());
+            cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
         }
 
-        osg::ref_ptr<osg::Node> createTileImplementation(const TileKey& key, ProgressCallback* progress) const override
+        // Reads the road segments and crossings for one cell.
+        bool readCell(const TileKey& cell, FeatureSource* featureSource, const SpatialReference* working_srs, cell_data_t& output, ProgressCallback* progress) const
         {
-            // take local refs to isolate this method from the member objects
-            auto featureSource(_features.getLayer());
-
-            OE_SOFT_ASSERT_AND_RETURN(featureSource, nullptr);
-            OE_SOFT_ASSERT_AND_RETURN(featureSource->getStatus().isOK(), nullptr);
+            auto featureSRS = featureSource->getFeatureProfile()->getSRS();
 
-            auto featureProfile = featureSource->getFeatureProfile();
-            OE_SOFT_ASSERT_AND_RETURN(featureProfile, nullptr);
+            FilterContext context(_session.get());
+            context.extent() = cell.getExtent().transform(featureSRS);
 
-            auto featureSRS = featureProfile->getSRS();
-            OE_SOFT_ASSERT_AND_RETURN(featureSRS, nullptr);
+            auto cursor = featureSource->createFeatureCursor(cell, _filterChain, &context, progress);
 
-            // Fetch the set of features to render
-            FilterContext context(_session.get());
-            context.extent() = key.getExtent().transform(featureSRS);
+            if (progress && progress->isCanceled())
+                return false;
 
-            auto cursor = featureSource->createFeatureCursor(key, _filterChain, &context, progress);
             if (!cursor.valid())
-                return nullptr;
+                return true;
 
             FeatureList features;
             if (cursor->fill(features) == 0)
-                return nullptr;
-
-#if 0
-            CropFilter crop(CropFilter::METHOD_BBOX);
-            context.extent() = key.getExtent().transform(featureSRS);
-            context = crop.push(features, context);
-#endif
-
-            osg::Group* root = new osg::Group();
-
-            graph_t graph;
-            osg::Vec3d origin(0, 0, 0);
+                return true;
 
-            auto centroid = key.getExtent().getCentroid();
-            //auto working_srs = key.getExtent().getSRS()->createTangentPlaneSRS(centroid.vec3d());
-            auto working_srs = SpatialReference::get("spherical-mercator");
-            auto working_extent = key.getExtent().transform(working_srs);
+            auto working_extent = cell.getExtent().transform(working_srs);
             auto working_bounds = working_extent.bounds();
 
             for (auto& feature : features)
@@ -1770,11 +2010,10 @@ namespace
                 {
                     if (feature->getString("crossing") != "unmarked" && !geom->empty())
                     {
-                        auto pos = (*geom)[0] - origin;
+                        auto pos = (*geom)[0];
                         if (working_extent.contains(osg::Vec3d(pos.x(), pos.y(), z)))
                         {
-                            auto node = graph.add_node(pos.x(), pos.y(), z, art);
-                            node->has_crossing = true;
+                            output.crossings.emplace_back(point_t(pos.x(), pos.y(), z), art);
                         }
                     }
                 }
@@ -1786,10 +2025,10 @@ namespace
                         auto part = iter.next();
                         if (part)
                         {
-                            for (int i = 0; i < part->size() - 1; ++i)
+                            for (int i = 0; i < (int)part->size() - 1; ++i)
                             {
-                                auto p1 = (*part)[i] - origin;
-                                auto p2 = (*part)[i + 1] - origin;
+                                auto p1 = (*part)[i];
+                                auto p2 = (*part)[i + 1];
 
                                 Bounds bounds;
                                 bounds.expandBy(p1);
@@ -1797,22 +2036,7 @@ namespace
 
                                 if (intersects2d(working_bounds, bounds))
                                 {
-                                    // skip segments that don't meet the minimum length requirement
-                                    //while ((p1 - p2).length() <= EPSILON && i < part->size() - 2)
-                                    //{
-                                    //    ++i;
-                                    //    p2 = (*part)[i + 1] - origin;
-                                    //}
-                                    //if (i < part->size() - 1)
-                                    {
-                                        auto* edge = graph.add_edge(p1.x(), p1.y(), p2.x(), p2.y(), z, width, art);
-
-                                        // higher layers draw later
-                                        if (edge)
-                                        {
-                                            edge->order += layer;
-                                        }
-                                    }
+                                    output.segments.push_back({ p1, p2, (float)width, layer, art });
                                 }
                             }
                         }
@@ -1820,17 +2044,113 @@ namespace
                 }
             }
 
+            return true;
+        }
+
+        void prepareForRendering(TerrainEngine* engine) override
+        {
+            super::prepareForRendering(engine);
+
+            // blending on, backface culling on
+            auto ss = getOrCreateStateSet();
+            ss->setMode(GL_BLEND, 1);
+            ss->setAttributeAndModes(new osg::CullFace(osg::CullFace::BACK), 1);
+            ss->setAttributeAndModes(new osg::PolygonOffset(-1, -1), 1);
+
+            // if the roads aren't cut in, we need some depth magic.
+            if (_drawRoadsAtopTerrainSkin)
+            {
+                auto vp = VirtualProgram::getOrCreate(getOrCreateStateSet());
+                ShaderLoader::load(vp, decal_shaders);
+                vp->setName("Road Decals");
+
+                ss->setAttributeAndModes(new osg::Depth(osg::Depth::LEQUAL, 0, 1, false), 1);
+            }
+        }
+
+        const Profile* getProfile() const override
+        {
+            return Profile::create(Profile::GLOBAL_GEODETIC);
+
+            auto fs = _features.getLayer();
+
+            if (fs && fs->getFeatureProfile())
+                return fs->getFeatureProfile()->getTilingProfile();
+            else
+                return nullptr;
+        }
+
+        osg::ref_ptr<osg::Node> createTileImplementation(const TileKey& key, ProgressCallback* progress) const override
+        {
+            // take local refs to isolate this method from the member objects
+            auto featureSource(_features.getLayer());
+
+            OE_SOFT_ASSERT_AND_RETURN(featureSource, nullptr);
+            OE_SOFT_ASSERT_AND_RETURN(featureSource->getStatus().isOK(), nullptr);
+
+            auto featureProfile = featureSource->getFeatureProfile();
+            OE_SOFT_ASSERT_AND_RETURN(featureProfile, nullptr);
+
+            auto featureSRS = featureProfile->getSRS();
+            OE_SOFT_ASSERT_AND_RETURN(featureSRS, nullptr);
+
+            auto centroid = key.getExtent().getCentroid();
+            auto working_srs = SpatialReference::get("spherical-mercator");
+            auto working_extent = key.getExtent().transform(working_srs);
+
+            // Cells this tile needs. The ring of neighbors makes sure that
+            // edges leaving the tile are joined properly at their far ends.
+            std::vector<TileKey> cells;
+            getCells(key, cells);
+
+            // Read the cells we don't have yet. Do this without the lock,
+            // since it's the expensive part; a cell read twice by racing
+            // tiles is harmless. Another tile may evict a cell between our
+            // two looks at the network, so go around again for those; every
+            // cell we read stays in new_data, so this ends quickly.
+            std::unordered_map<TileKey, cell_data_t> new_data;
+            graph_t graph;
+
+            for (;;)
+            {
+                std::vector<TileKey> missing;
+                {
+                    std::lock_guard<std::mutex> lock(_network.mutex);
+
+                    for (auto& cell : cells)
+                        if (!_network.contains(cell) && new_data.find(cell) == new_data.end())
+                            missing.push_back(cell);
+
+                    if (missing.empty())
+                    {
+                        for (auto& cell : cells)
+                        {
+                            if (_network.contains(cell))
+                                _network.touch(cell);
+                            else
+                                _network.add(cell, new_data[cell]);
+                        }
+
+                        _network.trim(std::max((std::size_t)_maxCells, cells.size()), cells);
+
+                        _network.extract(working_extent.bounds(), graph);
+                        break;
+                    }
+                }
+
+                for (auto& cell : missing)
+                {
+                    if (!readCell(cell, featureSource, working_srs, new_data[cell], progress))
+                        return nullptr;
+                }
+            }
+
             if (graph.edges.empty())
             {
                 return {};
             }
 
-            // OSM data should be properly noded. Any intersecting edges
-            // are likely layered data (e.g. bridges, overpasses, tunnels).
-            //graph.split_intersecting_edges();
-
-            // Compile the 3D geometry:
-            compile(graph);
+            osg::Group* root = new osg::Group();
 
             // Clamp to the terrain:
             auto pool = _session->getMap()->getElevationPool();
@@ -1888,6 +2208,7 @@ RoadLayer::Options::fromConfig(const Config& conf)
     conf.get("use_constraints", useConstraints());
     conf.get("substrate_min_level", substrateMinLevel());
     conf.get("constraints_min_level", constraintsMinLevel());
+    conf.get("topology_cache_size", topologyCacheSize());
 }
 
 Config
@@ -1899,6 +2220,7 @@ RoadLayer::Options::getConfig() const
     conf.set("use_constraints", useConstraints());
     conf.set("substrate_min_level", substrateMinLevel());
     conf.set("constraints_min_level", constraintsMinLevel());
+    conf.set("topology_cache_size", topologyCacheSize());
     return conf;
 }
 
@@ -1963,6 +2285,7 @@ RoadLayer::openImplementation()
         decals->_features = options().features();
         decals->_artConfig = &options().art().value();
         decals->_drawRoadsAtopTerrainSkin = options().useConstraints() == false;
+        decals->_maxCells = options().topologyCacheSize().value();
         decals->setUserProperty("show_in_ui", "true");
         decals->options().cachePolicy() = options().cachePolicy();
         decals->options().visible() = options().visible();
@@ -54,10 +54,12 @@
 
 #include <cstdlib> // getenv
 #include <random>
+#include <unordered_set>
 
 #define LC "[VegetationLayer] " << getName() << ": "
 
 #define JOB_ARENA_VEGETATION "oe.vegetation"
+#define JOB_ARENA_PLACEMENT "oe.vegetation.placement"
 
 #define OE_DEVEL OE_DEBUG
 
@@ -137,6 +139,7 @@ VegetationLayer::Options::getConfig() const
     conf.set("max_texture_size", maxTextureSize());
     conf.set("render_bin_number", renderBinNumber());
     conf.set("threads", threads());
+    conf.set("placement_threads", placementThreads());
 
     Config layers("layers");
     for (auto group_name : { GROUP_TREES, GROUP_BUSHES, GROUP_UNDERGROWTH })
@@ -214,6 +217,7 @@ VegetationLayer::Options::fromConfig(const Config& conf)
     conf.get("max_texture_size", maxTextureSize());
     conf.get("render_bin_number", renderBinNumber());
     conf.get("threads", threads());
+    conf.get("placement_threads", placementThreads());
 
     // some nice default group settings
     groups()[GROUP_TREES].lod().setDefault(14);
@@ -364,7 +368,18 @@ VegetationLayer::openImplementation()
 
     _lastVisit.setFrameNumber(~0);
 
-    return PatchLayer::openImplementation();
+    Status parent = PatchLayer::openImplementation();
+    if (parent.isError())
+        return parent;
+
+    // placements are deterministic, so we can persist them in our cache bin
+    _placementCacheBin = nullptr;
+    if (getCacheSettings() && getCacheSettings()->isCacheEnabled())
+    {
+        _placementCacheBin = getCacheSettings()->getCacheBin();
+    }
+
+    return parent;
 }
 
 Status
@@ -373,6 +388,8 @@ VegetationLayer::closeImplementation()
     releaseGLObjects(nullptr);
     reset();
 
+    _placementCacheBin = nullptr;
+
     return PatchLayer::closeImplementation();
 }
 
@@ -414,7 +431,7 @@ VegetationLayer::update(osg::NodeVisitor& nv)
             OE_INFO << LC << "timed out for inactivity." << std::endl;
         }
 
-        checkForNewAssets();
+        checkForNewAssets(false);
 
         if (_newAssets.available())
         {
@@ -885,8 +902,14 @@ VegetationLayer::prepareForRendering(TerrainEngine* engine)
     setLODTransitionPadding(options().lodTransitionPadding().get());
     setUseImpostorNormalMaps(options().useImpostorNormalMaps().get());
 
-    // configure the thread pool
+    // configure the thread pools
     jobs::get_pool(JOB_ARENA_VEGETATION)->set_concurrency(options().threads().get());
+
+    // placement jobs are always joined by a vegetation job, so this pool
+    // must not steal work or a placement thread might end up waiting on itself.
+    auto placementPool = jobs::get_pool(JOB_ARENA_PLACEMENT);
+    placementPool->set_can_steal_work(false);
+    placementPool->set_concurrency(std::max(1u, options().placementThreads().get()));
 }
 
 namespace
@@ -1073,7 +1096,7 @@ VegetationLayer::configureImpostor(const std::string& groupName)
 }
 
 bool
-VegetationLayer::checkForNewAssets() const
+VegetationLayer::checkForNewAssets(bool waitForAssets) const
 {
     OE_SOFT_ASSERT_AND_RETURN(getBiomeLayer() != nullptr, false);
 
@@ -1087,7 +1110,9 @@ VegetationLayer::checkForNewAssets() const
 
     osg::observer_ptr<const VegetationLayer> layer_weakptr(this);
 
-    auto loadNewAssets = [layer_weakptr](Cancelable& c) -> AssetsByGroup
+    // When not waiting, assets stream in the background and the biome
+    // revision changes as they arrive, bringing us back here.
+    auto loadNewAssets = [layer_weakptr, waitForAssets](Cancelable& c) -> AssetsByGroup
     {
         OE_PROFILING_ZONE_NAMED("VegetationLayer::loadNewAssets(job)");
 
@@ -1097,7 +1122,8 @@ VegetationLayer::checkForNewAssets() const
         if (layer_weakptr.lock(layer))
         {
             BiomeManager::ResidentBiomesById biomes = layer->getBiomeLayer()->getBiomeManager().getResidentBiomes(
-                layer->getReadOptions());
+                layer->getReadOptions(),
+                waitForAssets);
 
             // re-organize the data into a form we can readily use.
             for (auto iter : biomes)
@@ -1108,6 +1134,21 @@ VegetationLayer::checkForNewAssets() const
                 const Biome* biome = iter.second.biome;
                 auto& instances = iter.second.instances;
 
+                // Note the biome in every group it has assets in while some are
+                // still loading, so placements know they are incomplete.
+                if (!iter.second.complete)
+                {
+                    for (auto& asset_ptr : biome->getModelAssets())
+                    {
+                        if (asset_ptr->asset())
+                        {
+                            auto& biome_assets = result[asset_ptr->asset()->group()][biome->id()];
+                            biome_assets.biome = biome;
+                            biome_assets.complete = false;
+                        }
+                    }
+                }
+
                 // first, sort the instances by group:
                 vector_map<
                     std::string,
@@ -1236,6 +1277,187 @@ VegetationLayer::createDrawableAsync(
     return jobs::dispatch(function, context);
 }
 
+namespace
+{
+    // Asset selection table for one biome. Whether an asset is eligible at a
+    // given lushness depends only on where that value falls relative to the
+    // min/max lushness limits of the assets, so we can precompute the eligible
+    // assets and their weight CDF once per interval between those limits.
+    struct LushnessTable
+    {
+        struct Bucket
+        {
+            std::vector<unsigned> indices;
+            std::vector<float> cdf;
+        };
+
+        const std::vector<ResidentModelAssetInstance>* instances = nullptr;
+        std::vector<float> limits; // sorted unique lushness limits
+        std::vector<Bucket> buckets; // one per interval; limits.size()+1
+
+        void build(const std::vector<ResidentModelAssetInstance>& in)
+        {
+            instances = &in;
+
+            for (auto& instance : in)
+            {
+                limits.push_back(instance.residentAsset()->assetDef()->minLush().get());
+                limits.push_back(instance.residentAsset()->assetDef()->maxLush().get());
+            }
+            std::sort(limits.begin(), limits.end());
+            limits.erase(std::unique(limits.begin(), limits.end()), limits.end());
+
+            // The intervals below the lowest limit and above the highest one
+            // cannot match any asset, so leave those buckets empty.
+            buckets.resize(limits.size() + 1);
+            for (unsigned b = 1; b < limits.size(); ++b)
+            {
+                // any value strictly inside the interval will do
+                double lush = 0.5 * ((double)limits[b - 1] + (double)limits[b]);
+                fill(buckets[b], lush);
+            }
+        }
+
+        template<typename T>
+        void fill(Bucket& bucket, T lush) const
+        {
+            float cumulativeWeight = 0.0f;
+            for (unsigned i = 0; i < instances->size(); ++i)
+            {
+                auto& instance = (*instances)[i];
+                float min_lush = instance.residentAsset()->assetDef()->minLush().get();
+                float max_lush = instance.residentAsset()->assetDef()->maxLush().get();
+
+                if (lush >= min_lush && lush <= max_lush)
+                {
+                    bucket.indices.push_back(i);
+                    cumulativeWeight += instance.weight();
+                    bucket.cdf.push_back(cumulativeWeight);
+                }
+            }
+        }
+
+        // Index of the instance to use for a lushness value and random
+        // selector, or -1 if no asset matches that lushness.
+        int select(float lush, float rand, Bucket& scratch) const
+        {
+            const Bucket* bucket = nullptr;
+
+            auto i = std::upper_bound(limits.begin(), limits.end(), lush);
+            if (i != limits.begin() && *(i - 1) == lush)
+            {
+                // exactly on a limit; resolve it the long way
+                scratch.indices.clear();
+                scratch.cdf.clear();
+                fill(scratch, lush);
+                bucket = &scratch;
+            }
+            else
+            {
+                bucket = &buckets[i - limits.begin()];
+            }
+
+            if (bucket->indices.empty())
+                return -1;
+
+            unsigned index = 0;
+            if (bucket->indices.size() > 1)
+            {
+                float k = rand * bucket->cdf.back();
+                index = std::lower_bound(bucket->cdf.begin(), bucket->cdf.end() - 1, k) - bucket->cdf.begin();
+            }
+            return bucket->indices[index];
+        }
+    };
+
+    // Candidate instances for a tile, stored as parallel arrays.
+    struct PlacementCandidates
+    {
+        PlacementCandidates(unsigned size) :
+            u(size), v(size), assetRand(size), rotationRand(size), lushOffset(size),
+            biome(size, nullptr), instance(size, nullptr), scale(size, 1.0), density(size, 0.0f) { }
+
+        // random inputs
+        std::vector<float> u, v, assetRand, rotationRand, lushOffset;
+
+        // results of sampling; instance is null for rejected candidates
+        std::vector<const Biome*> biome;
+        std::vector<const ResidentModelAssetInstance*> instance;
+        std::vector<double> scale;
+        std::vector<float> density;
+    };
+
+    // Uniform grid of boxes for collision culling. Answers exactly as an RTree
+    // search would (boxes that touch are overlapping) but inserts and queries
+    // only touch the few cells that a box covers.
+    class CollisionGrid
+    {
+    public:
+        CollisionGrid(double xmin, double ymin, double xmax, double ymax, double cellSize)
+        {
+            const unsigned maxCells = 256u;
+            double size = std::max(cellSize, std::max(xmax - xmin, ymax - ymin) / (double)maxCells);
+            if (!(size > 0.0))
+                size = 1.0;
+
+            _xmin = xmin, _ymin = ymin;
+            _invSize = 1.0 / size;
+            _cols = std::max(1u, std::min(maxCells, (unsigned)std::ceil((xmax - xmin) * _invSize)));
+            _rows = std::max(1u, std::min(maxCells, (unsigned)std::ceil((ymax - ymin) * _invSize)));
+            _cells.resize(_cols * _rows);
+        }
+
+        //! Inserts a box unless it overlaps one that's already there.
+        //! Returns true if the box was inserted.
+        bool insertIfClear(const double* a_min, const double* a_max)
+        {
+            unsigned c0 = cell(std::min(a_min[0], a_max[0]), _xmin, _cols);
+            unsigned c1 = cell(std::max(a_min[0], a_max[0]), _xmin, _cols);
+            unsigned r0 = cell(std::min(a_min[1], a_max[1]), _ymin, _rows);
+            unsigned r1 = cell(std::max(a_min[1], a_max[1]), _ymin, _rows);
+
+            for (unsigned r = r0; r <= r1; ++r)
+            {
+                for (unsigned c = c0; c <= c1; ++c)
+                {
+                    for (auto index : _cells[r * _cols + c])
+                    {
+                        const double* b = &_boxes[index * 4];
+                        if (!(a_min[0] > b[2] || b[0] > a_max[0] ||
+                              a_min[1] > b[3] || b[1] > a_max[1]))
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            unsigned index = _boxes.size() / 4;
+            _boxes.insert(_boxes.end(), { a_min[0], a_min[1], a_max[0], a_max[1] });
+
+            for (unsigned r = r0; r <= r1; ++r)
+                for (unsigned c = c0; c <= c1; ++c)
+                    _cells[r * _cols + c].push_back(index);
+
+            return true;
+        }
+
+    private:
+        unsigned cell(double value, double origin, unsigned count) const
+        {
+            double f = std::floor((value - origin) * _invSize);
+            if (!(f > 0.0)) return 0u;
+            if (f >= (double)(count - 1)) return count - 1;
+            return (unsigned)f;
+        }
+
+        double _xmin, _ymin, _invSize;
+        unsigned _cols, _rows;
+        std::vector<std::vector<unsigned>> _cells;
+        std::vector<double> _boxes; // xmin, ymin, xmax, ymax
+    };
+}
+
 #undef RAND
 #define RAND() prng.next()
 
@@ -1294,6 +1516,15 @@ VegetationLayer::getAssetPlacements(
         }
     }
 
+    // Check the persistent cache, which saves us loading any rasters.
+    const std::string cacheKey = getPlacementCacheKey(key, group);
+
+    if (loadBiomesOnDemand == false &&
+        readPlacementsFromCache(cacheKey, groupAssets, output))
+    {
+        return true;
+    }
+
     // Load a lifemap raster:
     GeoImage lifemap;
     osg::Matrix lifemap_sb;
@@ -1314,15 +1545,17 @@ VegetationLayer::getAssetPlacements(
         }
     }
 
-    // Load a biome map raster:
-    GeoImage biomemap;
+    // Load a biome map raster. We only need the indices; the token
+    // keeps the biomes resident while we place.
+    ClassificationRaster::Ptr biomeIndices;
+    osg::ref_ptr<osg::Object> biomeToken;
     osg::Matrix biomemap_sb;
     if (getBiomeLayer())
     {
         TileKey bestKey = getBiomeLayer()->getBestAvailableTileKey(key);
-        biomemap = getBiomeLayer()->createImage(bestKey, progress);
-        key.getExtent().createScaleBias(biomemap.getExtent(), biomemap_sb);
-        biomemap.getReader().setBilinear(false);
+        biomeIndices = getBiomeLayer()->getBiomeIndexRaster(bestKey, biomeToken, progress);
+        if (biomeIndices)
+            key.getExtent().createScaleBias(bestKey.getExtent(), biomemap_sb);
     }
 
     // Prepare to deal with holes in the terrain, where we do not want
@@ -1341,7 +1574,7 @@ VegetationLayer::getAssetPlacements(
     // after loading the biome map.
     if (loadBiomesOnDemand)
     {
-        if (checkForNewAssets() == true)
+        if (checkForNewAssets(true) == true)
         {
             _newAssets.join(progress);
             AssetsByGroup newAssets = _newAssets.release();
@@ -1373,17 +1606,18 @@ VegetationLayer::getAssetPlacements(
             output = std::move(result);
             return true;
         }
+
+        if (readPlacementsFromCache(cacheKey, groupAssets, output))
+        {
+            return true;
+        }
     }
 
     const Biome* default_biome = groupAssets.begin()->second.biome;
 
-    osg::Vec4f noise;
     ImageUtils::PixelReader readNoise(_noiseTex->osgTexture()->getImage(0));
     readNoise.setSampleAsRepeatingTexture(true);
 
-    using Index = RTree<int, double, 2>;
-    Index index;
-
     std::default_random_engine gen(key.hash());
     Random prng(0);
 
@@ -1405,14 +1639,8 @@ VegetationLayer::getAssetPlacements(
 
     const GeoExtent& e = key.getExtent();
 
-    osg::Vec4f lifemap_value;
-    osg::Vec4f biomemap_value;
-    std::vector<double> hits;
-
     auto catalog = getBiomeLayer()->getBiomeCatalog();
 
-    bool scaleWithDensity = (group == GROUP_UNDERGROWTH);
-
     // determine a local tile bbox size for collisions and uv generation
     // note. This doesn't take elevation data into account. Does that matter?
     auto& ex = key.getExtent();
@@ -1425,159 +1653,200 @@ VegetationLayer::getAssetPlacements(
     double local_width = x1 - x0;
     double local_height = y1 - y0;
 
-    // keep track of biomes with no assets (for a possible error condition?)
-    std::set<const Biome*> empty_biomes;
-
-    // indicies of assets selected based on their lushness
-    std::vector<unsigned> assetIndices;
-
-    // cumulative density function based on asset weights
-    std::vector<float> assetCDF;
-
+    // Asset selection tables for each biome that has assets in this group
+    std::unordered_map<const Biome*, LushnessTable> tables;
+    {
+        std::vector<const Biome*> biomes = catalog->getBiomes();
+        biomes.push_back(default_biome);
+        for (auto biome : biomes)
+        {
+            auto iter = groupAssets.find(biome->id());
+            if (iter != groupAssets.end() && tables.find(biome) == tables.end())
+            {
+                tables[biome].build(iter->second.instances);
+            }
+        }
+    }
 
-    //TEMP - DEBUGGING DETERMINISTIC BEHAVIOR.
-    bool debug = false; // key.is(14, 17117, 4120);
-    if (debug) {
-        OE_INFO << LC << "---" << std::endl;
-        OE_INFO << LC << "Attempting to place " << max_instances << std::endl;
+    // Biomes whose assets are still streaming in. Placements that sample
+    // one of them are incomplete and must not be cached.
+    std::unordered_set<const Biome*> incomplete_biomes;
+    for (auto& iter : groupAssets)
+    {
+        if (!iter.second.complete)
+            incomplete_biomes.insert(iter.second.biome);
     }
+    std::atomic_bool sampled_incomplete_biome = { false };
 
     // normal distribution for lushness
     std::normal_distribution<float> normal_dist(0.0f, 1.0f / 6.0f);
 
-    // Generate random instances within the tile:
+    // Step 1: generate all the random numbers for all candidate instances up front,
+    // in the same order as always, so the results are deterministic no matter
+    // how we divide up the rest of the work.
+    PlacementCandidates candidates(max_instances);
     for (unsigned i = 0; i < max_instances; ++i)
     {
-        // perform all random number generations first to preserve determinism
-        // in the even of an early loop break.
+        candidates.u[i] = RAND();
+        candidates.v[i] = RAND();
+        candidates.assetRand[i] = RAND();
+        candidates.rotationRand[i] = RAND();
+        (void)RAND(); // reserved; keeps the sequence stable
+        candidates.lushOffset[i] = normal_dist(gen);
+    }
 
-        // random tile-normalized position:
-        float u = RAND();
-        float v = RAND();
+    // Step 2: sample the rasters and choose an asset for each candidate.
+    // Each candidate is independent, so large tiles can split this across jobs.
+    auto evaluate = [&](unsigned begin, unsigned end)
+    {
+        osg::Vec4f noise, lifemap_value;
+        LushnessTable::Bucket scratch;
 
-        float asset_index_rand = RAND();
-        float rotation_rand = RAND();
-        float normal_rand = RAND();
-        float lush_offset = normal_dist(gen);
+        for (unsigned i = begin; i < end; ++i)
+        {
+            const float u = candidates.u[i];
+            const float v = candidates.v[i];
 
+            // resolve the biome at this position:
+            const Biome* biome = nullptr;
+            if (biomeIndices)
+            {
+                float uu = u * biomemap_sb(0, 0) + biomemap_sb(3, 0);
+                float vv = v * biomemap_sb(1, 1) + biomemap_sb(3, 1);
+                biome = catalog->getBiomeByIndex((*biomeIndices)(uu, vv));
+                if (!biome)
+                    continue;
+            }
 
-        // resolve the biome at this position:
-        const Biome* biome = nullptr;
-        if (biomemap.valid())
-        {
-            float uu = u * biomemap_sb(0, 0) + biomemap_sb(3, 0);
-            float vv = v * biomemap_sb(1, 1) + biomemap_sb(3, 1);
-            biomemap.getReader()(biomemap_value, uu, vv);
-            int index = (int)biomemap_value.r();
-            biome = catalog->getBiomeByIndex(index);
-            if (!biome)
+            if (biome == nullptr)
             {
-                if (debug) OE_INFO << LC << "Instance " << i << " has invalid biome index " << index << std::endl;
-                continue;
+                // not sure this is even possible
+                biome = default_biome;
             }
-        }
 
-        if (biome == nullptr)
-        {
-            // not sure this is even possible
-            biome = default_biome;
-        }
+            if (!incomplete_biomes.empty() && incomplete_biomes.count(biome) > 0)
+            {
+                sampled_incomplete_biome = true;
+            }
 
-        // fetch the collection of assets belonging to the selected biome:
-        auto iter = groupAssets.find(biome->id());
-        if (iter == groupAssets.end())
-        {
-            empty_biomes.insert(biome);
-            if (debug) OE_INFO << LC << "Instance " << i << " has no assets for biome " << biome->id() << std::endl;
-            continue;
-        }
-        ResidentBiomeModelAssetInstances& biome_assets = iter->second;
+            // fetch the collection of assets belonging to the selected biome:
+            auto table = tables.find(biome);
+            if (table == tables.end())
+                continue;
 
-        // sample the noise texture at this (u,v)
-        readNoise(noise, u, v);
+            // read the life map at this point:
+            float density = 1.0f;
+            float lush = 1.0f;
+            if (lifemap.valid())
+            {
+                float uu = u * lifemap_sb(0, 0) + lifemap_sb(3, 0);
+                float vv = v * lifemap_sb(1, 1) + lifemap_sb(3, 1);
+                lifemap.getReader()(lifemap_value, uu, vv);
+                density = lifemap_value[LIFEMAP_DENSE];
+                lush = lifemap_value[LIFEMAP_LUSH];
+            }
 
-        // read the life map at this point:
-        float density = 1.0f;
-        float lush = 1.0f;
-        if (lifemap.valid())
-        {
-            float uu = u * lifemap_sb(0, 0) + lifemap_sb(3, 0);
-            float vv = v * lifemap_sb(1, 1) + lifemap_sb(3, 1);
-            lifemap.getReader()(lifemap_value, uu, vv);
-            density = lifemap_value[LIFEMAP_DENSE];
-            lush = lifemap_value[LIFEMAP_LUSH];
-        }
+            // RNG with normal distribution between approx lush-1..lush+1
+            lush = clamp(lush + candidates.lushOffset[i], 0.0f, 1.0f);
 
-        auto& assetInstances = biome_assets.instances;
+            // if there are no assets that match the lushness criteria, move on.
+            int index = table->second.select(lush, candidates.assetRand[i], scratch);
+            if (index < 0)
+                continue;
 
-        // RNG with normal distribution between approx lush-1..lush+1
-        // Note: moved this earlier in the loop to make it deterministic
-        //std::normal_distribution<float> normal_dist(lush, 1.0f / 6.0f);
-        lush = clamp(lush + lush_offset, 0.0f, 1.0f);
+            auto& instance = (*table->second.instances)[index];
+            auto& asset = instance.residentAsset();
 
-        assetIndices.clear();
-        assetCDF.clear();
-        float cumulativeWeight = 0.0f;
-        for (unsigned i = 0; i < assetInstances.size(); ++i)
-        {
-            float min_lush = assetInstances[i].residentAsset()->assetDef()->minLush().get();
-            float max_lush = assetInstances[i].residentAsset()->assetDef()->maxLush().get();
+            // if there's no geometry... bye
+            if (asset->chonk() == nullptr)
+                continue;
 
-            if (lush >= min_lush && lush <= max_lush)
+            // Apply a size variation with some randomness
+            double scale = 1.0;
+            if (asset->assetDef()->sizeVariation().isSet())
             {
-                assetIndices.push_back(i);
-                cumulativeWeight += assetInstances[i].weight();
-                assetCDF.push_back(cumulativeWeight);
+                readNoise(noise, u, v);
+                scale *= 1.0 + (asset->assetDef()->sizeVariation().get() *
+                    (noise[N_CLUMPY] * 2.0f - 1.0f));
             }
-        }
 
-        // if there are no assets that match the lushness criteria, move on.
-        if (assetIndices.empty())
-        {
-            if (debug) OE_INFO << LC << "Instance " << i << " has no assets for lushness " << lush << std::endl;
-            continue;
-        }
+            candidates.biome[i] = biome;
+            candidates.instance[i] = &instance;
+            candidates.scale[i] = scale;
 
-        int assetIndex = 0;
-        if (assetIndices.size() > 1)
-        {
-            float k = asset_index_rand * cumulativeWeight;
-            for (assetIndex = 0;
-                assetIndex < assetCDF.size() - 1 && k > assetCDF[assetIndex];
-                ++assetIndex);
+            // apply instance-specific density adjustment:
+            candidates.density[i] = density * instance.coverage();
         }
-        auto& instance = assetInstances[assetIndices[assetIndex]];
-        auto& asset = instance.residentAsset();
+    };
 
-        // if there's no geometry... bye
-        if (asset->chonk() == nullptr)
-        {
-            if (debug) OE_INFO << LC << "Instance " << i << " has no geometry" << std::endl;
-            continue;
-        }
+    const unsigned jobSize = 1024u;
+    unsigned numJobs = std::min(
+        std::max(1u, options().placementThreads().get()),
+        std::max(1u, max_instances / jobSize));
+
+    if (numJobs > 1u)
+    {
+        jobs::context context;
+        context.name = "Vegetation placement";
+        context.pool = jobs::get_pool(JOB_ARENA_PLACEMENT);
 
-        osg::Vec3d scale(1, 1, 1);
+        const unsigned perJob = (max_instances + numJobs - 1) / numJobs;
 
-        // Apply a size variation with some randomness
-        if (asset->assetDef()->sizeVariation().isSet())
+        std::vector<Future<bool>> results;
+        for (unsigned j = 1; j < numJobs; ++j)
         {
-            scale *= 1.0 + (asset->assetDef()->sizeVariation().get() *
-                (noise[N_CLUMPY] * 2.0f - 1.0f));
+            unsigned begin = j * perJob;
+            unsigned end = std::min(begin + perJob, max_instances);
+            results.emplace_back(jobs::dispatch([&evaluate, begin, end](Cancelable&)
+                {
+                    evaluate(begin, end);
+                    return true;
+                },
+                context));
         }
 
-        // apply instance-specific density adjustment:
-        density *= instance.coverage();
+        evaluate(0, std::min(perJob, max_instances));
 
-#if 0
-        // Removed, because this is causing the placement to go non-deterministic
-        // for some reason that I have not yet identified.
-        const float edge_threshold = 0.10f;
-        if (scaleWithDensity && density < edge_threshold)
+        for (auto& r : results)
+            r.join();
+    }
+    else
+    {
+        evaluate(0, max_instances);
+    }
+
+    // Step 3: in candidate order, cull instances that collide with ones already
+    // placed, and instances in constrained regions.
+    const double so = (1.0 - overlap);
+    double maxBoxSize = 0.0;
+    if (overlap < 1.0f)
+    {
+        for (unsigned i = 0; i < max_instances; ++i)
         {
-            float edginess = (density / edge_threshold);
-            scale *= edginess;
+            if (candidates.instance[i])
+            {
+                const auto& aabb = candidates.instance[i]->residentAsset()->boundingBox();
+                maxBoxSize = std::max(maxBoxSize, std::abs((aabb.xMax() - aabb.xMin()) * candidates.scale[i] * so));
+                maxBoxSize = std::max(maxBoxSize, std::abs((aabb.yMax() - aabb.yMin()) * candidates.scale[i] * so));
+            }
         }
-#endif
+    }
+
+    CollisionGrid grid(
+        local_bbox.xMin(), local_bbox.yMin(),
+        local_bbox.xMax(), local_bbox.yMax(),
+        maxBoxSize);
+
+    for (unsigned i = 0; i < max_instances; ++i)
+    {
+        const ResidentModelAssetInstance* instance = candidates.instance[i];
+        if (!instance)
+            continue;
+
+        const float u = candidates.u[i];
+        const float v = candidates.v[i];
+        const double scale = candidates.scale[i];
+        auto& asset = instance->residentAsset();
 
         // tile-local coordinates of the position:
         osg::Vec2d local(
@@ -1588,57 +1857,45 @@ VegetationLayer::getAssetPlacements(
 
         if (overlap < 1.0f)
         {
-            // To prevent overlap, write positions and radii to an r-tree. 
+            // To prevent overlap, record positions and extents in a collision grid.
             // TODO: consider using a Blend2d raster to update the 
             // density/lifemap raster as we place objects..?
-            pass = false;
 
             // scale the asset bounding box in preparation for collision:
             const auto& aabb = asset->boundingBox();
 
-            double so = (1.0 - overlap);
-            double a_min[2] = { local.x() + aabb.xMin() * scale.x() * so, local.y() + aabb.yMin() * scale.y() * so };
-            double a_max[2] = { local.x() + aabb.xMax() * scale.x() * so, local.y() + aabb.yMax() * scale.y() * so };
-            
-            if (index.Search(a_min, a_max) == 0)
-            {
-                index.Insert(a_min, a_max, 0);
-                pass = true;
-            }
+            double a_min[2] = { local.x() + aabb.xMin() * scale * so, local.y() + aabb.yMin() * scale * so };
+            double a_max[2] = { local.x() + aabb.xMax() * scale * so, local.y() + aabb.yMax() * scale * so };
+
+            pass = grid.insertIfClear(a_min, a_max);
         }
 
         if (pass)
         {
             osg::Vec3d map_point(e.xMin() + u * e.width(), e.yMin() + v * e.height(), 0);
 
-            if (!inConstrainedRegion(map_point.x(), map_point.y(), constraints))
+            if (constraints.empty() || !inConstrainedRegion(map_point.x(), map_point.y(), constraints))
             {
                 map_points.emplace_back(map_point);
 
                 Placement p;
                 p.localPoint() = local;
                 p.uv().set(u, v);
-                p.scale() = scale;
-                p.rotation() = rotation_rand * 3.1415927 * 2.0;
+                p.scale() = osg::Vec3d(scale, scale, scale);
+                p.rotation() = candidates.rotationRand[i] * 3.1415927 * 2.0;
                 p.asset() = asset;
-                p.density() = density;
-                p.biome = biome;
+                p.density() = candidates.density[i];
+                p.biome = candidates.biome[i];
 
                 result.emplace_back(std::move(p));
             }
-            else
-            {
-                if (debug) OE_INFO << LC << "Instance " << i << " is in a constrained region" << std::endl;
-            }
         }
     }
 
     // Next, go through and remove assets based on the density 
     // threshold. We have to do this after the fact so that
     // lifemap changes don't change existing assets (due to the
-    // collision rtree).
-    if (debug) OE_INFO << LC << (max_instances - result.size()) << " instances removed due to overlap" << std::endl;
-
+    // collision culling).
     std::vector<Placement> result_culled;
     result_culled.reserve(result.size());
 
@@ -1656,13 +1913,9 @@ VegetationLayer::getAssetPlacements(
         }
     }
 
-    if (debug) OE_INFO << LC << (result.size()-result_culled.size()) << " instances removed due to density" << std::endl;
-
     std::swap(result, result_culled);
     std::swap(map_points, map_points_culled);
 
-    if (debug) OE_INFO << LC << "Final instance count = " << result.size() << std::endl;
-
     // clamp everything to the terrain
     map->getElevationPool()->sampleMapCoords(
         map_points.begin(), map_points.end(),
@@ -1677,6 +1930,11 @@ VegetationLayer::getAssetPlacements(
         result[i].mapPoint() = std::move(map_points[i]);
     }
 
+    if (!(progress && progress->isCanceled()) && !sampled_incomplete_biome)
+    {
+        writePlacementsToCache(cacheKey, result);
+    }
+
 #if 0
     // print warnings about empty biomes
     if (!empty_biomes.empty())
@@ -1693,6 +1951,285 @@ VegetationLayer::getAssetPlacements(
 }
 
 
+namespace
+{
+    // Binary record of a tile's placements. Assets are stored as indices
+    // into a table of (biome id, asset name) pairs so we can resolve them
+    // back to resident assets when reading.
+    const std::uint32_t PLACEMENTS_MAGIC = 0x4f455650; // "OEVP"
+    const std::uint32_t PLACEMENTS_VERSION = 1u;
+
+    struct PlacementsWriter
+    {
+        std::string buf;
+
+        template<typename T>
+        void put(const T& value) {
+            buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+        void put(const std::string& value) {
+            put((std::uint32_t)value.size());
+            buf.append(value);
+        }
+    };
+
+    struct PlacementsReader
+    {
+        const std::string& buf;
+        std::size_t pos = 0;
+        bool ok = true;
+
+        PlacementsReader(const std::string& in) : buf(in) { }
+
+        template<typename T>
+        void get(T& value) {
+            if (ok && pos + sizeof(T) <= buf.size()) {
+                memcpy(&value, buf.data() + pos, sizeof(T));
+                pos += sizeof(T);
+            }
+            else ok = false;
+        }
+        void get(std::string& value) {
+            std::uint32_t len = 0;
+            get(len);
+            if (ok && pos + len <= buf.size()) {
+                value.assign(buf.data() + pos, len);
+                pos += len;
+            }
+            else ok = false;
+        }
+    };
+}
+
+std::string
+VegetationLayer::getPlacementCacheKey(
+    const TileKey& key,
+    const std::string& group) const
+{
+    // The layer options are already part of the cache bin ID, so only
+    // the tile, group and source data revisions go in the record key.
+    // Placements are clamped to the terrain and culled by constraints,
+    // so the elevation and constraint layers count as sources too.
+    std::size_t terrainRevision = 0u;
+    osg::ref_ptr<const Map> map;
+    if (_map.lock(map))
+    {
+        auto combine = [&terrainRevision](const Layer* layer)
+        {
+            terrainRevision = terrainRevision * 31u + (std::size_t)layer->getUID();
+            terrainRevision = terrainRevision * 31u + (std::size_t)layer->getRevision();
+        };
+
+        ElevationLayerVector elevationLayers;
+        map->getLayers(elevationLayers);
+        for (auto& layer : elevationLayers)
+        {
+            if (layer->isOpen())
+                combine(layer.get());
+        }
+
+        TerrainConstraintQuery query;
+        map->getLayers<TerrainConstraintLayer>(query.layers, [](const TerrainConstraintLayer* layer)
+            {
+                return layer->getRemoveInterior() == true;
+            });
+        for (auto& layer : query.layers)
+        {
+            combine(layer.get());
+        }
+    }
+
+    return Stringify()
+        << "placements/" << group << "/" << key.str()
+        << "/" << getRevision()
+        << "_" << (getBiomeLayer() ? getBiomeLayer()->getRevision() : 0)
+        << "_" << (getLifeMapLayer() ? getLifeMapLayer()->getRevision() : 0)
+        << "_" << std::hex << terrainRevision;
+}
+
+bool
+VegetationLayer::readPlacementsFromCache(
+    const std::string& cacheKey,
+    const AssetsByBiomeId& groupAssets,
+    std::vector<Placement>& output) const
+{
+    OE_PROFILING_ZONE;
+
+    if (!_placementCacheBin.valid() ||
+        !getCacheSettings()->cachePolicy()->isCacheReadable())
+    {
+        return false;
+    }
+
+    ReadResult rr = _placementCacheBin->readString(cacheKey, getReadOptions());
+    if (!rr.succeeded() ||
+        getCacheSettings()->cachePolicy()->isExpired(rr.lastModifiedTime()))
+    {
+        return false;
+    }
+
+    PlacementsReader in(rr.getString());
+
+    std::uint32_t magic = 0u, version = 0u, numAssets = 0u, numPlacements = 0u;
+    in.get(magic);
+    in.get(version);
+    if (!in.ok || magic != PLACEMENTS_MAGIC || version != PLACEMENTS_VERSION)
+        return false;
+
+    // resolve the asset table against the currently resident assets. If any
+    // asset is not resident, the record is no good to us right now.
+    in.get(numAssets);
+    std::vector<std::pair<const Biome*, ResidentModelAsset::Ptr>> assets;
+    for (std::uint32_t i = 0; in.ok && i < numAssets; ++i)
+    {
+        std::string biomeId, assetName;
+        in.get(biomeId);
+        in.get(assetName);
+
+        auto iter = groupAssets.find(biomeId);
+        if (iter == groupAssets.end())
+            return false;
+
+        ResidentModelAsset::Ptr asset;
+        for (auto& instance : iter->second.instances)
+        {
+            if (instance.residentAsset()->assetDef()->name() == assetName)
+            {
+                asset = instance.residentAsset();
+                break;
+            }
+        }
+
+        if (asset == nullptr || asset->chonk() == nullptr)
+            return false;
+
+        assets.emplace_back(iter->second.biome, asset);
+    }
+
+    in.get(numPlacements);
+    if (!in.ok)
+        return false;
+
+    std::vector<Placement> result;
+    result.reserve(numPlacements);
+
+    for (std::uint32_t i = 0; in.ok && i < numPlacements; ++i)
+    {
+        std::uint32_t assetIndex = 0u;
+        double mapPoint[3], localPoint[2];
+        float uv[2], scale[3], rotation, density;
+
+        in.get(assetIndex);
+        in.get(mapPoint);
+        in.get(localPoint);
+        in.get(uv);
+        in.get(scale);
+        in.get(rotation);
+        in.get(density);
+
+        if (!in.ok || assetIndex >= assets.size())
+            return false;
+
+        Placement p;
+        p.mapPoint().set(mapPoint[0], mapPoint[1], mapPoint[2]);
+        p.localPoint().set(localPoint[0], localPoint[1]);
+        p.uv().set(uv[0], uv[1]);
+        p.scale().set(scale[0], scale[1], scale[2]);
+        p.rotation() = rotation;
+        p.density() = density;
+        p.biome = assets[assetIndex].first;
+        p.asset() = assets[assetIndex].second;
+        result.emplace_back(std::move(p));
+    }
+
+    if (!in.ok)
+        return false;
+
+    output = std::move(result);
+    return true;
+}
+
+void
+VegetationLayer::writePlacementsToCache(
+    const std::string& cacheKey,
+    const std::vector<Placement>& placements) const
+{
+    OE_PROFILING_ZONE;
+
+    if (!_placementCacheBin.valid() ||
+        !getCacheSettings()->cachePolicy()->isCacheWriteable())
+    {
+        return;
+    }
+
+    // build the asset table:
+    std::vector<const Placement*> assets;
+    std::unordered_map<const ResidentModelAsset*, std::uint32_t> assetIndex;
+    std::vector<std::uint32_t> indices;
+    indices.reserve(placements.size());
+
+    for (auto& p : placements)
+    {
+        if (p.asset() == nullptr || p.biome == nullptr)
+            return;
+
+        auto iter = assetIndex.find(p.asset().get());
+        if (iter == assetIndex.end())
+        {
+            iter = assetIndex.emplace(p.asset().get(), (std::uint32_t)assets.size()).first;
+            assets.push_back(&p);
+        }
+        else if (assets[iter->second]->biome != p.biome)
+        {
+            // same asset in two biomes; give it another entry.
+            // (rare, so a linear search is fine)
+            std::uint32_t i = 0;
+            for (; i < assets.size(); ++i)
+                if (assets[i]->asset() == p.asset() && assets[i]->biome == p.biome)
+                    break;
+            if (i == assets.size())
+                assets.push_back(&p);
+            indices.push_back(i);
+            continue;
+        }
+        indices.push_back(iter->second);
+    }
+
+    PlacementsWriter out;
+    out.buf.reserve(64 + placements.size() * 72);
+
+    out.put(PLACEMENTS_MAGIC);
+    out.put(PLACEMENTS_VERSION);
+
+    out.put((std::uint32_t)assets.size());
+    for (auto p : assets)
+    {
+        out.put(p->biome->id());
+        out.put(p->asset()->assetDef()->name());
+    }
+
+    out.put((std::uint32_t)placements.size());
+    for (std::size_t i = 0; i < placements.size(); ++i)
+    {
+        const Placement& p = placements[i];
+        double mapPoint[3] = { p.mapPoint().x(), p.mapPoint().y(), p.mapPoint().z() };
+        double localPoint[2] = { p.localPoint().x(), p.localPoint().y() };
+        float uv[2] = { p.uv().x(), p.uv().y() };
+        float scale[3] = { p.scale().x(), p.scale().y(), p.scale().z() };
+
+        out.put(indices[i]);
+        out.put(mapPoint);
+        out.put(localPoint);
+        out.put(uv);
+        out.put(scale);
+        out.put(p.rotation());
+        out.put(p.density());
+    }
+
+    osg::ref_ptr<StringObject> record = new StringObject(out.buf);
+    _placementCacheBin->write(cacheKey, record.get(), getReadOptions());
+}
+
 std::string
 VegetationLayer::simulateAssetPlacement(const GeoPoint& point, const std::string& group) const
 {
@@ -1771,15 +2308,16 @@ VegetationLayer::simulateAssetPlacement(const GeoPoint& point, const std::string
     }
 
     // Load a biome map raster:
-    GeoImage biomemap;
+    ClassificationRaster::Ptr biomeIndices;
+    osg::ref_ptr<osg::Object> biomeToken;
     osg::Matrix biomemap_sb;
     if (getBiomeLayer())
     {
         TileKey maxKey = key;
         TileKey bestKey = getBiomeLayer()->getBestAvailableTileKey(maxKey);
-        biomemap = getBiomeLayer()->createImage(bestKey, progress);
-        key.getExtent().createScaleBias(biomemap.getExtent(), biomemap_sb);
-        biomemap.getReader().setBilinear(false);
+        biomeIndices = getBiomeLayer()->getBiomeIndexRaster(bestKey, biomeToken, progress);
+        if (biomeIndices)
+            key.getExtent().createScaleBias(bestKey.getExtent(), biomemap_sb);
         log << "Sampled biomemap at LOD " << bestKey.getLOD() << std::endl;
     }
 
@@ -1798,7 +2336,7 @@ VegetationLayer::simulateAssetPlacement(const GeoPoint& point, const std::string
     // after loading the biome map.
     if (loadBiomesOnDemand)
     {
-        if (checkForNewAssets() == true)
+        if (checkForNewAssets(true) == true)
         {
             _newAssets.join(progress);
             AssetsByGroup newAssets = _newAssets.release();
@@ -1846,7 +2384,6 @@ VegetationLayer::simulateAssetPlacement(const GeoPoint& point, const std::string
     auto catalog = getBiomeLayer()->getBiomeCatalog();
     auto& ex = key.getExtent();
     osg::Vec4f lifemap_value;
-    osg::Vec4f biomemap_value;
 
     // random tile-normalized position:
     float u = (point.x() - ex.xMin()) / ex.width();
@@ -1856,12 +2393,11 @@ VegetationLayer::simulateAssetPlacement(const GeoPoint& point, const std::string
 
     // resolve the biome at this position:
     const Biome* biome = nullptr;
-    if (biomemap.valid())
+    if (biomeIndices)
     {
         float uu = u * biomemap_sb(0, 0) + biomemap_sb(3, 0);
         float vv = v * biomemap_sb(1, 1) + biomemap_sb(3, 1);
-        biomemap.getReader()(biomemap_value, uu, vv);
-        int index = (int)biomemap_value.r();
+        int index = (*biomeIndices)(uu, vv);
         biome = catalog->getBiomeByIndex(index);
         if (!biome)
         {
@@ -0,0 +1,611 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "GroundCoverInstanceGenerator"
+#include "NoiseTextureFactory"
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Threading>
+
+using namespace osgEarth;
+using namespace osgEarth::Splat;
+
+#define LC "[GroundCoverInstanceGenerator] "
+
+#define ARENA_GROUNDCOVER_GENERATE "oe.groundcover.generate"
+
+//...................................................................
+
+namespace
+{
+    // Noise channels (see Splat.GroundCover.CS.glsl)
+    const int NOISE_SMOOTH = 0;
+    const int NOISE_RANDOM = 1;
+    const int NOISE_RANDOM_2 = 2;
+
+    // GLSL fract
+    inline float fract(float x)
+    {
+        return x - floorf(x);
+    }
+
+    // GLSL (matrix * vec4(u, v, 0, 1)).st
+    inline void transform(const osg::Matrixf& m, float u, float v, float& s, float& t)
+    {
+        s = u*m(0, 0) + v*m(1, 0) + m(3, 0);
+        t = u*m(0, 1) + v*m(1, 1) + m(3, 1);
+    }
+
+    // Same as the instancer; odd sizes make the shader misbehave
+    inline unsigned makeEven(unsigned value)
+    {
+        return (value & 0x01) ? value + 1 : value;
+    }
+
+    // Texture samplers for one tile. PixelReader isn't free to set up,
+    // so we do it once per tile rather than once per instance.
+    struct Samplers
+    {
+        ImageUtils::PixelReader noise;
+        ImageUtils::PixelReader landCover;
+        ImageUtils::PixelReader elevation;
+        ImageUtils::PixelReader mask;
+        ImageUtils::PixelReader color;
+        bool hasElevation = false;
+        bool hasMask = false;
+        bool hasColor = false;
+        float elevTexelCoeff[2] = { 1.0f, 0.0f };
+
+        Samplers(const osg::Texture* noiseTex, const GroundCoverInstanceGenerator::Tile& tile)
+        {
+            noise.setTexture(noiseTex);
+            landCover.setTexture(tile.landCoverTex.get());
+
+            if (tile.elevationTex.valid() && tile.elevationTex->getImage(0))
+            {
+                elevation.setTexture(tile.elevationTex.get());
+                float size = (float)tile.elevationTex->getImage(0)->s();
+                elevTexelCoeff[0] = (size - 1.0f) / size;
+                elevTexelCoeff[1] = 0.5f / size;
+                hasElevation = true;
+            }
+
+            if (tile.maskTex.valid() && tile.maskTex->getImage(0))
+            {
+                mask.setTexture(tile.maskTex.get());
+                hasMask = true;
+            }
+
+            if (tile.colorTex.valid() && tile.colorTex->getImage(0))
+            {
+                color.setTexture(tile.colorTex.get());
+                hasColor = true;
+            }
+        }
+    };
+}
+
+//...................................................................
+
+GroundCoverInstanceGenerator::GroundCoverInstanceGenerator() :
+    _numInstances1D(64u),
+    _colorMinSaturation(0.0f),
+    _pickNoiseType(NOISE_RANDOM),
+    _indexCount(0u),
+    _concurrency(4u)
+{
+    NoiseTextureFactory noise;
+    _noiseTexture = noise.create(256u, 4u);
+
+    // The caller always joins the jobs it dispatches, so don't let
+    // a waiting thread pick up unrelated work.
+    static std::once_flag s_poolConfigured;
+    std::call_once(s_poolConfigured, []()
+        {
+            auto pool = jobs::get_pool(ARENA_GROUNDCOVER_GENERATE);
+            pool->set_can_steal_work(false);
+            pool->set_concurrency(4u);
+        });
+}
+
+void
+GroundCoverInstanceGenerator::setLayer(GroundCoverLayer* layer, const Map* map)
+{
+    _layer = layer;
+    _map = map;
+
+    if (!_layer.valid())
+        return;
+
+    GroundCoverLayer::LUT lut;
+    _layer->buildLUT(lut);
+    setLUT(lut);
+
+    _colorMinSaturation = _layer->options().colorMinSaturation().get();
+
+    // Instance grid size per zone, calculated the same way as the renderer
+    _zoneNumInstances1D.clear();
+    if (_map.valid() && _map->getProfile())
+    {
+        unsigned lod = _layer->getLOD();
+        unsigned tx, ty;
+        _map->getProfile()->getNumTiles(lod, tx, ty);
+        GeoExtent e = TileKey(lod, tx / 2, ty / 2, _map->getProfile()).getExtent();
+        GeoCircle c = e.computeBoundingGeoCircle();
+        double tileWidth_m = 2.0 * c.getRadius() / 1.4142;
+
+        for (auto& zone : _layer->getZones())
+        {
+            unsigned num = 64u;
+            if (zone.options().spacing().isSet())
+                num = (unsigned)(tileWidth_m / zone.options().spacing()->as(Units::METERS));
+            _zoneNumInstances1D.push_back(makeEven(std::max(num, 2u)));
+        }
+    }
+
+    if (_layer->getLandCoverDictionary() == nullptr)
+    {
+        OE_WARN << LC << "Layer \"" << _layer->getName() << "\" has no land cover dictionary; "
+            << "it will not generate any instances" << std::endl;
+    }
+}
+
+void
+GroundCoverInstanceGenerator::setLUT(const GroundCoverLayer::LUT& lut)
+{
+    _lut = lut;
+
+    // Flatten the (zone, code) map into a dense table; land cover codes are
+    // small integers and this lookup happens for every candidate instance.
+    _codeToGroup.clear();
+    for (auto& i : _lut.groupIndex)
+    {
+        int zone = i.first.first;
+        int code = i.first.second;
+        if (zone < 0 || code < 0)
+            continue;
+
+        if (_codeToGroup.size() <= (unsigned)zone)
+            _codeToGroup.resize(zone + 1);
+
+        std::vector<int>& codes = _codeToGroup[zone];
+        if (codes.size() <= (unsigned)code)
+            codes.resize(code + 1, -1);
+
+        codes[code] = i.second;
+    }
+}
+
+void
+GroundCoverInstanceGenerator::setNoiseTexture(osg::Texture* tex)
+{
+    _noiseTexture = tex;
+}
+
+void
+GroundCoverInstanceGenerator::setNumInstances1D(unsigned value)
+{
+    _numInstances1D = makeEven(std::max(value, 2u));
+}
+
+void
+GroundCoverInstanceGenerator::setConcurrency(unsigned value)
+{
+    _concurrency = std::max(value, 1u);
+    jobs::get_pool(ARENA_GROUNDCOVER_GENERATE)->set_concurrency(_concurrency);
+}
+
+const GroundCoverLayer::LUT::Group*
+GroundCoverInstanceGenerator::getGroup(int zone, int code) const
+{
+    if (zone < 0 || zone >= (int)_codeToGroup.size())
+        return nullptr;
+
+    const std::vector<int>& codes = _codeToGroup[zone];
+    if (code < 0 || code >= (int)codes.size())
+        return nullptr;
+
+    // The layer counts land cover groups that have no classes even though
+    // it never emits them, so an index can run off the end. The shader
+    // would read out of bounds; we reject the instance instead.
+    int index = codes[code];
+    if (index < 0 || index >= (int)_lut.groups.size())
+        return nullptr;
+
+    return &_lut.groups[index];
+}
+
+Status
+GroundCoverInstanceGenerator::createTile(
+    const TileKey& key,
+    TerrainTileModelFactory* factory,
+    Tile& tile) const
+{
+    if (!_layer.valid() || !_map.valid())
+        return Status(Status::ConfigurationError, "Call setLayer() first");
+
+    if (!factory)
+        return Status(Status::ConfigurationError, "Missing required TerrainTileModelFactory");
+
+    if (_layer->getZones().empty())
+        return Status(Status::ConfigurationError, "No zones found in GroundCoverLayer");
+
+    CreateTileManifest manifest;
+    if (_layer->getLandCoverLayer())
+        manifest.insert(_layer->getLandCoverLayer());
+    if (_layer->getMaskLayer())
+        manifest.insert(_layer->getMaskLayer());
+    if (_layer->getColorLayer())
+        manifest.insert(_layer->getColorLayer());
+
+    ElevationLayerVector elevLayers;
+    _map->getLayers(elevLayers);
+    if (!elevLayers.empty())
+        manifest.insert(elevLayers.front().get());
+
+    osg::ref_ptr<TerrainTileModel> model = factory->createStandaloneTileModel(
+        _map.get(), key, manifest, {}, nullptr);
+
+    if (!model.valid())
+        return Status(Status::ResourceUnavailable, "No tile model");
+
+    tile = Tile();
+
+    // Same zone selection as the layer's cull callback: last match wins,
+    // and zone 0 is the fallback.
+    GeoPoint centroid = key.getExtent().getCentroid();
+    tile.zone = 0;
+    for (int z = _layer->getZones().size() - 1; z > 0 && tile.zone == 0; --z)
+    {
+        if (_layer->getZones()[z].contains(centroid))
+            tile.zone = z;
+    }
+
+    // Tile bounds in meters, centered on the key like a tile-local frame
+    float halfWidth = 0.5f * (float)key.getExtent().width(Units::METERS);
+    float halfHeight = 0.5f * (float)key.getExtent().height(Units::METERS);
+    tile.LL.set(-halfWidth, -halfHeight);
+    tile.UR.set(halfWidth, halfHeight);
+
+    if (tile.zone < (int)_zoneNumInstances1D.size())
+        tile.numInstances1D = _zoneNumInstances1D[tile.zone];
+
+    if (model->landCover.texture)
+    {
+        tile.landCoverTex = model->landCover.texture->osgTexture();
+        tile.landCoverMatrix = model->landCover.matrix;
+    }
+
+    if (model->elevation.texture)
+    {
+        tile.elevationTex = model->elevation.texture->osgTexture();
+        tile.elevationMatrix = model->elevation.matrix;
+    }
+
+    if (_layer->getMaskLayer())
+    {
+        auto tex = model->getTexture(_layer->getMaskLayer()->getUID());
+        if (tex)
+        {
+            tile.maskTex = tex->osgTexture();
+            tile.maskMatrix = model->getMatrix(_layer->getMaskLayer()->getUID());
+        }
+    }
+
+    if (_layer->getColorLayer())
+    {
+        auto tex = model->getTexture(_layer->getColorLayer()->getUID());
+        if (tex)
+        {
+            tile.colorTex = tex->osgTexture();
+            tile.colorMatrix = model->getMatrix(_layer->getColorLayer()->getUID());
+        }
+    }
+
+    return Status::NoError;
+}
+
+unsigned
+GroundCoverInstanceGenerator::generate(const Tile& tile, std::vector<Instance>& output) const
+{
+    if (!tile.landCoverTex.valid() || !tile.landCoverTex->getImage(0) || !_noiseTexture.valid())
+        return 0u;
+
+    Samplers samplers(_noiseTexture.get(), tile);
+
+    const unsigned N = tile.numInstances1D > 0u ? makeEven(tile.numInstances1D) : _numInstances1D;
+    const float numGroups = (float)N;
+    const float halfSpacing = 0.5f / numGroups;
+    const float elevScaleX = samplers.elevTexelCoeff[0] * tile.elevationMatrix(0, 0);
+    const float elevScaleY = samplers.elevTexelCoeff[0] * tile.elevationMatrix(1, 1);
+    const float elevBiasX = samplers.elevTexelCoeff[0] * tile.elevationMatrix(3, 0) + samplers.elevTexelCoeff[1];
+    const float elevBiasY = samplers.elevTexelCoeff[0] * tile.elevationMatrix(3, 1) + samplers.elevTexelCoeff[1];
+    const int pickNoiseType = osg::clampBetween(_pickNoiseType, 0, 3);
+
+    // Work one row of the grid at a time in structure-of-arrays form.
+    // The texture fetches are scalar, but the arithmetic passes between
+    // them are plain loops over floats that the compiler can vectorize.
+    std::vector<float> u(N), v(N), n0(N), n1(N), n2(N), n3(N);
+    std::vector<const GroundCoverLayer::LUT::Group*> groups(N);
+    std::vector<float> z(N);
+    std::vector<unsigned> keep;
+    keep.reserve(N);
+
+    osg::Vec4f sample;
+    unsigned start = output.size();
+
+    for (unsigned y = 0; y < N; ++y)
+    {
+        // grid positions:
+        const float row = halfSpacing + (float)y / numGroups;
+        for (unsigned x = 0; x < N; ++x)
+        {
+            u[x] = halfSpacing + (float)x / numGroups;
+            v[x] = row;
+        }
+
+        // noise at the grid positions:
+        for (unsigned x = 0; x < N; ++x)
+        {
+            samplers.noise(sample, u[x], v[x]);
+            n0[x] = sample[NOISE_SMOOTH];
+            n1[x] = sample[NOISE_RANDOM];
+            n2[x] = sample[NOISE_RANDOM_2];
+            n3[x] = sample[3];
+        }
+
+        // jitter:
+        for (unsigned x = 0; x < N; ++x)
+        {
+            u[x] += (fract(n1[x] * 1.5f)*2.0f - 1.0f) * halfSpacing;
+            v[x] += (fract(n2[x] * 1.5f)*2.0f - 1.0f) * halfSpacing;
+        }
+
+        // rejection tests, in the same order as the shader:
+        keep.clear();
+        for (unsigned x = 0; x < N; ++x)
+        {
+            float s, t;
+
+            if (samplers.hasColor)
+            {
+                // HSV saturation, as computed by rgb2hsv in the shader
+                transform(tile.colorMatrix, u[x], v[x], s, t);
+                samplers.color(sample, s, t);
+                float maxc = std::max(sample.r(), std::max(sample.g(), sample.b()));
+                float minc = std::min(sample.r(), std::min(sample.g(), sample.b()));
+                float saturation = (maxc - minc) / (maxc + 1.0e-10f);
+                if (!(saturation > _colorMinSaturation))
+                    continue;
+            }
+
+            transform(tile.landCoverMatrix, u[x], v[x], s, t);
+            samplers.landCover(sample, s, t);
+            const GroundCoverLayer::LUT::Group* group = getGroup(tile.zone, (int)sample.r());
+            if (group == nullptr)
+                continue;
+
+            if (samplers.hasMask)
+            {
+                transform(tile.maskMatrix, u[x], v[x], s, t);
+                samplers.mask(sample, s, t);
+                if (sample.a() > 0.0f)
+                    continue;
+            }
+
+            if (n0[x] > group->fill)
+                continue;
+
+            groups[x] = group;
+            keep.push_back(x);
+        }
+
+        if (keep.empty())
+            continue;
+
+        // elevation for the keepers:
+        for (unsigned x : keep)
+        {
+            z[x] = 0.0f;
+            if (samplers.hasElevation)
+            {
+                samplers.elevation(sample, u[x]*elevScaleX + elevBiasX, v[x]*elevScaleY + elevBiasY);
+                z[x] = sample.r();
+            }
+        }
+
+        // populate the render data:
+        unsigned first = output.size();
+        output.resize(first + keep.size());
+        Instance* out = &output[first];
+
+        for (unsigned k = 0; k < keep.size(); ++k)
+        {
+            const unsigned x = keep[k];
+            const GroundCoverLayer::LUT::Group& group = *groups[x];
+            Instance& instance = out[k];
+
+            float smooth = n0[x] / group.fill;
+
+            instance.fillEdge = 1.0f;
+            if (smooth > 0.5f)
+                instance.fillEdge = 1.0f - ((smooth - 0.5f) / 0.5f);
+
+            instance.vertex.set(
+                tile.LL.x() + (tile.UR.x() - tile.LL.x())*u[x],
+                tile.LL.y() + (tile.UR.y() - tile.LL.y())*v[x],
+                z[x],
+                1.0f);
+
+            instance.tilec.set(u[x], v[x]);
+
+            // select a billboard at random
+            float noise[4] = { smooth, n1[x], n2[x], n3[x] };
+            float pickNoise = 1.0f - noise[pickNoiseType];
+            int assetIndex = group.firstAssetIndex + (int)floorf(pickNoise * (float)group.numAssets);
+            assetIndex = std::min(assetIndex, group.firstAssetIndex + group.numAssets - 1);
+
+            if (assetIndex < 0 || assetIndex >= (int)_lut.assets.size())
+            {
+                instance.sideIndex = -1;
+                instance.topIndex = -1;
+                instance.width = 0.0f;
+                instance.height = 0.0f;
+            }
+            else
+            {
+                const GroundCoverLayer::LUT::Asset& asset = _lut.assets[assetIndex];
+
+                instance.sideIndex = asset.atlasIndexSide;
+                instance.topIndex = asset.atlasIndexTop;
+
+                // a pseudo-random scale factor to the width and height of a billboard
+                float sizeScale = asset.sizeVariation * (n2[x] * 2.0f - 1.0f);
+                instance.width = asset.width + asset.width*sizeScale;
+                instance.height = asset.height + asset.height*sizeScale;
+            }
+
+            instance._padding = 0.0f;
+        }
+    }
+
+    return output.size() - start;
+}
+
+void
+GroundCoverInstanceGenerator::generate(const std::vector<Tile>& tiles, Output& output) const
+{
+    output.instances.clear();
+    output.commands.clear();
+
+    if (tiles.empty())
+        return;
+
+    std::vector<std::vector<Instance>> results(tiles.size());
+    std::atomic_uint next(0u);
+
+    // Each worker pulls the next unclaimed tile until none remain,
+    // which keeps the load even when tiles differ in cost.
+    auto work = [&]()
+    {
+        for (unsigned i = next++; i < tiles.size(); i = next++)
+        {
+            generate(tiles[i], results[i]);
+        }
+    };
+
+    unsigned numJobs = std::min(_concurrency, (unsigned)tiles.size());
+    if (numJobs > 1u)
+    {
+        jobs::context context;
+        context.name = "GroundCover generate";
+        context.pool = jobs::get_pool(ARENA_GROUNDCOVER_GENERATE);
+
+        std::vector<Future<bool>> workers;
+        for (unsigned j = 1; j < numJobs; ++j)
+        {
+            workers.emplace_back(jobs::dispatch([&work](Cancelable&)
+                {
+                    work();
+                    return true;
+                },
+                context));
+        }
+
+        work();
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+    else
+    {
+        work();
+    }
+
+    // Pack the results into one buffer with a draw command per tile
+    std::size_t total = 0u;
+    for (auto& result : results)
+        total += result.size();
+
+    output.instances.reserve(total);
+    output.commands.resize(tiles.size());
+
+    for (unsigned i = 0; i < results.size(); ++i)
+    {
+        DrawCommand& cmd = output.commands[i];
+        cmd.count = _indexCount;
+        cmd.instanceCount = results[i].size();
+        cmd.firstIndex = 0u;
+        cmd.baseVertex = 0u;
+        cmd.baseInstance = output.instances.size();
+
+        output.instances.insert(output.instances.end(), results[i].begin(), results[i].end());
+    }
+}
+
+void
+GroundCoverInstanceGenerator::cull(
+    const std::vector<Tile>& tiles,
+    const Output& input,
+    const osg::Matrixd& projectionMatrix,
+    float maxRange,
+    Output& output) const
+{
+    output.instances.clear();
+    output.commands.resize(input.commands.size());
+
+    for (unsigned i = 0; i < input.commands.size(); ++i)
+    {
+        const DrawCommand& in = input.commands[i];
+        DrawCommand& out = output.commands[i];
+        out = in;
+        out.instanceCount = 0u;
+        out.baseInstance = output.instances.size();
+
+        if (i >= tiles.size())
+            continue;
+
+        const osg::Matrixd& mv = tiles[i].modelViewMatrix;
+
+        for (unsigned k = in.baseInstance; k < in.baseInstance + in.instanceCount; ++k)
+        {
+            const Instance& instance = input.instances[k];
+
+            osg::Vec4d view = osg::Vec4d(instance.vertex) * mv;
+
+            // range culling:
+            if (-view.z() >= maxRange)
+                continue;
+
+            // frustum culling:
+            osg::Vec4d clipLL = (view - osg::Vec4d(0.5*instance.width, 0, 0, 0)) * projectionMatrix;
+            if (clipLL.x() / clipLL.w() > 1.0 || clipLL.y() / clipLL.w() > 1.0)
+                continue;
+
+            osg::Vec4d clipUR = (view + osg::Vec4d(0.5*instance.width, instance.height, 0, 0)) * projectionMatrix;
+            if (clipUR.x() / clipUR.w() < -1.0 || clipUR.y() / clipUR.w() < -1.0)
+                continue;
+
+            // no billboard to draw
+            if (instance.sideIndex < 0)
+                continue;
+
+            output.instances.push_back(instance);
+            ++out.instanceCount;
+        }
+    }
+}
@@ -1296,39 +1296,40 @@ GroundCoverLayer::createTextureAtlas() const
     return tex;
 }
 
-namespace {
-
+namespace
+{
+    // Round a value the same way it gets rounded when we print it
+    // into the LUT shader, so CPU and GPU see identical numbers.
+    float quantize(float value, int precision)
+    {
+        std::stringstream buf;
+        buf << std::fixed << std::setprecision(precision) << value;
+        return std::stof(buf.str());
+    }
 }
 
-osg::Shader*
-GroundCoverLayer::createLUTShader() const
+void
+GroundCoverLayer::buildLUT(LUT& output)
 {
-    std::stringstream landCoverGroupBuf;
-    landCoverGroupBuf << std::fixed << std::setprecision(2);
-
-    std::stringstream assetBuf;
-    assetBuf << std::fixed << std::setprecision(1);
-
-    int numBiomeZones = options().biomeZones().size();
-    int numBiomeLayouts = numBiomeZones; // one per zone.
-    int numLandCoverGroups = 0;
-    int numAssets = 0;
-    for(int i=0; i<numBiomeZones; ++i)
+    if (_liveAssets.empty() && getLandCoverDictionary())
     {
-        const BiomeZone& bz = options().biomeZones()[i];
-        numLandCoverGroups += bz.getLandCoverGroups().size();
-        // todo.
+        loadAssets();
     }
 
-    // encode all the biome data.
+    populateLUT(output);
+}
+
+void
+GroundCoverLayer::populateLUT(LUT& lut) const
+{
+    lut.groups.clear();
+    lut.assets.clear();
+    lut.groupIndex.clear();
 
-    int numAssetInstancesAdded = 0;
-    int numLandCoverGroupsAdded = 0;
     int currentLandCoverGroupIndex = -1;
     const LandCoverGroup* currentLandCoverGroup = NULL;
     int startingAssetIndex = 0;
     int numAssetsInLandCoverGroup = 0;
-    float maxWidth = -1.0f, maxHeight = -1.0f;
     AssetData* data = NULL;
 
     for(int a=0; a<_liveAssets.size(); ++a)
@@ -1348,17 +1349,13 @@ GroundCoverLayer::createLUTShader() const
             float fill = currentLandCoverGroup->options().fill().getOrUse(
                 data->_zone->options().fill().get());
 
-            if (startingAssetIndex > 0)
-                landCoverGroupBuf << ", \n";
-
-            landCoverGroupBuf
-                << "    oe_gc_LandCoverGroup("
-                << startingAssetIndex << ", "
-                << numAssetsInLandCoverGroup << ", " << fill << ")";
+            LUT::Group group;
+            group.firstAssetIndex = startingAssetIndex;
+            group.numAssets = numAssetsInLandCoverGroup;
+            group.fill = quantize(fill, 2);
+            lut.groups.push_back(group);
 
-            ++numLandCoverGroupsAdded;
-
-            startingAssetIndex = a;
+            startingAssetIndex = lut.assets.size();
             numAssetsInLandCoverGroup = 0;
             currentLandCoverGroupIndex = data->_landCoverGroupIndex;
             currentLandCoverGroup = data->_landCoverGroup;
@@ -1374,29 +1371,29 @@ GroundCoverLayer::createLUTShader() const
 
         int weight = (int)osg::maximum(data->_asset->options().selectionWeight().get(), 1.0f);
 
-        maxWidth = osg::maximum(maxWidth, width + (width*sizeVariation));
-        maxHeight = osg::maximum(maxHeight, height + (height*sizeVariation));
+        LUT::Asset asset;
+        asset.atlasIndexSide = data->_sideImageAtlasIndex;
+        asset.atlasIndexTop = data->_topImageAtlasIndex;
+        asset.width = quantize(width, 1);
+        asset.height = quantize(height, 1);
+        asset.sizeVariation = quantize(sizeVariation, 1);
 
         // apply the selection weight by adding the object multiple times
-
         for(int w=0; w<weight; ++w)
         {
-            if (numAssetInstancesAdded > 0)
-                assetBuf << ", \n";
-
-            assetBuf << "    oe_gc_Asset("
-                << data->_sideImageAtlasIndex
-                << ", " << data->_topImageAtlasIndex
-                << ", " << width
-                << ", " << height
-                << ", " << sizeVariation
-                << ")";
-
-            ++data->_numInstances;
+            lut.assets.push_back(asset);
+            ++numAssetsInLandCoverGroup;
+        }
 
-            ++numAssetInstancesAdded;
+        data->_numInstances = weight;
 
-            ++numAssetsInLandCoverGroup;
+        // map each of the asset's codes to its group; first one in wins,
+        // just like the if/else chain in the shader
+        for(int c = 0; c < data->_codes.size(); ++c)
+        {
+            lut.groupIndex.emplace(
+                std::make_pair(data->_zoneIndex, data->_codes[c]),
+                data->_landCoverGroupIndex);
         }
     }
 
@@ -1406,17 +1403,58 @@ GroundCoverLayer::createLUTShader() const
         float fill = currentLandCoverGroup->options().fill().getOrUse(
             data->_zone->options().fill().get());
 
-        if (startingAssetIndex > 0)
+        LUT::Group group;
+        group.firstAssetIndex = startingAssetIndex;
+        group.numAssets = numAssetsInLandCoverGroup;
+        group.fill = quantize(fill, 2);
+        lut.groups.push_back(group);
+    }
+}
+
+osg::Shader*
+GroundCoverLayer::createLUTShader() const
+{
+    // encode all the biome data.
+    LUT lut;
+    populateLUT(lut);
+
+    std::stringstream landCoverGroupBuf;
+    landCoverGroupBuf << std::fixed << std::setprecision(2);
+
+    for(int i=0; i<lut.groups.size(); ++i)
+    {
+        const LUT::Group& group = lut.groups[i];
+
+        if (i > 0)
             landCoverGroupBuf << ", \n";
 
-        landCoverGroupBuf << "    oe_gc_LandCoverGroup("
-            << startingAssetIndex << ", "
-            << numAssetsInLandCoverGroup
-            << ", " << fill << ")";
+        landCoverGroupBuf
+            << "    oe_gc_LandCoverGroup("
+            << group.firstAssetIndex << ", "
+            << group.numAssets << ", " << group.fill << ")";
+    }
+
+    std::stringstream assetBuf;
+    assetBuf << std::fixed << std::setprecision(1);
 
-        ++numLandCoverGroupsAdded;
+    for(int i=0; i<lut.assets.size(); ++i)
+    {
+        const LUT::Asset& asset = lut.assets[i];
+
+        if (i > 0)
+            assetBuf << ", \n";
+
+        assetBuf << "    oe_gc_Asset("
+            << asset.atlasIndexSide
+            << ", " << asset.atlasIndexTop
+            << ", " << asset.width
+            << ", " << asset.height
+            << ", " << asset.sizeVariation
+            << ")";
     }
 
+    int numLandCoverGroupsAdded = lut.groups.size();
+    int numAssetInstancesAdded = lut.assets.size();
 
     std::stringstream landCoverGroupWrapperBuf;
     landCoverGroupWrapperBuf << 
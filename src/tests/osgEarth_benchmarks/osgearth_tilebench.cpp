@@ -0,0 +1,662 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Headless terrain tile-build benchmark.
+ *
+ * Builds a map from synthetic local sources (a GDAL elevation raster written
+ * on the fly, a FractalElevationLayer offset and a DebugImageLayer), then
+ * replays scripted camera paths. Each frame selects tiles the way the REX
+ * engine does (frustum test plus the per-LOD visibility ranges derived from
+ * minTileRangeFactor), and every tile that becomes resident is built on a
+ * job pool the way REX's LoadTileData does: the engine's createTileModel
+ * (TerrainTileModelFactory plus any tile model callbacks), then
+ * createStandaloneTile for the geometry (from the REX GeometryPool).
+ * Tiles that leave the selection are released.
+ *
+ * No window or graphics context is required. Results are written as JSON
+ * for regression tracking; the built-in paths are deterministic, so the
+ * "keys_hash" of a path only changes when tile selection changes.
+ */
+
+#define LC "[osgearth_tilebench] "
+
+#include <osgEarth/MapNode>
+#include <osgEarth/TerrainEngineNode>
+#include <osgEarth/GDAL>
+#include <osgEarth/FractalElevationLayer>
+#include <osgEarth/DebugImageLayer>
+#include <osgEarth/MetricsRegistry>
+#include <osgEarth/MemoryUtils>
+#include <osgEarth/FileUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Notify>
+#include <osgEarth/Threading>
+#include <osgEarth/Version>
+
+#include <osg/ArgumentParser>
+#include <osg/Polytope>
+#include <osgDB/FileUtils>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Area covered by the synthetic elevation raster; all built-in
+    // paths fly over it.
+    const double DEM_WEST = 5.0, DEM_SOUTH = 44.0, DEM_EAST = 10.0, DEM_NORTH = 48.0;
+
+    // Elevation bounds used for tile bounding spheres
+    const double MIN_ELEVATION = -500.0, MAX_ELEVATION = 5000.0;
+
+    const char* BENCH_POOL = "oe.tilebench";
+
+    int usage(char** argv)
+    {
+        std::cout
+            << "Measures headless terrain tile production along scripted camera paths.\n\n"
+            << argv[0]
+            << "\n    --path [name]          : built-in path to run: descent, orbit, lowpass or all (default)"
+            << "\n    --path-file [file]     : run a path from a file, one \"lon lat alt heading pitch\" per line"
+            << "\n    --threads [num]        : tile build concurrency (default = 4)"
+            << "\n    --max-lod [num]        : maximum terrain LOD (default = 16)"
+            << "\n    --raster-size [num]    : width of the synthetic GDAL raster in pixels (default = 1024)"
+            << "\n    --frames [num]         : frames per built-in path (default = 120)"
+            << "\n    --no-geometry          : build tile models only, skip REX geometry"
+            << "\n    --out [file]           : write the JSON results to a file instead of stdout"
+            << std::endl;
+        return 0;
+    }
+
+    //! One camera position along a path
+    struct Waypoint
+    {
+        double lon, lat, alt;  // degrees, degrees, meters
+        double heading, pitch; // degrees; pitch is negative looking down
+    };
+
+    struct Path
+    {
+        std::string name;
+        std::vector<Waypoint> waypoints;
+    };
+
+    // From orbit down to 2km over the Alps, tilting toward the horizon
+    Path makeDescent(unsigned frames)
+    {
+        Path path{ "descent", {} };
+        for (unsigned i = 0; i < frames; ++i)
+        {
+            double t = (double)i / (double)std::max(frames - 1u, 1u);
+            path.waypoints.push_back({
+                7.5, 46.0,
+                1.0e7 * pow(2.0e3 / 1.0e7, t),
+                0.0,
+                -90.0 + 60.0 * t });
+        }
+        return path;
+    }
+
+    // Circle at 50km looking inward and down
+    Path makeOrbit(unsigned frames)
+    {
+        Path path{ "orbit", {} };
+        for (unsigned i = 0; i < frames; ++i)
+        {
+            double a = 2.0 * osg::PI * (double)i / (double)std::max(frames, 1u);
+            path.waypoints.push_back({
+                7.5 + 1.5 * sin(a), 46.0 + 1.0 * cos(a),
+                5.0e4,
+                osg::RadiansToDegrees(a) + 180.0,
+                -45.0 });
+        }
+        return path;
+    }
+
+    // Straight line at 3km looking ahead, the worst case for streaming
+    Path makeLowPass(unsigned frames)
+    {
+        Path path{ "lowpass", {} };
+        for (unsigned i = 0; i < frames; ++i)
+        {
+            double t = (double)i / (double)std::max(frames - 1u, 1u);
+            path.waypoints.push_back({
+                5.5 + 4.0 * t, 44.5 + 3.0 * t,
+                3.0e3,
+                43.0,
+                -20.0 });
+        }
+        return path;
+    }
+
+    bool readPath(const std::string& filename, Path& path)
+    {
+        std::ifstream in(filename);
+        if (!in.is_open())
+            return false;
+
+        path.name = osgDB::getStrippedName(filename);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            line = trim(line);
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream buf(line);
+            Waypoint w;
+            if (buf >> w.lon >> w.lat >> w.alt >> w.heading >> w.pitch)
+                path.waypoints.push_back(w);
+        }
+        return !path.waypoints.empty();
+    }
+
+    // Writes a smooth, deterministic DEM as an ESRI ASCII grid with a .prj,
+    // which GDAL reads without any extra configuration.
+    bool writeSyntheticDEM(const std::string& filename, unsigned cols)
+    {
+        double cellSize = (DEM_EAST - DEM_WEST) / (double)cols;
+        unsigned rows = (unsigned)((DEM_NORTH - DEM_SOUTH) / cellSize);
+
+        std::ofstream out(filename);
+        if (!out.is_open())
+            return false;
+
+        out << std::setprecision(12)
+            << "ncols " << cols << "\n"
+            << "nrows " << rows << "\n"
+            << "xllcorner " << DEM_WEST << "\n"
+            << "yllcorner " << DEM_SOUTH << "\n"
+            << "cellsize " << cellSize << "\n"
+            << "NODATA_value -9999\n";
+
+        out << std::fixed << std::setprecision(1);
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            double y = DEM_SOUTH + ((double)(rows - r) - 0.5) * cellSize;
+            for (unsigned c = 0; c < cols; ++c)
+            {
+                double x = DEM_WEST + ((double)c + 0.5) * cellSize;
+                double h =
+                    1500.0 +
+                    1200.0 * sin(x * 0.9) * cos(y * 1.3) +
+                    300.0 * sin(x * 7.1 + y * 5.3);
+                out << (c > 0 ? " " : "") << h;
+            }
+            out << "\n";
+        }
+        out.close();
+
+        std::ofstream prj(osgDB::getNameLessExtension(filename) + ".prj");
+        prj << SpatialReference::get("wgs84")->getWKT();
+        return !out.fail() && !prj.fail();
+    }
+
+    //! Headless stand-in for the terrain cull: selects tiles the way
+    //! the REX TileNode/SelectionInfo logic does, without a scene graph.
+    class TileSelector
+    {
+    public:
+        TileSelector(const Profile* profile, unsigned maxLOD, float minTileRangeFactor) :
+            _profile(profile),
+            _maxLOD(maxLOD)
+        {
+            // same per-LOD visibility ranges as SelectionInfo::initialize
+            for (unsigned lod = 0; lod <= maxLOD; ++lod)
+            {
+                unsigned tx, ty;
+                profile->getNumTiles(lod, tx, ty);
+                TileKey key(lod, tx / 2, ty / 2, profile);
+                GeoCircle c = key.getExtent().computeBoundingGeoCircle();
+                _ranges.push_back(c.getRadius() * minTileRangeFactor * 2.0 * (1.0 / 1.405));
+            }
+        }
+
+        //! Collects the tiles the terrain would keep resident for a camera,
+        //! including the ancestors of every visible tile.
+        void select(const Waypoint& w, std::set<TileKey>& output) const
+        {
+            const SpatialReference* srs = _profile->getSRS();
+            GeoPoint point(srs->getGeographicSRS(), w.lon, w.lat, w.alt, ALTMODE_ABSOLUTE);
+
+            osg::Vec3d eye;
+            point.toWorld(eye);
+            osg::Matrixd local2world;
+            point.createLocalToWorld(local2world);
+
+            // look vector and up vector in the local tangent plane (ENU)
+            double h = osg::DegreesToRadians(w.heading), p = osg::DegreesToRadians(w.pitch);
+            osg::Vec3d forward(sin(h) * cos(p), cos(h) * cos(p), sin(p));
+            osg::Vec3d up(-sin(h) * sin(p), -cos(h) * sin(p), cos(p));
+            forward = osg::Matrixd::transform3x3(forward, local2world);
+            up = osg::Matrixd::transform3x3(up, local2world);
+
+            osg::Matrixd view = osg::Matrixd::lookAt(eye, eye + forward, up);
+            osg::Matrixd proj = osg::Matrixd::perspective(30.0, 16.0 / 9.0, 1.0, 1e8);
+
+            osg::Polytope frustum;
+            frustum.setToUnitFrustum(false, false);
+            frustum.transformProvidingInverse(view * proj);
+
+            std::vector<TileKey> roots;
+            _profile->getRootKeys(roots);
+            for (auto& key : roots)
+                select(key, eye, frustum, output);
+        }
+
+    private:
+        void select(const TileKey& key, const osg::Vec3d& eye, osg::Polytope& frustum, std::set<TileKey>& output) const
+        {
+            output.insert(key);
+
+            if (key.getLOD() >= _maxLOD)
+                return;
+
+            osg::BoundingSphered bs = key.getExtent().createWorldBoundingSphere(MIN_ELEVATION, MAX_ELEVATION);
+            if (!frustum.contains(osg::BoundingSphere(osg::Vec3(bs.center()), bs.radius())))
+                return;
+
+            // REX creates all four children once the eye is in range of the next LOD
+            double distance = std::max((bs.center() - eye).length() - bs.radius(), 0.0);
+            if (distance < _ranges[key.getLOD() + 1])
+            {
+                for (unsigned q = 0; q < 4; ++q)
+                    select(key.createChildKey(q), eye, frustum, output);
+            }
+        }
+
+        osg::ref_ptr<const Profile> _profile;
+        unsigned _maxLOD;
+        std::vector<double> _ranges;
+    };
+
+    struct PathResult
+    {
+        std::string name;
+        unsigned frames = 0u;
+        unsigned tiles = 0u;
+        unsigned failed = 0u;
+        unsigned released = 0u;
+        unsigned peakResident = 0u;
+        unsigned peakPendingJobs = 0u;
+        double seconds = 0.0;
+        std::uint64_t keysHash = 14695981039346656037ull;
+        std::int64_t physicalBytes = 0;
+        std::int64_t peakPhysicalBytes = 0;
+        MetricsRegistry::Histogram latency{ 1e-6 };
+        MetricsRegistry::Histogram frameTime{ 1e-6 };
+    };
+
+    class TileBench
+    {
+    public:
+        TileBench(MapNode* mapNode, unsigned maxLOD, unsigned threads, bool buildGeometry) :
+            _mapNode(mapNode),
+            _selector(mapNode->getMap()->getProfile(), maxLOD, mapNode->options().terrain()->minTileRangeFactor().get()),
+            _buildGeometry(buildGeometry)
+        {
+            _pool = jobs::get_pool(BENCH_POOL);
+            _pool->set_concurrency(std::max(threads, 1u));
+        }
+
+        void run(const Path& path, PathResult& result)
+        {
+            result.name = path.name;
+
+            std::map<TileKey, osg::ref_ptr<osg::Referenced>> resident;
+            std::mutex residentMutex;
+            std::set<TileKey> everLoaded;
+
+            auto start = std::chrono::steady_clock::now();
+
+            for (auto& waypoint : path.waypoints)
+            {
+                auto frameStart = std::chrono::steady_clock::now();
+
+                std::set<TileKey> selected;
+                _selector.select(waypoint, selected);
+
+                // release tiles that fell out of the selection
+                for (auto i = resident.begin(); i != resident.end(); )
+                {
+                    if (selected.count(i->first) == 0)
+                    {
+                        i = resident.erase(i);
+                        ++result.released;
+                    }
+                    else ++i;
+                }
+
+                // find the newcomers before any job starts adding to "resident"
+                std::vector<TileKey> newcomers;
+                for (auto& key : selected)
+                {
+                    if (resident.count(key) == 0)
+                        newcomers.push_back(key);
+                }
+
+                // build the newcomers in parallel
+                std::atomic<unsigned> remaining((unsigned)newcomers.size());
+                std::atomic<unsigned> failed(0u);
+
+                for (auto& key : newcomers)
+                {
+                    everLoaded.insert(key);
+
+                    jobs::context job;
+                    job.name = "tilebench.build";
+                    job.pool = _pool;
+                    jobs::dispatch([this, key, &result, &resident, &residentMutex, &remaining, &failed]()
+                        {
+                            osg::ref_ptr<osg::Referenced> tile;
+                            {
+                                MetricsRegistry::ScopedTimer timer(result.latency);
+                                tile = build(key);
+                            }
+                            if (!tile.valid())
+                                ++failed;
+
+                            std::lock_guard<std::mutex> lock(residentMutex);
+                            resident[key] = tile;
+                            --remaining;
+                        },
+                        job);
+                }
+
+                while (remaining > 0u)
+                {
+                    result.peakPendingJobs = std::max(result.peakPendingJobs, (unsigned)jobs::get_metrics()->total_pending());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                result.failed += failed;
+                result.peakResident = std::max(result.peakResident, (unsigned)resident.size());
+                result.frameTime.record((std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - frameStart).count());
+                ++result.frames;
+            }
+
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.physicalBytes = Memory::getProcessPhysicalUsage();
+            result.peakPhysicalBytes = Memory::getProcessPeakPhysicalUsage();
+
+            // FNV-1a over the keys in order, so a change in tile selection
+            // shows up as a different hash
+            for (auto& key : everLoaded)
+            {
+                for (char c : key.str())
+                    result.keysHash = (result.keysHash ^ (std::uint8_t)c) * 1099511628211ull;
+                ++result.tiles;
+            }
+
+            // the next path starts from an empty terrain
+            resident.clear();
+        }
+
+    private:
+        osg::Referenced* build(const TileKey& key)
+        {
+            const Map* map = _mapNode->getMap();
+            TerrainEngine* engine = _mapNode->getTerrainEngine();
+
+            osg::ref_ptr<TerrainTileModel> model = engine->createTileModel(
+                map, key, _manifest, nullptr);
+
+            if (!model.valid() || !_buildGeometry)
+                return model.release();
+
+            osg::ref_ptr<osg::Node> node = engine->createStandaloneTile(
+                model.get(), TerrainEngineNode::CREATE_TILE_INCLUDE_ALL, 0u, key);
+
+            return node.release();
+        }
+
+        osg::ref_ptr<MapNode> _mapNode;
+        CreateTileManifest _manifest;
+        TileSelector _selector;
+        bool _buildGeometry;
+        jobs::jobpool* _pool;
+    };
+
+    void writeDistribution(std::ostream& out, const MetricsRegistry::Histogram& h)
+    {
+        double mean = h.count() > 0 ? h.sum() / (double)h.count() : 0.0;
+        out << "{ \"count\": " << h.count()
+            << ", \"mean\": " << mean
+            << ", \"p50\": " << h.quantile(0.5)
+            << ", \"p90\": " << h.quantile(0.9)
+            << ", \"p99\": " << h.quantile(0.99)
+            << ", \"max\": " << h.max() << " }";
+    }
+
+    void writeJSON(
+        std::ostream& out,
+        const std::vector<std::unique_ptr<PathResult>>& results,
+        unsigned threads,
+        unsigned maxLOD,
+        bool buildGeometry)
+    {
+        out << std::setprecision(6)
+            << "{\n"
+            << "  \"benchmark\": \"tilebench\",\n"
+            << "  \"osgearth_version\": \"" << osgEarthGetVersion() << "\",\n"
+            << "  \"threads\": " << threads << ",\n"
+            << "  \"max_lod\": " << maxLOD << ",\n"
+            << "  \"geometry\": " << (buildGeometry ? "true" : "false") << ",\n"
+            << "  \"paths\": [\n";
+
+        for (unsigned i = 0; i < results.size(); ++i)
+        {
+            const PathResult& r = *results[i];
+            out << "    {\n"
+                << "      \"name\": \"" << r.name << "\",\n"
+                << "      \"frames\": " << r.frames << ",\n"
+                << "      \"tiles\": " << r.tiles << ",\n"
+                << "      \"failed\": " << r.failed << ",\n"
+                << "      \"released\": " << r.released << ",\n"
+                << "      \"peak_resident_tiles\": " << r.peakResident << ",\n"
+                << "      \"seconds\": " << r.seconds << ",\n"
+                << "      \"tiles_per_second\": " << (r.seconds > 0.0 ? (double)r.latency.count() / r.seconds : 0.0) << ",\n"
+                << "      \"load_latency_seconds\": "; writeDistribution(out, r.latency); out << ",\n"
+                << "      \"frame_seconds\": "; writeDistribution(out, r.frameTime); out << ",\n"
+                << "      \"peak_pending_jobs\": " << r.peakPendingJobs << ",\n"
+                << "      \"physical_bytes\": " << r.physicalBytes << ",\n"
+                << "      \"peak_physical_bytes\": " << r.peakPhysicalBytes << ",\n"
+                << "      \"keys_hash\": \"" << std::hex << std::setw(16) << std::setfill('0') << r.keysHash
+                << std::dec << std::setfill(' ') << "\"\n"
+                << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+
+        out << "  ],\n"
+            << "  \"jobs\": [\n";
+
+        bool first = true;
+        for (auto* pool : jobs::get_metrics()->all())
+        {
+            if (!pool) continue;
+            out << (first ? "" : ",\n")
+                << "    { \"pool\": \"" << pool->name << "\""
+                << ", \"concurrency\": " << pool->concurrency
+                << ", \"total\": " << pool->total
+                << ", \"canceled\": " << pool->canceled
+                << ", \"pending\": " << pool->pending << " }";
+            first = false;
+        }
+
+        out << "\n  ],\n"
+            << "  \"peak_physical_bytes\": " << Memory::getProcessPeakPhysicalUsage() << ",\n"
+            << "  \"peak_private_bytes\": " << Memory::getProcessPeakPrivateUsage() << "\n"
+            << "}" << std::endl;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc, argv);
+
+    if (args.read("--help") || args.read("-h"))
+        return usage(argv);
+
+    std::string pathName = "all";
+    args.read("--path", pathName);
+
+    std::string pathFile;
+    args.read("--path-file", pathFile);
+
+    unsigned threads = 4u;
+    args.read("--threads", threads);
+
+    unsigned maxLOD = 16u;
+    args.read("--max-lod", maxLOD);
+
+    unsigned rasterSize = 1024u;
+    args.read("--raster-size", rasterSize);
+
+    unsigned frames = 120u;
+    args.read("--frames", frames);
+
+    bool buildGeometry = !args.read("--no-geometry");
+
+    std::string outFile;
+    args.read("--out", outFile);
+
+    osgEarth::initialize();
+
+    std::vector<Path> paths;
+    if (!pathFile.empty())
+    {
+        Path path;
+        if (!readPath(pathFile, path))
+        {
+            OE_WARN << LC << "Failed to read a path from " << pathFile << std::endl;
+            return -1;
+        }
+        paths.push_back(path);
+    }
+    else
+    {
+        if (pathName == "all" || pathName == "descent") paths.push_back(makeDescent(frames));
+        if (pathName == "all" || pathName == "orbit") paths.push_back(makeOrbit(frames));
+        if (pathName == "all" || pathName == "lowpass") paths.push_back(makeLowPass(frames * 2u));
+        if (paths.empty())
+            return usage(argv);
+    }
+
+    std::string demFile = getTempPath() + getTempName("osgearth_tilebench_", ".asc");
+
+    // removes the DEM and its .prj however we leave, after the map
+    // (declared below) lets go of them
+    struct TempFiles
+    {
+        std::string dem;
+        ~TempFiles()
+        {
+            std::remove(dem.c_str());
+            std::remove((osgDB::getNameLessExtension(dem) + ".prj").c_str());
+        }
+    } tempFiles{ demFile };
+
+    if (!writeSyntheticDEM(demFile, rasterSize))
+    {
+        OE_WARN << LC << "Failed to write " << demFile << std::endl;
+        return -1;
+    }
+
+    osg::ref_ptr<Map> map = new Map();
+
+    GDALElevationLayer* dem = new GDALElevationLayer();
+    dem->setName("synthetic_dem");
+    dem->setURL(demFile);
+    map->addLayer(dem);
+
+    FractalElevationLayer* fractal = new FractalElevationLayer();
+    fractal->setName("fractal");
+    fractal->setOffset(true);
+    fractal->setBaseLOD(12u);
+    fractal->setAmplitude(20.0f);
+    map->addLayer(fractal);
+
+    DebugImageLayer* debug = new DebugImageLayer();
+    debug->setName("debug");
+    map->addLayer(debug);
+
+    LayerVector layers;
+    map->getLayers(layers);
+    for (auto& layer : layers)
+    {
+        if (!layer->getStatus().isOK())
+        {
+            OE_WARN << LC << layer->getName() << ": " << layer->getStatus().message() << std::endl;
+            return -1;
+        }
+    }
+
+    MapNode::Options mapNodeOptions;
+    mapNodeOptions.terrain().mutable_value().maxLOD() = maxLOD;
+    osg::ref_ptr<MapNode> mapNode = new MapNode(map.get(), mapNodeOptions);
+    if (!mapNode->open() || !mapNode->getTerrainEngine())
+    {
+        OE_WARN << LC << "Failed to create a terrain engine" << std::endl;
+        return -1;
+    }
+
+    std::vector<std::unique_ptr<PathResult>> results;
+    {
+        TileBench bench(mapNode.get(), maxLOD, threads, buildGeometry);
+        for (auto& path : paths)
+        {
+            OE_INFO << LC << "Running path \"" << path.name << "\" (" << path.waypoints.size() << " frames)" << std::endl;
+            results.emplace_back(new PathResult());
+            bench.run(path, *results.back());
+        }
+    }
+
+    if (outFile.empty())
+    {
+        writeJSON(std::cout, results, threads, maxLOD, buildGeometry);
+    }
+    else
+    {
+        std::ofstream out(outFile);
+        writeJSON(out, results, threads, maxLOD, buildGeometry);
+        if (out.fail())
+        {
+            OE_WARN << LC << "Failed to write " << outFile << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarthProcedural/BiomeManager>
+#include <memory>
+
+using namespace osgEarth;
+using namespace osgEarth::Procedural;
+
+namespace
+{
+    // biome using a single asset
+    void addAsset(Biome& biome, const ModelAsset* asset)
+    {
+        auto ref = std::make_shared<Biome::ModelAssetRef>();
+        ref->asset() = asset;
+        biome._assetsToUse.push_back(ref);
+    }
+
+    // stands in for a real impostor so the asset has something to render
+    void installImpostor(BiomeManager& man, const std::string& group)
+    {
+        man.setCreateImpostorFunction(group,
+            [](const osg::BoundingBox&, float, std::vector<osg::Texture*>&)
+            {
+                BiomeManager::Impostor imp;
+                imp._node = new osg::Group();
+                imp._farLODScale = 1.0f;
+                return imp;
+            });
+    }
+}
+
+TEST_CASE("BiomeManager does not retry assets that fail to load")
+{
+    ModelAsset missing;
+    missing.name() = "missing";
+    missing.modelURI() = URI("osgearth_tests_missing_model.osgb");
+    missing.width() = 1.0f;
+
+    Biome first, second;
+    first.id() = "first";
+    second.id() = "second";
+    addAsset(first, &missing);
+    addAsset(second, &missing);
+
+    BiomeManager man;
+    man.ref(&first);
+    man.getResidentBiomes(nullptr, true);
+
+    BiomeManager::Stats stats = man.getStats();
+    REQUIRE(stats.failedAssets == 1u);
+    REQUIRE(stats.residentAssets == 0u);
+    REQUIRE(stats.pendingAssets == 0u);
+
+    // a new revision must not queue the same load again
+    int revision = man.getRevision();
+    man.ref(&second);
+    REQUIRE(man.getRevision() != revision);
+    man.getResidentBiomes(nullptr, false);
+    stats = man.getStats();
+    REQUIRE(stats.pendingAssets == 0u);
+    REQUIRE(stats.failedAssets == 1u);
+
+    // flushing gives it another chance
+    man.flush();
+    REQUIRE(man.getStats().failedAssets == 0u);
+}
+
+TEST_CASE("BiomeManager expires unused assets without a new revision")
+{
+    ModelAsset asset;
+    asset.name() = "tree";
+    asset.group() = "trees";
+    asset.sideBillboardURI() = URI("osgearth_tests_missing_billboard.png");
+    asset.width() = 1.0f;
+
+    Biome biome;
+    biome.id() = "forest";
+    addAsset(biome, &asset);
+
+    BiomeManager man;
+    installImpostor(man, "trees");
+    man.setUnusedAssetRetention(0.0);
+
+    man.ref(&biome);
+    man.getResidentBiomes(nullptr, true);
+    REQUIRE(man.getStats().residentAssets == 1u);
+
+    // nobody asks for the resident biomes again; letting go
+    // of the biome is enough to unload its asset.
+    int revision = man.getRevision();
+    man.unref(&biome);
+    REQUIRE(man.getRevision() == revision);
+    REQUIRE(man.getStats().residentAssets == 0u);
+    REQUIRE(man.getStats().assetsUnloaded == 1u);
+}
+
+TEST_CASE("BiomeManager waits on loads discarded by a settings change")
+{
+    std::vector<ModelAsset> assets(16);
+    Biome biome;
+    biome.id() = "forest";
+    for (unsigned i = 0; i < assets.size(); ++i)
+    {
+        assets[i].name() = "tree" + std::to_string(i);
+        assets[i].group() = "trees";
+        assets[i].sideBillboardURI() = URI("osgearth_tests_missing_billboard.png");
+        assets[i].width() = 1.0f;
+        addAsset(biome, &assets[i]);
+    }
+
+    auto man = std::make_shared<BiomeManager>();
+    installImpostor(*man, "trees");
+    man->ref(&biome);
+
+    // queue the loads in the background, drop them, and go away
+    // while they may still be running; the destructor has to wait.
+    man->getResidentBiomes(nullptr, false);
+    man->setLODTransitionPixelScale(8.0f);
+    REQUIRE(man->getStats().pendingAssets == 0u);
+    man.reset();
+
+    // the same loads work again with the new settings
+    BiomeManager again;
+    installImpostor(again, "trees");
+    again.setLODTransitionPixelScale(8.0f);
+    again.ref(&biome);
+    again.getResidentBiomes(nullptr, true);
+    REQUIRE(again.getStats().residentAssets == assets.size());
+}
@@ -0,0 +1,203 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/CacheSeed>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Map>
+#include <osgEarth/MemCache>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+using namespace osgEarth;
+using namespace osgEarth::Contrib;
+
+namespace
+{
+    // Image layer that counts how many tiles it creates.
+    class CountingImageLayer : public ImageLayer
+    {
+    public:
+        META_Layer(osgEarth, CountingImageLayer, Options, ImageLayer, countingimage);
+
+        mutable std::atomic_uint _calls;
+
+        Status openImplementation() override
+        {
+            Status parent = ImageLayer::openImplementation();
+            if (parent.isError())
+                return parent;
+
+            setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
+            return Status::OK();
+        }
+
+        GeoImage createImageImplementation(const TileKey& key, ProgressCallback* progress) const override
+        {
+            ++_calls;
+            osg::ref_ptr<osg::Image> image = ImageUtils::createOnePixelImage(osg::Vec4(1, 0, 0, 1));
+            return GeoImage(image.get(), key.getExtent());
+        }
+
+    protected:
+        void init() override
+        {
+            ImageLayer::init();
+            _calls = 0u;
+        }
+    };
+
+    // Cancels the operation once a number of tiles are done.
+    struct CancelAfter : public ProgressCallback
+    {
+        CancelAfter(double count) : _count(count) { }
+
+        bool reportProgress(double current, double total, unsigned, unsigned, const std::string&) override
+        {
+            return current >= _count;
+        }
+
+        double _count;
+    };
+}
+
+TEST_CASE("PipelinedCacheSeed resumes a canceled seed from its checkpoint")
+{
+    const std::string checkpoint = "osgearth_tests_cacheseed.checkpoint";
+    ::remove(checkpoint.c_str());
+
+    osg::ref_ptr<Map> map = new Map();
+    map->setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
+    map->setCache(new MemCache());
+
+    osg::ref_ptr<CountingImageLayer> layer = new CountingImageLayer();
+    layer->setName("counting, with a comma");
+    map->addLayer(layer.get());
+    REQUIRE(layer->isOpen());
+
+    // 2 root tiles at LOD 0 through LOD 3
+    const unsigned numKeys = 2u * (1u + 4u + 16u + 64u);
+
+    // first pass: cancel part way through.
+    PipelinedCacheSeed seeder;
+    seeder.setConcurrency(2u);
+    seeder.setBatchSize(8u);
+    seeder.setQueueSize(16u);
+    seeder.setCheckpointFile(checkpoint);
+
+    osg::ref_ptr<TileVisitor> visitor = new TileVisitor();
+    visitor->setMinLevel(0u);
+    visitor->setMaxLevel(3u);
+    visitor->setProgressCallback(new CancelAfter(40.0));
+    seeder.setVisitor(visitor.get());
+    seeder.run(layer.get(), map.get());
+
+    PipelinedCacheSeed::Stats first = seeder.getStats();
+    REQUIRE(first.created > 0u);
+    REQUIRE(first.created < numKeys);
+
+    // second pass: no cancelation, picks up from the checkpoint.
+    visitor = new TileVisitor();
+    visitor->setMinLevel(0u);
+    visitor->setMaxLevel(3u);
+    seeder.setVisitor(visitor.get());
+
+    unsigned callsBefore = layer->_calls;
+    seeder.run(layer.get(), map.get());
+
+    PipelinedCacheSeed::Stats second = seeder.getStats();
+    unsigned calls = layer->_calls - callsBefore;
+
+    // every key is accounted for exactly once:
+    REQUIRE(second.generated == numKeys);
+    REQUIRE(second.resumed > 0u);
+    REQUIRE(second.resumed + second.cached + second.created + second.empty == numKeys);
+
+    // and only the keys that were neither checkpointed nor cached got created:
+    REQUIRE(second.empty == 0u);
+    REQUIRE(calls == second.created);
+    REQUIRE(calls <= numKeys - second.resumed);
+
+    // everything is in the cache now.
+    std::vector<TileKey> keys;
+    for (unsigned lod = 0; lod <= 3u; ++lod)
+    {
+        unsigned tx, ty;
+        map->getProfile()->getNumTiles(lod, tx, ty);
+        for (unsigned x = 0; x < tx; ++x)
+            for (unsigned y = 0; y < ty; ++y)
+                keys.emplace_back(lod, x, y, map->getProfile());
+    }
+    REQUIRE(keys.size() == numKeys);
+
+    std::vector<bool> cached;
+    layer->isCached(keys, cached);
+    REQUIRE(std::count(cached.begin(), cached.end(), true) == (long)numKeys);
+
+    ::remove(checkpoint.c_str());
+}
+
+TEST_CASE("PipelinedCacheSeed ignores a checkpoint from other extents")
+{
+    const std::string checkpoint = "osgearth_tests_cacheseed_extents.checkpoint";
+    ::remove(checkpoint.c_str());
+
+    osg::ref_ptr<Map> map = new Map();
+    map->setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
+    map->setCache(new MemCache());
+
+    osg::ref_ptr<CountingImageLayer> layer = new CountingImageLayer();
+    layer->setName("counting");
+    map->addLayer(layer.get());
+    REQUIRE(layer->isOpen());
+
+    PipelinedCacheSeed seeder;
+    seeder.setConcurrency(2u);
+    seeder.setCheckpointFile(checkpoint);
+
+    // checkpoint part of a whole-world seed...
+    osg::ref_ptr<TileVisitor> visitor = new TileVisitor();
+    visitor->setMinLevel(0u);
+    visitor->setMaxLevel(3u);
+    visitor->setProgressCallback(new CancelAfter(40.0));
+    seeder.setVisitor(visitor.get());
+    seeder.run(layer.get(), map.get());
+    REQUIRE(seeder.getStats().created > 0u);
+
+    // ...then seed the eastern hemisphere at the same levels.
+    visitor = new TileVisitor();
+    visitor->setMinLevel(0u);
+    visitor->setMaxLevel(3u);
+    visitor->addExtentToVisit(GeoExtent(map->getProfile()->getSRS(), 0.0, -90.0, 180.0, 90.0));
+    seeder.setVisitor(visitor.get());
+    seeder.run(layer.get(), map.get());
+
+    PipelinedCacheSeed::Stats stats = seeder.getStats();
+    REQUIRE(stats.generated > 0u);
+    REQUIRE(stats.resumed == 0u);
+    REQUIRE(stats.cached + stats.created == stats.generated);
+
+    ::remove(checkpoint.c_str());
+}
@@ -24,6 +24,15 @@
 #include <osgEarth/GeoData>
 #include <osgEarth/Registry>
 #include <osgEarth/MemCache>
+#include <osgEarth/StringUtils>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
 
 using namespace osgEarth;
 
@@ -83,3 +92,165 @@ TEST_CASE( "Cache" ) {
         REQUIRE(r2.failed());
     }  
 }
+
+namespace
+{
+    Cache* openTilePack(const std::string& path)
+    {
+        Config conf("cache");
+        conf.set("driver", "tilepack");
+        conf.set("path", path);
+        return CacheFactory::create(CacheOptions(ConfigOptions(conf)));
+    }
+
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        std::ostringstream buf;
+        buf << in.rdbuf();
+        return buf.str();
+    }
+
+    Cache* openFileSystem(const std::string& path)
+    {
+        Config conf("cache");
+        conf.set("driver", "filesystem");
+        conf.set("path", path);
+        conf.set("threads", 0u); // write synchronously
+        return CacheFactory::create(CacheOptions(ConfigOptions(conf)));
+    }
+
+    bool put(CacheBin* bin, const std::string& key, const std::string& value)
+    {
+        osg::ref_ptr<StringObject> object = new StringObject(value);
+        return bin->write(key, object.get(), 0L);
+    }
+
+    std::string readValue(CacheBin* bin, const std::string& key, const osgDB::Options* options =0L)
+    {
+        ReadResult r = bin->readString(key, options);
+        return r.succeeded() ? r.getString() : "(missing)";
+    }
+}
+
+TEST_CASE("Filesystem cache never returns a stale prefetch")
+{
+    const std::string root = "osgearth_tests_fscache";
+
+    osg::ref_ptr<Cache> cache = openFileSystem(root);
+    if (!cache.valid() || !cache->getStatus().isOK())
+    {
+        WARN("Skipping: the filesystem cache driver is not available");
+        return;
+    }
+
+    osg::ref_ptr<CacheBin> bin = cache->addBin("bin");
+    REQUIRE(bin.valid());
+    bin->clear();
+
+    SECTION("Removed record")
+    {
+        REQUIRE(put(bin.get(), "a", "v1"));
+        bin->prefetchObjects({ "a" }, 0L);
+        REQUIRE(bin->remove("a"));
+        REQUIRE(readValue(bin.get(), "a") == "(missing)");
+    }
+
+    SECTION("Rewritten record")
+    {
+        REQUIRE(put(bin.get(), "b", "v1"));
+        bin->prefetchObjects({ "b" }, 0L);
+        REQUIRE(put(bin.get(), "b", "v2"));
+        REQUIRE(readValue(bin.get(), "b") == "v2");
+    }
+
+    SECTION("Different read options")
+    {
+        REQUIRE(put(bin.get(), "c", "v1"));
+        bin->prefetchObjects({ "c" }, 0L);
+
+        // give the prefetch time to finish
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        // change the record behind this bin's back
+        osg::ref_ptr<Cache> other = openFileSystem(root);
+        REQUIRE(put(other->addBin("bin"), "c", "v2"));
+
+        // a read with other options must not get the prefetch made with none
+        osg::ref_ptr<osgDB::Options> options = new osgDB::Options();
+        REQUIRE(readValue(bin.get(), "c", options.get()) == "v2");
+    }
+
+    bin->clear();
+}
+
+TEST_CASE("TilePack cache ignores segments left over from a compaction")
+{
+    const std::string root = "osgearth_tests_tilepack";
+    const std::string binPath = osgDB::concatPaths(root, "bin");
+
+    osg::ref_ptr<Cache> cache = openTilePack(root);
+    if (!cache.valid() || !cache->getStatus().isOK())
+    {
+        WARN("Skipping: the tilepack cache driver is not available");
+        return;
+    }
+
+    osg::ref_ptr<CacheBin> bin = cache->addBin("bin");
+    REQUIRE(bin.valid());
+    bin->clear();
+
+    REQUIRE(put(bin.get(), "a", "v1"));
+    REQUIRE(put(bin.get(), "a", "v2"));
+    REQUIRE(put(bin.get(), "b", "removed"));
+    REQUIRE(put(bin.get(), "c", "kept"));
+    REQUIRE(bin->remove("b"));
+
+    // Keep copies of the segments the compaction is about to delete
+    std::map<std::string, std::string> before;
+    for (auto& name : osgDB::getDirectoryContents(binPath))
+        if (endsWith(name, ".oetp"))
+            before[name] = readFile(osgDB::concatPaths(binPath, name));
+    REQUIRE_FALSE(before.empty());
+
+    REQUIRE(bin->compact());
+
+    // Put them back, as if deleting them had failed
+    for (auto& i : before)
+    {
+        std::string path = osgDB::concatPaths(binPath, i.first);
+        REQUIRE_FALSE(osgDB::fileExists(path));
+        std::ofstream out(path.c_str(), std::ios::binary);
+        out << i.second;
+    }
+
+    // Newer writes that the leftovers would otherwise override on reopen
+    REQUIRE(put(bin.get(), "a", "v3"));
+    REQUIRE(bin->remove("c"));
+
+    bin = nullptr;
+    cache = nullptr;
+
+    cache = openTilePack(root);
+    bin = cache->addBin("bin");
+    REQUIRE(bin.valid());
+
+    REQUIRE(readValue(bin.get(), "a") == "v3");
+    REQUIRE(readValue(bin.get(), "b") == "(missing)");
+    REQUIRE(readValue(bin.get(), "c") == "(missing)");
+
+    for (auto& i : before)
+        REQUIRE_FALSE(osgDB::fileExists(osgDB::concatPaths(binPath, i.first)));
+
+    // clearing disowns the segments before deleting them
+    REQUIRE(put(bin.get(), "d", "cleared"));
+    REQUIRE(bin->clear());
+    bin = nullptr;
+    cache = nullptr;
+
+    cache = openTilePack(root);
+    bin = cache->addBin("bin");
+    REQUIRE(readValue(bin.get(), "d") == "(missing)");
+    REQUIRE(readValue(bin.get(), "a") == "(missing)");
+    bin->clear();
+}
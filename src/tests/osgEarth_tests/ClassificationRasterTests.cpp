@@ -0,0 +1,110 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/catch.hpp>
+#include <osgEarth/ClassificationRaster>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/GeoCommon>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    osg::Image* makeImage(unsigned size)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RED, GL_FLOAT);
+        return image;
+    }
+}
+
+TEST_CASE("ClassificationRaster")
+{
+    const unsigned size = 64;
+    osg::ref_ptr<osg::Image> image = makeImage(size);
+
+    // broad bands (run-length encoded), except for some noisy rows at the
+    // top (stored plain)
+    for (unsigned t = 0; t < size; ++t)
+    {
+        float* row = (float*)image->data(0, t);
+        for (unsigned s = 0; s < size; ++s)
+        {
+            row[s] = t >= 56 && s >= size / 2 ?
+                (float)((s * 7 + t * 13) % 5 + 100) :
+                (float)(s / 8);
+        }
+    }
+    ((float*)image->data(3, 5))[0] = NO_DATA_VALUE;
+
+    auto raster = ClassificationRaster::create(image.get());
+    REQUIRE(raster != nullptr);
+    REQUIRE(raster->s() == size);
+    REQUIRE(raster->t() == size);
+
+    SECTION("Every pixel matches the source image") {
+        bool match = true;
+        for (unsigned t = 0; t < size; ++t)
+        {
+            const float* row = (const float*)image->data(0, t);
+            for (unsigned s = 0; s < size; ++s)
+            {
+                int expected = row[s] == NO_DATA_VALUE ? ClassificationRaster::NO_DATA : (int)row[s];
+                match = match && (*raster)((int)s, (int)t) == expected;
+            }
+        }
+        REQUIRE(match);
+    }
+
+    SECTION("Normalized reads match PixelReader") {
+        ImageUtils::PixelReader read(image.get());
+        read.setBilinear(false);
+        osg::Vec4f pixel;
+        bool match = true;
+        for (double v = 0.0; v <= 1.0; v += 0.0137)
+        {
+            for (double u = 0.0; u <= 1.0; u += 0.0137)
+            {
+                read(pixel, u, v);
+                auto value = (*raster)(u, v);
+                if (pixel.r() == NO_DATA_VALUE)
+                    match = match && value == ClassificationRaster::NO_DATA;
+                else
+                    match = match && value == (int)pixel.r();
+            }
+        }
+        REQUIRE(match);
+    }
+
+    SECTION("Round trip through an image") {
+        osg::ref_ptr<osg::Image> decoded = raster->createImage();
+        REQUIRE(memcmp(decoded->data(), image->data(), image->getTotalSizeInBytes()) == 0);
+    }
+
+    SECTION("Palette holds the distinct values") {
+        REQUIRE(raster->getPalette().size() == 8 + 5 + 1);
+    }
+
+    SECTION("Smaller than the float image") {
+        REQUIRE(raster->getSizeInBytes() < image->getTotalSizeInBytes() / 2);
+    }
+}
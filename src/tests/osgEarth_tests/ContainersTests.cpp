@@ -0,0 +1,82 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/catch.hpp>
+#include <osgEarth/Containers>
+#include <set>
+#include <string>
+
+using namespace osgEarth;
+
+TEST_CASE("LRUReferences")
+{
+    // cells of a map sharing the road segments that cross their borders
+    LRUReferences<int, std::string> refs;
+    using Names = std::set<std::string>;
+    Names released;
+    auto release = [&](const std::string& item) { released.insert(item); };
+    auto keepNone = [](int) { return false; };
+
+    refs.add(1, "a");
+    refs.add(1, "ab");
+    refs.add(2, "ab");
+    refs.add(2, "b");
+    refs.touch(3); // a cell with no roads
+    refs.add(1, "a"); // again; no effect
+
+    REQUIRE(refs.size() == 3u);
+    REQUIRE(refs.refs("a") == 1u);
+    REQUIRE(refs.refs("ab") == 2u);
+
+    SECTION("Shared items outlive the first key")
+    {
+        refs.erase(1, release);
+        REQUIRE(released == Names({ "a" }));
+        REQUIRE(refs.refs("ab") == 1u);
+
+        refs.erase(2, release);
+        REQUIRE(released == Names({ "a", "ab", "b" }));
+        REQUIRE(refs.has(3));
+    }
+
+    SECTION("Trim evicts the least recently used keys")
+    {
+        // 1 was used last, then 3, so 2 goes first
+        REQUIRE(refs.trim(2u, keepNone, release) == 1u);
+        REQUIRE_FALSE(refs.has(2));
+        REQUIRE(released == Names({ "b" }));
+
+        refs.touch(3);
+        REQUIRE(refs.trim(1u, keepNone, release) == 1u);
+        REQUIRE(refs.has(3));
+        REQUIRE(released == Names({ "a", "ab", "b" }));
+    }
+
+    SECTION("Trim skips the keys to keep")
+    {
+        auto keep2 = [](int key) { return key == 2; };
+        REQUIRE(refs.trim(0u, keep2, release) == 2u);
+        REQUIRE(refs.size() == 1u);
+        REQUIRE(refs.has(2));
+        REQUIRE(refs.refs("ab") == 1u);
+        REQUIRE(released == Names({ "a" }));
+    }
+}
@@ -0,0 +1,147 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Elevation>
+#include <osgEarth/Profile>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace
+{
+    const unsigned tileSize = ELEVATION_TILE_SIZE;
+
+    std::vector<float> makeHeights(float lowest, float range)
+    {
+        std::vector<float> heights(tileSize * tileSize);
+        for (unsigned i = 0; i < heights.size(); ++i)
+            heights[i] = lowest + range * 0.5f * (1.0f + sinf(0.37f * (float)i));
+        return heights;
+    }
+
+    // largest error of the decoded heights, or -1 if NO_DATA didn't survive
+    double maxDecodeError(const QuantizedHeights& q, const std::vector<float>& heights)
+    {
+        double result = 0.0;
+        std::vector<float> row(tileSize);
+        for (unsigned t = 0; t < tileSize; ++t)
+        {
+            q.decodeRow(t, row.data());
+            for (unsigned s = 0; s < tileSize; ++s)
+            {
+                float expected = heights[t * tileSize + s];
+                if (row[s] != q.get(s, t))
+                    return -1.0;
+                if ((expected == NO_DATA_VALUE) != (row[s] == NO_DATA_VALUE))
+                    return -1.0;
+                if (expected != NO_DATA_VALUE)
+                    result = std::max(result, (double)fabs(expected - row[s]));
+            }
+        }
+        return result;
+    }
+}
+
+TEST_CASE("QuantizedHeights")
+{
+    SECTION("Stays within the error bound, with NO_DATA intact")
+    {
+        std::vector<float> heights = makeHeights(-400.0f, 8848.0f);
+        heights[17] = NO_DATA_VALUE;
+
+        QuantizedHeights q;
+        REQUIRE(q.encode(heights.data(), tileSize, tileSize, 0.1f));
+        REQUIRE(q.getBitsPerSample() == 16u);
+        REQUIRE(q.getSizeInBytes() == tileSize * tileSize * 2u);
+
+        double error = maxDecodeError(q, heights);
+        REQUIRE(error >= 0.0);
+        REQUIRE(error <= 0.1 + 1e-3);
+    }
+
+    SECTION("Uses 8 bits when the range allows it")
+    {
+        std::vector<float> heights = makeHeights(120.0f, 40.0f);
+
+        QuantizedHeights q;
+        REQUIRE(q.encode(heights.data(), tileSize, tileSize, 0.1f));
+        REQUIRE(q.getBitsPerSample() == 8u);
+
+        double error = maxDecodeError(q, heights);
+        REQUIRE(error >= 0.0);
+        REQUIRE(error <= 0.1 + 1e-3);
+    }
+
+    SECTION("Refuses ranges that need more than 16 bits")
+    {
+        std::vector<float> heights = makeHeights(0.0f, 3000.0f);
+
+        QuantizedHeights q;
+        REQUIRE_FALSE(q.encode(heights.data(), tileSize, tileSize, 0.01f));
+        REQUIRE_FALSE(q.valid());
+    }
+}
+
+TEST_CASE("ElevationTexture storage")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey key(6, 10, 20, profile.get());
+
+    std::vector<float> heights = makeHeights(0.0f, 2000.0f);
+    osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+    hf->allocate(tileSize, tileSize);
+    std::copy(heights.begin(), heights.end(), hf->getFloatArray()->asVector().begin());
+    GeoHeightField geohf(hf.get(), key.getExtent());
+
+    std::vector<float> resolutions(tileSize * tileSize, (float)key.getResolution(tileSize).second);
+
+    SECTION("Float tiles share the heightfield with the texture image")
+    {
+        osg::ref_ptr<ElevationTexture> tex = new ElevationTexture(key, geohf, resolutions);
+        REQUIRE_FALSE(tex->isQuantized());
+        REQUIRE(tex->getImage() != nullptr);
+        REQUIRE((const void*)tex->getImage()->data() == hf->getFloatArray()->getDataPointer());
+        REQUIRE(tex->getResolutions().size() == 1u);
+        REQUIRE(tex->getResolution(100, 200) == resolutions[0]);
+        REQUIRE(tex->getHeight(5, 7) == heights[7 * tileSize + 5]);
+    }
+
+    SECTION("Quantized tiles decode on demand")
+    {
+        osg::ref_ptr<ElevationTexture> tex = new ElevationTexture(key, geohf, resolutions, 0.25f);
+        REQUIRE(tex->isQuantized());
+        REQUIRE(tex->getImage() == nullptr);
+        REQUIRE(tex->getHeightField() == nullptr);
+        REQUIRE(fabs(tex->getHeight(5, 7) - heights[7 * tileSize + 5]) <= 0.25f + 1e-3f);
+
+        osg::ref_ptr<ElevationTexture> full = tex->uncompressed();
+        REQUIRE_FALSE(full->isQuantized());
+        REQUIRE(full->getImage() != nullptr);
+        REQUIRE(full->getHeightField() != nullptr);
+        REQUIRE(full->getHeight(5, 7) == tex->getHeight(5, 7));
+        REQUIRE(full->getTileKey() == key);
+    }
+}
@@ -23,7 +23,12 @@
 #include <osgEarth/catch.hpp>
 
 #include <osgEarth/Feature>
+#include <osgEarth/FeatureExpression>
 #include <osgEarth/GeometryUtils>
+#include <osgEarth/OgrUtils>
+#include <chrono>
+#include <set>
+#include <iostream>
 
 using namespace osgEarth;
 
@@ -109,3 +114,198 @@ TEST_CASE("Feature handles attributes correctly.") {
         REQUIRE(feature->getBool("bool") == false);
     }
 }
+
+
+namespace
+{
+    // Fills a column store and a set of plain features with the same
+    // attributes, in the shape of a typical OGR layer.
+    void makeFeatures(unsigned count, AttributeColumns* columns, FeatureList& columnar, FeatureList& plain)
+    {
+        const char* kinds[] = { "residential", "commercial", "industrial", "a much longer land use description" };
+        for (unsigned i = 0; i < count; ++i)
+        {
+            osg::ref_ptr<Feature> a = new Feature(new Geometry(), nullptr, Style(), i);
+            osg::ref_ptr<Feature> b = new Feature(new Geometry(), nullptr, Style(), i);
+
+            unsigned row = columns->addRow();
+            columns->set(row, columns->addColumn("NAME", ATTRTYPE_STRING), kinds[i % 4]);
+            columns->set(row, columns->addColumn("height", ATTRTYPE_DOUBLE), 10.0 + (double)(i % 7));
+            columns->set(row, columns->addColumn("floors", ATTRTYPE_INT), (long long)(i % 5));
+            columns->addColumn("note", ATTRTYPE_STRING); // always NULL
+            a->setAttributeRow(columns, row);
+
+            b->set("name", std::string(kinds[i % 4]));
+            b->set("height", 10.0 + (double)(i % 7));
+            b->set("floors", (long long)(i % 5));
+            b->setNull("note", ATTRTYPE_STRING);
+
+            columnar.push_back(a);
+            plain.push_back(b);
+        }
+    }
+}
+
+TEST_CASE("Feature attributes in a column store") {
+    osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
+    FeatureList columnar, plain;
+    makeFeatures(100, columns.get(), columnar, plain);
+
+    REQUIRE(columns->getNumRows() == 100);
+    REQUIRE(columns->getNumColumns() == 4);
+    REQUIRE(columns->getNumStrings() == 4);
+
+    SECTION("Columnar features read the same as plain ones") {
+        for (unsigned i = 0; i < columnar.size(); ++i)
+        {
+            const Feature* a = columnar[i].get();
+            const Feature* b = plain[i].get();
+            REQUIRE(a->getString("name") == b->getString("name"));
+            REQUIRE(a->getString("Name") == b->getString("Name"));
+            REQUIRE(a->getDouble("height") == b->getDouble("height"));
+            REQUIRE(a->getInt("floors") == b->getInt("floors"));
+            REQUIRE(a->getString("height") == b->getString("height"));
+            REQUIRE(a->isSet("note") == false);
+            REQUIRE(a->hasAttr("note") == true);
+            REQUIRE(a->hasAttr("missing") == false);
+            REQUIRE(a->getDouble("missing", 42.0) == 42.0);
+            REQUIRE(a->getAttrs().size() == b->getAttrs().size());
+            REQUIRE(a->getAttrs().find("height")->second.getDouble() == b->getDouble("height"));
+        }
+    }
+
+    SECTION("Changing a columnar feature doesn't touch the store") {
+        Feature* a = columnar[0].get();
+        a->set("name", std::string("changed"));
+        a->set("extra", 1.0);
+        REQUIRE(a->getAttributeColumns() == nullptr);
+        REQUIRE(a->getString("name") == "changed");
+        REQUIRE(a->getInt("floors") == plain[0]->getInt("floors"));
+        REQUIRE(a->getDouble("extra") == 1.0);
+        REQUIRE(columnar[4]->getString("name") == plain[4]->getString("name"));
+    }
+
+    SECTION("Copies share the row") {
+        osg::ref_ptr<Feature> copy = new Feature(*columnar[3]);
+        REQUIRE(copy->getAttributeColumns() == columns.get());
+        REQUIRE(copy->getString("name") == plain[3]->getString("name"));
+    }
+}
+
+TEST_CASE("OGR attribute names are lower case with or without a column store") {
+    OGRFeatureDefnH defn = OGR_FD_Create("test");
+    OGR_FD_Reference(defn);
+    OGRFieldDefnH name = OGR_Fld_Create("Name", OFTString);
+    OGRFieldDefnH height = OGR_Fld_Create("HEIGHT", OFTReal);
+    OGR_FD_AddFieldDefn(defn, name);
+    OGR_FD_AddFieldDefn(defn, height);
+    OGR_Fld_Destroy(name);
+    OGR_Fld_Destroy(height);
+
+    OGRFeatureH handle = OGR_F_Create(defn);
+    OGR_F_SetFieldString(handle, 0, "main street");
+    OGR_F_SetFieldDouble(handle, 1, 12.5);
+
+    osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
+    osg::ref_ptr<Feature> plain = OgrUtils::createFeature(handle, (const FeatureProfile*)nullptr);
+    osg::ref_ptr<Feature> columnar = OgrUtils::createFeature(handle, (const FeatureProfile*)nullptr, true, columns.get());
+
+    REQUIRE(plain.valid());
+    REQUIRE(columnar.valid());
+    REQUIRE(columnar->getAttributeColumns() == columns.get());
+
+    for (auto& feature : { plain, columnar })
+    {
+        // lookups ignore case, so check the names themselves
+        std::set<std::string> names;
+        for (auto& attr : feature->getAttrs())
+            names.insert(attr.first);
+        REQUIRE(names == std::set<std::string>({ "height", "name" }));
+        REQUIRE(feature->getString("name") == "main street");
+        REQUIRE(feature->getDouble("height") == 12.5);
+    }
+
+    OGR_F_Destroy(handle);
+    OGR_FD_Release(defn);
+}
+
+TEST_CASE("Feature expressions match Feature::eval") {
+    osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
+    FeatureList columnar, plain;
+    makeFeatures(20, columns.get(), columnar, plain);
+
+    NumericExpression numeric("max([height] * 2, 15) + [FLOORS] % 3 - [missing]");
+    FeatureNumericExpression boundNumeric(numeric);
+
+    StringExpression string("\"type: \" + [name] + \" \" + [floors]");
+    FeatureStringExpression boundString(string);
+
+    std::vector<double> numbers;
+    boundNumeric.eval(columnar, nullptr, numbers);
+    REQUIRE(numbers.size() == columnar.size());
+
+    std::vector<std::string> strings;
+    boundString.eval(plain, nullptr, strings);
+    REQUIRE(strings.size() == plain.size());
+
+    for (unsigned i = 0; i < plain.size(); ++i)
+    {
+        double expected = plain[i]->eval(numeric, (FilterContext*)nullptr);
+        REQUIRE(numbers[i] == expected);
+        REQUIRE(boundNumeric.eval(plain[i].get(), nullptr) == expected);
+
+        const std::string& expectedString = plain[i]->eval(string, (FilterContext*)nullptr);
+        REQUIRE(strings[i] == expectedString);
+        REQUIRE(boundString.eval(columnar[i].get(), nullptr) == expectedString);
+    }
+
+    REQUIRE(FeatureNumericExpression(NumericExpression(-4.5)).eval(plain[0].get(), nullptr) == -4.5);
+
+    StringExpression literal;
+    literal.setLiteral("[name] stays as is");
+    REQUIRE(FeatureStringExpression(literal).eval(plain[0].get(), nullptr) == "[name] stays as is");
+}
+
+TEST_CASE("Feature attribute storage benchmark", "[.benchmark]") {
+    const unsigned count = 200000;
+    osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
+    FeatureList columnar, plain;
+    makeFeatures(count, columns.get(), columnar, plain);
+
+    // lower bound for the plain tables: entries plus long strings
+    std::size_t plainBytes = 0;
+    for (auto& f : plain)
+    {
+        plainBytes += f->getAttrs()._container.capacity() * sizeof(AttributeTable::ENTRY);
+        for (auto& attr : f->getAttrs())
+            if (attr.second.value.stringValue.capacity() > 15u)
+                plainBytes += attr.second.value.stringValue.capacity() + 1u;
+    }
+    std::size_t columnarBytes = columns->getSizeInBytes();
+
+    auto time = [&](const FeatureList& features)
+    {
+        auto start = std::chrono::steady_clock::now();
+        double sum = 0.0;
+        std::size_t chars = 0;
+        for (auto& f : features)
+        {
+            sum += f->getDouble("height") + (double)f->getInt("floors");
+            chars += f->getString("name").size();
+        }
+        auto end = std::chrono::steady_clock::now();
+        REQUIRE(sum > 0.0);
+        REQUIRE(chars > 0u);
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    double plainMs = time(plain);
+    double columnarMs = time(columnar);
+
+    std::cout
+        << "Attributes for " << count << " features:\n"
+        << "  plain:    " << plainBytes / 1024 << " KB, " << plainMs << " ms to read\n"
+        << "  columnar: " << columnarBytes / 1024 << " KB, " << columnarMs << " ms to read\n";
+
+    REQUIRE(columnarBytes < plainBytes);
+}
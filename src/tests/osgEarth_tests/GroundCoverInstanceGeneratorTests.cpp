@@ -0,0 +1,140 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/catch.hpp>
+#include <osgEarthSplat/GroundCoverInstanceGenerator>
+#include <osg/Texture2D>
+#include <cstring>
+
+using namespace osgEarth;
+using namespace osgEarth::Splat;
+
+namespace
+{
+    const int GRASS = 5; // land cover code with assets
+    const int WATER = 9; // land cover code without
+
+    // single channel float texture, filled by a function of the pixel
+    template<typename FUNC>
+    osg::Texture* createTexture(int size, FUNC&& value)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RED, GL_FLOAT);
+        float* ptr = (float*)image->data();
+        for (int t = 0; t < size; ++t)
+            for (int s = 0; s < size; ++s)
+                *ptr++ = value(s, t);
+        return new osg::Texture2D(image);
+    }
+
+    GroundCoverLayer::LUT createLUT()
+    {
+        GroundCoverLayer::LUT lut;
+        lut.groups.push_back({ 0, 2, 1.0f });
+        lut.assets.push_back({ 3, 4, 2.0f, 4.0f, 0.0f });
+        lut.assets.push_back({ 7, 8, 1.0f, 1.0f, 0.0f });
+        lut.groupIndex[std::make_pair(0, GRASS)] = 0;
+        return lut;
+    }
+
+    GroundCoverInstanceGenerator::Tile createTile()
+    {
+        GroundCoverInstanceGenerator::Tile tile;
+        tile.LL.set(-100.0f, -100.0f);
+        tile.UR.set(100.0f, 100.0f);
+
+        // grass on the west half, water on the east half
+        tile.landCoverTex = createTexture(16, [](int s, int) {
+            return (float)(s < 8 ? GRASS : WATER); });
+
+        // 100m in the south half of the elevation texture (plus a row of
+        // margin) and 200m in the rest; the tile only covers the south half,
+        // so the scale differs in x and y.
+        tile.elevationTex = createTexture(16, [](int, int t) {
+            return t <= 8 ? 100.0f : 200.0f; });
+        tile.elevationMatrix.makeScale(1.0f, 0.5f, 1.0f);
+
+        return tile;
+    }
+
+    bool same(const std::vector<GroundCoverInstanceGenerator::Instance>& a, const std::vector<GroundCoverInstanceGenerator::Instance>& b)
+    {
+        return a.size() == b.size() &&
+            (a.empty() || ::memcmp(&a[0], &b[0], a.size() * sizeof(a[0])) == 0);
+    }
+}
+
+TEST_CASE("GroundCoverInstanceGenerator")
+{
+    GroundCoverInstanceGenerator gen;
+    gen.setLUT(createLUT());
+    gen.setNumInstances1D(32u);
+
+    auto tile = createTile();
+
+    std::vector<GroundCoverInstanceGenerator::Instance> instances;
+    REQUIRE(gen.generate(tile, instances) > 0u);
+
+    SECTION("Instances follow the LUT")
+    {
+        for (auto& i : instances)
+        {
+            // nothing on the water, which has no group in the LUT
+            REQUIRE(i.tilec.x() < 0.5f + 1.0f / 16.0f);
+
+            bool asset0 = i.sideIndex == 3 && i.topIndex == 4 && i.width == 2.0f && i.height == 4.0f;
+            bool asset1 = i.sideIndex == 7 && i.topIndex == 8 && i.width == 1.0f && i.height == 1.0f;
+            REQUIRE((asset0 || asset1));
+        }
+    }
+
+    SECTION("Elevation uses the matrix scale of each axis")
+    {
+        for (auto& i : instances)
+            REQUIRE(i.vertex.z() == Approx(100.0f));
+    }
+
+    SECTION("Output is deterministic")
+    {
+        std::vector<GroundCoverInstanceGenerator::Instance> again;
+        gen.generate(tile, again);
+        REQUIRE(same(instances, again));
+
+        // parallel generation packs the same per-tile results
+        gen.setConcurrency(4u);
+        std::vector<GroundCoverInstanceGenerator::Tile> tiles(8, tile);
+        GroundCoverInstanceGenerator::Output output;
+        gen.generate(tiles, output);
+
+        REQUIRE(output.commands.size() == tiles.size());
+        for (unsigned t = 0; t < tiles.size(); ++t)
+        {
+            auto& cmd = output.commands[t];
+            REQUIRE(cmd.instanceCount == instances.size());
+            REQUIRE(cmd.baseInstance == t * instances.size());
+
+            std::vector<GroundCoverInstanceGenerator::Instance> slice(
+                output.instances.begin() + cmd.baseInstance,
+                output.instances.begin() + cmd.baseInstance + cmd.instanceCount);
+            REQUIRE(same(instances, slice));
+        }
+    }
+}
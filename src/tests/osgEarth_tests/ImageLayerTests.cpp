@@ -53,6 +53,17 @@ TEST_CASE( "ImageLayers can be created" )
         REQUIRE(image.getImage()->t() == 256);
         REQUIRE(image.getExtent() == key.getExtent());
     }
+
+    SECTION("Tile statistics record each request")
+    {
+        TileKey key(0, 0, 0, layer->getProfile());
+        layer->createImage(key);
+
+        auto totals = layer->getTileStatistics().getTotals(TileLayerStatistics::ORIGIN_SOURCE, 0u);
+        REQUIRE(totals.count == 1u);
+        REQUIRE(totals.bytes >= 256u * 256u * 3u);
+        REQUIRE(layer->getTileStatistics().getLatency(TileLayerStatistics::ORIGIN_SOURCE).count() == 1u);
+    }
 }
 
 TEST_CASE("Attribution works")
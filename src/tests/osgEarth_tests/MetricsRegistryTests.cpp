@@ -0,0 +1,129 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/MetricsRegistry>
+#include <sstream>
+#include <thread>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+TEST_CASE("MetricsRegistry counters are exact under contention") {
+    auto& counter = MetricsRegistry::instance().counter(
+        "osgearth_test_counter_total", { {"test", "contention"} });
+    std::int64_t start = counter.value();
+
+    const int num_threads = 8;
+    const int per_thread = 10000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i)
+        threads.emplace_back([&]() { for (int j = 0; j < per_thread; ++j) counter.add(); });
+    for (auto& t : threads)
+        t.join();
+
+    REQUIRE(counter.value() - start == num_threads * per_thread);
+
+    // same name and labels, same counter
+    REQUIRE(&MetricsRegistry::instance().counter(
+        "osgearth_test_counter_total", { {"test", "contention"} }) == &counter);
+}
+
+TEST_CASE("MetricsRegistry lookups of a mismatched type share one instrument") {
+    auto& registry = MetricsRegistry::instance();
+    registry.gauge("osgearth_test_mismatched", { {"test", "mismatch"} });
+
+    // every thread must get the same counter, created exactly once
+    const int num_threads = 8;
+    const int per_thread = 1000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i)
+        threads.emplace_back([&]() {
+            auto& counter = registry.counter("osgearth_test_mismatched", { {"test", "mismatch"} });
+            for (int j = 0; j < per_thread; ++j)
+                counter.add();
+        });
+    for (auto& t : threads)
+        t.join();
+
+    REQUIRE(registry.counter("osgearth_test_mismatched", { {"test", "mismatch"} }).value() == num_threads * per_thread);
+}
+
+TEST_CASE("MetricsRegistry histograms") {
+    using H = MetricsRegistry::Histogram;
+
+    SECTION("Every value falls inside its bucket") {
+        for (std::uint64_t v : { 0ull, 1ull, 15ull, 16ull, 17ull, 31ull, 32ull, 1000ull, 123456789ull, ~0ull })
+        {
+            unsigned b = H::bucketOf(v);
+            REQUIRE(b < H::NUM_BUCKETS);
+            REQUIRE(H::bucketMin(b) <= v);
+            REQUIRE(v <= H::bucketMax(b));
+        }
+    }
+
+    SECTION("Quantiles are within one bucket of the truth") {
+        H h;
+        for (std::uint64_t v = 1; v <= 10000; ++v)
+            h.record(v);
+
+        REQUIRE(h.count() == 10000u);
+        REQUIRE(h.max() == 10000.0);
+        REQUIRE(h.quantile(0.5) == Approx(5000.0).epsilon(1.0 / 16.0));
+        REQUIRE(h.quantile(0.99) == Approx(9900.0).epsilon(1.0 / 16.0));
+    }
+}
+
+TEST_CASE("MetricsRegistry exports Prometheus text") {
+    auto& registry = MetricsRegistry::instance();
+    registry.describe("osgearth_test_export_total", "Export test");
+    registry.counter("osgearth_test_export_total", { {"layer", "a \"quoted\" name"} }).add(3);
+
+    std::ostringstream out;
+    registry.writePrometheus(out);
+    std::string text = out.str();
+
+    REQUIRE(text.find("# HELP osgearth_test_export_total Export test") != std::string::npos);
+    REQUIRE(text.find("# TYPE osgearth_test_export_total counter") != std::string::npos);
+    REQUIRE(text.find("osgearth_test_export_total{layer=\"a \\\"quoted\\\" name\"} 3") != std::string::npos);
+}
+
+TEST_CASE("MetricsRegistry removes the series of one label value") {
+    auto& registry = MetricsRegistry::instance();
+    registry.counter("osgearth_test_removed_total", { {"layer", "gone"}, {"origin", "a"} }).add(1);
+    registry.counter("osgearth_test_removed_total", { {"layer", "gone"}, {"origin", "b"} }).add(2);
+    registry.counter("osgearth_test_removed_total", { {"layer", "kept"}, {"origin", "a"} }).add(3);
+    registry.counter("osgearth_test_other_total", { {"layer", "gone"} }).add(4);
+
+    registry.remove("osgearth_test_removed_total", { {"layer", "gone"} });
+
+    std::ostringstream out;
+    registry.writePrometheus(out);
+    std::string text = out.str();
+
+    REQUIRE(text.find("osgearth_test_removed_total{layer=\"gone\"") == std::string::npos);
+    REQUIRE(text.find("osgearth_test_removed_total{layer=\"kept\",origin=\"a\"} 3") != std::string::npos);
+    REQUIRE(text.find("osgearth_test_other_total{layer=\"gone\"} 4") != std::string::npos);
+
+    // the name can be used again, starting over
+    REQUIRE(registry.counter("osgearth_test_removed_total", { {"layer", "gone"}, {"origin", "a"} }).value() == 0);
+}
@@ -0,0 +1,158 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Elevation>
+#include <osgEarth/ImageUtils>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace
+{
+    const int tileSize = ELEVATION_TILE_SIZE;
+    const int stride = ELEVATION_TILE_SIZE + 2;
+
+    // Rolling terrain with a one-sample apron, like createNormalMap builds
+    std::vector<float> makeGrid()
+    {
+        std::vector<float> grid(stride * stride);
+        for (int t = 0; t < stride; ++t)
+            for (int s = 0; s < stride; ++s)
+                grid[t*stride + s] = 800.0f * sinf(0.05f*s) * cosf(0.03f*t) + 3.0f*(float)((s*7 + t*13) % 11);
+        return grid;
+    }
+
+    inline float rowDX(int t)
+    {
+        // shrinks with latitude, as in a geographic tile
+        return 30.0f * cosf(0.5f + 0.001f*(float)t);
+    }
+
+    // The per-pixel path: vector math, then pack() and a PixelWriter
+    void perPixel(const std::vector<float>& grid, float dy, osg::Image* image)
+    {
+        ImageUtils::PixelWriter write(image);
+        osg::Vec3 a[4], normal;
+        osg::Vec4 pixel;
+
+        for (int t = 0; t < tileSize; ++t)
+        {
+            float dx = rowDX(t);
+            for (int s = 0; s < tileSize; ++s)
+            {
+                float w = grid[(t + 1)*stride + s];
+                float e = grid[(t + 1)*stride + s + 2];
+                float south = grid[t*stride + s + 1];
+                float north = grid[(t + 2)*stride + s + 1];
+
+                if (w != NO_DATA_VALUE && e != NO_DATA_VALUE &&
+                    south != NO_DATA_VALUE && north != NO_DATA_VALUE)
+                {
+                    a[0].set(-dx, 0, w);
+                    a[1].set(dx, 0, e);
+                    a[2].set(0, -dy, south);
+                    a[3].set(0, dy, north);
+                    normal = (a[1] - a[0]) ^ (a[3] - a[2]);
+                    normal.normalize();
+                }
+                else
+                {
+                    normal.set(0, 0, 1);
+                }
+
+                NormalMapGenerator::pack(normal, pixel);
+                write(pixel, s, t);
+            }
+        }
+    }
+
+    void byRow(const std::vector<float>& grid, float dy, osg::Image* image)
+    {
+        for (int t = 0; t < tileSize; ++t)
+        {
+            NormalMapGenerator::createNormalRow(
+                &grid[t*stride], &grid[(t + 1)*stride], &grid[(t + 2)*stride],
+                tileSize, rowDX(t), dy, image->data(0, t), nullptr);
+        }
+    }
+
+    osg::Image* makeImage()
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(tileSize, tileSize, 1, GL_RG, GL_UNSIGNED_BYTE);
+        return image;
+    }
+}
+
+TEST_CASE("NormalMapGenerator rows match the per-pixel normals")
+{
+    std::vector<float> grid = makeGrid();
+    grid[40*stride + 40] = NO_DATA_VALUE;
+
+    osg::ref_ptr<osg::Image> expected = makeImage();
+    osg::ref_ptr<osg::Image> actual = makeImage();
+    perPixel(grid, 30.0f, expected.get());
+    byRow(grid, 30.0f, actual.get());
+
+    // packing skips normalization, so allow for rounding at the last bit
+    int maxDiff = 0;
+    for (unsigned i = 0; i < expected->getTotalSizeInBytes(); ++i)
+        maxDiff = std::max(maxDiff, std::abs((int)expected->data()[i] - (int)actual->data()[i]));
+    REQUIRE(maxDiff <= 1);
+
+    // the pixels next to the missing sample face straight up
+    REQUIRE(actual->data(40, 39)[0] == 127);
+    REQUIRE(actual->data(40, 39)[1] == 127);
+    REQUIRE(actual->data(39, 38)[0] == 127);
+}
+
+TEST_CASE("NormalMapGenerator benchmark", "[.benchmark]") {
+    const int runs = 200;
+    std::vector<float> grid = makeGrid();
+    osg::ref_ptr<osg::Image> image = makeImage();
+
+    auto time = [&](void(*func)(const std::vector<float>&, float, osg::Image*))
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < runs; ++i)
+            func(grid, 30.0f, image.get());
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / (double)runs;
+    };
+
+    double perPixelMs = time(perPixel);
+    double byRowMs = time(byRow);
+
+    std::cout
+        << "Normal map for a " << tileSize << "x" << tileSize << " tile:\n"
+        << "  per pixel: " << perPixelMs << " ms\n"
+        << "  by row:    " << byRowMs << " ms\n";
+
+    REQUIRE(byRowMs > 0.0);
+}
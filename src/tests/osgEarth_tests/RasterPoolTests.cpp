@@ -0,0 +1,127 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/catch.hpp>
+#include <osgEarth/RasterPool>
+#include <osgEarth/ImageUtils>
+#include <cstring>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+TEST_CASE("RasterPool")
+{
+    // The pool is process-wide, so use sizes nothing else asks for
+    // and look at changes in the counters.
+    RasterPool& pool = RasterPool::instance();
+    pool.setEnabled(true);
+
+    SECTION("Images reuse buffers of the same size")
+    {
+        unsigned char* first = nullptr;
+        {
+            osg::ref_ptr<osg::Image> image = pool.createImage(123, 45, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            REQUIRE(image->s() == 123);
+            REQUIRE(image->t() == 45);
+            REQUIRE(image->getImageSizeInBytes() == 123u * 45u * 4u);
+            first = image->data();
+        }
+
+        RasterPool::Stats before = pool.getStats();
+        osg::ref_ptr<osg::Image> image = pool.createImage(123, 45, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        RasterPool::Stats after = pool.getStats();
+
+        REQUIRE(image->data() == first);
+        REQUIRE(after.reuses == before.reuses + 1);
+        REQUIRE(after.allocations == before.allocations);
+    }
+
+    SECTION("Heightfields reuse arrays unless shared")
+    {
+        const osg::FloatArray* first = nullptr;
+        {
+            osg::ref_ptr<osg::HeightField> hf = pool.createHeightField(37, 41);
+            REQUIRE(hf->getNumColumns() == 37);
+            REQUIRE(hf->getNumRows() == 41);
+            REQUIRE(hf->getFloatArray()->size() == 37u * 41u);
+            first = hf->getFloatArray();
+        }
+
+        osg::ref_ptr<osg::FloatArray> held;
+        {
+            osg::ref_ptr<osg::HeightField> hf = pool.createHeightField(37, 41);
+            REQUIRE(hf->getFloatArray() == first);
+            hf->setHeight(0, 0, 42.0f);
+            held = hf->getFloatArray();
+        }
+
+        // someone still holds the array, so it must not be handed out again
+        osg::ref_ptr<osg::HeightField> hf = pool.createHeightField(37, 41);
+        REQUIRE(hf->getFloatArray() != held.get());
+        REQUIRE((*held)[0] == 42.0f);
+    }
+
+    SECTION("Mipmapping a pooled image keeps it in the pool")
+    {
+        osg::ref_ptr<osg::Image> image = pool.createImage(64, 96, 1, GL_RG, GL_UNSIGNED_BYTE);
+        unsigned char* level0 = image->data();
+        ::memset(level0, 7, image->getTotalSizeInBytes());
+
+        RasterPool::Stats before = pool.getStats();
+        ImageUtils::mipmapImageInPlace(image.get());
+        RasterPool::Stats after = pool.getStats();
+
+        // the level-0 buffer went back to the pool right away...
+        REQUIRE(image->getNumMipmapLevels() > 1);
+        REQUIRE(image->data() != level0);
+        REQUIRE(image->data()[0] == 7);
+        REQUIRE(after.releases == before.releases + 1);
+
+        // ...and the mipmapped buffer returns to the pool with the image
+        std::size_t inUse = after.inUseBytes;
+        image = nullptr;
+        REQUIRE(pool.getStats().inUseBytes < inUse);
+    }
+
+    SECTION("Small rasters are not pooled")
+    {
+        RasterPool::Stats before = pool.getStats();
+        osg::ref_ptr<osg::Image> image = pool.createImage(4, 4, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        RasterPool::Stats after = pool.getStats();
+        REQUIRE(after.allocations == before.allocations);
+        REQUIRE(after.reuses == before.reuses);
+    }
+
+    SECTION("Trim enforces the watermark")
+    {
+        std::size_t max = pool.getMaxIdleBytes();
+        {
+            osg::ref_ptr<osg::Image> a = pool.createImage(111, 99, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            osg::ref_ptr<osg::Image> b = pool.createImage(111, 99, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+        REQUIRE(pool.getStats().idleBytes >= 2u * 111u * 99u * 4u);
+
+        pool.setMaxIdleBytes(0u);
+        REQUIRE(pool.getStats().idleBytes == 0u);
+
+        pool.setMaxIdleBytes(max);
+    }
+}
@@ -0,0 +1,208 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include "RocksDBCache"
+#include "RocksDBCacheBin"
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::RocksDBCache;
+
+// These run against the rocksdb cache sources built into the test
+// program, since the plugin's classes aren't visible from here.
+
+namespace
+{
+    osg::ref_ptr<RocksDBCacheImpl> openRocksDB(const std::string& path, unsigned batchBytes, bool columnFamilies)
+    {
+        Config conf("cache");
+        conf.set("driver", "rocksdb");
+        conf.set("path", path);
+        conf.set("write_batch_bytes", batchBytes);
+        conf.set("write_batch_period_ms", 600000u); // never commits on its own
+        conf.set("column_family_per_bin", columnFamilies);
+        return new RocksDBCacheImpl(CacheOptions(ConfigOptions(conf)));
+    }
+
+    RocksDBCacheBin* openBin(RocksDBCacheImpl* cache, const std::string& name)
+    {
+        RocksDBCacheBin* bin = dynamic_cast<RocksDBCacheBin*>(cache->addBin(name));
+        if (bin)
+            bin->clear();
+        return bin;
+    }
+
+    bool put(CacheBin* bin, const std::string& key, const std::string& value)
+    {
+        osg::ref_ptr<StringObject> object = new StringObject(value);
+        return bin->write(key, object.get(), Config(), nullptr);
+    }
+
+    std::string readValue(CacheBin* bin, const std::string& key)
+    {
+        ReadResult r = bin->readString(key, nullptr);
+        return r.succeeded() ? r.getString() : "(missing)";
+    }
+
+    unsigned pendingWrites(RocksDBCacheBin* bin)
+    {
+        return bin->getStatistics().value("pending_writes", 0u);
+    }
+}
+
+TEST_CASE("RocksDB cache batches writes")
+{
+    osg::ref_ptr<RocksDBCacheImpl> cache = openRocksDB("osgearth_tests_rocksdb_batch", 1u << 20, false);
+    RocksDBCacheBin* bin = openBin(cache.get(), "bin");
+    REQUIRE(bin != nullptr);
+
+    REQUIRE(put(bin, "committed", "1"));
+    REQUIRE(bin->flush());
+    REQUIRE(pendingWrites(bin) == 0u);
+
+    REQUIRE(put(bin, "batched", "2"));
+    REQUIRE(put(bin, "batched", "3"));
+    REQUIRE(pendingWrites(bin) > 0u);
+
+    // pending writes are readable, and the latest one wins
+    REQUIRE(readValue(bin, "batched") == "3");
+    REQUIRE(readValue(bin, "committed") == "1");
+
+    SECTION("Status checks see the batch without committing it")
+    {
+        std::vector<std::string> keys = { "committed", "missing", "batched" };
+        std::vector<CacheBin::RecordStatus> status;
+        bin->getRecordStatusBatch(keys, status);
+
+        REQUIRE(status.size() == 3u);
+        REQUIRE(status[0] == CacheBin::STATUS_OK);
+        REQUIRE(status[1] == CacheBin::STATUS_NOT_FOUND);
+        REQUIRE(status[2] == CacheBin::STATUS_OK);
+        REQUIRE(pendingWrites(bin) > 0u);
+
+        REQUIRE(bin->flush());
+        bin->getRecordStatusBatch(keys, status);
+        REQUIRE(status[0] == CacheBin::STATUS_OK);
+        REQUIRE(status[1] == CacheBin::STATUS_NOT_FOUND);
+        REQUIRE(status[2] == CacheBin::STATUS_OK);
+    }
+
+    SECTION("Batched writes survive closing the cache")
+    {
+        bin = nullptr;
+        cache = nullptr;
+
+        cache = openRocksDB("osgearth_tests_rocksdb_batch", 1u << 20, false);
+        CacheBin* reopened = cache->addBin("bin");
+        REQUIRE(readValue(reopened, "batched") == "3");
+        reopened->clear();
+    }
+}
+
+TEST_CASE("RocksDB cache keeps bins in their own column families")
+{
+    osg::ref_ptr<RocksDBCacheImpl> cache = openRocksDB("osgearth_tests_rocksdb_cf", 0u, true);
+    RocksDBCacheBin* a = openBin(cache.get(), "a");
+    RocksDBCacheBin* b = openBin(cache.get(), "b");
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+
+    REQUIRE(put(a, "key", "in a"));
+    REQUIRE(put(b, "key", "in b"));
+    REQUIRE(readValue(a, "key") == "in a");
+    REQUIRE(readValue(b, "key") == "in b");
+
+    // clearing one bin leaves the other alone
+    REQUIRE(a->clear());
+    REQUIRE(readValue(a, "key") == "(missing)");
+    REQUIRE(readValue(b, "key") == "in b");
+
+    // and the families come back when the cache is reopened
+    a = b = nullptr;
+    cache = nullptr;
+    cache = openRocksDB("osgearth_tests_rocksdb_cf", 0u, true);
+    CacheBin* reopened = cache->addBin("b");
+    REQUIRE(readValue(reopened, "key") == "in b");
+    reopened->clear();
+}
+
+TEST_CASE("RocksDB cache keeps existing data when column families are turned on")
+{
+    osg::ref_ptr<RocksDBCacheImpl> cache = openRocksDB("osgearth_tests_rocksdb_cf_upgrade", 0u, false);
+    RocksDBCacheBin* bin = openBin(cache.get(), "bin");
+    REQUIRE(bin != nullptr);
+    REQUIRE(put(bin, "key", "before"));
+
+    bin = nullptr;
+    cache = nullptr;
+
+    // the option is refused so the existing records stay visible
+    cache = openRocksDB("osgearth_tests_rocksdb_cf_upgrade", 0u, true);
+    REQUIRE(cache->getStatistics().value("column_family_per_bin", true) == false);
+
+    CacheBin* reopened = cache->addBin("bin");
+    REQUIRE(reopened != nullptr);
+    REQUIRE(readValue(reopened, "key") == "before");
+    reopened->clear();
+}
+
+TEST_CASE("RocksDB cache reads and removes by key prefix")
+{
+    // batched, to check that pending writes are included
+    osg::ref_ptr<RocksDBCacheImpl> cache = openRocksDB("osgearth_tests_rocksdb_prefix", 1u << 20, false);
+    RocksDBCacheBin* bin = openBin(cache.get(), "bin");
+    REQUIRE(bin != nullptr);
+
+    REQUIRE(put(bin, "tile/2", "b"));
+    REQUIRE(put(bin, "tile/1", "a"));
+    REQUIRE(put(bin, "tiles", "not a tile"));
+    REQUIRE(put(bin, "other/1", "c"));
+
+    std::vector<std::string> keys, values;
+    unsigned count = bin->readPrefix("tile/", nullptr,
+        [&](const std::string& key, ReadResult& r)
+        {
+            keys.push_back(key);
+            values.push_back(r.getString());
+            return true;
+        });
+
+    REQUIRE(count == 2u);
+    REQUIRE(keys == std::vector<std::string>({ "tile/1", "tile/2" }));
+    REQUIRE(values == std::vector<std::string>({ "a", "b" }));
+
+    // the callback can stop early
+    count = bin->readPrefix("tile/", nullptr,
+        [](const std::string&, ReadResult&) { return false; });
+    REQUIRE(count == 1u);
+
+    REQUIRE(bin->removePrefix("tile/") == 2u);
+    REQUIRE(readValue(bin, "tile/1") == "(missing)");
+    REQUIRE(readValue(bin, "tile/2") == "(missing)");
+    REQUIRE(readValue(bin, "tiles") == "not a tile");
+    REQUIRE(readValue(bin, "other/1") == "c");
+    REQUIRE(bin->readPrefix("tile/", nullptr,
+        [](const std::string&, ReadResult&) { return true; }) == 0u);
+
+    bin->clear();
+}
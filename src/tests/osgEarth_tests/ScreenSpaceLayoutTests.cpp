@@ -0,0 +1,259 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ScreenSpaceLayoutImpl>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Internal;
+
+namespace
+{
+    osg::BoundingBox makeBox(float x, float y, float w, float h)
+    {
+        return osg::BoundingBox(x, y, 0.0f, x + w, y + h, 0.0f);
+    }
+}
+
+TEST_CASE("DeclutterGrid")
+{
+    osg::ref_ptr<osg::Geode> a = new osg::Geode(), b = new osg::Geode();
+
+    DeclutterGrid grid;
+    grid.reset(0.0f, 0.0f, 1920.0f, 1080.0f, 64.0f);
+
+    SECTION("Places the same boxes as testing every pair")
+    {
+        std::mt19937 rng(7);
+        std::vector<osg::ref_ptr<osg::Geode>> parents(400);
+        std::vector<std::pair<const osg::Node*, osg::BoundingBox>> placed;
+
+        for (unsigned i = 0; i < 1000u; ++i)
+        {
+            // some boxes hang off the window
+            osg::BoundingBox box = makeBox(
+                (float)(rng() % 2100) - 100.0f, (float)(rng() % 1200) - 60.0f,
+                (float)(10 + rng() % 150), (float)(10 + rng() % 40));
+
+            osg::ref_ptr<osg::Geode>& parent = parents[i % parents.size()];
+            if (!parent.valid())
+                parent = new osg::Geode();
+
+            bool expected = true;
+            for (auto& p : placed)
+            {
+                if (box.intersects(p.second) && p.first != parent.get())
+                {
+                    expected = false;
+                    break;
+                }
+            }
+
+            bool actual = grid.findConflict(box, parent.get()) < 0;
+            REQUIRE(actual == expected);
+
+            if (actual)
+            {
+                grid.insert(box, parent.get(), nullptr, true);
+                placed.emplace_back(parent.get(), box);
+            }
+        }
+    }
+
+    SECTION("Tracks which cells changed since the previous pass")
+    {
+        grid.insert(makeBox(10, 10, 20, 20), a.get(), nullptr, true);
+        grid.insert(makeBox(500, 500, 20, 20), b.get(), nullptr, false);
+
+        REQUIRE(grid.findConflict(makeBox(25, 25, 20, 20), b.get()) == 0);
+        REQUIRE(grid.findConflict(makeBox(25, 25, 20, 20), a.get()) < 0);
+        REQUIRE(grid.isClean(makeBox(25, 25, 20, 20)));
+        REQUIRE_FALSE(grid.isClean(makeBox(490, 490, 20, 20)));
+    }
+}
+
+namespace
+{
+    // A screen full of labels, decluttered pass after pass
+    struct Scene
+    {
+        struct Label
+        {
+            osg::ref_ptr<osg::Geometry> drawable;
+            osg::BoundingBox box;
+            const osg::Node* parent = nullptr;
+            bool pinned = false;
+            DeclutterRecord record;
+            bool visible = true;
+        };
+
+        std::vector<Label> labels;
+        DeclutterGrid grid;
+        unsigned pass = 0u;
+        unsigned reused = 0u;
+
+        // one pass over the labels in "order", like the declutter sort callback.
+        // Without "reuse", every label starts from a blank record.
+        void declutter(const std::vector<unsigned>& order, float threshold, bool reuse)
+        {
+            grid.reset(0.0f, 0.0f, 1920.0f, 1080.0f, 64.0f);
+            std::set<const osg::Node*> culledParents;
+            ++pass;
+
+            for (unsigned i : order)
+            {
+                Label& label = labels[i];
+                if (!reuse)
+                    label.record = DeclutterRecord();
+
+                float buffer = label.visible ? 1.0f : 3.0f;
+                osg::BoundingBox box(
+                    label.box.xMin() - buffer, label.box.yMin() - buffer, 0.0f,
+                    label.box.xMax() + buffer, label.box.yMax() + buffer, 0.0f);
+
+                const DeclutterRecord* blockerRecord = nullptr;
+                for (auto& other : labels)
+                    if (other.drawable.get() == label.record._blocker)
+                        blockerRecord = &other.record;
+
+                bool groupCulled = culledParents.count(label.parent) > 0;
+                bool visible = true;
+                DeclutterOutcome outcome = declutterBox(
+                    grid, label.record, blockerRecord, box, label.parent, label.drawable.get(),
+                    label.pinned, groupCulled, pass, threshold, visible);
+
+                if (outcome == DeclutterOutcome::REUSED)
+                    ++reused;
+                if (!visible)
+                    culledParents.insert(label.parent);
+                label.visible = visible;
+            }
+        }
+    };
+}
+
+TEST_CASE("Declutter passes")
+{
+    std::mt19937 rng(11);
+    std::vector<osg::ref_ptr<osg::Geode>> parents;
+
+    auto makeLabel = [&](const osg::BoundingBox& box, bool newParent)
+    {
+        if (newParent || parents.empty())
+            parents.push_back(new osg::Geode());
+
+        Scene::Label label;
+        label.drawable = new osg::Geometry();
+        label.box = box;
+        label.parent = parents.back().get();
+        return label;
+    };
+
+    SECTION("Reusing results places the same labels as testing them all")
+    {
+        Scene reusing, testing;
+        for (unsigned i = 0; i < 600u; ++i)
+        {
+            // every fourth label shares a parent with the one before it
+            Scene::Label label = makeLabel(makeBox(
+                (float)(rng() % 2000) - 40.0f, (float)(rng() % 1100) - 10.0f,
+                (float)(20 + rng() % 120), (float)(10 + rng() % 20)),
+                i % 4 != 0);
+            label.pinned = (i % 97 == 0);
+            reusing.labels.push_back(label);
+        }
+        testing.labels = reusing.labels;
+
+        std::vector<unsigned> order(reusing.labels.size());
+        for (unsigned i = 0; i < order.size(); ++i)
+            order[i] = i;
+
+        for (unsigned frame = 0; frame < 200u; ++frame)
+        {
+            // a few labels move, and a few drop out of the pass
+            for (unsigned i = 0; i < reusing.labels.size(); ++i)
+            {
+                if (rng() % 10 == 0)
+                {
+                    float dx = (float)(rng() % 11) - 5.0f, dy = (float)(rng() % 11) - 5.0f;
+                    osg::BoundingBox& box = reusing.labels[i].box;
+                    box.set(box.xMin() + dx, box.yMin() + dy, 0.0f, box.xMax() + dx, box.yMax() + dy, 0.0f);
+                    testing.labels[i].box = box;
+                }
+            }
+
+            std::vector<unsigned> visited;
+            for (unsigned i : order)
+                if (rng() % 20 != 0)
+                    visited.push_back(i);
+
+            // now and then the priorities change
+            if (frame % 25 == 24)
+                std::swap(order[rng() % order.size()], order[rng() % order.size()]);
+
+            reusing.declutter(visited, 0.0f, true);
+            testing.declutter(visited, 0.0f, false);
+
+            for (unsigned i : visited)
+                REQUIRE(reusing.labels[i].visible == testing.labels[i].visible);
+        }
+
+        // make sure the reuse paths ran
+        REQUIRE(reusing.reused > 0u);
+        REQUIRE(testing.reused == 0u);
+    }
+
+    SECTION("A label drifting below the motion threshold is tested again")
+    {
+        const float threshold = 2.0f;
+
+        Scene scene;
+        scene.labels.push_back(makeLabel(makeBox(100.0f, 100.0f, 50.0f, 20.0f), true));
+        scene.labels.push_back(makeLabel(makeBox(200.0f, 100.0f, 50.0f, 20.0f), true));
+        const std::vector<unsigned> order = { 0u, 1u };
+
+        // half a pixel per frame, until it sits right on top of the first one
+        for (unsigned frame = 0; frame < 200u; ++frame)
+        {
+            osg::BoundingBox& box = scene.labels[1].box;
+            box.set(box.xMin() - 0.5f, box.yMin(), 0.0f, box.xMax() - 0.5f, box.yMax(), 0.0f);
+
+            scene.declutter(order, threshold, true);
+
+            REQUIRE(scene.labels[0].visible);
+
+            // the overlap can't grow beyond what the threshold allows
+            // on both sides (plus the 1-pixel buffer on each box)
+            float overlap = scene.labels[0].box.xMax() - box.xMin() + 2.0f;
+            if (overlap > 2.0f * threshold)
+                REQUIRE_FALSE(scene.labels[1].visible);
+        }
+
+        REQUIRE(scene.reused > 0u);
+    }
+}
@@ -0,0 +1,197 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ScriptEngine>
+#include <osgEarth/Feature>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+using namespace osgEarth;
+
+namespace
+{
+    void makeFeatures(unsigned count, FeatureList& output)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            Feature* f = new Feature(new Point(), nullptr);
+            f->setFID(i);
+            f->set("height", 10.0 + (double)(i % 50));
+            f->set("floors", (long long)(i % 7));
+            f->set("name", std::string("building_") + std::to_string(i));
+            f->set("type", std::string(i % 3 == 0 ? "house" : "office"));
+            f->set("closed", i % 2 == 0);
+            output.push_back(f);
+        }
+    }
+
+    ScriptEngine* createEngine(const std::string& profile)
+    {
+        ScriptEngine* engine = ScriptEngineFactory::create("javascript", "", true);
+        if (engine)
+            engine->setProfile(profile);
+        return engine;
+    }
+}
+
+TEST_CASE("Script engine feature bindings") {
+    osg::ref_ptr<ScriptEngine> lazy = createEngine("");
+    osg::ref_ptr<ScriptEngine> eager = createEngine("eager");
+
+    if (!lazy.valid() || !eager.valid())
+    {
+        WARN("Skipping: the javascript script engine plugin is not available");
+        return;
+    }
+
+    FeatureList features;
+    makeFeatures(10, features);
+
+    const std::vector<std::string> scripts = {
+        "feature.properties.height * 2 + feature.properties.floors",
+        "feature.properties.name + ':' + feature.properties.type",
+        "feature.properties.closed ? 'yes' : 'no'",
+        "feature.id",
+        "feature.properties.missing === undefined",
+        "feature.properties.floors = 99; feature.properties.floors"
+    };
+
+    SECTION("Lazy and eager bindings agree") {
+        for (auto& script : scripts)
+        {
+            for (auto& f : features)
+            {
+                ScriptResult a = lazy->run(script, f.get());
+                ScriptResult b = eager->run(script, f.get());
+                REQUIRE(a.success());
+                REQUIRE(b.success());
+                REQUIRE(a.asString() == b.asString());
+            }
+        }
+    }
+
+    SECTION("Batch run matches single runs") {
+        for (auto& script : scripts)
+        {
+            std::vector<ScriptResult> results;
+            REQUIRE(lazy->run(script, features, results));
+            REQUIRE(results.size() == features.size());
+            unsigned i = 0;
+            for (auto& f : features)
+            {
+                REQUIRE(results[i++].asString() == eager->run(script, f.get()).asString());
+            }
+        }
+    }
+
+    SECTION("Assignments don't leak into the next feature") {
+        lazy->run("feature.properties.height = -1; 0", features.front().get());
+        ScriptResult r = lazy->run("feature.properties.height", features.back().get());
+        REQUIRE(r.asDouble(0.0) == features.back()->getDouble("height"));
+    }
+
+    SECTION("Cached results follow changes to the feature") {
+        Feature* f = features.front().get();
+        REQUIRE(lazy->run("feature.properties.height", f).asDouble(0.0) == 10.0);
+        f->set("height", 42.0);
+        REQUIRE(lazy->run("feature.properties.height", f).asDouble(0.0) == 42.0);
+    }
+
+    SECTION("Only scripts that just read the feature are cached") {
+        Feature* f = features.front().get();
+
+        const std::string counter = "this.n = (this.n || 0) + 1; this.n + feature.properties.floors";
+        double first = lazy->run(counter, f).asDouble(0.0);
+        REQUIRE(lazy->run(counter, f).asDouble(0.0) == first + 1.0);
+
+        const std::string random = "Math.random() + feature.properties.height";
+        bool changed = false;
+        double last = lazy->run(random, f).asDouble(0.0);
+        for (int i = 0; i < 10 && !changed; ++i)
+            changed = (lazy->run(random, f).asDouble(0.0) != last);
+        REQUIRE(changed);
+    }
+}
+
+TEST_CASE("Script engine feature binding benchmark", "[.benchmark]") {
+    osg::ref_ptr<ScriptEngine> lazy = createEngine("");
+    osg::ref_ptr<ScriptEngine> eager = createEngine("eager");
+    if (!lazy.valid() || !eager.valid())
+    {
+        WARN("Skipping: the javascript script engine plugin is not available");
+        return;
+    }
+
+    const unsigned count = 100000;
+    FeatureList features;
+    makeFeatures(count, features);
+
+    const std::string script = "feature.properties.height * 2 + feature.properties.floors";
+
+    auto time = [&](const std::function<void()>& func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    double sum = 0.0;
+
+    double eagerMs = time([&]() {
+        for (auto& f : features)
+            sum += eager->run(script, f.get()).asDouble(0.0);
+    });
+
+    double lazyMs = time([&]() {
+        for (auto& f : features)
+            sum += lazy->run(script, f.get()).asDouble(0.0);
+    });
+
+    double batchMs = time([&]() {
+        std::vector<ScriptResult> results;
+        results.reserve(features.size());
+        lazy->run(script, features, results);
+        for (auto& r : results)
+            sum += r.asDouble(0.0);
+    });
+
+    double cachedMs = time([&]() {
+        for (auto& f : features)
+        {
+            sum += lazy->run(script, f.get()).asDouble(0.0);
+            sum += lazy->run(script, f.get()).asDouble(0.0);
+        }
+    });
+
+    REQUIRE(sum > 0.0);
+
+    std::cout
+        << "Script runs over " << count << " features:\n"
+        << "  eager:         " << eagerMs << " ms\n"
+        << "  lazy:          " << lazyMs << " ms\n"
+        << "  lazy (batch):  " << batchMs << " ms\n"
+        << "  lazy (x2, cached): " << cachedMs << " ms\n";
+}
@@ -0,0 +1,222 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Map>
+#include <atomic>
+#include <set>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Geodetic elevation layer that counts the tiles it creates.
+    class CountingElevationLayer : public ElevationLayer
+    {
+    public:
+        META_Layer(osgEarth, CountingElevationLayer, Options, ElevationLayer, countingelevation);
+
+        mutable std::atomic_uint _calls;
+
+        Status openImplementation() override
+        {
+            Status parent = ElevationLayer::openImplementation();
+            if (parent.isError())
+                return parent;
+
+            setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
+            return Status::OK();
+        }
+
+        GeoHeightField createHeightFieldImplementation(const TileKey& key, ProgressCallback* progress) const override
+        {
+            ++_calls;
+            osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+            hf->allocate(17, 17);
+            for (auto& h : hf->getFloatArray()->asVector())
+                h = 100.0f;
+            return GeoHeightField(hf.get(), key.getExtent());
+        }
+
+    protected:
+        void init() override
+        {
+            ElevationLayer::init();
+            _calls = 0u;
+        }
+    };
+
+    // Geodetic image layer that counts the tiles it creates.
+    class CountingSourceImageLayer : public ImageLayer
+    {
+    public:
+        META_Layer(osgEarth, CountingSourceImageLayer, Options, ImageLayer, countingsourceimage);
+
+        mutable std::atomic_uint _calls;
+
+        Status openImplementation() override
+        {
+            Status parent = ImageLayer::openImplementation();
+            if (parent.isError())
+                return parent;
+
+            setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
+            return Status::OK();
+        }
+
+        GeoImage createImageImplementation(const TileKey& key, ProgressCallback* progress) const override
+        {
+            ++_calls;
+            osg::ref_ptr<osg::Image> image = ImageUtils::createOnePixelImage(osg::Vec4(1, 0, 0, 1));
+            return GeoImage(image.get(), key.getExtent());
+        }
+
+    protected:
+        void init() override
+        {
+            ImageLayer::init();
+            _calls = 0u;
+        }
+    };
+
+    // Vertically adjacent tiles in the map profile; the latitude edges of
+    // mercator tiles don't line up with geodetic ones, so they share sources.
+    std::vector<TileKey> neighboringKeys(const Profile* profile)
+    {
+        return {
+            TileKey(4, 5, 5, profile),
+            TileKey(4, 5, 6, profile),
+            TileKey(4, 5, 7, profile) };
+    }
+}
+
+TEST_CASE("SourceTileCache")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey a(3, 1, 2, profile.get());
+    TileKey b(3, 2, 2, profile.get());
+    TileKey c(3, 3, 2, profile.get());
+
+    SourceTileCache<int> cache;
+    int value = 0;
+
+    SECTION("Is disabled until it has a size")
+    {
+        cache.insert(a, 1, 10);
+        REQUIRE_FALSE(cache.get(a, 1, value));
+        REQUIRE(cache.hits() == 0u);
+        REQUIRE(cache.misses() == 0u);
+    }
+
+    SECTION("Hits only on the same key and revision")
+    {
+        cache.setMaxSize(4u);
+        cache.insert(a, 1, 10);
+
+        REQUIRE(cache.get(a, 1, value));
+        REQUIRE(value == 10);
+        REQUIRE_FALSE(cache.get(b, 1, value));
+        REQUIRE_FALSE(cache.get(a, 2, value));
+
+        REQUIRE(cache.hits() == 1u);
+        REQUIRE(cache.misses() == 2u);
+    }
+
+    SECTION("Evicts the least recently used tile")
+    {
+        cache.setMaxSize(2u);
+        cache.insert(a, 1, 10);
+        cache.insert(b, 1, 20);
+
+        // touch a, so b is the oldest
+        REQUIRE(cache.get(a, 1, value));
+        cache.insert(c, 1, 30);
+
+        REQUIRE(cache.get(a, 1, value));
+        REQUIRE(value == 10);
+        REQUIRE(cache.get(c, 1, value));
+        REQUIRE(value == 30);
+        REQUIRE_FALSE(cache.get(b, 1, value));
+    }
+
+    SECTION("Resizing clears it")
+    {
+        cache.setMaxSize(4u);
+        cache.insert(a, 1, 10);
+        cache.setMaxSize(8u);
+        REQUIRE_FALSE(cache.get(a, 1, value));
+    }
+}
+
+TEST_CASE("Elevation layers reuse source tiles across output tiles")
+{
+    osg::ref_ptr<Map> map = new Map();
+    map->setProfile(Profile::create(Profile::SPHERICAL_MERCATOR));
+
+    osg::ref_ptr<CountingElevationLayer> layer = new CountingElevationLayer();
+    map->addLayer(layer.get());
+    REQUIRE(layer->isOpen());
+    REQUIRE(layer->getSourceTileCacheSize() > 0u);
+
+    const SourceTileCache<GeoHeightField>& cache = layer->getSourceTileCache();
+
+    for (auto& key : neighboringKeys(map->getProfile()))
+        REQUIRE(layer->createHeightField(key, nullptr).valid());
+
+    // every source tile was created once, on its first miss
+    unsigned calls = layer->_calls;
+    REQUIRE(cache.hits() > 0u);
+    REQUIRE(calls == cache.misses());
+}
+
+TEST_CASE("Image layers share source tiles through their L2 cache")
+{
+    osg::ref_ptr<Map> map = new Map();
+    map->setProfile(Profile::create(Profile::SPHERICAL_MERCATOR));
+
+    osg::ref_ptr<CountingSourceImageLayer> layer = new CountingSourceImageLayer();
+    map->addLayer(layer.get());
+    REQUIRE(layer->isOpen());
+
+    // the same source tiles assembleImage will ask for
+    std::set<TileKey> sources;
+    unsigned total = 0u;
+    for (auto& key : neighboringKeys(map->getProfile()))
+    {
+        std::vector<TileKey> intersecting;
+        layer->getProfile()->getIntersectingTiles(key, intersecting);
+        sources.insert(intersecting.begin(), intersecting.end());
+        total += intersecting.size();
+    }
+    REQUIRE(sources.size() < total);
+
+    for (auto& key : neighboringKeys(map->getProfile()))
+        REQUIRE(layer->createImage(key).valid());
+
+    // no source tile cache involved, yet each source tile was created once
+    unsigned calls = layer->_calls;
+    REQUIRE(calls == sources.size());
+}
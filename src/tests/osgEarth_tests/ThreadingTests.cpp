@@ -22,10 +22,73 @@
 
 #include <osgEarth/catch.hpp>
 #include <osgEarth/Threading>
+#include <algorithm>
 #include <thread>
 
 using namespace osgEarth;
 
+TEST_CASE("SingleFlight coalesces concurrent calls with the same key") {
+
+    Threading::SingleFlight<std::string, int> inflight;
+    std::atomic_int calls = { 0 };
+    std::atomic_int started = { 0 };
+    std::atomic_bool release = { false };
+
+    auto work = [&]() {
+        ++calls;
+        while (!release)
+            std::this_thread::yield();
+        return 42;
+    };
+
+    const int num_threads = 4;
+    std::vector<std::thread> threads;
+    std::vector<int> results(num_threads, 0);
+    std::vector<char> coalesced(num_threads, 0);
+    auto start = [&](int i) {
+        threads.emplace_back([&, i]() {
+            ++started;
+            bool c = false;
+            results[i] = inflight.run("key", work, nullptr, &c);
+            coalesced[i] = c ? 1 : 0;
+        });
+    };
+
+    // start the leader and hold it inside the call,
+    // so that everyone after it has a call to join
+    start(0);
+    while (calls < 1)
+        std::this_thread::yield();
+
+    for (int i = 1; i < num_threads; ++i)
+        start(i);
+
+    // give every thread a chance to join the leader before releasing it
+    while (started < num_threads)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    release = true;
+
+    for (auto& t : threads)
+        t.join();
+
+    for (auto r : results)
+        REQUIRE(r == 42);
+
+    // something must actually have been coalesced
+    REQUIRE(inflight.followers() > 0u);
+    REQUIRE(calls < num_threads);
+    REQUIRE(coalesced[0] == 0);
+
+    REQUIRE(calls == (int)inflight.leaders());
+    REQUIRE(inflight.leaders() + inflight.followers() == (unsigned)num_threads);
+    REQUIRE(std::count(coalesced.begin(), coalesced.end(), 1) == (int)inflight.followers());
+
+    // once nothing is in flight, the next call runs again
+    int again = inflight.run("key", []() { return 7; });
+    REQUIRE(again == 7);
+}
+
 #if 0
 namespace ReadWriteMutexTest
 {
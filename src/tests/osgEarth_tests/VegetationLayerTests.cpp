@@ -0,0 +1,131 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarthProcedural/VegetationLayer>
+#include <osgEarth/Chonk>
+#include <osgEarth/Map>
+
+using namespace osgEarth;
+using namespace osgEarth::Procedural;
+
+namespace
+{
+    // Lets a test install resident assets directly, so placement runs
+    // without loading biomes or rendering anything.
+    class TestVegetationLayer : public VegetationLayer
+    {
+    public:
+        void setAssets(const std::string& group, const Biome* biome, const std::vector<ResidentModelAssetInstance>& instances)
+        {
+            std::lock_guard<std::mutex> lock(_assets.mutex());
+            auto& entry = _assets[group][biome->id()];
+            entry.biome = biome;
+            entry.instances = instances;
+        }
+    };
+
+    ResidentModelAssetInstance makeInstance(const ModelAsset* asset, const osg::BoundingBox& box, float weight)
+    {
+        auto resident = ResidentModelAsset::create();
+        resident->assetDef() = asset;
+        resident->boundingBox() = box;
+        resident->chonk() = Chonk::create();
+
+        ResidentModelAssetInstance instance;
+        instance.residentAsset() = resident;
+        instance.weight() = weight;
+        return instance;
+    }
+
+    std::vector<VegetationLayer::Placement> place(TestVegetationLayer* layer, const TileKey& key, unsigned threads)
+    {
+        layer->options().placementThreads() = threads;
+        std::vector<VegetationLayer::Placement> output;
+        layer->getAssetPlacements(key, "trees", false, output, nullptr);
+        return output;
+    }
+
+    bool samePlacements(const std::vector<VegetationLayer::Placement>& a, const std::vector<VegetationLayer::Placement>& b)
+    {
+        if (a.size() != b.size())
+            return false;
+
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].mapPoint() != b[i].mapPoint() ||
+                a[i].localPoint() != b[i].localPoint() ||
+                a[i].uv() != b[i].uv() ||
+                a[i].scale() != b[i].scale() ||
+                a[i].rotation() != b[i].rotation() ||
+                a[i].asset() != b[i].asset() ||
+                a[i].density() != b[i].density() ||
+                a[i].biome != b[i].biome)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST_CASE("VegetationLayer places the same assets every time")
+{
+    osg::ref_ptr<Map> map = new Map();
+
+    // no biome map, so every candidate falls in the one biome with assets
+    osg::ref_ptr<BiomeLayer> biomes = new BiomeLayer();
+    biomes->options().biomeCatalog() = std::make_shared<BiomeCatalog>();
+
+    Biome forest;
+    forest.id() = "forest";
+
+    ModelAsset pine, oak;
+    pine.name() = "pine";
+    pine.group() = "trees";
+    pine.sizeVariation() = 0.3f;
+    oak.name() = "oak";
+    oak.group() = "trees";
+
+    osg::ref_ptr<TestVegetationLayer> layer = new TestVegetationLayer();
+    layer->setBiomeLayer(biomes.get());
+    layer->addedToMap(map.get());
+    layer->setAssets("trees", &forest, {
+        makeInstance(&pine, osg::BoundingBox(-2, -2, 0, 2, 2, 12), 1.0f),
+        makeInstance(&oak, osg::BoundingBox(-4, -4, 0, 4, 4, 9), 2.0f) });
+
+    // big enough to split the selection pass across jobs
+    TileKey key(14, 16000, 5000, map->getProfile());
+
+    std::vector<VegetationLayer::Placement> first = place(layer.get(), key, 4u);
+    REQUIRE_FALSE(first.empty());
+
+    SECTION("Running again gives identical placements")
+    {
+        REQUIRE(samePlacements(first, place(layer.get(), key, 4u)));
+    }
+
+    SECTION("Splitting the work gives the same placements as not splitting it")
+    {
+        REQUIRE(samePlacements(first, place(layer.get(), key, 1u)));
+    }
+}